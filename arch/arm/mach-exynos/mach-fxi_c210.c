@@ -24,12 +24,16 @@
 #include <linux/pm_runtime.h>
 #include <linux/w1-gpio.h>
 #include <linux/clk.h>
+#include <linux/opp.h>
 
 #include <linux/dma-mapping.h>
 #include <linux/memblock.h>
 #include <linux/dma-contiguous.h>
+#include <linux/ion.h>
 
 #include <linux/mali/mali_utgard.h>
+#include <linux/fb.h>
+#include <drm/exynos_drm.h>
 
 #include <asm/mach/arch.h>
 #include <asm/hardware/gic.h>
@@ -55,12 +59,16 @@
 
 #include "common.h"
 
+/* CMA areas of the MFC memory ports, see s5p_mfc_reserve_mem() */
 #define MFC_RBASE 0x43000000
 #define MFC_RSIZE (32 << 20)
 
 #define MFC_LBASE 0x51000000
 #define MFC_LSIZE (32 << 20)
 
+/* CMA area shared by the video, camera and display buffers allocated from ion */
+#define FXI_ION_CMA_SIZE (64 << 20)
+
 #define FXI_W1_GPIO_PIN EXYNOS4_GPK3(1)
 
 /* Following are default values for UCON, ULCON and UFCON UART registers */
@@ -770,6 +778,7 @@ static struct resource mali_gpu_resource[] = {
 
 static struct mali_gpu_device_data mali_device_data = {
 	.shared_mem_size = 0x18000000, /* ~400MiB */
+	.utilization_interval = 100, /* ms, also the DVFS sampling period */
 };
 
 static struct platform_device mali_gpu = {
@@ -779,12 +788,39 @@ static struct platform_device mali_gpu = {
 	.resource = mali_gpu_resource,
 };
 
+#ifdef CONFIG_PM_OPP
+/* sclk_g3d is divided down from the 800MHz MPLL, vdd_g3d is MAX8997 BUCK3 */
+static struct {
+	unsigned long freq;
+	unsigned long volt;
+} mali_opp_table[] = {
+	{ 100000000, 900000 },
+	{ MALI_GPU_FREQ, 950000 },
+	{ 266666666, 1050000 },
+};
+
+static void init_mali_opp(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mali_opp_table); i++) {
+		if (opp_add(&mali_gpu.dev, mali_opp_table[i].freq,
+			    mali_opp_table[i].volt) < 0)
+			printk(KERN_ERR "%s: failed to add %luHz\n", __func__,
+			       mali_opp_table[i].freq);
+	}
+}
+#else
+static inline void init_mali_opp(void) {}
+#endif
+
 static void init_mali_gpu(void)
 {
 	if (init_mali_clock() < 0) {
 		printk(KERN_ERR "%s: Error initializing mali clock\n", __func__);
 		return;
 	}
+	init_mali_opp();
 	if (platform_device_add_data(&mali_gpu, &mali_device_data, sizeof (mali_device_data)) < 0) {
 		printk(KERN_ERR "%s: Error setting mali device data\n",__func__);
 		return;
@@ -796,9 +832,16 @@ static void init_mali_gpu(void)
 	pm_runtime_enable(&mali_gpu.dev);
 }
 
+/* mali_drm allocates its buffer objects from the default CMA area */
+static u64 fxi_mali_drm_dmamask = DMA_BIT_MASK(32);
+
 static struct platform_device fxi_mali_drm = {
 	.name = "mali_drm",
 	.id = -1,
+	.dev = {
+		.dma_mask = &fxi_mali_drm_dmamask,
+		.coherent_dma_mask = DMA_BIT_MASK(32),
+	},
 };
 
 static struct platform_device ccandy_audio = {
@@ -811,6 +854,90 @@ struct platform_device anyscreen = {
 	.id   = -1,
 };
 
+#ifdef CONFIG_ION_EXYNOS
+static struct ion_platform_data fxi_c210_ion_pdata = {
+	.nr = 2,
+	.heaps = {
+		{
+			.type = ION_HEAP_TYPE_SYSTEM,
+			.id = ION_HEAP_TYPE_SYSTEM,
+			.name = "system",
+		},
+		{
+			/* allocates from the CMA area of fxi_c210_ion */
+			.type = ION_HEAP_TYPE_DMA,
+			.id = ION_HEAP_TYPE_DMA,
+			.name = "cma",
+		},
+	},
+};
+
+static u64 fxi_c210_ion_dmamask = DMA_BIT_MASK(32);
+
+static struct platform_device fxi_c210_ion = {
+	.name = "ion-exynos",
+	.id = -1,
+	.dev = {
+		.platform_data = &fxi_c210_ion_pdata,
+		.dma_mask = &fxi_c210_ion_dmamask,
+		.coherent_dma_mask = DMA_BIT_MASK(32),
+	},
+};
+#endif
+
+#ifdef CONFIG_DRM_EXYNOS
+/*
+ * Exynos DRM is opt-in: the Ubuntu defconfig keeps the s5p-tv V4L2 drivers
+ * and videobuf2-fb, whose fb ioctls the Anyscreen gadget relies on.  With
+ * CONFIG_DRM_EXYNOS_HDMI (which excludes s5p-tv) the HDMI output is driven
+ * by DRM instead: the mixer's graphic and video layers become planes of
+ * one CRTC, and page flips complete on the mixer's vsync interrupt.
+ */
+static u64 fxi_c210_drm_dmamask = DMA_BIT_MASK(32);
+
+static struct platform_device fxi_c210_drm = {
+	.name = "exynos-drm",
+	.id = -1,
+	.dev = {
+		.dma_mask = &fxi_c210_drm_dmamask,
+		.coherent_dma_mask = DMA_BIT_MASK(32),
+	},
+};
+
+#ifdef CONFIG_DRM_EXYNOS_HDMI
+static struct exynos_drm_hdmi_pdata fxi_c210_drm_hdmi_pdata = {
+	.is_v13		= 1,
+	.default_win	= 0,
+	.bpp		= 32,
+};
+
+static struct exynos_drm_common_hdmi_pd fxi_c210_drm_common_hdmi_pdata = {
+	.hdmi_dev	= &s5p_device_hdmi.dev,
+	.mixer_dev	= &s5p_device_mixer.dev,
+};
+
+static struct platform_device fxi_c210_drm_hdmi = {
+	.name = "exynos-drm-hdmi",
+	.id = -1,
+	.dev = {
+		.platform_data = &fxi_c210_drm_common_hdmi_pdata,
+	},
+};
+
+static struct i2c_board_info fxi_c210_drm_hdmiphy_info __initdata = {
+	I2C_BOARD_INFO("s5p_hdmiphy", 0x38),
+};
+#endif
+
+#ifdef CONFIG_DRM_EXYNOS_VIDI
+/* virtual display, connected from userspace, to test without a monitor */
+static struct platform_device fxi_c210_drm_vidi = {
+	.name = "exynos-drm-vidi",
+	.id = -1,
+};
+#endif
+#endif
+
 static struct platform_device *fxi_c210_devices[] __initdata = {
 	&s3c_device_hsmmc2,
 	&s3c_device_hsmmc0,
@@ -847,13 +974,27 @@ static struct platform_device *fxi_c210_devices[] __initdata = {
   	&fxi_fxiid,
 	&fxi_mali_drm,
 	&ccandy_audio,
-	&exynos4_device_sysmmu
+	&exynos4_device_sysmmu,
+#ifdef CONFIG_ION_EXYNOS
+	&fxi_c210_ion,
+#endif
+#ifdef CONFIG_DRM_EXYNOS_HDMI
+	&fxi_c210_drm_hdmi,
+#endif
+#ifdef CONFIG_DRM_EXYNOS_VIDI
+	&fxi_c210_drm_vidi,
+#endif
+#ifdef CONFIG_DRM_EXYNOS
+	&fxi_c210_drm,
+#endif
 };
 
+#ifndef CONFIG_DRM_EXYNOS_HDMI
 /* I2C module and id for HDMIPHY */
 static struct i2c_board_info hdmiphy_info = {
         I2C_BOARD_INFO("hdmiphy", 0x38),
 };
+#endif
 
 static struct s5p_platform_cec hdmi_cec_data __initdata = {
 
@@ -906,6 +1047,12 @@ static void __init fxi_c210_power_init(void)
 static void __init fxi_c210_reserve(void)
 {
   s5p_mfc_reserve_mem(MFC_RBASE, MFC_RSIZE, MFC_LBASE, MFC_LSIZE);
+
+#ifdef CONFIG_ION_EXYNOS
+	if (dma_declare_contiguous(&fxi_c210_ion.dev, FXI_ION_CMA_SIZE, 0, 0))
+		printk(KERN_ERR "%s: failed to reserve %u bytes for ion\n",
+		       __func__, FXI_ION_CMA_SIZE);
+#endif
 }
 
 static void __init fxi_c210_machine_init(void)
@@ -933,7 +1080,14 @@ static void __init fxi_c210_machine_init(void)
 
 	s5p_tv_setup();
 	s5p_i2c_hdmiphy_set_platdata(NULL);
+#ifdef CONFIG_DRM_EXYNOS_HDMI
+	/* the DRM HDMI driver and its clocks go by the exynos4 name */
+	s5p_device_hdmi.name = "exynos4-hdmi";
+	s5p_device_hdmi.dev.platform_data = &fxi_c210_drm_hdmi_pdata;
+	i2c_register_board_info(8, &fxi_c210_drm_hdmiphy_info, 1);
+#else
 	s5p_hdmi_set_platdata(&hdmiphy_info, NULL, 0);
+#endif
 
 	s5p_hdmi_cec_set_platdata(&hdmi_cec_data);
 
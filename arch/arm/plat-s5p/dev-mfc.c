@@ -32,5 +32,5 @@ void __init s5p_mfc_reserve_mem(phys_addr_t rbase, unsigned int rsize,
 
 	if (dma_declare_contiguous(&s5p_device_mfc_l.dev, lsize, lbase, 0))
 		printk(KERN_ERR "Failed to reserve memory for MFC device (%u bytes at 0x%08lx)\n",
-		       rsize, (unsigned long) rbase);
+		       lsize, (unsigned long) lbase);
 }
@@ -19,7 +19,10 @@
  *
  * This function reserves system memory for both MFC device memory
  * interfaces and registers it to respective struct device entries as
- * coherent memory.
+ * contiguous memory areas (CMA). The areas are used for movable pages
+ * while the MFC does not need them, and are only taken by the driver when
+ * it is opened and as it allocates its buffers. The areas are at fixed
+ * addresses, as the two interfaces have to reach different memory banks.
  */
 void __init s5p_mfc_reserve_mem(phys_addr_t rbase, unsigned int rsize,
 				phys_addr_t lbase, unsigned int lsize);
@@ -24,6 +24,8 @@
 
 #include <linux/memblock.h>
 #include <linux/err.h>
+#include <linux/export.h>
+#include <linux/ktime.h>
 #include <linux/mm.h>
 #include <linux/mutex.h>
 #include <linux/page-isolation.h>
@@ -40,6 +42,7 @@ struct cma {
 	unsigned long	base_pfn;
 	unsigned long	count;
 	unsigned long	*bitmap;
+	struct dma_contiguous_stats stats;
 };
 
 struct cma *dma_contiguous_default_area;
@@ -175,6 +178,8 @@ static __init struct cma *cma_create_area(unsigned long base_pfn,
 	cma->base_pfn = base_pfn;
 	cma->count = count;
 	cma->bitmap = kzalloc(bitmap_size, GFP_KERNEL);
+	memset(&cma->stats, 0, sizeof(cma->stats));
+	cma->stats.size = count << PAGE_SHIFT;
 
 	if (!cma->bitmap)
 		goto no_mem;
@@ -299,6 +304,21 @@ err:
 	return base;
 }
 
+/* Called with cma_mutex held */
+static void cma_account_alloc(struct cma *cma, int count, s64 us)
+{
+	struct dma_contiguous_stats *st = &cma->stats;
+
+	st->used += count << PAGE_SHIFT;
+	if (st->used > st->max_used)
+		st->max_used = st->used;
+	st->allocs++;
+	st->last_us = us;
+	if (us > st->max_us)
+		st->max_us = us;
+	st->total_us += us;
+}
+
 /**
  * dma_alloc_from_contiguous() - allocate pages from contiguous area
  * @dev:   Pointer to device for which the allocation is performed.
@@ -315,6 +335,7 @@ struct page *dma_alloc_from_contiguous(struct device *dev, int count,
 {
 	unsigned long mask, pfn, pageno, start = 0;
 	struct cma *cma = dev_get_cma_area(dev);
+	ktime_t t;
 	int ret;
 
 	if (!cma || !cma->count)
@@ -332,6 +353,7 @@ struct page *dma_alloc_from_contiguous(struct device *dev, int count,
 	mask = (1 << align) - 1;
 
 	mutex_lock(&cma_mutex);
+	t = ktime_get();
 
 	for (;;) {
 		pageno = bitmap_find_next_zero_area(cma->bitmap, cma->count,
@@ -351,15 +373,18 @@ struct page *dma_alloc_from_contiguous(struct device *dev, int count,
 		}
 		pr_debug("%s(): memory range at %p is busy, retrying\n",
 			 __func__, pfn_to_page(pfn));
+		cma->stats.busy++;
 		/* try again with a bit different memory target */
 		start = pageno + mask + 1;
 	}
 
+	cma_account_alloc(cma, count, ktime_us_delta(ktime_get(), t));
 	mutex_unlock(&cma_mutex);
 
 	pr_debug("%s(): returned %p\n", __func__, pfn_to_page(pfn));
 	return pfn_to_page(pfn);
 error:
+	cma->stats.fails++;
 	mutex_unlock(&cma_mutex);
 	return NULL;
 }
@@ -395,7 +420,32 @@ bool dma_release_from_contiguous(struct device *dev, struct page *pages,
 	mutex_lock(&cma_mutex);
 	bitmap_clear(cma->bitmap, pfn - cma->base_pfn, count);
 	free_contig_range(pfn, count);
+	cma->stats.used -= count << PAGE_SHIFT;
 	mutex_unlock(&cma_mutex);
 
 	return true;
 }
+
+/**
+ * dma_contiguous_get_stats() - get usage of a contiguous area
+ * @dev:   Pointer to device which allocates from the area.
+ * @stats: Filled with the counters of the area.
+ *
+ * This function reports how much of the area the device allocates from is
+ * in use, so that the rest can be told to be available to movable pages,
+ * and how long the allocations took to migrate those pages out of the way.
+ */
+int dma_contiguous_get_stats(struct device *dev,
+			     struct dma_contiguous_stats *stats)
+{
+	struct cma *cma = dev_get_cma_area(dev);
+
+	if (!cma)
+		return -ENODEV;
+
+	mutex_lock(&cma_mutex);
+	*stats = cma->stats;
+	mutex_unlock(&cma_mutex);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(dma_contiguous_get_stats);
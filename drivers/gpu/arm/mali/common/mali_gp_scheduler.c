@@ -17,6 +17,7 @@
 #include "mali_gp_job.h"
 #include "mali_group.h"
 #include "mali_pm.h"
+#include "mali_memory.h"
 
 enum mali_gp_slot_state
 {
@@ -303,6 +304,9 @@ _mali_osk_errcode_t _mali_ukk_gp_start_job(void *ctx, _mali_uk_gp_start_job_s *u
 
 	session = (struct mali_session_data*)ctx;
 
+	/* Zap once for all memory unmapped since the last job of this session */
+	mali_memory_session_flush_unmapped(session);
+
 	job = mali_gp_job_create(session, uargs, mali_scheduler_get_new_id());
 	if (NULL == job)
 	{
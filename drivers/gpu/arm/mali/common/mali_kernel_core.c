@@ -1046,6 +1046,11 @@ _mali_osk_errcode_t _mali_ukk_open(void **context)
 	}
 #endif
 
+	session->pid = _mali_osk_get_pid();
+	session->pp_priority = MALI_SESSION_PRIORITY_NORMAL;
+	_MALI_OSK_INIT_LIST_HEAD(&session->pp_job_queue);
+	_MALI_OSK_INIT_LIST_HEAD(&session->pp_queue_link);
+
 	*context = (void*)session;
 
 	/* Add session to the list of all sessions. */
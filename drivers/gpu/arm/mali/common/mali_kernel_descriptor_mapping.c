@@ -40,7 +40,7 @@ mali_descriptor_mapping * mali_descriptor_mapping_create(int init_entries, int m
 		map->table = descriptor_table_alloc(init_entries);
 		if (NULL != map->table)
 		{
-            map->lock = _mali_osk_lock_init( (_mali_osk_lock_flags_t)(_MALI_OSK_LOCKFLAG_ORDERED | _MALI_OSK_LOCKFLAG_READERWRITER | _MALI_OSK_LOCKFLAG_NONINTERRUPTABLE), 0, _MALI_OSK_LOCK_ORDER_DESCRIPTOR_MAP);
+            map->lock = _mali_osk_lock_init( (_mali_osk_lock_flags_t)(_MALI_OSK_LOCKFLAG_ORDERED | _MALI_OSK_LOCKFLAG_NONINTERRUPTABLE), 0, _MALI_OSK_LOCK_ORDER_DESCRIPTOR_MAP);
             if (NULL != map->lock)
             {
 			    _mali_osk_set_nonatomic_bit(0, map->table->usage); /* reserve bit 0 to prevent NULL/zero logic to kick in */
@@ -78,20 +78,23 @@ _mali_osk_errcode_t mali_descriptor_mapping_allocate_mapping(mali_descriptor_map
 		mali_descriptor_table * new_table, * old_table;
 		if (map->current_nr_mappings >= map->max_nr_mappings_allowed) goto unlock_and_exit;
 
-        map->current_nr_mappings += BITS_PER_LONG;
-		new_table = descriptor_table_alloc(map->current_nr_mappings);
+		new_table = descriptor_table_alloc(map->current_nr_mappings + BITS_PER_LONG);
 		if (NULL == new_table) goto unlock_and_exit;
 
         old_table = map->table;
 		_mali_osk_memcpy(new_table->usage, old_table->usage, (sizeof(unsigned long)*map->current_nr_mappings) / BITS_PER_LONG);
 		_mali_osk_memcpy(new_table->mappings, old_table->mappings, map->current_nr_mappings * sizeof(void*));
-		map->table = new_table;
+		_mali_osk_rcu_assign_pointer(map->table, new_table);
+		map->current_nr_mappings += BITS_PER_LONG;
+
+		/* lookups may still be using the old table */
+		_mali_osk_synchronize_rcu();
 		descriptor_table_free(old_table);
 	}
 
 	/* we have found a valid descriptor, set the value and usage bit */
 	_mali_osk_set_nonatomic_bit(new_descriptor, map->table->usage);
-	map->table->mappings[new_descriptor] = target;
+	_mali_osk_rcu_assign_pointer(map->table->mappings[new_descriptor], target);
 	*odescriptor = new_descriptor;
     err = _MALI_OSK_ERR_OK;
 
@@ -107,7 +110,7 @@ void mali_descriptor_mapping_call_for_each(mali_descriptor_mapping * map, void (
 	MALI_DEBUG_ASSERT_POINTER(map);
 	MALI_DEBUG_ASSERT_POINTER(callback);
 
-    _mali_osk_lock_wait(map->lock, _MALI_OSK_LOCKMODE_RO);
+    _mali_osk_lock_wait(map->lock, _MALI_OSK_LOCKMODE_RW);
 	/* id 0 is skipped as it's an reserved ID not mapping to anything */
 	for (i = 1; i < map->current_nr_mappings; ++i)
 	{
@@ -116,34 +119,41 @@ void mali_descriptor_mapping_call_for_each(mali_descriptor_mapping * map, void (
 			callback(i, map->table->mappings[i]);
 		}
 	}
-    _mali_osk_lock_signal(map->lock, _MALI_OSK_LOCKMODE_RO);
+    _mali_osk_lock_signal(map->lock, _MALI_OSK_LOCKMODE_RW);
 }
 
 _mali_osk_errcode_t mali_descriptor_mapping_get(mali_descriptor_mapping * map, int descriptor, void** target)
 {
 	_mali_osk_errcode_t result = _MALI_OSK_ERR_FAULT;
+	mali_descriptor_table * table;
 	MALI_DEBUG_ASSERT_POINTER(map);
-    _mali_osk_lock_wait(map->lock, _MALI_OSK_LOCKMODE_RO);
-	if ( (descriptor >= 0) && (descriptor < map->current_nr_mappings) && _mali_osk_test_bit(descriptor, map->table->usage) )
+
+	/*
+	 * Lock free: the table is only freed after a grace period, and a slot
+	 * is published by its value, so a NULL value means not in use.
+	 */
+	_mali_osk_rcu_read_lock();
+	table = _mali_osk_rcu_dereference(map->table);
+	*target = NULL;
+	if ( (descriptor >= 0) && (descriptor < table->count) )
 	{
-		*target = map->table->mappings[descriptor];
-		result = _MALI_OSK_ERR_OK;
+		*target = _mali_osk_rcu_dereference(table->mappings[descriptor]);
+		if (NULL != *target) result = _MALI_OSK_ERR_OK;
 	}
-	else *target = NULL;
-    _mali_osk_lock_signal(map->lock, _MALI_OSK_LOCKMODE_RO);
+	_mali_osk_rcu_read_unlock();
 	MALI_ERROR(result);
 }
 
 _mali_osk_errcode_t mali_descriptor_mapping_set(mali_descriptor_mapping * map, int descriptor, void * target)
 {
 	_mali_osk_errcode_t result = _MALI_OSK_ERR_FAULT;
-    _mali_osk_lock_wait(map->lock, _MALI_OSK_LOCKMODE_RO);
+    _mali_osk_lock_wait(map->lock, _MALI_OSK_LOCKMODE_RW);
 	if ( (descriptor >= 0) && (descriptor < map->current_nr_mappings) && _mali_osk_test_bit(descriptor, map->table->usage) )
 	{
-		map->table->mappings[descriptor] = target;
+		_mali_osk_rcu_assign_pointer(map->table->mappings[descriptor], target);
 		result = _MALI_OSK_ERR_OK;
 	}
-    _mali_osk_lock_signal(map->lock, _MALI_OSK_LOCKMODE_RO);
+    _mali_osk_lock_signal(map->lock, _MALI_OSK_LOCKMODE_RW);
 	MALI_ERROR(result);
 }
 
@@ -155,7 +165,7 @@ void *mali_descriptor_mapping_free(mali_descriptor_mapping * map, int descriptor
 	if ( (descriptor >= 0) && (descriptor < map->current_nr_mappings) && _mali_osk_test_bit(descriptor, map->table->usage) )
 	{
 		old_value = map->table->mappings[descriptor];
-		map->table->mappings[descriptor] = NULL;
+		_mali_osk_rcu_assign_pointer(map->table->mappings[descriptor], NULL);
 		_mali_osk_clear_nonatomic_bit(descriptor, map->table->usage);
 	}
     _mali_osk_lock_signal(map->lock, _MALI_OSK_LOCKMODE_RW);
@@ -173,6 +183,7 @@ static mali_descriptor_table * descriptor_table_alloc(int count)
 	{
 		table->usage = (u32*)((u8*)table + sizeof(mali_descriptor_table));
 		table->mappings = (void**)((u8*)table + sizeof(mali_descriptor_table) + ((sizeof(unsigned long) * count)/BITS_PER_LONG));
+		table->count = count;
 	}
 
 	return table;
@@ -19,9 +19,11 @@
 
 /**
  * The actual descriptor mapping table, never directly accessed by clients
+ * A grown map gets a new table; the old one is freed once no lookup can see it
  */
 typedef struct mali_descriptor_table
 {
+	int count; /**< Number of mappings the table has room for */
 	u32 * usage; /**< Pointer to bitpattern indicating if a descriptor is valid/used or not */
 	void** mappings; /**< Array of the pointers the descriptors map to */
 } mali_descriptor_table;
@@ -32,7 +34,7 @@ typedef struct mali_descriptor_table
  */
 typedef struct mali_descriptor_mapping
 {
-    _mali_osk_lock_t *lock; /**< Lock protecting access to the mapping object */
+    _mali_osk_lock_t *lock; /**< Lock serializing changes to the mapping object, lookups do not take it */
 	int max_nr_mappings_allowed; /**< Max number of mappings to support in this namespace */
 	int current_nr_mappings; /**< Current number of possible mappings */
 	mali_descriptor_table * table; /**< Pointer to the current mapping table */
@@ -64,6 +66,7 @@ _mali_osk_errcode_t mali_descriptor_mapping_allocate_mapping(mali_descriptor_map
 
 /**
  * Get the value mapped to by a descriptor ID
+ * Does not take the mapping lock, so it may run concurrently with changes to the map
  * @param map The map to lookup the descriptor id in
  * @param descriptor The descriptor ID to lookup
  * @param target Pointer to a pointer which will receive the stored value
@@ -109,14 +109,27 @@ typedef struct mali_mmu_page_table_allocation
 	mali_page_table_block pages;
 } mali_mmu_page_table_allocation;
 
+/*
+ * All pages not handed out by the cache are zero, so page tables and page
+ * directories come out of mali_mmu_get_table_page() ready to use.
+ */
 typedef struct mali_mmu_page_table_allocations
 {
 	_mali_osk_lock_t *lock;
 	_mali_osk_list_t partial;
 	_mali_osk_list_t full;
-	/* we never hold on to a empty allocation */
+	_mali_osk_list_t free; /* empty allocations, kept up to MALI_MMU_PAGE_TABLE_CACHE_FREE_MAX pages */
+	u32 free_pages;
 } mali_mmu_page_table_allocations;
 
+/* Empty page table allocations kept by the cache, in pages. One 64 page
+ * allocation covers the page directory and tables of a typical session. */
+#define MALI_MMU_PAGE_TABLE_CACHE_FREE_MAX 128
+
+/* Bytes of unmapped memory a session may hold on to before it is zapped
+ * and freed without waiting for the next job start. */
+#define MALI_MEMORY_UNMAPPED_MAX (4 * 1024 * 1024)
+
 static mali_kernel_mem_address_manager mali_address_manager =
 {
 	mali_address_manager_allocate, /* allocate */
@@ -128,6 +141,10 @@ static mali_kernel_mem_address_manager mali_address_manager =
 /* the mmu page table cache */
 static struct mali_mmu_page_table_allocations page_table_cache;
 
+/* table_* members are protected by the page table cache lock, the rest by mmu_stats_lock */
+static mali_mmu_stats mmu_stats;
+static _mali_osk_lock_t *mmu_stats_lock = NULL;
+
 
 static mali_kernel_mem_address_manager process_address_manager =
 {
@@ -139,6 +156,7 @@ static mali_kernel_mem_address_manager process_address_manager =
 
 static _mali_osk_errcode_t mali_mmu_page_table_cache_create(void);
 static void mali_mmu_page_table_cache_destroy(void);
+static void mali_memory_session_flush_unmapped_locked(struct mali_session_data *session_data);
 
 static mali_allocation_engine memory_engine = NULL;
 static mali_physical_memory_allocator * physical_memory_allocators = NULL;
@@ -157,9 +175,15 @@ _mali_osk_errcode_t mali_memory_initialize(void)
 
 	MALI_DEBUG_PRINT(2, ("Memory system initializing\n"));
 
+	mmu_stats_lock = _mali_osk_lock_init( _MALI_OSK_LOCKFLAG_ORDERED | _MALI_OSK_LOCKFLAG_SPINLOCK
+	                                | _MALI_OSK_LOCKFLAG_NONINTERRUPTABLE, 0, _MALI_OSK_LOCK_ORDER_MEM_STATS);
+	MALI_CHECK_NON_NULL( mmu_stats_lock, _MALI_OSK_ERR_FAULT );
+
 	err = mali_mmu_page_table_cache_create();
 	if(_MALI_OSK_ERR_OK != err)
 	{
+		_mali_osk_lock_term(mmu_stats_lock);
+		mmu_stats_lock = NULL;
 		MALI_ERROR(err);
 	}
 
@@ -198,6 +222,37 @@ void mali_memory_terminate(void)
 		mali_allocation_engine_destroy(memory_engine);
 		memory_engine = NULL;
 	}
+
+	if (NULL != mmu_stats_lock)
+	{
+		_mali_osk_lock_term(mmu_stats_lock);
+		mmu_stats_lock = NULL;
+	}
+}
+
+/* Adds the time since start_ns to the MMU management time, and counts an operation if counter is given */
+static void mali_mmu_stats_add(u32 *counter, u64 start_ns)
+{
+	u64 ns = _mali_osk_time_get_ns() - start_ns;
+
+	_mali_osk_lock_wait(mmu_stats_lock, _MALI_OSK_LOCKMODE_RW);
+	if (NULL != counter)
+	{
+		(*counter)++;
+	}
+	mmu_stats.ns_total += ns;
+	_mali_osk_lock_signal(mmu_stats_lock, _MALI_OSK_LOCKMODE_RW);
+}
+
+void mali_mmu_get_stats(mali_mmu_stats *stats)
+{
+	MALI_DEBUG_ASSERT_POINTER(stats);
+
+	_mali_osk_lock_wait(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
+	_mali_osk_lock_wait(mmu_stats_lock, _MALI_OSK_LOCKMODE_RW);
+	*stats = mmu_stats;
+	_mali_osk_lock_signal(mmu_stats_lock, _MALI_OSK_LOCKMODE_RW);
+	_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
 }
 
 _mali_osk_errcode_t mali_memory_session_begin(struct mali_session_data * session_data)
@@ -223,6 +278,8 @@ _mali_osk_errcode_t mali_memory_session_begin(struct mali_session_data * session
 
 	/* Init the session's memory allocation list */
 	_MALI_OSK_INIT_LIST_HEAD( &session_data->memory_head );
+	_MALI_OSK_INIT_LIST_HEAD( &session_data->memory_unmapped );
+	session_data->memory_unmapped_size = 0;
 
 	MALI_DEBUG_PRINT(5, ("MMU session begin: success\n"));
 	MALI_SUCCESS;
@@ -308,8 +365,11 @@ void mali_memory_session_end(struct mali_session_data *session_data)
 			}
 		}
 	}
+	mali_memory_session_flush_unmapped_locked(session_data);
+
 	/* Assert that we really did free everything */
 	MALI_DEBUG_ASSERT( _mali_osk_list_empty(&session_data->memory_head) );
+	MALI_DEBUG_ASSERT( _mali_osk_list_empty(&session_data->memory_unmapped) );
 
 	if (NULL != session_data->descriptor_mapping)
 	{
@@ -896,7 +956,9 @@ _mali_osk_errcode_t _mali_ukk_term_mem( _mali_uk_term_mem_s *args )
 static _mali_osk_errcode_t mali_address_manager_allocate(mali_memory_allocation * descriptor)
 {
 	struct mali_session_data *session_data;
+	_mali_osk_errcode_t err;
 	u32 actual_size;
+	u64 start_ns = _mali_osk_time_get_ns();
 
 	MALI_DEBUG_ASSERT_POINTER(descriptor);
 
@@ -909,21 +971,27 @@ static _mali_osk_errcode_t mali_address_manager_allocate(mali_memory_allocation
 		actual_size += _MALI_OSK_MALI_PAGE_SIZE;
 	}
 
-	return mali_mmu_pagedir_map(session_data->page_directory, descriptor->mali_address, actual_size);
+	err = mali_mmu_pagedir_map(session_data->page_directory, descriptor->mali_address, actual_size);
+	mali_mmu_stats_add(&mmu_stats.map_ops, start_ns);
+
+	return err;
 }
 
 static void mali_address_manager_release(mali_memory_allocation * descriptor)
 {
 	const u32 illegal_mali_address = 0xffffffff;
 	struct mali_session_data *session_data;
+	u64 start_ns;
 	MALI_DEBUG_ASSERT_POINTER(descriptor);
 
 	/* It is allowed to call this function several times on the same descriptor.
 	   When memory is released we set the illegal_mali_address so we can early out here. */
 	if ( illegal_mali_address == descriptor->mali_address) return;
 
+	start_ns = _mali_osk_time_get_ns();
 	session_data = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
 	mali_mmu_pagedir_unmap(session_data->page_directory, descriptor->mali_address, descriptor->size);
+	mali_mmu_stats_add(&mmu_stats.unmap_ops, start_ns);
 
 	descriptor->mali_address = illegal_mali_address ;
 }
@@ -932,6 +1000,7 @@ static _mali_osk_errcode_t mali_address_manager_map(mali_memory_allocation * des
 {
 	struct mali_session_data *session_data;
 	u32 mali_address;
+	u64 start_ns = _mali_osk_time_get_ns();
 
 	MALI_DEBUG_ASSERT_POINTER(descriptor);
 	MALI_DEBUG_ASSERT_POINTER(phys_addr);
@@ -944,6 +1013,7 @@ static _mali_osk_errcode_t mali_address_manager_map(mali_memory_allocation * des
 	MALI_DEBUG_PRINT(7, ("Mali map: mapping 0x%08X to Mali address 0x%08X length 0x%08X\n", *phys_addr, mali_address, size));
 
 	mali_mmu_pagedir_update(session_data->page_directory, mali_address, *phys_addr, size, descriptor->cache_settings);
+	mali_mmu_stats_add(NULL, start_ns);
 
 	MALI_SUCCESS;
 }
@@ -1020,6 +1090,31 @@ static _mali_osk_errcode_t _mali_ukk_mem_munmap_internal( _mali_uk_mem_munmap_s
 	   It is allowed to call this function severeal times, which might happen if zapping below fails. */
 	mali_allocation_engine_release_pt1_mali_pagetables_unmap(memory_engine, descriptor);
 
+	/* Cores running the session may still have the old entries in their TLBs, so the physical memory
+	   is only released after a zap. Queue it, so that all unmaps until the next job start share one zap. */
+	_mali_osk_list_move(&descriptor->list, &session_data->memory_unmapped);
+	session_data->memory_unmapped_size += descriptor->size;
+
+	if (MALI_MEMORY_UNMAPPED_MAX <= session_data->memory_unmapped_size)
+	{
+		mali_memory_session_flush_unmapped_locked(session_data);
+	}
+
+	return _MALI_OSK_ERR_OK;
+}
+
+static void mali_memory_session_flush_unmapped_locked(struct mali_session_data *session_data)
+{
+	mali_memory_allocation *descriptor;
+	mali_memory_allocation *temp;
+	u64 start_ns;
+
+	if (_mali_osk_list_empty(&session_data->memory_unmapped)) return;
+
+	MALI_DEBUG_PRINT(5, ("Zapping session 0x%08X for %u unmapped bytes\n", session_data, session_data->memory_unmapped_size));
+
+	start_ns = _mali_osk_time_get_ns();
+
 #ifdef MALI_UNMAP_FLUSH_ALL_MALI_L2
 	{
 		u32 i;
@@ -1037,13 +1132,28 @@ static _mali_osk_errcode_t _mali_ukk_mem_munmap_internal( _mali_uk_mem_munmap_s
 #endif
 
 	mali_scheduler_zap_all_active(session_data);
+	mali_mmu_stats_add(&mmu_stats.zaps, start_ns);
 
-	/* Removes the descriptor from the session's memory list, releases physical memory, releases descriptor */
-	mali_allocation_engine_release_pt2_physical_memory_free(memory_engine, descriptor);
+	_MALI_OSK_LIST_FOREACHENTRY(descriptor, temp, &session_data->memory_unmapped, mali_memory_allocation, list)
+	{
+		/* Removes the descriptor from the unmapped list, releases physical memory, releases descriptor */
+		mali_allocation_engine_release_pt2_physical_memory_free(memory_engine, descriptor);
+		_mali_osk_free(descriptor);
+	}
 
-	_mali_osk_free(descriptor);
+	session_data->memory_unmapped_size = 0;
+}
 
-	return _MALI_OSK_ERR_OK;
+void mali_memory_session_flush_unmapped(struct mali_session_data *session_data)
+{
+	MALI_DEBUG_ASSERT_POINTER(session_data);
+
+	/* Unlocked peek; an unmap racing with the job start of the same session may be zapped by the next one */
+	if (_mali_osk_list_empty(&session_data->memory_unmapped)) return;
+
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+	mali_memory_session_flush_unmapped_locked(session_data);
+	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
 }
 
 /* Handler for unmapping memory for MMU builds */
@@ -1100,10 +1210,36 @@ u32 _mali_ukk_report_memory_usage(void)
 	return mali_allocation_engine_memory_usage(physical_memory_allocators);
 }
 
+/* Called with the page table cache lock held, when the last page of an allocation has been released */
+static void mali_mmu_page_table_cache_release_empty(mali_mmu_page_table_allocation * alloc)
+{
+	if (page_table_cache.free_pages + alloc->num_pages <= MALI_MMU_PAGE_TABLE_CACHE_FREE_MAX)
+	{
+		/* keep it, the pages are already zeroed */
+		_mali_osk_list_move(&alloc->list, &page_table_cache.free);
+		page_table_cache.free_pages += alloc->num_pages;
+		return;
+	}
+
+	_mali_osk_list_del(&alloc->list);
+	mmu_stats.table_pages_free -= alloc->num_pages;
+	alloc->pages.release(&alloc->pages);
+	_mali_osk_free(alloc->usage_map);
+	_mali_osk_free(alloc);
+}
+
 _mali_osk_errcode_t mali_mmu_get_table_page(u32 *table_page, mali_io_address *mapping)
 {
 	_mali_osk_lock_wait(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
 
+	if (_mali_osk_list_empty(&page_table_cache.partial) && !_mali_osk_list_empty(&page_table_cache.free))
+	{
+		/* reuse an empty allocation before asking for a new one */
+		mali_mmu_page_table_allocation * alloc = _MALI_OSK_LIST_ENTRY(page_table_cache.free.next, mali_mmu_page_table_allocation, list);
+		page_table_cache.free_pages -= alloc->num_pages;
+		_mali_osk_list_move(&alloc->list, &page_table_cache.partial);
+	}
+
 	if (!_mali_osk_list_empty(&page_table_cache.partial))
 	{
 		mali_mmu_page_table_allocation * alloc = _MALI_OSK_LIST_ENTRY(page_table_cache.partial.next, mali_mmu_page_table_allocation, list);
@@ -1111,6 +1247,9 @@ _mali_osk_errcode_t mali_mmu_get_table_page(u32 *table_page, mali_io_address *ma
 		MALI_DEBUG_PRINT(6, ("Partial page table allocation found, using page offset %d\n", page_number));
 		_mali_osk_set_nonatomic_bit(page_number, alloc->usage_map);
 		alloc->usage_count++;
+		mmu_stats.table_hits++;
+		mmu_stats.table_pages++;
+		mmu_stats.table_pages_free--;
 		if (alloc->num_pages == alloc->usage_count)
 		{
 			/* full, move alloc to full list*/
@@ -1166,6 +1305,13 @@ _mali_osk_errcode_t mali_mmu_get_table_page(u32 *table_page, mali_io_address *ma
 
 		_mali_osk_set_nonatomic_bit(0, alloc->usage_map);
 
+		/* dedicated memory comes with whatever was left in it */
+		_mali_osk_memset((void*)alloc->pages.mapping, 0, alloc->pages.size);
+
+		mmu_stats.table_misses++;
+		mmu_stats.table_pages++;
+		mmu_stats.table_pages_free += alloc->num_pages - 1;
+
 		if (alloc->num_pages > 1)
 		{
 			_mali_osk_list_add(&alloc->list, &page_table_cache.partial);
@@ -1206,14 +1352,12 @@ void mali_mmu_release_table_page(u32 pa)
 			alloc->usage_count--;
 
 			_mali_osk_memset((void*)( ((u32)alloc->pages.mapping) + (pa - start) ), 0, MALI_MMU_PAGE_SIZE);
+			mmu_stats.table_pages--;
+			mmu_stats.table_pages_free++;
 
 			if (0 == alloc->usage_count)
 			{
-				/* empty, release whole page alloc */
-				_mali_osk_list_del(&alloc->list);
-				alloc->pages.release(&alloc->pages);
-				_mali_osk_free(alloc->usage_map);
-				_mali_osk_free(alloc);
+				mali_mmu_page_table_cache_release_empty(alloc);
 			}
 		   	_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
 			MALI_DEBUG_PRINT(4, ("(partial list)Released table page 0x%08X to the cache\n", pa));
@@ -1232,15 +1376,12 @@ void mali_mmu_release_table_page(u32 pa)
 			alloc->usage_count--;
 
 			_mali_osk_memset((void*)( ((u32)alloc->pages.mapping) + (pa - start) ), 0, MALI_MMU_PAGE_SIZE);
-
+			mmu_stats.table_pages--;
+			mmu_stats.table_pages_free++;
 
 			if (0 == alloc->usage_count)
 			{
-				/* empty, release whole page alloc */
-				_mali_osk_list_del(&alloc->list);
-				alloc->pages.release(&alloc->pages);
-				_mali_osk_free(alloc->usage_map);
-				_mali_osk_free(alloc);
+				mali_mmu_page_table_cache_release_empty(alloc);
 			}
 			else
 			{
@@ -1266,6 +1407,8 @@ static _mali_osk_errcode_t mali_mmu_page_table_cache_create(void)
 	MALI_CHECK_NON_NULL( page_table_cache.lock, _MALI_OSK_ERR_FAULT );
 	_MALI_OSK_INIT_LIST_HEAD(&page_table_cache.partial);
 	_MALI_OSK_INIT_LIST_HEAD(&page_table_cache.full);
+	_MALI_OSK_INIT_LIST_HEAD(&page_table_cache.free);
+	page_table_cache.free_pages = 0;
 	MALI_SUCCESS;
 }
 
@@ -1273,6 +1416,14 @@ static void mali_mmu_page_table_cache_destroy(void)
 {
 	mali_mmu_page_table_allocation * alloc, *temp;
 
+	_MALI_OSK_LIST_FOREACHENTRY(alloc, temp, &page_table_cache.free, mali_mmu_page_table_allocation, list)
+	{
+		_mali_osk_list_del(&alloc->list);
+		alloc->pages.release(&alloc->pages);
+		_mali_osk_free(alloc->usage_map);
+		_mali_osk_free(alloc);
+	}
+
 	_MALI_OSK_LIST_FOREACHENTRY(alloc, temp, &page_table_cache.partial, mali_mmu_page_table_allocation, list)
 	{
 		MALI_DEBUG_PRINT_IF(1, 0 != alloc->usage_count, ("Destroying page table cache while pages are tagged as in use. %d allocations still marked as in use.\n", alloc->usage_count));
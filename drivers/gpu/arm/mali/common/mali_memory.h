@@ -46,6 +46,36 @@ _mali_osk_errcode_t mali_memory_session_begin(struct mali_session_data *mali_ses
  */
 void mali_memory_session_end(struct mali_session_data *mali_session_data);
 
+/** @brief Zap the MMUs and free memory unmapped since the last zap
+ *
+ * Unmapping memory from Mali only clears the page table entries. The zap
+ * that removes them from the TLBs of the cores running the session, and
+ * the release of the physical memory that has to wait for it, are batched
+ * up and done here. Called before a job of the session is started.
+ *
+ * @param mali_session_data pointer to the session data structure
+ */
+void mali_memory_session_flush_unmapped(struct mali_session_data *mali_session_data);
+
+/** Counters for Mali MMU management */
+typedef struct mali_mmu_stats
+{
+	u32 map_ops;          /**< Memory blocks mapped into a Mali address space */
+	u32 unmap_ops;        /**< Memory blocks unmapped from a Mali address space */
+	u32 zaps;             /**< Zaps done for unmapped memory */
+	u32 table_pages;      /**< Page table pages in use */
+	u32 table_pages_free; /**< Zeroed page table pages kept for reuse */
+	u32 table_hits;       /**< Page table pages served from the cache */
+	u32 table_misses;     /**< Page table pages that needed a new allocation */
+	u64 ns_total;         /**< Time spent building and tearing down mappings and zapping, in ns */
+} mali_mmu_stats;
+
+/** @brief Get a snapshot of the MMU management counters
+ *
+ * @param stats filled in with the current counters
+ */
+void mali_mmu_get_stats(mali_mmu_stats *stats);
+
 /** @brief Allocate a page table page
  *
  * Allocate a page for use as a page directory or page table. The page is
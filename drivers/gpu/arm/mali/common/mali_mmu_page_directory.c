@@ -21,10 +21,10 @@ static _mali_osk_errcode_t fill_page(mali_io_address mapping, u32 data);
 
 u32 mali_allocate_empty_page(void)
 {
-	_mali_osk_errcode_t err;
 	mali_io_address mapping;
 	u32 address;
 
+	/* Pages from the page table cache are already zeroed */
 	if(_MALI_OSK_ERR_OK != mali_mmu_get_table_page(&address, &mapping))
 	{
 		/* Allocation failed */
@@ -33,11 +33,6 @@ u32 mali_allocate_empty_page(void)
 
 	MALI_DEBUG_ASSERT_POINTER( mapping );
 
-	err = fill_page(mapping, 0);
-	if (_MALI_OSK_ERR_OK != err)
-	{
-		mali_mmu_release_table_page(address);
-	}
 	return address;
 }
 
@@ -65,7 +60,6 @@ _mali_osk_errcode_t mali_create_fault_flush_pages(u32 *page_directory, u32 *page
 			err = mali_mmu_get_table_page(page_directory, &page_directory_mapping);
 			if (_MALI_OSK_ERR_OK == err)
 			{
-				fill_page(data_page_mapping, 0);
 				fill_page(page_table_mapping, *data_page | MALI_MMU_FLAGS_WRITE_PERMISSION | MALI_MMU_FLAGS_READ_PERMISSION | MALI_MMU_FLAGS_PRESENT);
 				fill_page(page_directory_mapping, *page_table | MALI_MMU_FLAGS_PRESENT);
 				MALI_SUCCESS;
@@ -267,8 +261,7 @@ struct mali_page_directory *mali_mmu_pagedir_alloc(void)
 		return NULL;
 	}
 
-	/* Zero page directory */
-	fill_page(pagedir->page_directory_mapped, 0);
+	/* The page directory comes zeroed from the page table cache */
 
 	return pagedir;
 }
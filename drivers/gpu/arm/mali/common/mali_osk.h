@@ -200,6 +200,7 @@ typedef enum
 {
 	_MALI_OSK_LOCK_ORDER_LAST = 0,
 
+	_MALI_OSK_LOCK_ORDER_MEM_STATS,
 	_MALI_OSK_LOCK_ORDER_SESSION_PENDING_JOBS,
 	_MALI_OSK_LOCK_ORDER_PM_EXECUTE,
 	_MALI_OSK_LOCK_ORDER_UTILIZATION,
@@ -1629,6 +1630,14 @@ u64 _mali_osk_time_get_ns( void );
  * @return the number of leading zeros.
  */
 u32 _mali_osk_clz( u32 val );
+
+/** @brief Divide a 64-bit value by a 32-bit value
+ *
+ * @param value pointer to the dividend, replaced by the quotient
+ * @param divisor 32-bit divisor, must not be zero
+ * @return the remainder.
+ */
+u32 _mali_osk_divmod64( u64 *value, u32 divisor );
 /** @} */ /* end group _mali_osk_math */
 
 /** @defgroup _mali_osk_wait_queue OSK Wait Queue functionality
@@ -1728,6 +1737,12 @@ u32 _mali_osk_get_pid(void);
  */
 u32 _mali_osk_get_tid(void);
 
+/** @brief Return the scheduling niceness of the calling thread.
+ *
+ * @return Nice level of the calling thread, lower values mean higher priority.
+ */
+s32 _mali_osk_get_nice(void);
+
 /** @brief Enable OS controlled runtime power management
  */
 void _mali_osk_pm_dev_enable(void);
@@ -81,6 +81,8 @@ struct mali_pp_job *mali_pp_job_create(struct mali_session_data *session, _mali_
 		job->sub_job_errors = 0;
 		job->pid = _mali_osk_get_pid();
 		job->tid = _mali_osk_get_tid();
+		job->priority = mali_session_priority_from_nice(_mali_osk_get_nice());
+		job->queue_time = 0;
 #if defined(CONFIG_SYNC)
 		job->sync_point = NULL;
 		job->pre_fence = NULL;
@@ -43,6 +43,8 @@ struct mali_pp_job
 	u32 sub_job_errors;                                /**< Bitfield with errors (errors for each single sub-job is or'ed together) */
 	u32 pid;                                           /**< Process ID of submitting process */
 	u32 tid;                                           /**< Thread ID of submitting thread */
+	u32 priority;                                      /**< Priority derived from the submitting thread, see enum mali_session_priority */
+	u64 queue_time;                                    /**< Time in ns when the job was queued in the scheduler */
 	_mali_osk_notification_t *finished_notification;   /**< Notification sent back to userspace on job complete */
 #ifdef CONFIG_SYNC
 	mali_sync_pt *sync_point;                          /**< Sync point to signal on completion */
@@ -18,6 +18,7 @@
 #include "mali_pp_job.h"
 #include "mali_group.h"
 #include "mali_pm.h"
+#include "mali_memory.h"
 
 #if defined(CONFIG_SYNC)
 #define MALI_PP_SCHEDULER_USE_DEFERRED_JOB_DELETE 1
@@ -34,9 +35,18 @@ static void mali_pp_scheduler_do_job_delete(void *arg);
 
 static u32 pp_version = 0;
 
-/* Physical job queue */
-static _MALI_OSK_LIST_HEAD_STATIC_INIT(job_queue);              /* List of physical jobs with some unscheduled work */
-static u32 job_queue_depth = 0;
+/*
+ * Physical job queue
+ *
+ * Each session keeps its physical jobs with some unscheduled work in its own
+ * pp_job_queue, in submission order. Sessions with such jobs are linked into
+ * the list of their priority. A sub job is always taken from the first
+ * session of the highest priority which has a runnable job, and a session
+ * goes to the back of its list once all sub jobs of its first job have been
+ * started, so sessions of the same priority take turns job by job.
+ */
+static _mali_osk_list_t session_queue[MALI_SESSION_PRIORITY_COUNT];
+static u32 job_queue_depth = 0;                                 /* Number of unstarted physical sub jobs */
 
 /* Physical groups */
 static _MALI_OSK_LIST_HEAD_STATIC_INIT(group_list_working);     /* List of physical groups with working jobs on the pp core */
@@ -53,6 +63,9 @@ static mali_bool virtual_group_working = MALI_FALSE;            /* Flag which in
 /* Number of physical cores */
 static u32 num_cores = 0;
 
+/* Number of physical cores allowed to work at the same time (lowered for thermal throttling) */
+static u32 max_working_cores = MALI_MAX_NUMBER_OF_PP_GROUPS;
+
 /* Variables to allow safe pausing of the scheduler */
 static _mali_osk_wait_queue_t *pp_scheduler_working_wait_queue = NULL;
 static u32 pause_count = 0;
@@ -83,7 +96,10 @@ _mali_osk_errcode_t mali_pp_scheduler_initialize(void)
 	lock_flags = _MALI_OSK_LOCKFLAG_ORDERED | _MALI_OSK_LOCKFLAG_SPINLOCK | _MALI_OSK_LOCKFLAG_NONINTERRUPTABLE;
 #endif
 
-	_MALI_OSK_INIT_LIST_HEAD(&job_queue);
+	for (i = 0; i < MALI_SESSION_PRIORITY_COUNT; i++)
+	{
+		_MALI_OSK_INIT_LIST_HEAD(&session_queue[i]);
+	}
 	_MALI_OSK_INIT_LIST_HEAD(&group_list_working);
 	_MALI_OSK_INIT_LIST_HEAD(&group_list_idle);
 
@@ -239,21 +255,31 @@ MALI_STATIC_INLINE void mali_pp_scheduler_assert_locked(void)
 
 /**
  * Returns a physical job if a physical job is ready to run (no barrier present)
+ *
+ * The first job of each session is considered, highest priority first. A
+ * barrier only holds back the jobs of its own session.
  */
 MALI_STATIC_INLINE struct mali_pp_job *mali_pp_scheduler_get_physical_job(void)
 {
+	struct mali_session_data *session, *tmp;
+	u32 priority;
+
 	MALI_ASSERT_PP_SCHEDULER_LOCKED();
 
-	if (!_mali_osk_list_empty(&job_queue))
+	for (priority = 0; priority < MALI_SESSION_PRIORITY_COUNT; priority++)
 	{
-		struct mali_pp_job *job;
+		_MALI_OSK_LIST_FOREACHENTRY(session, tmp, &session_queue[priority], struct mali_session_data, pp_queue_link)
+		{
+			struct mali_pp_job *job;
 
-		MALI_DEBUG_ASSERT(job_queue_depth > 0);
-		job = _MALI_OSK_LIST_ENTRY(job_queue.next, struct mali_pp_job, list);
+			MALI_DEBUG_ASSERT(job_queue_depth > 0);
+			MALI_DEBUG_ASSERT(!_mali_osk_list_empty(&session->pp_job_queue));
+			job = _MALI_OSK_LIST_ENTRY(session->pp_job_queue.next, struct mali_pp_job, list);
 
-		if (!mali_pp_job_has_active_barrier(job))
-		{
-			return job;
+			if (!mali_pp_job_has_active_barrier(job))
+			{
+				return job;
+			}
 		}
 	}
 
@@ -262,17 +288,28 @@ MALI_STATIC_INLINE struct mali_pp_job *mali_pp_scheduler_get_physical_job(void)
 
 MALI_STATIC_INLINE void mali_pp_scheduler_dequeue_physical_job(struct mali_pp_job *job)
 {
+	struct mali_session_data *session = mali_pp_job_get_session(job);
+
 	MALI_ASSERT_PP_SCHEDULER_LOCKED();
 	MALI_DEBUG_ASSERT(job_queue_depth > 0);
+	MALI_DEBUG_ASSERT(session->pp_queue_depth > 0);
 
 	/* Remove job from queue */
 	if (!mali_pp_job_has_unstarted_sub_jobs(job))
 	{
 		/* All sub jobs have been started: remove job from queue */
 		_mali_osk_list_delinit(&job->list);
+
+		/* Let the other sessions of this priority start a job before this session starts its next one */
+		_mali_osk_list_delinit(&session->pp_queue_link);
+		if (!_mali_osk_list_empty(&session->pp_job_queue))
+		{
+			_mali_osk_list_addtail(&session->pp_queue_link, &session_queue[session->pp_priority]);
+		}
 	}
 
 	--job_queue_depth;
+	--session->pp_queue_depth;
 }
 
 /**
@@ -307,6 +344,7 @@ MALI_STATIC_INLINE void mali_pp_scheduler_dequeue_virtual_job(struct mali_pp_job
 	/* Remove job from queue */
 	_mali_osk_list_delinit(&job->list);
 	--virtual_job_queue_depth;
+	--mali_pp_job_get_session(job)->pp_queue_depth;
 }
 
 /**
@@ -329,10 +367,31 @@ MALI_STATIC_INLINE mali_bool mali_pp_scheduler_can_move_virtual_to_physical(void
 	       (NULL != mali_pp_scheduler_get_physical_job());
 }
 
+MALI_STATIC_INLINE u32 mali_pp_scheduler_get_num_working_groups(void)
+{
+	struct mali_group *group, *temp;
+	u32 n = 0;
+
+	MALI_ASSERT_PP_SCHEDULER_LOCKED();
+
+	_MALI_OSK_LIST_FOREACHENTRY(group, temp, &group_list_working, struct mali_group, pp_scheduler_list)
+	{
+		n++;
+	}
+
+	return n;
+}
+
 MALI_STATIC_INLINE struct mali_group *mali_pp_scheduler_acquire_physical_group(void)
 {
 	MALI_ASSERT_PP_SCHEDULER_LOCKED();
 
+	if (mali_pp_scheduler_get_num_working_groups() >= max_working_cores)
+	{
+		MALI_DEBUG_PRINT(4, ("Mali PP scheduler: Limit of %u working cores reached\n", max_working_cores));
+		return NULL;
+	}
+
 	if (!_mali_osk_list_empty(&group_list_idle))
 	{
 		MALI_DEBUG_PRINT(4, ("Mali PP scheduler: Acquiring physical group from idle list\n"));
@@ -528,6 +587,20 @@ static void mali_pp_scheduler_schedule(void)
 	}
 }
 
+MALI_STATIC_INLINE void mali_pp_scheduler_account_job_done(struct mali_session_data *session, struct mali_pp_job *job)
+{
+	u64 latency = _mali_osk_time_get_ns() - job->queue_time;
+
+	MALI_ASSERT_PP_SCHEDULER_LOCKED();
+
+	session->pp_jobs_completed++;
+	session->pp_latency_ns_total += latency;
+	if (latency > session->pp_latency_ns_max)
+	{
+		session->pp_latency_ns_max = latency;
+	}
+}
+
 static void mali_pp_scheduler_return_job_to_user(struct mali_pp_job *job, mali_bool deferred)
 {
 	if (MALI_FALSE == mali_pp_job_use_no_notification(job))
@@ -642,6 +715,8 @@ void mali_pp_scheduler_job_done(struct mali_group *group, struct mali_pp_job *jo
 		/* Remove job from session list */
 		_mali_osk_list_del(&job->session_list);
 
+		mali_pp_scheduler_account_job_done(session, job);
+
 		/* Send notification back to user space */
 		MALI_DEBUG_PRINT(4, ("Mali PP scheduler: All parts completed for %s job %u (0x%08X)\n",
 		                     mali_pp_job_is_virtual(job) ? "virtual" : "physical",
@@ -882,24 +957,67 @@ void mali_pp_scheduler_resume(void)
 	}
 }
 
+/**
+ * Gives the session the priority of its latest job, moving the session to the list of the new
+ * priority if it has queued physical jobs
+ */
+MALI_STATIC_INLINE void mali_pp_scheduler_set_session_priority(struct mali_session_data *session, u32 priority)
+{
+	MALI_ASSERT_PP_SCHEDULER_LOCKED();
+	MALI_DEBUG_ASSERT(priority < MALI_SESSION_PRIORITY_COUNT);
+
+	if (session->pp_priority == priority)
+	{
+		return;
+	}
+
+	MALI_DEBUG_PRINT(3, ("Mali PP scheduler: Session 0x%08X priority %u -> %u\n", session, session->pp_priority, priority));
+	session->pp_priority = priority;
+
+	if (!_mali_osk_list_empty(&session->pp_queue_link))
+	{
+		_mali_osk_list_delinit(&session->pp_queue_link);
+		_mali_osk_list_addtail(&session->pp_queue_link, &session_queue[priority]);
+	}
+}
+
 MALI_STATIC_INLINE void mali_pp_scheduler_queue_job(struct mali_pp_job *job, struct mali_session_data *session)
 {
+	u32 sub_jobs;
+
 	MALI_DEBUG_ASSERT_POINTER(job);
 
 	mali_pm_core_event(MALI_CORE_EVENT_PP_START);
 
 	mali_pp_scheduler_lock();
 
+	job->queue_time = _mali_osk_time_get_ns();
+	mali_pp_scheduler_set_session_priority(session, job->priority);
+
 	if (mali_pp_job_is_virtual(job))
 	{
 		/* Virtual job */
+		sub_jobs = 1;
 		virtual_job_queue_depth += 1;
 		_mali_osk_list_addtail(&job->list, &virtual_job_queue);
 	}
 	else
 	{
-		job_queue_depth += mali_pp_job_get_sub_job_count(job);
-		_mali_osk_list_addtail(&job->list, &job_queue);
+		sub_jobs = mali_pp_job_get_sub_job_count(job);
+		job_queue_depth += sub_jobs;
+		_mali_osk_list_addtail(&job->list, &session->pp_job_queue);
+
+		if (_mali_osk_list_empty(&session->pp_queue_link))
+		{
+			/* First runnable job of this session, take a place in the queue */
+			_mali_osk_list_addtail(&session->pp_queue_link, &session_queue[session->pp_priority]);
+		}
+	}
+
+	session->pp_queue_depth += sub_jobs;
+	if (session->pp_queue_depth > session->pp_queue_depth_max)
+	{
+		session->pp_queue_depth_max = session->pp_queue_depth;
 	}
 
 	if (mali_pp_job_has_active_barrier(job) && _mali_osk_list_empty(&session->job_list))
@@ -977,6 +1095,9 @@ _mali_osk_errcode_t _mali_ukk_pp_start_job(void *ctx, _mali_uk_pp_start_job_s *u
 
 	session = (struct mali_session_data*)ctx;
 
+	/* Zap once for all memory unmapped since the last job of this session */
+	mali_memory_session_flush_unmapped(session);
+
 	job = mali_pp_job_create(session, uargs, mali_scheduler_get_new_id());
 	if (NULL == job)
 	{
@@ -1133,12 +1254,11 @@ void _mali_ukk_pp_job_disable_wb(_mali_uk_pp_disable_wb_s *args)
 
 	session = (struct mali_session_data*)args->ctx;
 
-	/* Check queue for jobs that match */
+	/* Check the session's queue for jobs that match */
 	mali_pp_scheduler_lock();
-	_MALI_OSK_LIST_FOREACHENTRY(job, tmp, &job_queue, struct mali_pp_job, list)
+	_MALI_OSK_LIST_FOREACHENTRY(job, tmp, &session->pp_job_queue, struct mali_pp_job, list)
 	{
-		if (mali_pp_job_get_session(job) == session &&
-		    mali_pp_job_get_frame_builder_id(job) == (u32)args->fb_id &&
+		if (mali_pp_job_get_frame_builder_id(job) == (u32)args->fb_id &&
 		    mali_pp_job_get_flush_id(job) == (u32)args->flush_id)
 		{
 			if (args->wbx & _MALI_UK_PP_JOB_WB0)
@@ -1180,11 +1300,15 @@ void mali_pp_scheduler_abort_session(struct mali_session_data *session)
 			if (0 == mali_pp_job_get_first_unstarted_sub_job(job))
 			{
 				--virtual_job_queue_depth;
+				--session->pp_queue_depth;
 			}
 		}
 		else
 		{
-			job_queue_depth -= mali_pp_job_get_sub_job_count(job) - mali_pp_job_get_first_unstarted_sub_job(job);
+			u32 unstarted = mali_pp_job_get_sub_job_count(job) - mali_pp_job_get_first_unstarted_sub_job(job);
+
+			job_queue_depth -= unstarted;
+			session->pp_queue_depth -= unstarted;
 		}
 
 		/* Mark all unstarted jobs as failed */
@@ -1206,6 +1330,10 @@ void mali_pp_scheduler_abort_session(struct mali_session_data *session)
 		}
 	}
 
+	/* No jobs of this session are queued any more */
+	MALI_DEBUG_ASSERT(_mali_osk_list_empty(&session->pp_job_queue));
+	_mali_osk_list_delinit(&session->pp_queue_link);
+
 	_MALI_OSK_LIST_FOREACHENTRY(group, tmp_group, &group_list_working, struct mali_group, pp_scheduler_list)
 	{
 		groups[i++] = group;
@@ -1246,6 +1374,58 @@ int mali_pp_scheduler_get_queue_depth(void)
 	return job_queue_depth;
 }
 
+u32 mali_pp_scheduler_get_num_cores(void)
+{
+	return num_cores;
+}
+
+void mali_pp_scheduler_set_max_cores(u32 max_cores)
+{
+	mali_pp_scheduler_lock();
+	max_working_cores = (0 == max_cores) ? MALI_MAX_NUMBER_OF_PP_GROUPS : max_cores;
+	mali_pp_scheduler_unlock();
+
+	MALI_DEBUG_PRINT(3, ("Mali PP scheduler: Using at most %u cores\n", max_working_cores));
+
+	/* A raised limit may let queued jobs start right away */
+	_mali_osk_wq_schedule_work(pp_scheduler_wq_schedule);
+}
+
+u32 mali_pp_scheduler_dump_sessions(char *buf, u32 size)
+{
+	static const char *priority_names[MALI_SESSION_PRIORITY_COUNT] = { "high", "normal", "background" };
+	struct mali_session_data *session, *tmp;
+	u32 n = 0;
+
+	n += _mali_osk_snprintf(buf + n, size - n, "%8s %-10s %6s %9s %10s %12s %12s\n",
+	                        "pid", "priority", "queued", "max queued", "jobs", "avg lat us", "max lat us");
+
+	mali_session_lock();
+	mali_pp_scheduler_lock();
+	MALI_SESSION_FOREACH(session, tmp, link)
+	{
+		u64 avg_us = 0;
+		u64 max_us = session->pp_latency_ns_max;
+
+		if (0 != session->pp_jobs_completed)
+		{
+			avg_us = session->pp_latency_ns_total;
+			_mali_osk_divmod64(&avg_us, session->pp_jobs_completed);
+		}
+		_mali_osk_divmod64(&avg_us, 1000);
+		_mali_osk_divmod64(&max_us, 1000);
+
+		n += _mali_osk_snprintf(buf + n, size - n, "%8u %-10s %6u %9u %10u %12llu %12llu\n",
+		                        session->pid, priority_names[session->pp_priority],
+		                        session->pp_queue_depth, session->pp_queue_depth_max,
+		                        session->pp_jobs_completed, avg_us, max_us);
+	}
+	mali_pp_scheduler_unlock();
+	mali_session_unlock();
+
+	return n;
+}
+
 #if MALI_STATE_TRACKING
 u32 mali_pp_scheduler_dump_state(char *buf, u32 size)
 {
@@ -1254,7 +1434,7 @@ u32 mali_pp_scheduler_dump_state(char *buf, u32 size)
 	struct mali_group *temp;
 
 	n += _mali_osk_snprintf(buf + n, size - n, "PP:\n");
-	n += _mali_osk_snprintf(buf + n, size - n, "\tQueue is %s\n", _mali_osk_list_empty(&job_queue) ? "empty" : "not empty");
+	n += _mali_osk_snprintf(buf + n, size - n, "\tQueue is %s\n", 0 == job_queue_depth ? "empty" : "not empty");
 	n += _mali_osk_snprintf(buf + n, size - n, "\n");
 
 	_MALI_OSK_LIST_FOREACHENTRY(group, temp, &group_list_working, struct mali_group, pp_scheduler_list)
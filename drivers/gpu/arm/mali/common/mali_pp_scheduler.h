@@ -52,6 +52,30 @@ void mali_pp_scheduler_reset_all_groups(void);
 void mali_pp_scheduler_zap_all_active(struct mali_session_data *session);
 
 int mali_pp_scheduler_get_queue_depth(void);
+
+/**
+ * @brief Number of physical PP cores owned by the scheduler
+ */
+u32 mali_pp_scheduler_get_num_cores(void);
+
+/**
+ * @brief Limit the number of physical PP cores that may work at the same time
+ *
+ * Jobs already running are not affected; the limit applies when new sub jobs
+ * are started. Used for thermal throttling.
+ *
+ * @param max_cores Maximum number of working cores, 0 removes the limit
+ */
+void mali_pp_scheduler_set_max_cores(u32 max_cores);
+
+/**
+ * @brief Print the PP queue depth and job latency statistics of every session
+ *
+ * @param buf Buffer to print to
+ * @param size Size of the buffer
+ * @return Number of characters printed
+ */
+u32 mali_pp_scheduler_dump_sessions(char *buf, u32 size);
 u32 mali_pp_scheduler_dump_state(char *buf, u32 size);
 
 #endif /* __MALI_PP_SCHEDULER_H__ */
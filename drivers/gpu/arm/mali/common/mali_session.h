@@ -16,6 +16,21 @@
 #include "mali_osk.h"
 #include "mali_osk_list.h"
 
+/**
+ * Scheduling priority of a session's PP jobs. Lower values are scheduled first.
+ */
+enum mali_session_priority
+{
+	MALI_SESSION_PRIORITY_HIGH = 0,   /**< Compositor and other display critical clients */
+	MALI_SESSION_PRIORITY_NORMAL,     /**< Foreground applications */
+	MALI_SESSION_PRIORITY_BACKGROUND, /**< Applications which are not visible */
+	MALI_SESSION_PRIORITY_COUNT
+};
+
+/* Nice levels of the submitting thread which select the high and background priorities */
+#define MALI_SESSION_PRIORITY_HIGH_NICE       (-8)
+#define MALI_SESSION_PRIORITY_BACKGROUND_NICE 10
+
 struct mali_session_data
 {
 	_mali_osk_notification_queue_t * ioctl_queue;
@@ -28,12 +43,26 @@ struct mali_session_data
 	_mali_osk_lock_t *memory_lock; /**< Lock protecting the vm manipulation */
 	mali_descriptor_mapping * descriptor_mapping; /**< Mapping between userspace descriptors and our pointers */
 	_mali_osk_list_t memory_head; /**< Track all the memory allocated in this session, for freeing on abnormal termination */
+	_mali_osk_list_t memory_unmapped; /**< Memory unmapped from Mali but not yet zapped from the TLBs, protected by memory_lock */
+	u32 memory_unmapped_size; /**< Bytes on memory_unmapped */
 
 	struct mali_page_directory *page_directory; /**< MMU page directory for this session */
 
 	_MALI_OSK_LIST_HEAD(link); /**< Link for list of all sessions */
 
 	_MALI_OSK_LIST_HEAD(job_list); /**< List of all jobs on this session */
+
+	u32 pid; /**< Process ID of the process which opened the session */
+
+	/* The members below are protected by the PP scheduler lock */
+	u32 pp_priority; /**< Priority of the most recently queued PP job, see enum mali_session_priority */
+	_MALI_OSK_LIST_HEAD(pp_job_queue); /**< Physical PP jobs of this session with unstarted sub jobs */
+	_MALI_OSK_LIST_HEAD(pp_queue_link); /**< Link in the PP scheduler's list of runnable sessions of this priority */
+	u32 pp_queue_depth; /**< Number of unstarted PP sub jobs */
+	u32 pp_queue_depth_max; /**< Highest value of pp_queue_depth seen */
+	u32 pp_jobs_completed; /**< Number of PP jobs completed */
+	u64 pp_latency_ns_total; /**< Sum of the queue to completion times of the completed PP jobs */
+	u64 pp_latency_ns_max; /**< Longest queue to completion time of a PP job */
 };
 
 _mali_osk_errcode_t mali_session_initialize(void);
@@ -59,6 +88,20 @@ void mali_session_remove(struct mali_session_data *session);
 #define MALI_SESSION_FOREACH(session, tmp, link) \
 	_MALI_OSK_LIST_FOREACHENTRY(session, tmp, &mali_sessions, struct mali_session_data, link)
 
+MALI_STATIC_INLINE u32 mali_session_priority_from_nice(s32 nice)
+{
+	if (nice <= MALI_SESSION_PRIORITY_HIGH_NICE)
+	{
+		return MALI_SESSION_PRIORITY_HIGH;
+	}
+	else if (nice >= MALI_SESSION_PRIORITY_BACKGROUND_NICE)
+	{
+		return MALI_SESSION_PRIORITY_BACKGROUND;
+	}
+
+	return MALI_SESSION_PRIORITY_NORMAL;
+}
+
 MALI_STATIC_INLINE struct mali_page_directory *mali_session_get_page_directory(struct mali_session_data *session)
 {
 	return session->page_directory;
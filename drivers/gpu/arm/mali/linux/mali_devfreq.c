@@ -0,0 +1,559 @@
+/*
+ * Copyright (C) 2012 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation, and any use by you of this program is subject to the terms of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained from Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * @file mali_devfreq.c
+ * Utilization driven GPU frequency and voltage scaling on top of devfreq.
+ *
+ * The platform attaches an OPP table to the Mali platform device. The GPU
+ * utilization computed by mali_kernel_utilization.c is fed to the
+ * simple_ondemand governor, which picks an OPP; we then program the GPU
+ * clock and supply voltage to match.
+ */
+#include <linux/module.h>
+#include <linux/device.h>
+#include <linux/clk.h>
+#include <linux/devfreq.h>
+#include <linux/opp.h>
+#include <linux/rcupdate.h>
+#include <linux/regulator/consumer.h>
+#include <linux/slab.h>
+#include <linux/jiffies.h>
+#include <linux/mali/mali_utgard.h>
+#include "mali_kernel_common.h"
+#include "mali_osk.h"
+#include "mali_kernel_utilization.h"
+#include "mali_devfreq.h"
+
+#define MALI_DEVFREQ_CLK_NAME "sclk_g3d"
+#define MALI_DEVFREQ_REGULATOR_NAME "vdd_g3d"
+
+/* Same default as the utilization tracker uses when the platform gives no interval */
+#define MALI_DEVFREQ_DEFAULT_INTERVAL 1000
+
+/* Utilization is reported in parts of 256 */
+#define MALI_DEVFREQ_UTILIZATION_MAX 256
+
+/*
+ * Go to the highest OPP above upthreshold percent utilization, stay put
+ * within downdifferential below it, and scale down proportionally otherwise.
+ */
+static struct devfreq_simple_ondemand_data mali_devfreq_ondemand_data =
+{
+	.upthreshold = 85,
+	.downdifferential = 20,
+};
+module_param_named(mali_dvfs_upthreshold, mali_devfreq_ondemand_data.upthreshold, uint, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_dvfs_upthreshold, "GPU utilization (percent) above which the highest frequency is selected");
+
+module_param_named(mali_dvfs_downdifferential, mali_devfreq_ondemand_data.downdifferential, uint, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_dvfs_downdifferential, "Hysteresis (percent) below mali_dvfs_upthreshold before the frequency is lowered");
+
+struct mali_devfreq
+{
+	struct device *dev;
+	struct devfreq *devfreq;
+	struct clk *clk;
+	struct regulator *vdd;
+
+	unsigned long cur_freq;
+	unsigned long cur_volt;
+
+	/* Last value reported by the utilization tracker */
+	u32 utilization;
+	/* Platform utilization handler we took the callback over from */
+	void (*next_handler)(unsigned int);
+
+	/* Statistics, protected by devfreq->lock */
+	unsigned int num_levels;
+	unsigned int cur_level;
+	unsigned long *freq_table;
+	u64 *time_in_state;
+	unsigned int *trans_table;
+	unsigned int total_trans;
+	u64 last_stat_update;
+};
+
+/*
+ * Static so the utilization timer can never observe freed memory while the
+ * callback is being torn down.
+ */
+static struct mali_devfreq mali_devfreq;
+
+static void mali_devfreq_utilization(unsigned int utilization)
+{
+	mali_devfreq.utilization = utilization;
+
+	if (NULL != mali_devfreq.next_handler)
+	{
+		mali_devfreq.next_handler(utilization);
+	}
+}
+
+static unsigned int mali_devfreq_level(struct mali_devfreq *mdf, unsigned long freq)
+{
+	unsigned int i;
+
+	for (i = 0; i < mdf->num_levels; i++)
+	{
+		if (mdf->freq_table[i] == freq)
+		{
+			return i;
+		}
+	}
+
+	return mdf->cur_level;
+}
+
+static void mali_devfreq_update_time(struct mali_devfreq *mdf)
+{
+	u64 now = get_jiffies_64();
+
+	mdf->time_in_state[mdf->cur_level] += now - mdf->last_stat_update;
+	mdf->last_stat_update = now;
+}
+
+static void mali_devfreq_update_stats(struct mali_devfreq *mdf, unsigned long freq)
+{
+	unsigned int level = mali_devfreq_level(mdf, freq);
+
+	mali_devfreq_update_time(mdf);
+
+	if (level != mdf->cur_level)
+	{
+		mdf->trans_table[mdf->cur_level * mdf->num_levels + level]++;
+		mdf->total_trans++;
+		mdf->cur_level = level;
+	}
+}
+
+static int mali_devfreq_set_voltage(struct mali_devfreq *mdf, unsigned long volt)
+{
+	int err;
+
+	if (NULL == mdf->vdd || volt == mdf->cur_volt)
+	{
+		return 0;
+	}
+
+	err = regulator_set_voltage(mdf->vdd, volt, volt);
+	if (0 != err)
+	{
+		MALI_PRINT_ERROR(("Mali DVFS: failed to set %luuV\n", volt));
+		return err;
+	}
+
+	mdf->cur_volt = volt;
+	return 0;
+}
+
+static int mali_devfreq_set_opp(struct mali_devfreq *mdf, unsigned long freq, unsigned long volt)
+{
+	unsigned long old_volt = mdf->cur_volt;
+	int err;
+
+	/* Raise the voltage before speeding up, lower it after slowing down */
+	if (volt > old_volt)
+	{
+		err = mali_devfreq_set_voltage(mdf, volt);
+		if (0 != err)
+		{
+			return err;
+		}
+	}
+
+	err = clk_set_rate(mdf->clk, freq);
+	if (0 != err)
+	{
+		MALI_PRINT_ERROR(("Mali DVFS: failed to set clock to %luHz\n", freq));
+		mali_devfreq_set_voltage(mdf, old_volt);
+		return err;
+	}
+	mdf->cur_freq = freq;
+
+	if (volt < old_volt)
+	{
+		/* Staying at the higher voltage is safe, so this is not an error */
+		mali_devfreq_set_voltage(mdf, volt);
+	}
+
+	MALI_DEBUG_PRINT(3, ("Mali DVFS: %luHz at %luuV\n", freq, mdf->cur_volt));
+
+	return 0;
+}
+
+static int mali_devfreq_target(struct device *dev, unsigned long *freq, u32 flags)
+{
+	struct mali_devfreq *mdf = &mali_devfreq;
+	struct opp *opp;
+	unsigned long new_freq;
+	unsigned long new_volt;
+	int err;
+
+	rcu_read_lock();
+	opp = devfreq_recommended_opp(dev, freq, flags);
+	if (IS_ERR(opp))
+	{
+		rcu_read_unlock();
+		return PTR_ERR(opp);
+	}
+	new_freq = opp_get_freq(opp);
+	new_volt = opp_get_voltage(opp);
+	rcu_read_unlock();
+
+	if (new_freq != mdf->cur_freq)
+	{
+		err = mali_devfreq_set_opp(mdf, new_freq, new_volt);
+		if (0 != err)
+		{
+			return err;
+		}
+		mali_devfreq_update_stats(mdf, new_freq);
+	}
+
+	*freq = new_freq;
+	return 0;
+}
+
+static int mali_devfreq_get_dev_status(struct device *dev, struct devfreq_dev_status *stat)
+{
+	struct mali_devfreq *mdf = &mali_devfreq;
+
+	stat->current_frequency = mdf->cur_freq;
+	stat->busy_time = ACCESS_ONCE(mdf->utilization);
+	stat->total_time = MALI_DEVFREQ_UTILIZATION_MAX;
+
+	return 0;
+}
+
+static struct devfreq_dev_profile mali_devfreq_profile =
+{
+	.target = mali_devfreq_target,
+	.get_dev_status = mali_devfreq_get_dev_status,
+};
+
+static ssize_t show_time_in_state(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct mali_devfreq *mdf = &mali_devfreq;
+	ssize_t len = 0;
+	unsigned int i;
+
+	mutex_lock(&mdf->devfreq->lock);
+	mali_devfreq_update_time(mdf);
+	for (i = 0; i < mdf->num_levels; i++)
+	{
+		len += sprintf(buf + len, "%lu %llu\n", mdf->freq_table[i],
+		               (unsigned long long)jiffies_64_to_clock_t(mdf->time_in_state[i]));
+	}
+	mutex_unlock(&mdf->devfreq->lock);
+
+	return len;
+}
+
+static ssize_t show_trans_stat(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct mali_devfreq *mdf = &mali_devfreq;
+	ssize_t len = 0;
+	unsigned int i, j;
+
+	mutex_lock(&mdf->devfreq->lock);
+	len += sprintf(buf + len, "   From  :    To\n");
+	len += sprintf(buf + len, "         :");
+	for (i = 0; i < mdf->num_levels; i++)
+	{
+		len += sprintf(buf + len, "%10lu", mdf->freq_table[i]);
+	}
+	len += sprintf(buf + len, "\n");
+
+	for (i = 0; i < mdf->num_levels; i++)
+	{
+		len += sprintf(buf + len, "%c%10lu:", i == mdf->cur_level ? '*' : ' ', mdf->freq_table[i]);
+		for (j = 0; j < mdf->num_levels; j++)
+		{
+			len += sprintf(buf + len, "%10u", mdf->trans_table[i * mdf->num_levels + j]);
+		}
+		len += sprintf(buf + len, "\n");
+	}
+	len += sprintf(buf + len, "Total transition : %u\n", mdf->total_trans);
+	mutex_unlock(&mdf->devfreq->lock);
+
+	return len;
+}
+
+static struct device_attribute mali_devfreq_attrs[] =
+{
+	__ATTR(time_in_state, S_IRUGO, show_time_in_state, NULL),
+	__ATTR(trans_stat, S_IRUGO, show_trans_stat, NULL),
+};
+
+static int mali_devfreq_init_table(struct mali_devfreq *mdf)
+{
+	unsigned long freq = 0;
+	struct opp *opp;
+	unsigned int i;
+	int count;
+
+	rcu_read_lock();
+	count = opp_get_opp_count(mdf->dev);
+	rcu_read_unlock();
+	if (count <= 0)
+	{
+		return -ENODEV;
+	}
+
+	mdf->freq_table = kcalloc(count, sizeof(*mdf->freq_table), GFP_KERNEL);
+	mdf->time_in_state = kcalloc(count, sizeof(*mdf->time_in_state), GFP_KERNEL);
+	mdf->trans_table = kcalloc(count * count, sizeof(*mdf->trans_table), GFP_KERNEL);
+	if (NULL == mdf->freq_table || NULL == mdf->time_in_state || NULL == mdf->trans_table)
+	{
+		return -ENOMEM;
+	}
+
+	rcu_read_lock();
+	for (i = 0; i < count; i++, freq++)
+	{
+		opp = opp_find_freq_ceil(mdf->dev, &freq);
+		if (IS_ERR(opp))
+		{
+			break;
+		}
+		mdf->freq_table[i] = freq;
+	}
+	rcu_read_unlock();
+
+	mdf->num_levels = i;
+	mdf->last_stat_update = get_jiffies_64();
+
+	return 0;
+}
+
+static void mali_devfreq_free_table(struct mali_devfreq *mdf)
+{
+	kfree(mdf->trans_table);
+	kfree(mdf->time_in_state);
+	kfree(mdf->freq_table);
+	mdf->trans_table = NULL;
+	mdf->time_in_state = NULL;
+	mdf->freq_table = NULL;
+	mdf->num_levels = 0;
+}
+
+/*
+ * Without a regulator the supply stays where the boot loader left it, which
+ * is only known to be enough for the boot clock.  Disable every operating
+ * point that needs a higher voltage than the one at or below that clock, so
+ * neither devfreq nor thermal capping (which only sees the OPPs left) can
+ * select it.
+ */
+static int mali_devfreq_limit_to_boot(struct mali_devfreq *mdf)
+{
+	unsigned long freq = clk_get_rate(mdf->clk);
+	unsigned long boot_volt;
+	unsigned long *excess;
+	struct opp *opp;
+	unsigned int n = 0;
+	unsigned int i;
+	int count;
+
+	rcu_read_lock();
+	count = opp_get_opp_count(mdf->dev);
+	rcu_read_unlock();
+	if (count <= 0)
+	{
+		return 0;
+	}
+
+	excess = kcalloc(count, sizeof(*excess), GFP_KERNEL);
+	if (NULL == excess)
+	{
+		return -ENOMEM;
+	}
+
+	rcu_read_lock();
+	opp = opp_find_freq_floor(mdf->dev, &freq);
+	if (IS_ERR(opp))
+	{
+		/* Booted below every operating point, keep the lowest voltage */
+		freq = 0;
+		opp = opp_find_freq_ceil(mdf->dev, &freq);
+	}
+	boot_volt = opp_get_voltage(opp);
+
+	/* opp_disable() sleeps, collect the frequencies first */
+	for (freq = 0, i = 0; i < count; i++, freq++)
+	{
+		opp = opp_find_freq_ceil(mdf->dev, &freq);
+		if (IS_ERR(opp))
+		{
+			break;
+		}
+		if (opp_get_voltage(opp) > boot_volt)
+		{
+			excess[n++] = freq;
+		}
+	}
+	rcu_read_unlock();
+
+	for (i = 0; i < n; i++)
+	{
+		opp_disable(mdf->dev, excess[i]);
+	}
+	if (0 != n)
+	{
+		MALI_PRINT(("Mali DVFS: %u operating points above %luuV disabled\n", n, boot_volt));
+	}
+
+	kfree(excess);
+	return 0;
+}
+
+int mali_devfreq_init(struct platform_device *pdev)
+{
+	struct mali_devfreq *mdf = &mali_devfreq;
+	struct mali_gpu_device_data *data = pdev->dev.platform_data;
+	unsigned long freq;
+	unsigned long volt;
+	struct opp *opp;
+	int err;
+	int i;
+
+	mdf->dev = &pdev->dev;
+
+	mdf->clk = clk_get(mdf->dev, MALI_DEVFREQ_CLK_NAME);
+	if (IS_ERR(mdf->clk))
+	{
+		MALI_PRINT_ERROR(("Mali DVFS: failed to get clock %s\n", MALI_DEVFREQ_CLK_NAME));
+		err = PTR_ERR(mdf->clk);
+		goto err_table;
+	}
+
+	mdf->vdd = regulator_get(mdf->dev, MALI_DEVFREQ_REGULATOR_NAME);
+	if (IS_ERR(mdf->vdd))
+	{
+		/* Frequency scaling alone still saves power */
+		MALI_PRINT(("Mali DVFS: no %s regulator, scaling the clock only\n", MALI_DEVFREQ_REGULATOR_NAME));
+		mdf->vdd = NULL;
+		err = mali_devfreq_limit_to_boot(mdf);
+		if (0 != err)
+		{
+			goto err_opp;
+		}
+	}
+	else
+	{
+		mdf->cur_volt = regulator_get_voltage(mdf->vdd);
+	}
+
+	/* Only the operating points left enabled make it into the table */
+	err = mali_devfreq_init_table(mdf);
+	if (0 != err)
+	{
+		MALI_PRINT(("Mali DVFS: no operating points, running at a fixed clock\n"));
+		goto err_opp;
+	}
+
+	/* Move from the boot clock onto the nearest operating point */
+	freq = clk_get_rate(mdf->clk);
+	rcu_read_lock();
+	opp = opp_find_freq_ceil(mdf->dev, &freq);
+	if (IS_ERR(opp))
+	{
+		freq = ULONG_MAX;
+		opp = opp_find_freq_floor(mdf->dev, &freq);
+	}
+	volt = opp_get_voltage(opp);
+	rcu_read_unlock();
+
+	err = mali_devfreq_set_opp(mdf, freq, volt);
+	if (0 != err)
+	{
+		goto err_opp;
+	}
+	mdf->cur_level = mali_devfreq_level(mdf, freq);
+
+	mali_devfreq_profile.initial_freq = freq;
+	mali_devfreq_profile.polling_ms = MALI_DEVFREQ_DEFAULT_INTERVAL;
+	if (NULL != data && 0 != data->utilization_interval)
+	{
+		mali_devfreq_profile.polling_ms = data->utilization_interval;
+	}
+
+	mdf->devfreq = devfreq_add_device(mdf->dev, &mali_devfreq_profile, &devfreq_simple_ondemand, &mali_devfreq_ondemand_data);
+	if (IS_ERR(mdf->devfreq))
+	{
+		err = PTR_ERR(mdf->devfreq);
+		goto err_opp;
+	}
+
+	/* Let OPP enable/disable (e.g. thermal capping) re-evaluate the frequency */
+	devfreq_register_opp_notifier(mdf->dev, mdf->devfreq);
+
+	for (i = 0; i < ARRAY_SIZE(mali_devfreq_attrs); i++)
+	{
+		err = device_create_file(&mdf->devfreq->dev, &mali_devfreq_attrs[i]);
+		if (0 != err)
+		{
+			while (--i >= 0)
+			{
+				device_remove_file(&mdf->devfreq->dev, &mali_devfreq_attrs[i]);
+			}
+			goto err_devfreq;
+		}
+	}
+
+	mdf->next_handler = mali_utilization_callback;
+	mali_utilization_callback = mali_devfreq_utilization;
+
+	MALI_DEBUG_PRINT(2, ("Mali DVFS: %u operating points, starting at %luHz\n", mdf->num_levels, freq));
+
+	return 0;
+
+err_devfreq:
+	devfreq_unregister_opp_notifier(mdf->dev, mdf->devfreq);
+	devfreq_remove_device(mdf->devfreq);
+err_opp:
+	if (NULL != mdf->vdd)
+	{
+		regulator_put(mdf->vdd);
+	}
+	clk_put(mdf->clk);
+err_table:
+	mali_devfreq_free_table(mdf);
+	mdf->devfreq = NULL;
+	return err;
+}
+
+void mali_devfreq_term(void)
+{
+	struct mali_devfreq *mdf = &mali_devfreq;
+	int i;
+
+	if (NULL == mdf->devfreq)
+	{
+		return;
+	}
+
+	mali_utilization_callback = mdf->next_handler;
+
+	for (i = 0; i < ARRAY_SIZE(mali_devfreq_attrs); i++)
+	{
+		device_remove_file(&mdf->devfreq->dev, &mali_devfreq_attrs[i]);
+	}
+	devfreq_unregister_opp_notifier(mdf->dev, mdf->devfreq);
+	devfreq_remove_device(mdf->devfreq);
+	mdf->devfreq = NULL;
+
+	if (NULL != mdf->vdd)
+	{
+		regulator_put(mdf->vdd);
+	}
+	clk_put(mdf->clk);
+	mali_devfreq_free_table(mdf);
+}
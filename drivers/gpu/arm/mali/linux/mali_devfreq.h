@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2012 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation, and any use by you of this program is subject to the terms of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained from Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * @file mali_devfreq.h
+ * Utilization driven GPU frequency and voltage scaling on top of devfreq.
+ */
+
+#ifndef __MALI_DEVFREQ_H__
+#define __MALI_DEVFREQ_H__
+
+#include <linux/platform_device.h>
+
+#ifdef CONFIG_MALI400_DEVFREQ
+
+/*
+ * Register the GPU with devfreq, using the OPPs the platform attached to
+ * the Mali device, and hook it up to the utilization callback.
+ * Failure is not fatal; the GPU keeps running at whatever clock it booted with.
+ */
+int mali_devfreq_init(struct platform_device *pdev);
+
+void mali_devfreq_term(void);
+
+#else
+
+static inline int mali_devfreq_init(struct platform_device *pdev)
+{
+	return 0;
+}
+
+static inline void mali_devfreq_term(void)
+{
+}
+
+#endif /* CONFIG_MALI400_DEVFREQ */
+
+#endif /* __MALI_DEVFREQ_H__ */
@@ -34,6 +34,8 @@
 #include "mali_pm.h"
 #include "mali_kernel_license.h"
 #include "mali_dma_buf.h"
+#include "mali_devfreq.h"
+#include "mali_thermal.h"
 #if defined(CONFIG_MALI400_INTERNAL_PROFILING)
 #include "mali_profiling_internal.h"
 #endif
@@ -291,6 +293,9 @@ static int mali_probe(struct platform_device *pdev)
 				err = mali_sysfs_register(mali_dev_name);
 				if (0 == err)
 				{
+					/* DVFS and thermal capping are optional, without them the GPU stays at its boot clock */
+					mali_devfreq_init(pdev);
+					mali_thermal_init(pdev);
 					MALI_DEBUG_PRINT(2, ("mali_probe(): Successfully initialized driver for platform device %s\n", pdev->name));
 					return 0;
 				}
@@ -320,6 +325,8 @@ static int mali_probe(struct platform_device *pdev)
 static int mali_remove(struct platform_device *pdev)
 {
 	MALI_DEBUG_PRINT(2, ("mali_remove() called for platform device %s\n", pdev->name));
+	mali_thermal_term();
+	mali_devfreq_term();
 	mali_sysfs_unregister();
 	mali_miscdevice_unregister();
 	mali_terminate_subsystems();
@@ -30,6 +30,23 @@ extern struct workqueue_struct * mali_wq;
 void mali_osk_low_level_mem_init(void);
 void mali_osk_low_level_mem_term(void);
 
+/** Counters for the pool of pre-cleaned OS memory pages */
+typedef struct mali_mem_pool_stats
+{
+	u32 pages;          /**< Pages currently in the pool */
+	u32 low_pages;      /**< Low watermark, the pool is refilled up to this */
+	u32 high_pages;     /**< High watermark, released pages beyond this are freed */
+	u32 hits;           /**< Allocations served from the pool */
+	u32 misses;         /**< Allocations that went to the kernel page allocator */
+	u32 recycled;       /**< Released pages that went back into the pool */
+	u32 refilled;       /**< Pages added by the background refill */
+	u32 shrunk;         /**< Pages given back to the kernel by the shrinker */
+	u64 alloc_ns_total; /**< Time spent allocating pages, in ns */
+	u32 alloc_ns_max;   /**< Slowest single page allocation, in ns */
+} mali_mem_pool_stats;
+
+void mali_osk_low_level_mem_pool_stats(mali_mem_pool_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
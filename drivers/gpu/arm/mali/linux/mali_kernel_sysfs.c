@@ -27,8 +27,10 @@
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
 #include <asm/uaccess.h>
+#include <asm/div64.h>
 #include <linux/module.h>
 #include "mali_kernel_sysfs.h"
+#include "mali_kernel_linux.h"
 #if defined(CONFIG_MALI400_INTERNAL_PROFILING)
 #include <linux/slab.h>
 #include "mali_osk_profiling.h"
@@ -46,6 +48,8 @@
 #include "mali_profiling_internal.h"
 #include "mali_gp_job.h"
 #include "mali_pp_job.h"
+#include "mali_pp_scheduler.h"
+#include "mali_memory.h"
 
 #define POWER_BUFFER_SIZE 3
 
@@ -1134,6 +1138,119 @@ static const struct file_operations memory_usage_fops = {
 	.read = memory_used_read,
 };
 
+static ssize_t memory_pool_read(struct file *filp, char __user *ubuf, size_t cnt, loff_t *ppos)
+{
+	char buf[512];
+	size_t r;
+	mali_mem_pool_stats stats;
+	u32 allocs;
+	u64 avg_ns = 0;
+	u64 hit_rate = 0;
+
+	mali_osk_low_level_mem_pool_stats(&stats);
+
+	allocs = stats.hits + stats.misses;
+	if (0 != allocs)
+	{
+		avg_ns = stats.alloc_ns_total;
+		do_div(avg_ns, allocs);
+		hit_rate = (u64)stats.hits * 100;
+		do_div(hit_rate, allocs);
+	}
+
+	r = snprintf(buf, sizeof(buf),
+	             "pages: %u\nlow watermark: %u\nhigh watermark: %u\n"
+	             "hits: %u\nmisses: %u\nhit rate: %u%%\n"
+	             "recycled: %u\nrefilled: %u\nshrunk: %u\n"
+	             "alloc latency avg: %llu ns\nalloc latency max: %u ns\n",
+	             stats.pages, stats.low_pages, stats.high_pages,
+	             stats.hits, stats.misses, (u32)hit_rate,
+	             stats.recycled, stats.refilled, stats.shrunk,
+	             avg_ns, stats.alloc_ns_max);
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static const struct file_operations memory_pool_fops = {
+	.owner = THIS_MODULE,
+	.read = memory_pool_read,
+};
+
+/* Rates are over the time since the previous read of the file */
+static ssize_t memory_mmu_read(struct file *filp, char __user *ubuf, size_t cnt, loff_t *ppos)
+{
+	static mali_mmu_stats last;
+	static u64 last_ns;
+	char buf[512];
+	size_t r;
+	mali_mmu_stats stats;
+	u64 now_ns = _mali_osk_time_get_ns();
+	u64 period_ns = now_ns - last_ns;
+	u64 map_rate, unmap_rate, zap_rate, mmu_permille;
+
+	mali_mmu_get_stats(&stats);
+
+	if (0 == period_ns)
+	{
+		period_ns = 1;
+	}
+	map_rate = div64_u64((u64)(stats.map_ops - last.map_ops) * 1000000000ULL, period_ns);
+	unmap_rate = div64_u64((u64)(stats.unmap_ops - last.unmap_ops) * 1000000000ULL, period_ns);
+	zap_rate = div64_u64((u64)(stats.zaps - last.zaps) * 1000000000ULL, period_ns);
+	mmu_permille = div64_u64((stats.ns_total - last.ns_total) * 1000, period_ns);
+
+	r = snprintf(buf, sizeof(buf),
+	             "map ops: %u (%llu/s)\nunmap ops: %u (%llu/s)\nzaps: %u (%llu/s)\n"
+	             "table pages: %u\nfree table pages: %u\ntable hits: %u\ntable misses: %u\n"
+	             "mmu time: %llu us (%u.%u%% of the last %llu ms)\n",
+	             stats.map_ops, map_rate, stats.unmap_ops, unmap_rate, stats.zaps, zap_rate,
+	             stats.table_pages, stats.table_pages_free, stats.table_hits, stats.table_misses,
+	             div64_u64(stats.ns_total, 1000), (u32)mmu_permille / 10, (u32)mmu_permille % 10,
+	             div64_u64(period_ns, 1000000));
+
+	/* a read(2) to the end of the file comes back with *ppos set, only the first one starts a new period */
+	if (0 == *ppos)
+	{
+		last = stats;
+		last_ns = now_ns;
+	}
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static const struct file_operations memory_mmu_fops = {
+	.owner = THIS_MODULE,
+	.read = memory_mmu_read,
+};
+
+static int pp_sessions_show(struct seq_file *seq_file, void *v)
+{
+	u32 size;
+	char *buf;
+
+	size = seq_get_buf(seq_file, &buf);
+	if (!size)
+	{
+		return -ENOMEM;
+	}
+
+	seq_commit(seq_file, mali_pp_scheduler_dump_sessions(buf, size));
+
+	return 0;
+}
+
+static int pp_sessions_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pp_sessions_show, NULL);
+}
+
+static const struct file_operations pp_sessions_fops = {
+	.owner = THIS_MODULE,
+	.open = pp_sessions_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static ssize_t utilization_gp_pp_read(struct file *filp, char __user *ubuf, size_t cnt, loff_t *ppos)
 {
 	char buf[64];
@@ -1378,10 +1495,13 @@ int mali_sysfs_register(const char *mali_dev_name)
 			}
 
 			debugfs_create_file("memory_usage", 0400, mali_debugfs_dir, NULL, &memory_usage_fops);
+			debugfs_create_file("memory_pool", 0400, mali_debugfs_dir, NULL, &memory_pool_fops);
+			debugfs_create_file("memory_mmu", 0400, mali_debugfs_dir, NULL, &memory_mmu_fops);
 
 			debugfs_create_file("utilization_gp_pp", 0400, mali_debugfs_dir, NULL, &utilization_gp_pp_fops);
 			debugfs_create_file("utilization_gp", 0400, mali_debugfs_dir, NULL, &utilization_gp_fops);
 			debugfs_create_file("utilization_pp", 0400, mali_debugfs_dir, NULL, &utilization_pp_fops);
+			debugfs_create_file("pp_sessions", 0400, mali_debugfs_dir, NULL, &pp_sessions_fops);
 
 #if defined(CONFIG_MALI400_INTERNAL_PROFILING)
 			mali_profiling_dir = debugfs_create_dir("profiling", mali_debugfs_dir);
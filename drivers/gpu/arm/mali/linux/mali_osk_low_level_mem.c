@@ -22,6 +22,10 @@
 #include <linux/mm.h>
 #include <linux/dma-mapping.h>
 #include <linux/spinlock.h>
+#include <linux/highmem.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/module.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,1,0)
 #include <linux/shrinker.h>
 #endif
@@ -68,6 +72,7 @@ typedef struct AllocationList AllocationList;
 struct MappingInfo
 {
 	struct vm_area_struct *vma;
+	struct mali_vma_usage_tracker *vma_usage_tracker; /* the vma may be gone by the time the mapping is terminated */
 	struct AllocationList *list;
 	struct AllocationList *tail;
 };
@@ -77,6 +82,7 @@ typedef struct MappingInfo MappingInfo;
 
 static u32 _kernel_page_allocate(void);
 static void _kernel_page_release(u32 physical_address);
+static void _kernel_page_clean(u32 physical_address);
 static AllocationList * _allocation_list_item_get(void);
 static void _allocation_list_item_release(AllocationList * item);
 
@@ -91,6 +97,24 @@ static int pre_allocated_memory_size_current  = 0;
 	static int pre_allocated_memory_size_max      = 16 * 1024 * 1024; /* 6 MiB */
 #endif
 
+/*
+ * The pool of pre_allocated_memory is kept between a low and a high watermark.
+ * pre_allocated_memory_size_max is the high watermark; pages released beyond
+ * it go straight back to the kernel. When an allocation takes the pool below
+ * the low watermark, a worker refills it up to the low watermark so bursts
+ * of allocations are served from the pool rather than the page allocator.
+ * Every page in the pool is zeroed and cleaned from the CPU caches, so it can
+ * be handed out without further maintenance.
+ */
+static unsigned int mali_mem_pool_low_pages = 256;
+module_param(mali_mem_pool_low_pages, uint, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_mem_pool_low_pages, "Number of pages the OS memory pool is refilled to in the background");
+
+static mali_mem_pool_stats pool_stats;
+
+static void mali_mem_pool_refill(struct work_struct *work);
+static DECLARE_WORK(mali_mem_pool_refill_work, mali_mem_pool_refill);
+
 static struct vm_operations_struct mali_kernel_vm_ops =
 {
 	.open = mali_kernel_memory_vma_open,
@@ -146,6 +170,7 @@ static int mali_mem_shrink(struct shrinker *shrinker, struct shrink_control *sc)
 		_mali_osk_free(item);
 
 		pre_allocated_memory_size_current -= PAGE_SIZE;
+		pool_stats.shrunk++;
 		--nr;
 	}
 	spin_unlock_irqrestore(&allocation_list_spinlock,flags);
@@ -161,6 +186,7 @@ struct shrinker mali_mem_shrinker = {
 void mali_osk_low_level_mem_init(void)
 {
 	pre_allocated_memory = (AllocationList*) NULL ;
+	memset(&pool_stats, 0, sizeof(pool_stats));
 
 	register_shrinker(&mali_mem_shrinker);
 }
@@ -168,6 +194,7 @@ void mali_osk_low_level_mem_init(void)
 void mali_osk_low_level_mem_term(void)
 {
 	unregister_shrinker(&mali_mem_shrinker);
+	cancel_work_sync(&mali_mem_pool_refill_work);
 
 	while ( NULL != pre_allocated_memory )
 	{
@@ -211,10 +238,74 @@ static void _kernel_page_release(u32 physical_address)
 	__free_page( unmap_page );
 }
 
+static void _kernel_page_clean(u32 physical_address)
+{
+	/* Wipe what the previous owner left behind, and push the zeroes out of the CPU caches */
+	clear_highpage(pfn_to_page(physical_address >> PAGE_SHIFT));
+	dma_sync_single_for_device(NULL, physical_address, PAGE_SIZE, DMA_TO_DEVICE);
+}
+
+static AllocationList * _allocation_list_item_new(void)
+{
+	AllocationList *item;
+
+	item = _mali_osk_malloc( sizeof(AllocationList) );
+	if ( NULL == item)
+	{
+		return NULL;
+	}
+
+	item->physaddr = _kernel_page_allocate();
+	if ( INVALID_PAGE == item->physaddr )
+	{
+		/* Non-fatal error condition, out of memory. Upper levels will handle this. */
+		_mali_osk_free( item );
+		return NULL;
+	}
+	return item;
+}
+
+static void mali_mem_pool_refill(struct work_struct *work)
+{
+	AllocationList *item;
+	unsigned long flags;
+
+	while ( pre_allocated_memory_size_current < (int)(mali_mem_pool_low_pages * PAGE_SIZE) )
+	{
+		item = _allocation_list_item_new();
+		if ( NULL == item )
+		{
+			return;
+		}
+
+		spin_lock_irqsave(&allocation_list_spinlock,flags);
+		if ( pre_allocated_memory_size_current < pre_allocated_memory_size_max )
+		{
+			item->next = pre_allocated_memory;
+			pre_allocated_memory = item;
+			pre_allocated_memory_size_current += PAGE_SIZE;
+			pool_stats.refilled++;
+			item = NULL;
+		}
+		spin_unlock_irqrestore(&allocation_list_spinlock,flags);
+
+		if ( NULL != item )
+		{
+			_kernel_page_release(item->physaddr);
+			_mali_osk_free( item );
+			return;
+		}
+	}
+}
+
 static AllocationList * _allocation_list_item_get(void)
 {
 	AllocationList *item = NULL;
 	unsigned long flags;
+	ktime_t start = ktime_get();
+	mali_bool hit;
+	mali_bool refill;
+	u32 ns;
 
 	spin_lock_irqsave(&allocation_list_spinlock,flags);
 	if ( pre_allocated_memory )
@@ -222,46 +313,75 @@ static AllocationList * _allocation_list_item_get(void)
 		item = pre_allocated_memory;
 		pre_allocated_memory = pre_allocated_memory->next;
 		pre_allocated_memory_size_current -= PAGE_SIZE;
-
-		spin_unlock_irqrestore(&allocation_list_spinlock,flags);
-		return item;
 	}
+	hit = (NULL != item) ? MALI_TRUE : MALI_FALSE;
+	refill = pre_allocated_memory_size_current < (int)(mali_mem_pool_low_pages * PAGE_SIZE);
 	spin_unlock_irqrestore(&allocation_list_spinlock,flags);
 
-	item = _mali_osk_malloc( sizeof(AllocationList) );
-	if ( NULL == item)
+	if ( refill )
 	{
-		return NULL;
+		schedule_work(&mali_mem_pool_refill_work);
 	}
 
-	item->physaddr = _kernel_page_allocate();
-	if ( INVALID_PAGE == item->physaddr )
+	if ( NULL == item )
 	{
-		/* Non-fatal error condition, out of memory. Upper levels will handle this. */
-		_mali_osk_free( item );
-		return NULL;
+		item = _allocation_list_item_new();
+		if ( NULL == item )
+		{
+			return NULL;
+		}
 	}
+
+	ns = (u32)ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock_irqsave(&allocation_list_spinlock,flags);
+	if ( hit ) pool_stats.hits++;
+	else pool_stats.misses++;
+	pool_stats.alloc_ns_total += ns;
+	if ( ns > pool_stats.alloc_ns_max ) pool_stats.alloc_ns_max = ns;
+	spin_unlock_irqrestore(&allocation_list_spinlock,flags);
+
 	return item;
 }
 
 static void _allocation_list_item_release(AllocationList * item)
 {
 	unsigned long flags;
-	spin_lock_irqsave(&allocation_list_spinlock,flags);
-	if ( pre_allocated_memory_size_current < pre_allocated_memory_size_max)
+
+	/* Only pages that will actually be recycled are worth cleaning */
+	if ( pre_allocated_memory_size_current < pre_allocated_memory_size_max )
 	{
-		item->next = pre_allocated_memory;
-		pre_allocated_memory = item;
-		pre_allocated_memory_size_current += PAGE_SIZE;
+		_kernel_page_clean(item->physaddr);
+
+		spin_lock_irqsave(&allocation_list_spinlock,flags);
+		if ( pre_allocated_memory_size_current < pre_allocated_memory_size_max)
+		{
+			item->next = pre_allocated_memory;
+			pre_allocated_memory = item;
+			pre_allocated_memory_size_current += PAGE_SIZE;
+			pool_stats.recycled++;
+			spin_unlock_irqrestore(&allocation_list_spinlock,flags);
+			return;
+		}
 		spin_unlock_irqrestore(&allocation_list_spinlock,flags);
-		return;
 	}
-	spin_unlock_irqrestore(&allocation_list_spinlock,flags);
 
 	_kernel_page_release(item->physaddr);
 	_mali_osk_free( item );
 }
 
+void mali_osk_low_level_mem_pool_stats(mali_mem_pool_stats *stats)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&allocation_list_spinlock,flags);
+	*stats = pool_stats;
+	stats->pages = pre_allocated_memory_size_current / PAGE_SIZE;
+	stats->low_pages = mali_mem_pool_low_pages;
+	stats->high_pages = pre_allocated_memory_size_max / PAGE_SIZE;
+	spin_unlock_irqrestore(&allocation_list_spinlock,flags);
+}
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
 static int mali_kernel_memory_cpu_page_fault_handler(struct vm_area_struct *vma, struct vm_fault *vmf)
 #else
@@ -457,6 +577,7 @@ _mali_osk_errcode_t _mali_osk_mem_mapregion_init( mali_memory_allocation * descr
 	}
 
 	mappingInfo->vma = vma;
+	mappingInfo->vma_usage_tracker = vma_usage_tracker;
 	descriptor->process_addr_mapping_info = mappingInfo;
 
 	/* Do the va range allocation - in this case, it was done earlier, so we copy in that information */
@@ -485,8 +606,6 @@ _mali_osk_errcode_t _mali_osk_mem_mapregion_init( mali_memory_allocation * descr
 
 void _mali_osk_mem_mapregion_term( mali_memory_allocation * descriptor )
 {
-	struct vm_area_struct* vma;
-	mali_vma_usage_tracker * vma_usage_tracker;
 	MappingInfo *mappingInfo;
 
 	if (NULL == descriptor) return;
@@ -498,19 +617,16 @@ void _mali_osk_mem_mapregion_term( mali_memory_allocation * descriptor )
 	MALI_DEBUG_ASSERT_POINTER( mappingInfo );
 
 	/* Linux does the right thing as part of munmap to remove the mapping
-	 * All that remains is that we remove the vma_usage_tracker setup in init() */
-	vma = mappingInfo->vma;
-
-	MALI_DEBUG_ASSERT_POINTER( vma );
+	 * All that remains is that we remove the vma_usage_tracker setup in init().
+	 * The vma itself is not touched: the Mali side releases unmapped memory
+	 * some time after the vma has been closed and freed. */
 
 	/* ASSERT that there are no allocations on the list. Unmap should've been
 	 * called on all OS allocations. */
 	MALI_DEBUG_ASSERT( NULL == mappingInfo->list );
 
-	vma_usage_tracker = vma->vm_private_data;
-
 	/* We only get called if mem_mapregion_init succeeded */
-	_mali_osk_free(vma_usage_tracker);
+	_mali_osk_free(mappingInfo->vma_usage_tracker);
 
 	_mali_osk_free( mappingInfo );
 	return;
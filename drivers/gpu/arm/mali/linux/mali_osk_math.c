@@ -15,8 +15,14 @@
 
 #include "mali_osk.h"
 #include <linux/bitops.h>
+#include <asm/div64.h>
 
 u32 inline _mali_osk_clz( u32 input )
 {
 	return 32-fls(input);
 }
+
+u32 _mali_osk_divmod64( u64 *value, u32 divisor )
+{
+	return do_div(*value, divisor);
+}
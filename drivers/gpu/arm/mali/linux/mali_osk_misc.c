@@ -62,3 +62,8 @@ u32 _mali_osk_get_tid(void)
 	/* pid is actually identifying the thread on Linux */
 	return (u32)current->pid;
 }
+
+s32 _mali_osk_get_nice(void)
+{
+	return (s32)task_nice(current);
+}
@@ -18,6 +18,7 @@
 #define __MALI_OSK_SPECIFIC_H__
 
 #include <asm/uaccess.h>
+#include <linux/rcupdate.h>
 
 #include "mali_sync.h"
 
@@ -34,6 +35,30 @@ MALI_STATIC_INLINE u32 _mali_osk_copy_from_user(void *to, void *from, u32 n)
 	return (u32)copy_from_user(to, from, (unsigned long)n);
 }
 
+/*
+ * Read-copy-update, for tables that are looked up without taking a lock.
+ * Readers load the published pointer with _mali_osk_rcu_dereference inside
+ * a read-side section; writers publish with _mali_osk_rcu_assign_pointer
+ * and call _mali_osk_synchronize_rcu before freeing what readers could see.
+ */
+MALI_STATIC_INLINE void _mali_osk_rcu_read_lock(void)
+{
+	rcu_read_lock();
+}
+
+MALI_STATIC_INLINE void _mali_osk_rcu_read_unlock(void)
+{
+	rcu_read_unlock();
+}
+
+MALI_STATIC_INLINE void _mali_osk_synchronize_rcu(void)
+{
+	synchronize_rcu();
+}
+
+#define _mali_osk_rcu_dereference(p) rcu_dereference(p)
+#define _mali_osk_rcu_assign_pointer(p, v) rcu_assign_pointer(p, v)
+
 /** The list of events supported by the Mali DDK. */
 typedef enum
 {
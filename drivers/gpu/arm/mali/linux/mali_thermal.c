@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2012 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation, and any use by you of this program is subject to the terms of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained from Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * @file mali_thermal.c
+ * Mali GPU as a thermal cooling device.
+ *
+ * Each cooling state caps the GPU frequency and the number of PP cores that
+ * may render at the same time:
+ * - state 0: no limits
+ * - state 1: the highest operating point is disabled
+ * - state 2: only the lowest operating point is left, and at most
+ *            mali_thermal_pp_cores PP cores are used
+ *
+ * Frequency capping disables OPPs; devfreq is notified through its OPP
+ * notifier and moves the GPU to an operating point that is still available.
+ */
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/opp.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <linux/thermal.h>
+#include "mali_kernel_common.h"
+#include "mali_osk.h"
+#include "mali_pp_scheduler.h"
+#include "mali_thermal.h"
+
+#define MALI_COOLING_MAX_STATE 2
+
+/* PP cores used in the hottest state, 0 means half of the cores */
+static unsigned int mali_thermal_pp_cores = 0;
+module_param(mali_thermal_pp_cores, uint, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_thermal_pp_cores, "Number of PP cores to use at the highest cooling state (0 = half)");
+
+struct mali_cooling
+{
+	struct device *dev;
+	struct thermal_cooling_device *cdev;
+	struct mutex lock;
+	unsigned long cur_state;
+
+	/*
+	 * Operating points, ascending, captured before any is disabled for
+	 * cooling; those devfreq disabled for good are not among them
+	 */
+	unsigned int num_opps;
+	unsigned long *opp_freqs;
+};
+
+static struct mali_cooling mali_cooling;
+
+static unsigned long mali_cooling_freq_max(struct mali_cooling *mc, unsigned long state)
+{
+	switch (state)
+	{
+	case 0:
+		return ULONG_MAX;
+	case 1:
+		return mc->opp_freqs[mc->num_opps > 1 ? mc->num_opps - 2 : 0];
+	default:
+		return mc->opp_freqs[0];
+	}
+}
+
+static u32 mali_cooling_pp_cores(unsigned long state)
+{
+	u32 cores;
+
+	if (state < MALI_COOLING_MAX_STATE)
+	{
+		return 0; /* no limit */
+	}
+
+	cores = mali_thermal_pp_cores;
+	if (0 == cores)
+	{
+		cores = mali_pp_scheduler_get_num_cores() / 2;
+	}
+
+	return max_t(u32, cores, 1);
+}
+
+static int mali_cooling_apply(struct mali_cooling *mc, unsigned long state)
+{
+	unsigned long freq_max = mali_cooling_freq_max(mc, state);
+	unsigned int i;
+	int err = 0;
+
+	/*
+	 * Enable the allowed OPPs before disabling the others, so devfreq
+	 * always has somewhere to go.
+	 */
+	for (i = 0; i < mc->num_opps && mc->opp_freqs[i] <= freq_max; i++)
+	{
+		err = opp_enable(mc->dev, mc->opp_freqs[i]);
+		if (0 != err)
+		{
+			return err;
+		}
+	}
+	for (; i < mc->num_opps; i++)
+	{
+		err = opp_disable(mc->dev, mc->opp_freqs[i]);
+		if (0 != err)
+		{
+			return err;
+		}
+	}
+
+	mali_pp_scheduler_set_max_cores(mali_cooling_pp_cores(state));
+
+	MALI_DEBUG_PRINT(2, ("Mali thermal: cooling state %lu, max %luHz, %u PP cores\n",
+	                     state, state ? freq_max : mc->opp_freqs[mc->num_opps - 1], mali_cooling_pp_cores(state)));
+
+	return 0;
+}
+
+static int mali_cooling_get_max_state(struct thermal_cooling_device *cdev, unsigned long *state)
+{
+	*state = MALI_COOLING_MAX_STATE;
+	return 0;
+}
+
+static int mali_cooling_get_cur_state(struct thermal_cooling_device *cdev, unsigned long *state)
+{
+	struct mali_cooling *mc = cdev->devdata;
+
+	mutex_lock(&mc->lock);
+	*state = mc->cur_state;
+	mutex_unlock(&mc->lock);
+
+	return 0;
+}
+
+static int mali_cooling_set_cur_state(struct thermal_cooling_device *cdev, unsigned long state)
+{
+	struct mali_cooling *mc = cdev->devdata;
+	int err = 0;
+
+	if (state > MALI_COOLING_MAX_STATE)
+	{
+		return -EINVAL;
+	}
+
+	mutex_lock(&mc->lock);
+	if (state != mc->cur_state)
+	{
+		err = mali_cooling_apply(mc, state);
+		if (0 == err)
+		{
+			mc->cur_state = state;
+		}
+	}
+	mutex_unlock(&mc->lock);
+
+	return err;
+}
+
+static const struct thermal_cooling_device_ops mali_cooling_ops =
+{
+	.get_max_state = mali_cooling_get_max_state,
+	.get_cur_state = mali_cooling_get_cur_state,
+	.set_cur_state = mali_cooling_set_cur_state,
+};
+
+int mali_thermal_init(struct platform_device *pdev)
+{
+	struct mali_cooling *mc = &mali_cooling;
+	unsigned long freq = 0;
+	struct opp *opp;
+	unsigned int i;
+	int count;
+
+	mc->dev = &pdev->dev;
+	mutex_init(&mc->lock);
+
+	rcu_read_lock();
+	count = opp_get_opp_count(mc->dev);
+	rcu_read_unlock();
+	if (count <= 0)
+	{
+		MALI_PRINT(("Mali thermal: no operating points, not registering a cooling device\n"));
+		return -ENODEV;
+	}
+
+	mc->opp_freqs = kcalloc(count, sizeof(*mc->opp_freqs), GFP_KERNEL);
+	if (NULL == mc->opp_freqs)
+	{
+		return -ENOMEM;
+	}
+
+	rcu_read_lock();
+	for (i = 0; i < count; i++, freq++)
+	{
+		opp = opp_find_freq_ceil(mc->dev, &freq);
+		if (IS_ERR(opp))
+		{
+			break;
+		}
+		mc->opp_freqs[i] = freq;
+	}
+	rcu_read_unlock();
+	mc->num_opps = i;
+
+	mc->cdev = thermal_cooling_device_register(MALI_COOLING_DEVICE_TYPE, mc, &mali_cooling_ops);
+	if (IS_ERR(mc->cdev))
+	{
+		int err = PTR_ERR(mc->cdev);
+
+		MALI_PRINT_ERROR(("Mali thermal: failed to register cooling device\n"));
+		kfree(mc->opp_freqs);
+		mc->opp_freqs = NULL;
+		mc->cdev = NULL;
+		return err;
+	}
+
+	return 0;
+}
+
+void mali_thermal_term(void)
+{
+	struct mali_cooling *mc = &mali_cooling;
+
+	if (NULL == mc->cdev)
+	{
+		return;
+	}
+
+	thermal_cooling_device_unregister(mc->cdev);
+	mc->cdev = NULL;
+
+	/* Leave the GPU unthrottled for whoever comes next */
+	mali_cooling_apply(mc, 0);
+	mc->cur_state = 0;
+
+	kfree(mc->opp_freqs);
+	mc->opp_freqs = NULL;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2012 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation, and any use by you of this program is subject to the terms of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained from Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * @file mali_thermal.h
+ * Mali GPU as a thermal cooling device.
+ */
+
+#ifndef __MALI_THERMAL_H__
+#define __MALI_THERMAL_H__
+
+#include <linux/platform_device.h>
+
+/* Thermal zones bind the GPU cooling device by this type */
+#define MALI_COOLING_DEVICE_TYPE "thermal-gpu"
+
+#ifdef CONFIG_MALI400_THERMAL
+
+/*
+ * Register the cooling device. Must be called after mali_devfreq_init(),
+ * since frequency capping works by disabling the OPPs devfreq scales over.
+ */
+int mali_thermal_init(struct platform_device *pdev);
+
+void mali_thermal_term(void);
+
+#else
+
+static inline int mali_thermal_init(struct platform_device *pdev)
+{
+	return 0;
+}
+
+static inline void mali_thermal_term(void)
+{
+}
+
+#endif /* CONFIG_MALI400_THERMAL */
+
+#endif /* __MALI_THERMAL_H__ */
@@ -293,7 +293,11 @@ _mali_osk_errcode_t _ump_ukk_size_get( _ump_uk_size_get_s *user_interaction )
 
 
 
-void _ump_ukk_msync( _ump_uk_msync_s *args )
+/*
+ * Resolve one msync request into a range for the OSK layer.
+ * Returns MALI_TRUE, with a reference taken on range->mem, if there is maintenance to do.
+ */
+static mali_bool ump_msync_prepare( _ump_uk_msync_s *args, ump_osk_msync_range *range )
 {
 	ump_dd_mem * mem = NULL;
 	void *virtual = NULL;
@@ -307,7 +311,7 @@ void _ump_ukk_msync( _ump_uk_msync_s *args )
 	{
 		_mali_osk_lock_signal(device.secure_id_map_lock, _MALI_OSK_LOCKMODE_RW);
 		DBG_MSG(1, ("Failed to look up mapping in _ump_ukk_msync(). ID: %u\n", (ump_secure_id)args->secure_id));
-		return;
+		return MALI_FALSE;
 	}
 	/* Ensure the memory doesn't dissapear when we are flushing it. */
 	ump_dd_reference_add(mem);
@@ -354,12 +358,62 @@ void _ump_ukk_msync( _ump_uk_msync_s *args )
 		goto msync_release_and_return;
 	}
 
-	/* The actual cache flush - Implemented for each OS*/
-	_ump_osk_msync( mem, virtual, offset, size, args->op, NULL);
+	range->mem = mem;
+	range->virt = virtual;
+	range->offset = offset;
+	range->size = size;
+	range->op = args->op;
+	return MALI_TRUE;
 
 msync_release_and_return:
 	ump_dd_reference_release(mem);
-	return;
+	return MALI_FALSE;
+}
+
+void _ump_ukk_msync( _ump_uk_msync_s *args )
+{
+	ump_osk_msync_range range;
+
+	if ( MALI_FALSE == ump_msync_prepare(args, &range) )
+	{
+		return;
+	}
+
+	/* The actual cache flush - Implemented for each OS*/
+	_ump_osk_msync_ranges( &range, 1, NULL );
+
+	ump_dd_reference_release(range.mem);
+}
+
+void _ump_ukk_msync_ranges( _ump_uk_msync_ranges_s *args )
+{
+	ump_osk_msync_range ranges[UMP_MSYNC_MAX_RANGES];
+	u32 count = 0;
+	u32 i;
+
+	DEBUG_ASSERT_POINTER( args );
+	DEBUG_ASSERT( args->count <= UMP_MSYNC_MAX_RANGES );
+
+	for ( i = 0; i < args->count; i++ )
+	{
+		if ( MALI_TRUE == ump_msync_prepare(&args->ranges[i], &ranges[count]) )
+		{
+			count++;
+		}
+	}
+
+	if ( 0 == count )
+	{
+		return;
+	}
+
+	/* All the ranges are maintained together, so the L1 cost is decided once for the batch */
+	_ump_osk_msync_ranges( ranges, count, NULL );
+
+	for ( i = 0; i < count; i++ )
+	{
+		ump_dd_reference_release(ranges[i].mem);
+	}
 }
 
 void _ump_ukk_cache_operations_control(_ump_uk_cache_operations_control_s* args)
@@ -387,16 +441,13 @@ void _ump_ukk_cache_operations_control(_ump_uk_cache_operations_control_s* args)
 	{
 		DBG_MSG(4, ("Cache ops finish\n"));
 		session_data->cache_operations_ongoing--;
-		#if 0
+
+		/* Ranged maintenance is done on the spot, only deferred full flushes are left to do here */
 		if ( session_data->has_pending_level1_cache_flush)
 		{
 			/* This function will set has_pending_level1_cache_flush=0 */
 			_ump_osk_msync( NULL, NULL, 0, 0, _UMP_UK_MSYNC_FLUSH_L1, session_data);
 		}
-		#endif
-
-		/* to be on the safe side: always flush l1 cache when cache operations are done */
-		_ump_osk_msync( NULL, NULL, 0, 0, _UMP_UK_MSYNC_FLUSH_L1, session_data);
 		DBG_MSG(4, ("Cache ops finish end\n" ));
 	}
 	else
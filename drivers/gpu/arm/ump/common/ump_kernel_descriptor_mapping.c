@@ -41,7 +41,7 @@ ump_descriptor_mapping * ump_descriptor_mapping_create(int init_entries, int max
 		map->table = descriptor_table_alloc(init_entries);
 		if (NULL != map->table)
 		{
-			map->lock = _mali_osk_lock_init(_MALI_OSK_LOCKFLAG_NONINTERRUPTABLE | _MALI_OSK_LOCKFLAG_READERWRITER, 0 , 0);
+			map->lock = _mali_osk_lock_init(_MALI_OSK_LOCKFLAG_NONINTERRUPTABLE, 0 , 0);
 			if ( NULL != map->lock )
 			{
 				_mali_osk_set_nonatomic_bit(0, map->table->usage); /* reserve bit 0 to prevent NULL/zero logic to kick in */
@@ -91,14 +91,17 @@ int ump_descriptor_mapping_allocate_mapping(ump_descriptor_mapping * map, void *
 
  		_mali_osk_memcpy(new_table->usage, old_table->usage, (sizeof(unsigned long)*map->current_nr_mappings) / BITS_PER_LONG);
  		_mali_osk_memcpy(new_table->mappings, old_table->mappings, map->current_nr_mappings * sizeof(void*));
-		map->table = new_table;
+		_mali_osk_rcu_assign_pointer(map->table, new_table);
 		map->current_nr_mappings = nr_mappings_new;
+
+		/* lookups may still be using the old table */
+		_mali_osk_synchronize_rcu();
 		descriptor_table_free(old_table);
 	}
 
 	/* we have found a valid descriptor, set the value and usage bit */
 	_mali_osk_set_nonatomic_bit(descriptor, map->table->usage);
-	map->table->mappings[descriptor] = target;
+	_mali_osk_rcu_assign_pointer(map->table->mappings[descriptor], target);
 
 unlock_and_exit:
 	_mali_osk_lock_signal(map->lock, _MALI_OSK_LOCKMODE_RW);
@@ -108,28 +111,35 @@ unlock_and_exit:
 int ump_descriptor_mapping_get(ump_descriptor_mapping * map, int descriptor, void** target)
 {
  	int result = -1;/*-EFAULT;*/
+	ump_descriptor_table * table;
  	DEBUG_ASSERT(map);
- 	_mali_osk_lock_wait(map->lock, _MALI_OSK_LOCKMODE_RO);
- 	if ( (descriptor >= 0) && (descriptor < map->current_nr_mappings) && _mali_osk_test_bit(descriptor, map->table->usage) )
+
+	/*
+	 * Lock free: the table is only freed after a grace period, and a slot
+	 * is published by its value, so a NULL value means not in use.
+	 */
+	_mali_osk_rcu_read_lock();
+	table = _mali_osk_rcu_dereference(map->table);
+	*target = NULL;
+ 	if ( (descriptor >= 0) && (descriptor < table->count) )
 	{
-		*target = map->table->mappings[descriptor];
-		result = 0;
+		*target = _mali_osk_rcu_dereference(table->mappings[descriptor]);
+		if (NULL != *target) result = 0;
 	}
-	else *target = NULL;
-	_mali_osk_lock_signal(map->lock, _MALI_OSK_LOCKMODE_RO);
+	_mali_osk_rcu_read_unlock();
 	return result;
 }
 
 int ump_descriptor_mapping_set(ump_descriptor_mapping * map, int descriptor, void * target)
 {
  	int result = -1;/*-EFAULT;*/
- 	_mali_osk_lock_wait(map->lock, _MALI_OSK_LOCKMODE_RO);
+ 	_mali_osk_lock_wait(map->lock, _MALI_OSK_LOCKMODE_RW);
  	if ( (descriptor >= 0) && (descriptor < map->current_nr_mappings) && _mali_osk_test_bit(descriptor, map->table->usage) )
 	{
-		map->table->mappings[descriptor] = target;
+		_mali_osk_rcu_assign_pointer(map->table->mappings[descriptor], target);
 		result = 0;
 	}
-	_mali_osk_lock_signal(map->lock, _MALI_OSK_LOCKMODE_RO);
+	_mali_osk_lock_signal(map->lock, _MALI_OSK_LOCKMODE_RW);
 	return result;
 }
 
@@ -138,7 +148,7 @@ void ump_descriptor_mapping_free(ump_descriptor_mapping * map, int descriptor)
  	_mali_osk_lock_wait(map->lock, _MALI_OSK_LOCKMODE_RW);
  	if ( (descriptor >= 0) && (descriptor < map->current_nr_mappings) && _mali_osk_test_bit(descriptor, map->table->usage) )
 	{
-		map->table->mappings[descriptor] = NULL;
+		_mali_osk_rcu_assign_pointer(map->table->mappings[descriptor], NULL);
 		_mali_osk_clear_nonatomic_bit(descriptor, map->table->usage);
 	}
 	_mali_osk_lock_signal(map->lock, _MALI_OSK_LOCKMODE_RW);
@@ -154,6 +164,7 @@ static ump_descriptor_table * descriptor_table_alloc(int count)
 	{
 		table->usage = (u32*)((u8*)table + sizeof(ump_descriptor_table));
 		table->mappings = (void**)((u8*)table + sizeof(ump_descriptor_table) + ((sizeof(unsigned long) * count)/BITS_PER_LONG));
+		table->count = count;
 	}
 
 	return table;
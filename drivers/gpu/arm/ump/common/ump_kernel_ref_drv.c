@@ -23,8 +23,21 @@
 #define UMP_ADDR_ALIGN_OFFSET(x) ((x)&(UMP_MINIMUM_SIZE-1))
 static void phys_blocks_release(void * ctx, struct ump_dd_mem * descriptor);
 
+/* Owner of memory wrapped by ump_dd_handle_create_from_phys_blocks_release() */
+typedef struct phys_blocks_owner
+{
+	void (*release)(void * ctx);
+	void * ctx;
+} phys_blocks_owner;
+
 UMP_KERNEL_API_EXPORT ump_dd_handle ump_dd_handle_create_from_phys_blocks(ump_dd_physical_block * blocks, unsigned long num_blocks)
 {
+	return ump_dd_handle_create_from_phys_blocks_release(blocks, num_blocks, NULL, NULL);
+}
+
+UMP_KERNEL_API_EXPORT ump_dd_handle ump_dd_handle_create_from_phys_blocks_release(ump_dd_physical_block * blocks, unsigned long num_blocks, void (*release)(void * ctx), void * ctx)
+{
+	phys_blocks_owner * owner = NULL;
 	ump_dd_mem * mem;
 	unsigned long size_total = 0;
 	int map_id;
@@ -52,11 +65,24 @@ UMP_KERNEL_API_EXPORT ump_dd_handle ump_dd_handle_create_from_phys_blocks(ump_dd
 		}
 	}
 
+	if (NULL != release)
+	{
+		owner = _mali_osk_malloc(sizeof(*owner));
+		if (NULL == owner)
+		{
+			DBG_MSG(1, ("Could not allocate owner in ump_dd_handle_create_from_phys_blocks()\n"));
+			return UMP_DD_HANDLE_INVALID;
+		}
+		owner->release = release;
+		owner->ctx = ctx;
+	}
+
 	/* Allocate the ump_dd_mem struct for this allocation */
 	mem = _mali_osk_malloc(sizeof(*mem));
 	if (NULL == mem)
 	{
 		DBG_MSG(1, ("Could not allocate ump_dd_mem in ump_dd_handle_create_from_phys_blocks()\n"));
+		if (NULL != owner) _mali_osk_free(owner);
 		return UMP_DD_HANDLE_INVALID;
 	}
 
@@ -68,6 +94,7 @@ UMP_KERNEL_API_EXPORT ump_dd_handle ump_dd_handle_create_from_phys_blocks(ump_dd
 	{
 		_mali_osk_lock_signal(device.secure_id_map_lock, _MALI_OSK_LOCKMODE_RW);
 		_mali_osk_free(mem);
+		if (NULL != owner) _mali_osk_free(owner);
 		DBG_MSG(1, ("Failed to allocate secure ID in ump_dd_handle_create_from_phys_blocks()\n"));
 		return UMP_DD_HANDLE_INVALID;
 	}
@@ -79,6 +106,7 @@ UMP_KERNEL_API_EXPORT ump_dd_handle ump_dd_handle_create_from_phys_blocks(ump_dd
 		ump_descriptor_mapping_free(device.secure_id_map, map_id);
 		_mali_osk_lock_signal(device.secure_id_map_lock, _MALI_OSK_LOCKMODE_RW);
 		_mali_osk_free(mem);
+		if (NULL != owner) _mali_osk_free(owner);
 		DBG_MSG(1, ("Could not allocate a mem handle for function ump_dd_handle_create_from_phys_blocks().\n"));
 		return UMP_DD_HANDLE_INVALID;
 	}
@@ -91,7 +119,7 @@ UMP_KERNEL_API_EXPORT ump_dd_handle ump_dd_handle_create_from_phys_blocks(ump_dd
 	mem->size_bytes = size_total;
 	mem->nr_blocks = num_blocks;
 	mem->backend_info = NULL;
-	mem->ctx = NULL;
+	mem->ctx = owner;
 	mem->release_func = phys_blocks_release;
 	/* For now UMP handles created by ump_dd_handle_create_from_phys_blocks() is forced to be Uncached */
 	mem->is_cached = 0;
@@ -106,8 +134,16 @@ UMP_KERNEL_API_EXPORT ump_dd_handle ump_dd_handle_create_from_phys_blocks(ump_dd
 
 static void phys_blocks_release(void * ctx, struct ump_dd_mem * descriptor)
 {
+	phys_blocks_owner * owner = (phys_blocks_owner *)ctx;
+
 	_mali_osk_free(descriptor->block_array);
 	descriptor->block_array = NULL;
+
+	if (NULL != owner)
+	{
+		owner->release(owner->ctx);
+		_mali_osk_free(owner);
+	}
 }
 
 _mali_osk_errcode_t _ump_ukk_allocate( _ump_uk_allocate_s *user_interaction )
@@ -42,6 +42,22 @@ void _ump_osk_mem_mapregion_term( ump_memory_allocation * descriptor );
 
 void _ump_osk_msync( ump_dd_mem * mem, void * virt, u32 offset, u32 size, ump_uk_msync_op op, ump_session_data * session_data );
 
+/** One range of an UMP buffer for _ump_osk_msync_ranges() */
+typedef struct ump_osk_msync_range
+{
+	ump_dd_mem * mem;
+	void * virt;          /**< CPU mapping of offset in the calling process, NULL if unknown */
+	u32 offset;
+	u32 size;
+	ump_uk_msync_op op;
+} ump_osk_msync_range;
+
+/**
+ * Cache maintenance on several ranges in one go. The L1 is maintained range
+ * by range unless the ranges add up to more than a full flush would cost.
+ */
+void _ump_osk_msync_ranges( ump_osk_msync_range * ranges, u32 count, ump_session_data * session_data );
+
 #ifdef __cplusplus
 }
 #endif
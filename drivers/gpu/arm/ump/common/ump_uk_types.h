@@ -49,6 +49,7 @@ typedef enum
 	_UMP_IOC_SWITCH_HW_USAGE,
 	_UMP_IOC_LOCK,
 	_UMP_IOC_UNLOCK,
+	_UMP_IOC_MSYNC_RANGES,
 }_ump_uk_functions;
 
 typedef enum
@@ -159,6 +160,20 @@ typedef struct _ump_uk_msync_s
 	u32 is_cached;        /**< [out] caching of CPU mappings */
 } _ump_uk_msync_s;
 
+/** Maximum number of ranges in one MSYNC_RANGES call */
+#define UMP_MSYNC_MAX_RANGES 16
+
+/**
+ * MSYNC_RANGES: cache maintenance on several ranges, possibly of different
+ * UMP buffers, in one call. Each entry is handled like a single MSYNC.
+ */
+typedef struct _ump_uk_msync_ranges_s
+{
+	void *ctx;                /**< [in,out] user-kernel context (trashed on output) */
+	u32 count;                /**< [in] number of entries in ranges, at most UMP_MSYNC_MAX_RANGES */
+	_ump_uk_msync_s *ranges;  /**< [in,out] the ranges, is_cached is returned for each */
+} _ump_uk_msync_ranges_s;
+
 typedef struct _ump_uk_cache_operations_control_s
 {
 	void *ctx;                   /**< [in,out] user-kernel context (trashed on output) */
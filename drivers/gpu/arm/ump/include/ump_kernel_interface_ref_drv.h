@@ -24,6 +24,13 @@ extern "C" {
 /** Turn specified physical memory into UMP memory. */
 UMP_KERNEL_API_EXPORT ump_dd_handle ump_dd_handle_create_from_phys_blocks(ump_dd_physical_block * blocks, unsigned long num_blocks);
 
+/**
+ * Turn specified physical memory into UMP memory, and hand it back to its owner
+ * once the last reference is gone. @a release is called with @a ctx from
+ * @ref ump_dd_reference_release, without any UMP locks held.
+ */
+UMP_KERNEL_API_EXPORT ump_dd_handle ump_dd_handle_create_from_phys_blocks_release(ump_dd_physical_block * blocks, unsigned long num_blocks, void (*release)(void * ctx), void * ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2012 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation, and any use by you of this program is subject to the terms of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained from Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * @file ump_descriptor_mapping_test.c
+ * Self-test of the lock free descriptor mapping lookups.
+ *
+ * One thread per online CPU looks up random descriptors in a shared map,
+ * while another thread keeps allocating and freeing descriptors so the
+ * table is grown and replaced underneath the readers. A descriptor mapped
+ * for the whole run must always be found with its own value, and any other
+ * descriptor must either be missing or carry the churn value.
+ *
+ * The result and the average cost of a lookup on each CPU are logged.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <asm/div64.h>
+
+#include "mali_osk.h"
+#include "ump_kernel_common.h"
+#include "ump_kernel_descriptor_mapping.h"
+
+/* Descriptors 1 .. UMP_MAPPING_TEST_LIVE - 1 stay mapped for the whole run */
+#define UMP_MAPPING_TEST_LIVE 64
+/* Lookups are done over this many descriptors, which is also the map limit */
+#define UMP_MAPPING_TEST_MAX 4096
+
+#define UMP_MAPPING_TEST_VALUE(d) ((void *)(0x1000 + ((unsigned long)(d) << 2)))
+#define UMP_MAPPING_TEST_CHURN ((void *)0x3)
+
+static unsigned int ump_mapping_test_lookups = 1000000;
+module_param(ump_mapping_test_lookups, uint, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(ump_mapping_test_lookups, "Lookups done on each CPU by the descriptor mapping self-test");
+
+struct ump_mapping_test_reader
+{
+	ump_descriptor_mapping *map;
+	struct task_struct *task;
+	struct completion done;
+	int cpu;
+	u32 errors;
+	u64 ns;
+};
+
+struct ump_mapping_test_writer
+{
+	ump_descriptor_mapping *map;
+	int *descriptors;
+};
+
+static int ump_mapping_test_reader_thread(void *data)
+{
+	struct ump_mapping_test_reader *reader = data;
+	u32 seed = reader->cpu + 1;
+	ktime_t start;
+	unsigned int i;
+
+	start = ktime_get();
+	for (i = 0; i < ump_mapping_test_lookups; i++)
+	{
+		void *target;
+		int d;
+
+		seed = seed * 1103515245 + 12345;
+		d = (seed >> 8) & (UMP_MAPPING_TEST_MAX - 1);
+
+		if (0 == ump_descriptor_mapping_get(reader->map, d, &target))
+		{
+			if (d < UMP_MAPPING_TEST_LIVE ? target != UMP_MAPPING_TEST_VALUE(d) : target != UMP_MAPPING_TEST_CHURN)
+			{
+				reader->errors++;
+			}
+		}
+		else if (d > 0 && d < UMP_MAPPING_TEST_LIVE)
+		{
+			reader->errors++;
+		}
+	}
+	reader->ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	complete(&reader->done);
+
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop())
+	{
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+static int ump_mapping_test_writer_thread(void *data)
+{
+	struct ump_mapping_test_writer *writer = data;
+	int *descriptors = writer->descriptors;
+	int count;
+
+	while (!kthread_should_stop())
+	{
+		for (count = 0; count < UMP_MAPPING_TEST_MAX; count++)
+		{
+			descriptors[count] = ump_descriptor_mapping_allocate_mapping(writer->map, UMP_MAPPING_TEST_CHURN);
+			if (descriptors[count] < 0)
+			{
+				break;
+			}
+		}
+
+		while (count-- > 0)
+		{
+			ump_descriptor_mapping_free(writer->map, descriptors[count]);
+		}
+
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static int __init ump_mapping_test_init(void)
+{
+	struct ump_mapping_test_reader *readers;
+	struct ump_mapping_test_writer writer;
+	struct task_struct *writer_task;
+	ump_descriptor_mapping *map;
+	u32 errors = 0;
+	int cpu;
+	int d;
+
+	/* Start small so the writer has to grow the table under the readers */
+	map = ump_descriptor_mapping_create(BITS_PER_LONG, UMP_MAPPING_TEST_MAX);
+	if (NULL == map)
+	{
+		return -ENOMEM;
+	}
+
+	readers = kcalloc(nr_cpu_ids, sizeof(*readers), GFP_KERNEL);
+	writer.descriptors = kcalloc(UMP_MAPPING_TEST_MAX, sizeof(*writer.descriptors), GFP_KERNEL);
+	if (NULL == readers || NULL == writer.descriptors)
+	{
+		kfree(writer.descriptors);
+		kfree(readers);
+		ump_descriptor_mapping_destroy(map);
+		return -ENOMEM;
+	}
+	writer.map = map;
+
+	for (d = 1; d < UMP_MAPPING_TEST_LIVE; d++)
+	{
+		if (d != ump_descriptor_mapping_allocate_mapping(map, UMP_MAPPING_TEST_VALUE(d)))
+		{
+			MSG_ERR(("Descriptor mapping test: unexpected descriptor allocated\n"));
+			errors++;
+		}
+	}
+
+	for_each_online_cpu(cpu)
+	{
+		struct ump_mapping_test_reader *reader = &readers[cpu];
+
+		reader->map = map;
+		reader->cpu = cpu;
+		init_completion(&reader->done);
+		reader->task = kthread_create(ump_mapping_test_reader_thread, reader, "ump_map_test/%d", cpu);
+		if (IS_ERR(reader->task))
+		{
+			reader->task = NULL;
+			continue;
+		}
+		kthread_bind(reader->task, cpu);
+	}
+
+	writer_task = kthread_run(ump_mapping_test_writer_thread, &writer, "ump_map_test_w");
+
+	for_each_online_cpu(cpu)
+	{
+		if (NULL != readers[cpu].task)
+		{
+			wake_up_process(readers[cpu].task);
+		}
+	}
+
+	for_each_online_cpu(cpu)
+	{
+		struct ump_mapping_test_reader *reader = &readers[cpu];
+		u64 ns_per_lookup;
+
+		if (NULL == reader->task)
+		{
+			continue;
+		}
+
+		wait_for_completion(&reader->done);
+		kthread_stop(reader->task);
+
+		ns_per_lookup = reader->ns;
+		do_div(ns_per_lookup, max(ump_mapping_test_lookups, 1U));
+		MSG(("Descriptor mapping test: cpu %d: %u lookups, %llu ns/lookup\n",
+		     cpu, ump_mapping_test_lookups, (unsigned long long)ns_per_lookup));
+
+		errors += reader->errors;
+	}
+
+	if (!IS_ERR(writer_task))
+	{
+		kthread_stop(writer_task);
+	}
+
+	if (0 != errors)
+	{
+		MSG_ERR(("Descriptor mapping test: FAILED, %u bad lookups\n", errors));
+	}
+	else
+	{
+		MSG(("Descriptor mapping test: passed\n"));
+	}
+
+	kfree(writer.descriptors);
+	kfree(readers);
+	ump_descriptor_mapping_destroy(map);
+
+	return 0;
+}
+
+late_initcall(ump_mapping_test_init);
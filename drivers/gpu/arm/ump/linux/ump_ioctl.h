@@ -45,6 +45,7 @@ extern "C"
 #define UMP_IOC_SWITCH_HW_USAGE   _IOW(UMP_IOCTL_NR,  _UMP_IOC_SWITCH_HW_USAGE, _ump_uk_switch_hw_usage_s)
 #define UMP_IOC_LOCK          _IOW(UMP_IOCTL_NR,  _UMP_IOC_LOCK, _ump_uk_lock_s)
 #define UMP_IOC_UNLOCK        _IOW(UMP_IOCTL_NR,  _UMP_IOC_UNLOCK, _ump_uk_unlock_s)
+#define UMP_IOC_MSYNC_RANGES  _IOWR(UMP_IOCTL_NR, _UMP_IOC_MSYNC_RANGES, _ump_uk_msync_ranges_s)
 
 
 #ifdef __cplusplus
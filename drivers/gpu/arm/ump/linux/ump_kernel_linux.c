@@ -34,6 +34,7 @@
 #include "ump_uk_types.h"
 #include "ump_ukk_wrappers.h"
 #include "ump_ukk_ref_wrappers.h"
+#include "ump_kernel_linux.h"
 
 
 /* Module parameter to control log level */
@@ -153,6 +154,25 @@ static const struct file_operations ump_memory_usage_fops = {
         .read = ump_memory_used_read,
 };
 
+static ssize_t ump_cache_stats_read(struct file *filp, char __user *ubuf, size_t cnt, loff_t *ppos)
+{
+        char buf[256];
+        size_t r;
+        u32 l1_full, l1_ranged;
+        u64 l1_bytes, l2_bytes;
+
+        _ump_osk_cache_stats(&l1_full, &l1_ranged, &l1_bytes, &l2_bytes);
+
+        r = snprintf(buf, sizeof(buf), "l1 full flushes: %u\nl1 ranged flushes: %u\nl1 ranged bytes: %llu\nl2 bytes: %llu\n",
+                     l1_full, l1_ranged, l1_bytes, l2_bytes);
+        return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static const struct file_operations ump_cache_stats_fops = {
+        .owner = THIS_MODULE,
+        .read = ump_cache_stats_read,
+};
+
 /*
  * Initialize the UMP device driver.
  */
@@ -169,6 +189,7 @@ int ump_kernel_device_initialize(void)
 	else
 	{
 		debugfs_create_file("memory_usage", 0400, ump_debugfs_dir, NULL, &ump_memory_usage_fops);
+		debugfs_create_file("cache_stats", 0400, ump_debugfs_dir, NULL, &ump_cache_stats_fops);
 	}
 #endif
 
@@ -352,6 +373,10 @@ static int ump_file_ioctl(struct inode *inode, struct file *filp, unsigned int c
 			err = ump_msync_wrapper((u32 __user *)argument, session_data);
 			break;
 
+		case UMP_IOC_MSYNC_RANGES:
+			err = ump_msync_ranges_wrapper((u32 __user *)argument, session_data);
+			break;
+
 		case UMP_IOC_CACHE_OPERATIONS_CONTROL:
 			err = ump_cache_operations_control_wrapper((u32 __user *)argument, session_data);
 			break;
@@ -453,6 +478,7 @@ EXPORT_SYMBOL(ump_dd_reference_release);
 
 /* Export our own extended kernel space allocator */
 EXPORT_SYMBOL(ump_dd_handle_create_from_phys_blocks);
+EXPORT_SYMBOL(ump_dd_handle_create_from_phys_blocks_release);
 
 /* Setup init and exit functions for this module */
 module_init(ump_initialize_module);
@@ -14,5 +14,8 @@
 int ump_kernel_device_initialize(void);
 void ump_kernel_device_terminate(void);
 
+/* Counters of the msync cache maintenance, since load */
+void _ump_osk_cache_stats( u32 *l1_full, u32 *l1_ranged, u64 *l1_bytes, u64 *l2_bytes );
+
 
 #endif /* __UMP_KERNEL_H__ */
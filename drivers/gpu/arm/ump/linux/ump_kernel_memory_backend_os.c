@@ -18,7 +18,10 @@
 #endif
 
 #include <linux/dma-mapping.h>
+#include <linux/dma-contiguous.h>
+#include <linux/highmem.h>
 #include <linux/mm.h>
+#include <linux/scatterlist.h>
 #include <linux/slab.h>
 #include <asm/atomic.h>
 #include <linux/vmalloc.h>
@@ -35,6 +38,24 @@ typedef struct os_allocator
 	u32 num_pages_allocated; /**< Number of pages allocated from the OS */
 } os_allocator;
 
+/*
+ * Per allocation bookkeeping, in descriptor->backend_info.
+ * Each UMP block is one physically contiguous chunk of pages.
+ */
+typedef struct os_allocation
+{
+	u32 num_pages;           /**< Pages taken from the OS, counted against num_pages_max */
+	struct sg_table sgt;     /**< One entry per block, mapped for the device when not cached */
+	int sgt_mapped;
+	int from_cma;            /**< Contiguous cached allocation from the CMA area */
+} os_allocation;
+
+/*
+ * Chunk sizes tried, largest first. Higher orders are only attempted
+ * opportunistically so an allocation never stalls on compaction.
+ */
+static const unsigned int os_orders[] = { 8, 4, 0 };
+
 
 
 static void os_free(void* ctx, ump_dd_mem * descriptor);
@@ -101,6 +122,94 @@ static int num_pages(int size) {
 	return (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
 }
 
+static struct page *os_alloc_chunk(int is_cached, unsigned int order)
+{
+	gfp_t gfp = GFP_HIGHUSER | __GFP_ZERO | __GFP_NOWARN;
+
+	if (!is_cached)
+	{
+		gfp |= __GFP_COLD;
+	}
+
+	if (order > 0)
+	{
+		gfp |= __GFP_NORETRY | __GFP_NO_KSWAPD;
+	}
+	else
+	{
+		gfp |= __GFP_REPEAT;
+	}
+
+	return alloc_pages(gfp, order);
+}
+
+static void os_free_blocks(ump_dd_mem * descriptor, os_allocation * allocation, int nr_blocks)
+{
+	int i;
+
+	if (allocation->from_cma)
+	{
+#ifdef CONFIG_CMA
+		dma_release_from_contiguous(NULL, pfn_to_page(descriptor->block_array[0].addr >> PAGE_SHIFT), allocation->num_pages);
+#endif
+		return;
+	}
+
+	for (i = 0; i < nr_blocks; i++)
+	{
+		DBG_MSG(6, ("Freeing physical block. Address: 0x%08lx, size: %lu\n", descriptor->block_array[i].addr, descriptor->block_array[i].size));
+		__free_pages(pfn_to_page(descriptor->block_array[i].addr >> PAGE_SHIFT), get_order(descriptor->block_array[i].size));
+	}
+}
+
+/*
+ * Physically contiguous, CPU cached memory. Comes from CMA when it is
+ * available, otherwise from the buddy allocator if the size allows it.
+ */
+static int os_allocate_contiguous_cached(ump_dd_mem * descriptor, os_allocation * allocation, u32 size)
+{
+	int count = num_pages(size);
+	struct page *page = NULL;
+	int i;
+
+#ifdef CONFIG_CMA
+	page = dma_alloc_from_contiguous(NULL, count, get_order(size));
+	if (NULL != page)
+	{
+		allocation->from_cma = 1;
+		allocation->num_pages = count;
+	}
+#endif
+	if (NULL == page)
+	{
+		unsigned int order = get_order(size);
+
+		if (order >= MAX_ORDER)
+		{
+			return 0;
+		}
+		page = os_alloc_chunk(1, order);
+		if (NULL == page)
+		{
+			return 0;
+		}
+		/* The block keeps the requested size, the tail pages are just not exported */
+		allocation->num_pages = 1 << order;
+	}
+	else
+	{
+		/* CMA hands out whatever was there before */
+		for (i = 0; i < count; i++)
+		{
+			clear_highpage(page + i);
+		}
+	}
+
+	descriptor->block_array[0].addr = page_to_phys(page);
+	descriptor->block_array[0].size = size;
+	return 1;
+}
+
 /*
  * Allocate UMP memory
  */
@@ -108,9 +217,13 @@ static int os_allocate(void* ctx, ump_dd_mem * descriptor)
 {
 	u32 left;
 	os_allocator * info;
+	os_allocation * allocation;
 	int pages_allocated = 0;
+	int nr_blocks = 0;
 	int is_cached;
 	int is_contiguous;
+	struct scatterlist *sg;
+	int i;
 
 	BUG_ON(!descriptor);
 	BUG_ON(!ctx);
@@ -120,17 +233,24 @@ static int os_allocate(void* ctx, ump_dd_mem * descriptor)
 	is_cached = descriptor->is_cached;
 	is_contiguous = descriptor->is_contiguous;
 
+	allocation = kzalloc(sizeof(*allocation), GFP_KERNEL);
+	if (NULL == allocation)
+	{
+		return 0; /* failure */
+	}
+
 	if (down_interruptible(&info->mutex))
 	{
 		DBG_MSG(1, ("Failed to get mutex in os_free\n"));
+		kfree(allocation);
 		return 0; /* failure */
 	}
 
-	descriptor->backend_info = NULL;
+	descriptor->backend_info = allocation;
 	if (is_contiguous)
 		descriptor->nr_blocks = 1;
 	else
-		descriptor->nr_blocks = num_pages(left);
+		descriptor->nr_blocks = num_pages(left); /* worst case, trimmed below */
 
 	DBG_MSG(5, ("Allocating page array. Size: %lu\n", descriptor->nr_blocks * sizeof(ump_dd_physical_block)));
 
@@ -139,95 +259,98 @@ static int os_allocate(void* ctx, ump_dd_mem * descriptor)
 	{
 		up(&info->mutex);
 		DBG_MSG(1, ("Block array could not be allocated\n"));
-		return 0; /* failure */
+		goto fail;
 	}
 
-	if (is_contiguous) {
+	if (is_contiguous && !is_cached) {
 		dma_addr_t dma_addr;
 
-		if (is_cached) {
-			printk(KERN_ERR "UMP: Contiguous cached areas not supported\n");
-			up(&info->mutex);
-			vfree(descriptor->block_array);
-			return 0;
-		}
-
 		descriptor->contiguous_cpu_addr =
 			dma_zalloc_coherent(NULL, left, &dma_addr, GFP_KERNEL);
 		if (descriptor->contiguous_cpu_addr == NULL) {
 			printk(KERN_ERR "Coherent dma allocation failed, size: %d\n", left);
 			up(&info->mutex);
-			vfree(descriptor->block_array);
-			return 0;
+			goto fail;
 		}
 		descriptor->block_array[0].addr = dma_addr;
 		descriptor->block_array[0].size = left;
 		DBG_MSG(4, ("Allocated %d bytes contiguously\n", left));
-		pages_allocated = num_pages(left);
+		allocation->num_pages = num_pages(left);
+		info->num_pages_allocated += allocation->num_pages;
+		up(&info->mutex);
+		return 1; /* success */
+	}
+
+	if (is_contiguous) {
+		if (info->num_pages_allocated + num_pages(left) > info->num_pages_max ||
+		    !os_allocate_contiguous_cached(descriptor, allocation, left))
+		{
+			printk(KERN_ERR "UMP: Contiguous cached allocation failed, size: %d\n", left);
+			up(&info->mutex);
+			goto fail;
+		}
+		DBG_MSG(4, ("Allocated %d cached bytes contiguously\n", left));
+		nr_blocks = 1;
+		pages_allocated = allocation->num_pages;
 		left = 0;
 	} else {
-		while (left > 0 &&
-		       ((info->num_pages_allocated + pages_allocated) < info->num_pages_max))
+		unsigned int o = 0;
+
+		while (left > 0 && o < ARRAY_SIZE(os_orders))
 		{
+			unsigned int order = os_orders[o];
+			u32 chunk = PAGE_SIZE << order;
 			struct page * new_page;
 
-			if (is_cached)
+			if (order > 0 && chunk > left)
 			{
-				new_page = alloc_page(GFP_HIGHUSER | __GFP_ZERO | __GFP_REPEAT | __GFP_NOWARN);
-			} else
-			{
-				new_page = alloc_page(GFP_HIGHUSER | __GFP_ZERO | __GFP_REPEAT | __GFP_NOWARN | __GFP_COLD);
+				o++;
+				continue;
 			}
-			if (NULL == new_page)
+			if ((info->num_pages_allocated + pages_allocated + (1 << order)) > info->num_pages_max)
 			{
 				break;
 			}
 
-			/* Ensure page caches are flushed. */
-			if ( is_cached )
-			{
-				descriptor->block_array[pages_allocated].addr = page_to_phys(new_page);
-				descriptor->block_array[pages_allocated].size = PAGE_SIZE;
-			} else
+			new_page = os_alloc_chunk(is_cached, order);
+			if (NULL == new_page)
 			{
-				descriptor->block_array[pages_allocated].addr = dma_map_page(NULL, new_page, 0, PAGE_SIZE, DMA_BIDIRECTIONAL );
-				descriptor->block_array[pages_allocated].size = PAGE_SIZE;
+				if (0 == order)
+				{
+					break;
+				}
+				o++;
+				continue;
 			}
 
-			DBG_MSG(5, ("Allocated page 0x%08lx cached: %d\n", descriptor->block_array[pages_allocated].addr, is_cached));
+			descriptor->block_array[nr_blocks].addr = page_to_phys(new_page);
+			descriptor->block_array[nr_blocks].size = chunk;
+
+			DBG_MSG(5, ("Allocated block 0x%08lx order %u cached: %d\n", descriptor->block_array[nr_blocks].addr, order, is_cached));
 
-			if (left < PAGE_SIZE)
+			if (left < chunk)
 			{
 				left = 0;
 			}
 			else
 			{
-				left -= PAGE_SIZE;
+				left -= chunk;
 			}
 
-			pages_allocated++;
+			nr_blocks++;
+			pages_allocated += 1 << order;
 		}
+		allocation->num_pages = pages_allocated;
 	}
 
-	DBG_MSG(5, ("Alloce for ID:%2d got %d pages, cached: %d\n", descriptor->secure_id,  pages_allocated));
+	DBG_MSG(5, ("Alloce for ID:%2d got %d pages in %d blocks, cached: %d\n", descriptor->secure_id, pages_allocated, nr_blocks, is_cached));
 
 	if (left)
 	{
 		DBG_MSG(1, ("Failed to allocate needed pages\n"));
-
-		while(pages_allocated)
-		{
-			pages_allocated--;
-			if ( !is_cached )
-			{
-				dma_unmap_page(NULL, descriptor->block_array[pages_allocated].addr, PAGE_SIZE, DMA_BIDIRECTIONAL);
-			}
-			__free_page(pfn_to_page(descriptor->block_array[pages_allocated].addr >> PAGE_SHIFT) );
-		}
-
+		os_free_blocks(descriptor, allocation, nr_blocks);
 		up(&info->mutex);
-
-		return 0; /* failure */
+		goto fail;
 	}
 
 	info->num_pages_allocated += pages_allocated;
@@ -236,7 +359,41 @@ static int os_allocate(void* ctx, ump_dd_mem * descriptor)
 
 	up(&info->mutex);
 
+	descriptor->nr_blocks = nr_blocks;
+
+	/* Describe the whole allocation once, so it can be handed to the DMA API in one go */
+	if (0 != sg_alloc_table(&allocation->sgt, nr_blocks, GFP_KERNEL))
+	{
+		goto fail_release;
+	}
+	for_each_sg(allocation->sgt.sgl, sg, nr_blocks, i)
+	{
+		sg_set_page(sg, pfn_to_page(descriptor->block_array[i].addr >> PAGE_SHIFT), descriptor->block_array[i].size, 0);
+	}
+
+	/* Ensure page caches are flushed. */
+	if (!is_cached)
+	{
+		if (0 == dma_map_sg(NULL, allocation->sgt.sgl, nr_blocks, DMA_BIDIRECTIONAL))
+		{
+			sg_free_table(&allocation->sgt);
+			goto fail_release;
+		}
+		allocation->sgt_mapped = 1;
+	}
+
 	return 1; /* success*/
+
+fail_release:
+	os_free(ctx, descriptor);
+	return 0; /* failure */
+
+fail:
+	vfree(descriptor->block_array);
+	descriptor->block_array = NULL;
+	descriptor->backend_info = NULL;
+	kfree(allocation);
+	return 0; /* failure */
 }
 
 
@@ -246,14 +403,16 @@ static int os_allocate(void* ctx, ump_dd_mem * descriptor)
 static void os_free(void* ctx, ump_dd_mem * descriptor)
 {
 	os_allocator * info;
-	int i;
+	os_allocation * allocation;
 
 	BUG_ON(!ctx);
 	BUG_ON(!descriptor);
 
 	info = (os_allocator*)ctx;
+	allocation = (os_allocation*)descriptor->backend_info;
 
-	BUG_ON(descriptor->nr_blocks > info->num_pages_allocated);
+	BUG_ON(!allocation);
+	BUG_ON(allocation->num_pages > info->num_pages_allocated);
 
 	if (down_interruptible(&info->mutex))
 	{
@@ -261,31 +420,35 @@ static void os_free(void* ctx, ump_dd_mem * descriptor)
 		return;
 	}
 
-	DBG_MSG(5, ("Releasing %lu OS pages\n", descriptor->nr_blocks));
+	DBG_MSG(5, ("Releasing %u OS pages in %lu blocks\n", allocation->num_pages, descriptor->nr_blocks));
 
-	if (!descriptor->is_contiguous)
-		info->num_pages_allocated -= descriptor->nr_blocks;
-	else
-		info->num_pages_allocated -= num_pages(descriptor->block_array[0].size);
+	info->num_pages_allocated -= allocation->num_pages;
 
 	up(&info->mutex);
 
-	if (descriptor->is_contiguous)
+	if (descriptor->is_contiguous && !descriptor->is_cached)
+	{
 		dma_free_coherent(NULL, descriptor->block_array[0].size,
 				  descriptor->contiguous_cpu_addr,
 				  descriptor->block_array[0].addr);
+	}
 	else
-		for ( i = 0; i < descriptor->nr_blocks; i++)
+	{
+		if (allocation->sgt_mapped)
 		{
-			DBG_MSG(6, ("Freeing physical page. Address: 0x%08lx\n", descriptor->block_array[i].addr));
-			if ( ! descriptor->is_cached)
-			{
-				dma_unmap_page(NULL, descriptor->block_array[i].addr, PAGE_SIZE, DMA_BIDIRECTIONAL);
-			}
-			__free_page(pfn_to_page(descriptor->block_array[i].addr>>PAGE_SHIFT) );
+			dma_unmap_sg(NULL, allocation->sgt.sgl, descriptor->nr_blocks, DMA_BIDIRECTIONAL);
 		}
+		if (NULL != allocation->sgt.sgl)
+		{
+			sg_free_table(&allocation->sgt);
+		}
+		os_free_blocks(descriptor, allocation, descriptor->nr_blocks);
+	}
 
 	vfree(descriptor->block_array);
+	descriptor->block_array = NULL;
+	descriptor->backend_info = NULL;
+	kfree(allocation);
 }
 
 
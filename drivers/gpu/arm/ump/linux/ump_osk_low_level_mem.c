@@ -20,6 +20,7 @@
 #include "ump_uk_types.h"
 #include "ump_ukk.h"
 #include "ump_kernel_common.h"
+#include "ump_kernel_linux.h"
 #include <linux/module.h>            /* kernel module definitions */
 #include <linux/kernel.h>
 #include <linux/mm.h>
@@ -210,61 +211,60 @@ _mali_osk_errcode_t _ump_osk_mem_mapregion_map( ump_memory_allocation * descript
 	return retval;
 }
 
+/*
+ * Above this many bytes in one call, flushing the L1 by address costs more
+ * than cleaning and invalidating all of it by set/way.
+ */
+static unsigned int ump_l1_full_flush_threshold = 32 * 1024;
+module_param(ump_l1_full_flush_threshold, uint, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH); /* rw-rw-r-- */
+MODULE_PARM_DESC(ump_l1_full_flush_threshold, "Size in bytes above which msync flushes the whole L1 instead of a range");
+
+static atomic_t ump_l1_full_flushes = ATOMIC_INIT(0);
+static atomic_t ump_l1_ranged_flushes = ATOMIC_INIT(0);
+static atomic64_t ump_l1_bytes = ATOMIC64_INIT(0);
+static atomic64_t ump_l2_bytes = ATOMIC64_INIT(0);
+
 static void level1_cache_flush_all(void)
 {
 	DBG_MSG(4, ("UMP[xx] Flushing complete L1 cache\n"));
+	atomic_inc(&ump_l1_full_flushes);
 	__cpuc_flush_kern_all();
 }
 
-void _ump_osk_msync( ump_dd_mem * mem, void * virt, u32 offset, u32 size, ump_uk_msync_op op, ump_session_data * session_data )
+/* Full L1 flush, deferred to the end of the cache operations if the session has some ongoing */
+static void level1_cache_flush_all_deferrable(ump_dd_mem * mem, ump_session_data * session_data)
 {
-	int i;
-	const void *start_v, *end_v;
-
-	/* Flush L1 using virtual address, the entire range in one go.
-	 * Only flush if user space process has a valid write mapping on given address. */
-	if( (mem) && (virt!=NULL) && (access_ok(VERIFY_WRITE, virt, size)) )
+	if (session_data && session_data->cache_operations_ongoing)
 	{
-		start_v = (void *)virt;
-		end_v   = (void *)(start_v + size - 1);
-		/*  There is no dmac_clean_range, so the L1 is always flushed,
-		 *  also for UMP_MSYNC_CLEAN. */
-		dmac_flush_range(start_v, end_v);
-		DBG_MSG(3, ("UMP[%02u] Flushing CPU L1 Cache. Cpu address: %x-%x\n", mem->secure_id, start_v,end_v));
+		session_data->has_pending_level1_cache_flush++;
+		DBG_MSG(4, ("UMP[%02u] Defering the L1 flush. Nr pending:%d\n", mem->secure_id, session_data->has_pending_level1_cache_flush) );
+		return;
 	}
-	else
+
+	if (NULL == session_data)
 	{
-		if (session_data)
-		{
-			if (op == _UMP_UK_MSYNC_FLUSH_L1  )
-			{
-				DBG_MSG(4, ("UMP Pending L1 cache flushes: %d\n", session_data->has_pending_level1_cache_flush));
-				session_data->has_pending_level1_cache_flush = 0;
-				level1_cache_flush_all();
-				return;
-			}
-			else
-			{
-				if (session_data->cache_operations_ongoing)
-				{
-					session_data->has_pending_level1_cache_flush++;
-					DBG_MSG(4, ("UMP[%02u] Defering the L1 flush. Nr pending:%d\n", mem->secure_id, session_data->has_pending_level1_cache_flush) );
-				}
-				else
-				{
-					/* Flushing the L1 cache for each switch_user() if ump_cache_operations_control(START) is not called */
-					level1_cache_flush_all();
-				}
-			}
-		}
-		else
-		{
-			DBG_MSG(4, ("Unkown state %s %d\n", __FUNCTION__, __LINE__));
-			level1_cache_flush_all();
-		}
+		DBG_MSG(4, ("Unkown state %s %d\n", __FUNCTION__, __LINE__));
 	}
+	level1_cache_flush_all();
+}
 
-	if ( NULL == mem ) return;
+static void level1_cache_flush_range(ump_dd_mem * mem, void * virt, u32 size)
+{
+	const void *start_v = virt;
+	const void *end_v = virt + size - 1;
+
+	/*  There is no dmac_clean_range, so the L1 is always flushed,
+	 *  also for UMP_MSYNC_CLEAN. */
+	dmac_flush_range(start_v, end_v);
+	atomic_inc(&ump_l1_ranged_flushes);
+	atomic64_add(size, &ump_l1_bytes);
+	DBG_MSG(3, ("UMP[%02u] Flushing CPU L1 Cache. Cpu address: %x-%x\n", mem->secure_id, start_v,end_v));
+}
+
+/* Flush L2 using physical addresses, block for block. */
+static void level2_cache_maintain(ump_dd_mem * mem, u32 offset, u32 size, ump_uk_msync_op op)
+{
+	int i;
 
 	if ( mem->size_bytes==size)
 	{
@@ -276,8 +276,8 @@ void _ump_osk_msync( ump_dd_mem * mem, void * virt, u32 offset, u32 size, ump_uk
 	            mem->secure_id, mem->nr_blocks, mem->size_bytes, size, offset, mem->block_array[0].addr));
 	}
 
+	atomic64_add(size, &ump_l2_bytes);
 
-	/* Flush L2 using physical addresses, block for block. */
 	for (i=0 ; i < mem->nr_blocks; i++)
 	{
 		u32 start_p, end_p;
@@ -341,6 +341,98 @@ void _ump_osk_msync( ump_dd_mem * mem, void * virt, u32 offset, u32 size, ump_uk
 			break;
 		}
 	}
+}
 
-	return;
+/*
+ * Find where the session has mem mapped, so the L1 can be maintained by
+ * address. Called with the session lock held.
+ */
+static void *ump_session_mapping_find(ump_session_data * session_data, ump_dd_mem * mem, u32 offset, u32 size)
+{
+	ump_memory_allocation *descriptor;
+	ump_memory_allocation *temp;
+
+	_MALI_OSK_LIST_FOREACHENTRY(descriptor, temp, &session_data->list_head_session_memory_mappings_list, ump_memory_allocation, list)
+	{
+		if ((ump_dd_mem *)descriptor->handle == mem && offset + size <= descriptor->size)
+		{
+			return (void *)((u32)descriptor->mapping + offset);
+		}
+	}
+
+	return NULL;
+}
+
+void _ump_osk_msync_ranges( ump_osk_msync_range * ranges, u32 count, ump_session_data * session_data )
+{
+	mali_bool full_l1 = MALI_FALSE;
+	u32 total = 0;
+	u32 i;
+
+	/* Only flush L1 by address where the user space process has a valid write mapping */
+	for (i = 0; i < count; i++)
+	{
+		if (NULL == ranges[i].virt || !access_ok(VERIFY_WRITE, ranges[i].virt, ranges[i].size))
+		{
+			full_l1 = MALI_TRUE;
+		}
+		total += ranges[i].size;
+	}
+	if (total > ump_l1_full_flush_threshold)
+	{
+		full_l1 = MALI_TRUE;
+	}
+
+	if (full_l1)
+	{
+		level1_cache_flush_all_deferrable(ranges[0].mem, session_data);
+	}
+	else
+	{
+		for (i = 0; i < count; i++)
+		{
+			level1_cache_flush_range(ranges[i].mem, ranges[i].virt, ranges[i].size);
+		}
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		level2_cache_maintain(ranges[i].mem, ranges[i].offset, ranges[i].size, ranges[i].op);
+	}
+}
+
+void _ump_osk_msync( ump_dd_mem * mem, void * virt, u32 offset, u32 size, ump_uk_msync_op op, ump_session_data * session_data )
+{
+	ump_osk_msync_range range;
+
+	if ( NULL == mem )
+	{
+		if (session_data && op == _UMP_UK_MSYNC_FLUSH_L1)
+		{
+			DBG_MSG(4, ("UMP Pending L1 cache flushes: %d\n", session_data->has_pending_level1_cache_flush));
+			session_data->has_pending_level1_cache_flush = 0;
+		}
+		level1_cache_flush_all();
+		return;
+	}
+
+	if (NULL == virt && NULL != session_data)
+	{
+		virt = ump_session_mapping_find(session_data, mem, offset, size);
+	}
+
+	range.mem = mem;
+	range.virt = virt;
+	range.offset = offset;
+	range.size = size;
+	range.op = op;
+	_ump_osk_msync_ranges(&range, 1, session_data);
+}
+
+void _ump_osk_cache_stats( u32 *l1_full, u32 *l1_ranged, u64 *l1_bytes, u64 *l2_bytes )
+{
+	*l1_full = atomic_read(&ump_l1_full_flushes);
+	*l1_ranged = atomic_read(&ump_l1_ranged_flushes);
+	*l1_bytes = atomic64_read(&ump_l1_bytes);
+	*l2_bytes = atomic64_read(&ump_l2_bytes);
 }
@@ -171,6 +171,55 @@ int ump_msync_wrapper(u32 __user * argument, struct ump_session_data  * session_
 
 	return 0; /* success */
 }
+
+/*
+ * IOCTL operation; Do cache maintenance on several ranges of UMP memory.
+ */
+int ump_msync_ranges_wrapper(u32 __user * argument, struct ump_session_data  * session_data)
+{
+	_ump_uk_msync_ranges_s user_interaction;
+	_ump_uk_msync_s ranges[UMP_MSYNC_MAX_RANGES];
+	_ump_uk_msync_s __user * user_ranges;
+
+	/* Sanity check input parameters */
+	if (NULL == argument || NULL == session_data)
+	{
+		MSG_ERR(("NULL parameter in ump_ioctl_msync_ranges()\n"));
+		return -ENOTTY;
+	}
+
+	if (0 != copy_from_user(&user_interaction, argument, sizeof(user_interaction)))
+	{
+		MSG_ERR(("copy_from_user() in ump_ioctl_msync_ranges()\n"));
+		return -EFAULT;
+	}
+
+	if (user_interaction.count > UMP_MSYNC_MAX_RANGES)
+	{
+		return -EINVAL;
+	}
+
+	user_ranges = (_ump_uk_msync_s __user *)user_interaction.ranges;
+	if (0 != copy_from_user(ranges, user_ranges, user_interaction.count * sizeof(ranges[0])))
+	{
+		MSG_ERR(("copy_from_user() of ranges in ump_ioctl_msync_ranges()\n"));
+		return -EFAULT;
+	}
+
+	user_interaction.ctx = (void *) session_data;
+	user_interaction.ranges = ranges;
+
+	_ump_ukk_msync_ranges( &user_interaction );
+
+	if (0 != copy_to_user(user_ranges, ranges, user_interaction.count * sizeof(ranges[0])))
+	{
+		MSG_ERR(("copy_to_user() failed in ump_ioctl_msync_ranges()\n"));
+		return -EFAULT;
+	}
+
+	return 0; /* success */
+}
+
 int ump_cache_operations_control_wrapper(u32 __user * argument, struct ump_session_data  * session_data)
 {
 	_ump_uk_cache_operations_control_s user_interaction;
@@ -30,6 +30,7 @@ int ump_get_api_version_wrapper(u32 __user * argument, struct ump_session_data *
 int ump_release_wrapper(u32 __user * argument, struct ump_session_data  * session_data);
 int ump_size_get_wrapper(u32 __user * argument, struct ump_session_data  * session_data);
 int ump_msync_wrapper(u32 __user * argument, struct ump_session_data  * session_data);
+int ump_msync_ranges_wrapper(u32 __user * argument, struct ump_session_data  * session_data);
 int ump_cache_operations_control_wrapper(u32 __user * argument, struct ump_session_data  * session_data);
 int ump_switch_hw_usage_wrapper(u32 __user * argument, struct ump_session_data  * session_data);
 int ump_lock_wrapper(u32 __user * argument, struct ump_session_data  * session_data);
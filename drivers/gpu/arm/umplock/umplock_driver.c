@@ -14,12 +14,17 @@
 #include <linux/slab.h>
 #include <linux/cdev.h>
 #include <linux/device.h>
+#include <linux/hash.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/semaphore.h>
 #include <asm/uaccess.h>
 #include "umplock_ioctl.h"
 #include <linux/sched.h>
 
-#define MAX_ITEMS 1024
-#define MAX_PIDS 128    
+#define UMPLOCK_HASH_BITS 8
+#define UMPLOCK_HASH_SIZE (1 << UMPLOCK_HASH_BITS)
 
 typedef struct lock_cmd_priv
 {
@@ -27,27 +32,38 @@ typedef struct lock_cmd_priv
 	u32 pid;			  /*process id*/
 }_lock_cmd_priv;
 
+/* One process' hold on a lock item, protected by the item's ref_lock */
 typedef struct lock_ref
 {
+	struct list_head list;
 	int ref_count;
 	u32 pid;
 }_lock_ref;
 
 typedef struct umplock_item
 {
+	struct hlist_node hash_node;   /* in device.items, protected by item_list_lock */
+	struct kref kref;              /* the hash table and every in-flight ioctl hold one */
 	u32 secure_id;
-	/*u32 references;*/
 	_lock_access_usage usage;
-	_lock_ref references[MAX_PIDS]; 
+	struct mutex ref_lock;         /* protects references */
+	struct list_head references;
 	struct semaphore item_lock;
 } umplock_item;
 
+typedef struct umplock_client
+{
+	struct list_head list;
+	u32 pid;
+	int open_count;
+} umplock_client;
+
 typedef struct umplock_device_private
 {
-	struct mutex item_list_lock;
+	struct mutex item_list_lock;   /* protects items and clients */
 	atomic_t sessions;
-	umplock_item items[MAX_ITEMS];
-	u32 pids[MAX_PIDS];
+	struct hlist_head items[UMPLOCK_HASH_SIZE];
+	struct list_head clients;
 } umplock_device_private;
 
 struct umplock_device
@@ -79,13 +95,29 @@ static umplock_device_private device;
 
 void umplock_init_locklist( void )
 {
-	memset(&device.items, 0, sizeof(umplock_item)*MAX_ITEMS);
+	int i;
+
+	for ( i=0; i<UMPLOCK_HASH_SIZE; i++ )
+	{
+		INIT_HLIST_HEAD(&device.items[i]);
+	}
+	INIT_LIST_HEAD(&device.clients);
 	atomic_set(&device.sessions, 0);
 }
 
+static int do_umplock_zap( void );
+
 void umplock_deinit_locklist( void )
 {
-	memset(&device.items, 0, sizeof(umplock_item)*MAX_ITEMS);
+	umplock_client *client, *tmp;
+
+	do_umplock_zap();
+
+	list_for_each_entry_safe(client, tmp, &device.clients, list)
+	{
+		list_del(&client->list);
+		kfree(client);
+	}
 }
 
 int umplock_device_initialize( void )
@@ -167,167 +199,232 @@ void umplock_destructor(void)
 	mutex_destroy(&device.item_list_lock);
 }
 
-int umplock_find_item( u32 secure_id )
+static void umplock_item_free( struct kref *kref )
 {
-	int i;
-	for ( i=0; i<MAX_ITEMS; i++ )
+	umplock_item *item = container_of(kref, umplock_item, kref);
+	_lock_ref *ref, *tmp;
+
+	list_for_each_entry_safe(ref, tmp, &item->references, list)
 	{
-		if ( device.items[i].secure_id == secure_id ) return i;
+		list_del(&ref->list);
+		kfree(ref);
 	}
-	
-	return -1;
+	mutex_destroy(&item->ref_lock);
+	kfree(item);
 }
 
-int umplock_find_slot( void )
+static void umplock_item_put( umplock_item *item )
 {
-	int i;
-	for ( i=0; i<MAX_ITEMS; i++ )
+	kref_put(&item->kref, umplock_item_free);
+}
+
+static struct hlist_head *umplock_hash_bucket( u32 secure_id )
+{
+	return &device.items[hash_32(secure_id, UMPLOCK_HASH_BITS)];
+}
+
+/* Called with item_list_lock held */
+static umplock_item *umplock_find_item( u32 secure_id )
+{
+	umplock_item *item;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(item, node, umplock_hash_bucket(secure_id), hash_node)
 	{
-		if ( device.items[i].secure_id == 0 ) return i;
+		if ( item->secure_id == secure_id ) return item;
 	}
 
-	return -1;
+	return NULL;
 }
 
-static int umplock_find_item_by_pid( _lock_cmd_priv *lock_cmd, int *item_slot, int *ref_slot)
+/* Look up an item and take a reference on it, creating it first if asked to */
+static umplock_item *umplock_get_item( _lock_item_s *lock_item, int create )
 {
-	_lock_item_s *lock_item;
-	int i,j;
-	
-	lock_item = (_lock_item_s *)&lock_cmd->msg;
-
-	i = umplock_find_item(lock_item->secure_id);
+	umplock_item *item, *new_item = NULL;
 
-	if ( i < 0)
-		return -1;
-	
-	for(j=0; j<MAX_PIDS; j++)
+	if ( create )
 	{
-		if(device.items[i].references[j].pid == lock_cmd->pid)
+		new_item = kzalloc(sizeof(*new_item), GFP_KERNEL);
+		if ( NULL == new_item )
 		{
-			*item_slot = i;
-			*ref_slot = j;
-			return 0;
+			printk( KERN_ERR "UMPLOCK: whoops, out of memory for lock item 0x%x\n", lock_item->secure_id );
+			return NULL;
 		}
 	}
-	return -1 ;
+
+	mutex_lock(&device.item_list_lock);
+	item = umplock_find_item( lock_item->secure_id );
+	if ( NULL == item && NULL != new_item )
+	{
+		item = new_item;
+		new_item = NULL;
+
+		kref_init(&item->kref); /* the hash table's reference */
+		item->secure_id = lock_item->secure_id;
+		item->usage = lock_item->usage;
+		mutex_init(&item->ref_lock);
+		INIT_LIST_HEAD(&item->references);
+		sema_init(&item->item_lock, 1);
+		hlist_add_head(&item->hash_node, umplock_hash_bucket(item->secure_id));
+	}
+	if ( NULL != item )
+	{
+		kref_get(&item->kref);
+	}
+	mutex_unlock(&device.item_list_lock);
+
+	kfree(new_item);
+	return item;
 }
 
-static int umplock_find_client_valid(u32 pid)
+/* Drop an item from the hash table once nobody references it any more */
+static void umplock_item_unhash_if_unused( umplock_item *item )
 {
-	int i;
+	int unhashed = 0;
 
-	if(pid == 0)
-		return -1;
-	
-	for(i=0; i<MAX_PIDS; i++)
+	mutex_lock(&device.item_list_lock);
+	mutex_lock(&item->ref_lock);
+	if ( list_empty(&item->references) && !hlist_unhashed(&item->hash_node) )
+	{
+		hlist_del_init(&item->hash_node);
+		unhashed = 1;
+	}
+	mutex_unlock(&item->ref_lock);
+	mutex_unlock(&device.item_list_lock);
+
+	if ( unhashed )
+	{
+		umplock_item_put( item );
+	}
+}
+
+/* Called with the item's ref_lock held */
+static _lock_ref *umplock_find_ref( umplock_item *item, u32 pid )
+{
+	_lock_ref *ref;
+
+	list_for_each_entry(ref, &item->references, list)
+	{
+		if ( ref->pid == pid ) return ref;
+	}
+
+	return NULL;
+}
+
+/* Called with item_list_lock held */
+static umplock_client *umplock_find_client( u32 pid )
+{
+	umplock_client *client;
+
+	list_for_each_entry(client, &device.clients, list)
 	{
-		if(device.pids[i] == pid) return i;
+		if ( client->pid == pid ) return client;
 	}
 
-	return -1;
+	return NULL;
 }
+
 /** IOCTLs **/
 static int do_umplock_create( _lock_cmd_priv *lock_cmd)
 {
-	int i_index,ref_index;
-	int ret;
+	umplock_item *item;
+	_lock_ref *ref;
 	_lock_item_s *lock_item = (_lock_item_s *)&lock_cmd->msg;
 
-	i_index = ref_index = -1;
-
 	#if 0
 	if ( lock_item->usage == 1 ) printk( KERN_DEBUG "UMPLOCK: C 0x%x GPU SURFACE\n", lock_item->secure_id );
 	else if ( lock_item->usage == 2 ) printk( KERN_DEBUG "UMPLOCK: C 0x%x GPU TEXTURE\n", lock_item->secure_id );
 	else printk( KERN_DEBUG "UMPLOCK: C 0x%x CPU\n", lock_item->secure_id );
 	#endif
 
-	mutex_lock(&device.item_list_lock);
-	ret = umplock_find_client_valid( lock_cmd->pid );	
-	mutex_unlock(&device.item_list_lock);
-	if( ret < 0 )
+again:
+	item = umplock_get_item( lock_item, 1 );
+	if ( NULL == item )
 	{
-		/*lock request from an invalid client pid, do nothing*/
 		return 0;
 	}
 
-	mutex_lock(&device.item_list_lock);
-
-	ret = umplock_find_item_by_pid( lock_cmd, &i_index, &ref_index );
-	if ( ret >= 0 )
+	mutex_lock(&item->ref_lock);
+	if ( hlist_unhashed(&item->hash_node) )
 	{
-		if (device.items[i_index].references[ref_index].ref_count == 0)
-			device.items[i_index].references[ref_index].ref_count = 1;
+		/* The last reference went away while we were looking the item up */
+		mutex_unlock(&item->ref_lock);
+		umplock_item_put( item );
+		goto again;
 	}
-	else if ( (i_index = umplock_find_item( lock_item->secure_id)) >= 0 )
+
+	ref = umplock_find_ref( item, lock_cmd->pid );
+	if ( NULL != ref )
 	{
-		for ( ref_index = 0; ref_index < MAX_PIDS; ref_index++)
-		{
-			if (device.items[i_index].references[ref_index].pid == 0) break;
-		}
-		if ( ref_index < MAX_PIDS )
-		{
-			device.items[i_index].references[ref_index].pid = lock_cmd->pid;
-			device.items[i_index].references[ref_index].ref_count = 1;
-		}
-		else
-		{
-			printk( KERN_ERR "UMPLOCK: whoops, item ran out of available reference slot\n" );
-		}
+		if (ref->ref_count == 0)
+			ref->ref_count = 1;
 	}
 	else
 	{
-		i_index = umplock_find_slot();
-
-		if ( i_index >= 0 )
-		{
-			device.items[i_index].secure_id = lock_item->secure_id;
-			device.items[i_index].usage = lock_item->usage;
-			device.items[i_index].references[0].pid = lock_cmd->pid;
-			device.items[i_index].references[0].ref_count = 1;
-			sema_init(&device.items[i_index].item_lock, 1);
-		}
-		else
+		ref = kzalloc(sizeof(*ref), GFP_KERNEL);
+		if ( NULL != ref )
 		{
-			printk( KERN_ERR "UMPLOCK: whoops, ran out of available slots\n" );
+			ref->pid = lock_cmd->pid;
+			ref->ref_count = 1;
+			list_add_tail(&ref->list, &item->references);
 		}
 	}
-	
-	mutex_unlock(&device.item_list_lock);
+	mutex_unlock(&item->ref_lock);
+
+	if ( NULL == ref )
+	{
+		printk( KERN_ERR "UMPLOCK: whoops, out of memory for a reference on 0x%x\n", lock_item->secure_id );
+		/* Don't leave an item nobody references behind */
+		umplock_item_unhash_if_unused( item );
+	}
+
+	umplock_item_put( item );
 	return 0;
 }
 
 static int do_umplock_process( _lock_cmd_priv *lock_cmd )
 {
-	int ret, i_index, ref_index, ref_count;
+	umplock_item *item;
+	_lock_ref *ref;
+	int ref_count;
+	int ret = 0;
 	_lock_item_s *lock_item = (_lock_item_s *)&lock_cmd->msg;
 
-	mutex_lock(&device.item_list_lock);
-	ret = umplock_find_client_valid( lock_cmd->pid );	
-	mutex_unlock(&device.item_list_lock);
-	if( ret < 0 )
+	item = umplock_get_item( lock_item, 0 );
+	if ( NULL == item )
 	{
-		/*lock request from an invalid client pid, do nothing*/
 		return 0;
 	}
-	
-	mutex_lock(&device.item_list_lock);
-	ret = umplock_find_item_by_pid( lock_cmd, &i_index, &ref_index );
-	ref_count = device.items[i_index].references[ref_index].ref_count;
-	mutex_unlock(&device.item_list_lock);
-	if ( ret >= 0 )
+
+	mutex_lock(&item->ref_lock);
+	ref = umplock_find_ref( item, lock_cmd->pid );
+	ref_count = ref ? ref->ref_count : 0;
+	mutex_unlock(&item->ref_lock);
+
+	if ( NULL != ref )
 	{
+		/* Sleep on the item alone; other items and other clients carry on */
 		if (ref_count == 1)
 		{
-			if ( down_interruptible(&device.items[i_index].item_lock) )
+			if ( down_interruptible(&item->item_lock) )
 			{
-				return -ERESTARTSYS;
+				ret = -ERESTARTSYS;
+				goto out;
 			}
 		}
 
-		mutex_lock(&device.item_list_lock);
-		device.items[i_index].references[ref_index].ref_count++;
-		mutex_unlock(&device.item_list_lock);
+		mutex_lock(&item->ref_lock);
+		ref = umplock_find_ref( item, lock_cmd->pid );
+		if ( NULL != ref )
+		{
+			ref->ref_count++;
+		}
+		else if (ref_count == 1)
+		{
+			/* Released under our feet, don't keep the item locked */
+			up( &item->item_lock );
+		}
+		mutex_unlock(&item->ref_lock);
 
 		#if 0
 		if ( lock_item->usage == 1 ) printk( KERN_DEBUG "UMPLOCK:  P 0x%x GPU SURFACE\n", lock_item->secure_id );
@@ -336,102 +433,119 @@ static int do_umplock_process( _lock_cmd_priv *lock_cmd )
 		#endif
 	}
 
-	return 0;
+out:
+	umplock_item_put( item );
+	return ret;
 }
 
-static int do_umplock_release( _lock_cmd_priv *lock_cmd )
+/* Drop one count of pid's reference on item, returns the counts left */
+static int umplock_item_release( umplock_item *item, u32 pid )
 {
-	int i_index,ref_index, ref_count;
-	int ret;
-	_lock_item_s *lock_item = (_lock_item_s *)&lock_cmd->msg;
+	_lock_ref *ref;
+	int ref_count;
 
-	mutex_lock(&device.item_list_lock);
-	ret = umplock_find_client_valid( lock_cmd->pid );	
-	mutex_unlock(&device.item_list_lock);
-	if( ret < 0 )
+	mutex_lock(&item->ref_lock);
+	ref = umplock_find_ref( item, pid );
+	if ( NULL == ref )
 	{
-		/*lock request from an invalid client pid, do nothing*/
+		mutex_unlock(&item->ref_lock);
 		return 0;
 	}
-	
-	i_index = ref_index = -1;
 
-	mutex_lock(&device.item_list_lock);
-	ret = umplock_find_item_by_pid( lock_cmd, &i_index, &ref_index );
-	mutex_unlock(&device.item_list_lock);
+	ref->ref_count--;
+	ref_count = ref->ref_count;
+	if ( ref_count == 1 )
+	{
+		if ( 0 == down_trylock(&item->item_lock) )
+		{
+			//printk( KERN_ERR "UMPLOCK: semaphore for secure id 0x%x was not taken\n", item->secure_id );
+		}
+		up( &item->item_lock );
+		ref_count = 0;
+	}
+	if ( ref_count <= 0 )
+	{
+		list_del(&ref->list);
+		kfree(ref);
+		ref_count = 0;
+	}
+	mutex_unlock(&item->ref_lock);
 
-	if ( ret >= 0 )
+	return ref_count;
+}
+
+static int do_umplock_release( _lock_cmd_priv *lock_cmd )
+{
+	umplock_item *item;
+	_lock_item_s *lock_item = (_lock_item_s *)&lock_cmd->msg;
+
+	item = umplock_get_item( lock_item, 0 );
+	if ( NULL == item )
 	{
-		mutex_lock(&device.item_list_lock);
-		device.items[i_index].references[ref_index].ref_count--;
-		ref_count = device.items[i_index].references[ref_index].ref_count;
-		mutex_unlock(&device.item_list_lock);
+		return 0;
+	}
 
-		#if 0
-		if ( lock_item->usage == 1 ) printk( KERN_DEBUG "UMPLOCK:   R 0x%x GPU SURFACE\n", lock_item->secure_id );
-		else if ( lock_item->usage == 2 ) printk( KERN_DEBUG "UMPLOCK:   R 0x%x GPU TEXTURE\n", lock_item->secure_id );
-		else printk( KERN_DEBUG "UMPLOCK:   R 0x%x CPU\n", lock_item->secure_id );
-		#endif
-        if ( ref_count == 1 )
-		{
-			if ( 0 == down_trylock(&device.items[i_index].item_lock) )
-			{
-				//printk( KERN_ERR "UMPLOCK: semaphore for secure id 0x%x was not taken\n", lock_item->secure_id );
-			}
-			up( &device.items[i_index].item_lock );
+	#if 0
+	if ( lock_item->usage == 1 ) printk( KERN_DEBUG "UMPLOCK:   R 0x%x GPU SURFACE\n", lock_item->secure_id );
+	else if ( lock_item->usage == 2 ) printk( KERN_DEBUG "UMPLOCK:   R 0x%x GPU TEXTURE\n", lock_item->secure_id );
+	else printk( KERN_DEBUG "UMPLOCK:   R 0x%x CPU\n", lock_item->secure_id );
+	#endif
 
-			mutex_lock(&device.item_list_lock);
-			device.items[i_index].references[ref_index].ref_count = 0;
-			device.items[i_index].references[ref_index].pid = 0;
-			mutex_unlock(&device.item_list_lock);
-		}
+	if ( 0 == umplock_item_release( item, lock_cmd->pid ) )
+	{
+		umplock_item_unhash_if_unused( item );
 	}
+
+	umplock_item_put( item );
 	return 0;
 }
 
 static int do_umplock_zap( void )
 {
+	umplock_item *item;
+	struct hlist_node *node, *tmp;
 	int i;
 
 	printk( KERN_DEBUG "UMPLOCK: ZAP ALL ENTRIES!\n" );
 
 	mutex_lock(&device.item_list_lock);
-	
-	for ( i=0; i<MAX_ITEMS; i++ )
+	for ( i=0; i<UMPLOCK_HASH_SIZE; i++ )
 	{
-		device.items[i].secure_id = 0;
-		memset(&device.items[i].references, 0, sizeof(_lock_ref)*MAX_PIDS);
-		sema_init(&device.items[i].item_lock, 1);
+		hlist_for_each_entry_safe(item, node, tmp, &device.items[i], hash_node)
+		{
+			hlist_del_init(&item->hash_node);
+			umplock_item_put( item );
+		}
 	}
 	mutex_unlock(&device.item_list_lock);
 
-	for ( i=0; i<MAX_PIDS; i++)
-	{
-		device.pids[i] = 0;
-	}
 	return 0;
 }
 
 static int do_umplock_dump( void )
 {
-	int i, j;
+	umplock_item *item;
+	struct hlist_node *node;
+	_lock_ref *ref;
+	int i;
 
 	printk("dump all the items\n");
 
 	mutex_lock(&device.item_list_lock);
-	for (i = 0; i < MAX_ITEMS; i++)
+	for (i = 0; i < UMPLOCK_HASH_SIZE; i++)
 	{
-		for (j = 0; j < MAX_PIDS; j++)
+		hlist_for_each_entry(item, node, &device.items[i], hash_node)
 		{
-			if (device.items[i].secure_id != 0 && device.items[i].references[j].pid != 0)
+			mutex_lock(&item->ref_lock);
+			list_for_each_entry(ref, &item->references, list)
 			{
-				printk("item[%d]->secure_id=%d\t reference[%d].ref_count=%d.pid=%d\n",
+				printk("bucket[%d]->secure_id=%d\t reference.ref_count=%d.pid=%d\n",
 					i,
-					device.items[i].secure_id,
-					j,
-					device.items[i].references[j].ref_count,
-					device.items[i].references[j].pid);
+					item->secure_id,
+					ref->ref_count,
+					ref->pid);
 			}
+			mutex_unlock(&item->ref_lock);
 		}
 	}
 	mutex_unlock(&device.item_list_lock);
@@ -439,74 +553,87 @@ static int do_umplock_dump( void )
 	return 0;
 }
 
-int do_umplock_client_add (_lock_cmd_priv *lock_cmd )
+static umplock_client *do_umplock_client_add( u32 pid )
 {
-	int i;
+	umplock_client *client;
 
-	for ( i= 0; i<MAX_PIDS; i++)
+	mutex_lock(&device.item_list_lock);
+	client = umplock_find_client( pid );
+	if ( NULL == client )
 	{
-		if(device.pids[i] == lock_cmd->pid)
+		client = kzalloc(sizeof(*client), GFP_KERNEL);
+		if ( NULL == client )
 		{
-			return 0;
+			mutex_unlock(&device.item_list_lock);
+			printk(KERN_ERR "Oops, out of memory for a client\n ");
+			return NULL;
 		}
+		client->pid = pid;
+		list_add_tail(&client->list, &device.clients);
 	}
-	for ( i=0; i<MAX_PIDS; i++)
+	client->open_count++;
+	mutex_unlock(&device.item_list_lock);
+
+	return client;
+}
+
+/* Find, and take a reference on, an item pid still holds. Starts looking in bucket *bucket. */
+static umplock_item *umplock_find_item_by_pid( u32 pid, int *bucket )
+{
+	umplock_item *item;
+	struct hlist_node *node;
+	int found;
+
+	mutex_lock(&device.item_list_lock);
+	for ( ; *bucket < UMPLOCK_HASH_SIZE; (*bucket)++ )
 	{
-		if(device.pids[i]==0)
+		hlist_for_each_entry(item, node, &device.items[*bucket], hash_node)
 		{
-			mutex_lock(&device.item_list_lock);
-			device.pids[i] = lock_cmd->pid;
-			mutex_unlock(&device.item_list_lock);
-			break;
+			mutex_lock(&item->ref_lock);
+			found = (NULL != umplock_find_ref( item, pid ));
+			mutex_unlock(&item->ref_lock);
+
+			if ( found )
+			{
+				kref_get(&item->kref);
+				mutex_unlock(&device.item_list_lock);
+				return item;
+			}
 		}
 	}
-	if( i==MAX_PIDS)
-	{
-		printk(KERN_ERR "Oops, Run out of cient slots\n ");
-	}
-	return 0;
+	mutex_unlock(&device.item_list_lock);
+
+	return NULL;
 }
 
-int do_umplock_client_delete (_lock_cmd_priv *lock_cmd )
+static int do_umplock_client_delete( umplock_client *client )
 {
-	int p_index=-1, i_index=-1,ref_index=-1;
-	int ret;
-	_lock_item_s *lock_item;
-	lock_item = (_lock_item_s *)&lock_cmd->msg;
-	
+	umplock_item *item;
+	u32 pid = client->pid;
+	int bucket = 0;
+
 	mutex_lock(&device.item_list_lock);
-	p_index = umplock_find_client_valid( lock_cmd->pid );
-	mutex_unlock(&device.item_list_lock);
-	/*lock item pid is not valid.*/
-	if ( p_index<0 )
+	if ( --client->open_count > 0 )
+	{
+		/*the process still has the device open.*/
+		mutex_unlock(&device.item_list_lock);
 		return 0;
+	}
+	/*remove the pid from umplock valid pid list*/
+	list_del(&client->list);
+	kfree(client);
+	mutex_unlock(&device.item_list_lock);
 
-
-	/*walk through umplock item list and release reference attached to this client*/
-	for(i_index = 0; i_index< MAX_ITEMS; i_index++ )
+	/*walk through umplock item list and release references attached to this client*/
+	while ( NULL != (item = umplock_find_item_by_pid( pid, &bucket )) )
 	{
-		lock_item->secure_id = device.items[i_index].secure_id;
-		mutex_lock(&device.item_list_lock);
-		/*find the item index and reference slot for the lock_item*/
-		ret = umplock_find_item_by_pid(lock_cmd, &i_index, &ref_index);
-		mutex_unlock(&device.item_list_lock);
-		
-		if(ret < 0)
-		{
-			/*client has no reference on this umplock item, skip*/
-			continue;
-		}
-		while(device.items[i_index].references[ref_index].ref_count)
+		while ( umplock_item_release( item, pid ) )
 		{
 			/*release references on this client*/
-			do_umplock_release(lock_cmd);
 		}
+		umplock_item_unhash_if_unused( item );
+		umplock_item_put( item );
 	}
-	
-	mutex_lock(&device.item_list_lock);
-	/*remove the pid from umplock valid pid list*/
-	device.pids[p_index] = 0;
-	mutex_unlock(&device.item_list_lock);
 
 	return 0;
 }
@@ -516,6 +643,7 @@ static long umplock_driver_ioctl( struct file *f, unsigned int cmd, unsigned lon
 	int ret;
 	uint32_t size = _IOC_SIZE(cmd);
 	_lock_cmd_priv lock_cmd ;
+	umplock_client *client = f->private_data;
 
 	if (_IOC_TYPE(cmd) != LOCK_IOCTL_GROUP )
 	{
@@ -539,7 +667,12 @@ static long umplock_driver_ioctl( struct file *f, unsigned int cmd, unsigned lon
 			{
 				return -EFAULT;
 			}
-			lock_cmd.pid = (u32)current->tgid;		
+			lock_cmd.pid = (u32)current->tgid;
+			if ( lock_cmd.pid != client->pid )
+			{
+				/*lock request from a process that did not open the device, do nothing*/
+				return 0;
+			}
 			ret = do_umplock_create(&lock_cmd);
 			if (ret)
 			{
@@ -558,6 +691,11 @@ static long umplock_driver_ioctl( struct file *f, unsigned int cmd, unsigned lon
 				return -EFAULT;
 			}
 			lock_cmd.pid = (u32)current->tgid;
+			if ( lock_cmd.pid != client->pid )
+			{
+				/*lock request from a process that did not open the device, do nothing*/
+				return 0;
+			}
 			return do_umplock_process(&lock_cmd);
 
 		case LOCK_IOCTL_RELEASE:
@@ -571,6 +709,11 @@ static long umplock_driver_ioctl( struct file *f, unsigned int cmd, unsigned lon
 				return -EFAULT;
 			}
 			lock_cmd.pid = (u32)current->tgid;
+			if ( lock_cmd.pid != client->pid )
+			{
+				/*lock request from a process that did not open the device, do nothing*/
+				return 0;
+			}
 			ret = do_umplock_release( &lock_cmd );
 			if (ret)
 			{
@@ -592,23 +735,24 @@ static long umplock_driver_ioctl( struct file *f, unsigned int cmd, unsigned lon
 
 static int umplock_driver_open( struct inode *inode, struct file *filp )
 {
-	_lock_cmd_priv lock_cmd;
-	
+	umplock_client *client;
+
+	client = do_umplock_client_add( (u32)current->tgid );
+	if ( NULL == client )
+	{
+		return -ENOMEM;
+	}
+	filp->private_data = client;
+
 	atomic_inc(&device.sessions); 
 	printk( KERN_DEBUG "UMPLOCK: OPEN SESSION (%i references)\n", atomic_read(&device.sessions) );
 	
-	lock_cmd.pid = (u32)current->tgid;
-	do_umplock_client_add(&lock_cmd);
-	
 	return 0;
 }
 
 static int umplock_driver_release( struct inode *inode, struct file *filp )
 {
-	_lock_cmd_priv lock_cmd;
-	
-	lock_cmd.pid = (u32)current->tgid;
-	do_umplock_client_delete(&lock_cmd);
+	do_umplock_client_delete( filp->private_data );
 	
 	atomic_dec(&device.sessions); 
 	printk( KERN_DEBUG "UMPLOCK: CLOSE SESSION (%i references)\n", atomic_read(&device.sessions) );
@@ -54,12 +54,15 @@
  *	we can refer to the crtc to current hardware interrupt occured through
  *	this pipe value.
  * @dpms: store the crtc dpms value
+ * @pending_flip: a page flip was applied and hasn't been latched by the
+ *	hardware yet. protected by drm_device->event_lock.
  */
 struct exynos_drm_crtc {
 	struct drm_crtc			drm_crtc;
 	struct exynos_drm_overlay	overlay;
 	unsigned int			pipe;
 	unsigned int			dpms;
+	bool				pending_flip;
 };
 
 static void exynos_drm_crtc_apply(struct drm_crtc *crtc)
@@ -81,6 +84,8 @@ int exynos_drm_overlay_update(struct exynos_drm_overlay *overlay,
 	struct exynos_drm_gem_buf *buffer;
 	unsigned int actual_w;
 	unsigned int actual_h;
+	unsigned int src_w;
+	unsigned int src_h;
 	int nr = exynos_drm_format_num_buffers(fb->pixel_format);
 	int i;
 
@@ -102,6 +107,17 @@ int exynos_drm_overlay_update(struct exynos_drm_overlay *overlay,
 	actual_w = min((mode->hdisplay - pos->crtc_x), pos->crtc_w);
 	actual_h = min((mode->vdisplay - pos->crtc_y), pos->crtc_h);
 
+	/*
+	 * the source region is clipped in proportion to the window so that
+	 * a scaled overlay keeps its scaling ratio at the screen edge.
+	 */
+	src_w = pos->src_w ? pos->src_w : pos->crtc_w;
+	src_h = pos->src_h ? pos->src_h : pos->crtc_h;
+	if (actual_w < pos->crtc_w)
+		src_w = src_w * actual_w / pos->crtc_w;
+	if (actual_h < pos->crtc_h)
+		src_h = src_h * actual_h / pos->crtc_h;
+
 	/* set drm framebuffer data. */
 	overlay->fb_x = pos->fb_x;
 	overlay->fb_y = pos->fb_y;
@@ -116,6 +132,8 @@ int exynos_drm_overlay_update(struct exynos_drm_overlay *overlay,
 	overlay->crtc_y = pos->crtc_y;
 	overlay->crtc_width = actual_w;
 	overlay->crtc_height = actual_h;
+	overlay->src_width = src_w;
+	overlay->src_height = src_h;
 
 	/* set drm mode data. */
 	overlay->mode_width = mode->hdisplay;
@@ -185,6 +203,9 @@ static void exynos_drm_crtc_dpms(struct drm_crtc *crtc, int mode)
 		exynos_drm_fn_encoder(crtc, &mode,
 				exynos_drm_encoder_crtc_dpms);
 		exynos_crtc->dpms = mode;
+
+		/* no vblank will come to complete a flip still pending. */
+		exynos_drm_crtc_finish_pageflip(dev, exynos_crtc->pipe);
 		break;
 	default:
 		DRM_ERROR("unspecified mode %d\n", mode);
@@ -300,48 +321,67 @@ static int exynos_drm_crtc_page_flip(struct drm_crtc *crtc,
 	struct exynos_drm_private *dev_priv = dev->dev_private;
 	struct exynos_drm_crtc *exynos_crtc = to_exynos_crtc(crtc);
 	struct drm_framebuffer *old_fb = crtc->fb;
-	int ret = -EINVAL;
+	bool busy;
+	int ret;
 
 	DRM_DEBUG_KMS("%s\n", __FILE__);
 
 	mutex_lock(&dev->struct_mutex);
 
+	/*
+	 * only one flip can be queued to the shadow registers at a time;
+	 * a second one would replace a framebuffer that may never have been
+	 * scanned out, and its event would complete for the wrong frame.
+	 */
+	spin_lock_irq(&dev->event_lock);
+	busy = exynos_crtc->pending_flip;
+	spin_unlock_irq(&dev->event_lock);
+	if (busy) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	/* the vblank interrupt is needed to see when the flip is done. */
+	ret = drm_vblank_get(dev, exynos_crtc->pipe);
+	if (ret) {
+		DRM_DEBUG("failed to acquire vblank counter\n");
+		goto out;
+	}
+
+	crtc->fb = fb;
+	ret = exynos_drm_crtc_update(crtc);
+	if (ret) {
+		crtc->fb = old_fb;
+		drm_vblank_put(dev, exynos_crtc->pipe);
+		goto out;
+	}
+
+	/*
+	 * the values related to a buffer of the drm framebuffer
+	 * to be applied should be set at here. because these values
+	 * first, are set to shadow registers and then to
+	 * real registers at vsync front porch period.
+	 */
+	exynos_drm_crtc_apply(crtc);
+
+	/*
+	 * marking the flip pending only after the registers are written
+	 * means a vblank racing with apply() can complete it one frame
+	 * late, but never before the new framebuffer is on screen.
+	 */
+	spin_lock_irq(&dev->event_lock);
 	if (event) {
 		/*
 		 * the pipe from user always is 0 so we can set pipe number
 		 * of current owner to event.
 		 */
 		event->pipe = exynos_crtc->pipe;
-
-		ret = drm_vblank_get(dev, exynos_crtc->pipe);
-		if (ret) {
-			DRM_DEBUG("failed to acquire vblank counter\n");
-			list_del(&event->base.link);
-
-			goto out;
-		}
-
 		list_add_tail(&event->base.link,
 				&dev_priv->pageflip_event_list);
-
-		crtc->fb = fb;
-		ret = exynos_drm_crtc_update(crtc);
-		if (ret) {
-			crtc->fb = old_fb;
-			drm_vblank_put(dev, exynos_crtc->pipe);
-			list_del(&event->base.link);
-
-			goto out;
-		}
-
-		/*
-		 * the values related to a buffer of the drm framebuffer
-		 * to be applied should be set at here. because these values
-		 * first, are set to shadow registers and then to
-		 * real registers at vsync front porch period.
-		 */
-		exynos_drm_crtc_apply(crtc);
 	}
+	exynos_crtc->pending_flip = true;
+	spin_unlock_irq(&dev->event_lock);
+
 out:
 	mutex_unlock(&dev->struct_mutex);
 	return ret;
@@ -432,3 +472,52 @@ void exynos_drm_crtc_disable_vblank(struct drm_device *dev, int crtc)
 	exynos_drm_fn_encoder(private->crtc[crtc], &crtc,
 			exynos_drm_disable_vblank);
 }
+
+/*
+ * called by the sub drivers from their vblank handler, after
+ * drm_handle_vblank(), once the hardware has latched the registers
+ * written by the last page flip on this crtc.
+ */
+void exynos_drm_crtc_finish_pageflip(struct drm_device *dev, int crtc)
+{
+	struct exynos_drm_private *dev_priv = dev->dev_private;
+	struct exynos_drm_crtc *exynos_crtc;
+	struct drm_pending_vblank_event *e, *t;
+	struct timeval now;
+	unsigned long flags;
+
+	if (!dev_priv->crtc[crtc])
+		return;
+
+	exynos_crtc = to_exynos_crtc(dev_priv->crtc[crtc]);
+
+	spin_lock_irqsave(&dev->event_lock, flags);
+
+	if (!exynos_crtc->pending_flip)
+		goto out;
+
+	list_for_each_entry_safe(e, t, &dev_priv->pageflip_event_list,
+			base.link) {
+		/* if event's pipe isn't same as crtc then ignore it. */
+		if (crtc != e->pipe)
+			continue;
+
+		/*
+		 * report the vblank the flip was latched at, with the
+		 * timestamp taken when it was handled, so that the event
+		 * agrees with what a vblank wait returns for the same frame.
+		 */
+		e->event.sequence = drm_vblank_count_and_time(dev, crtc, &now);
+		e->event.tv_sec = now.tv_sec;
+		e->event.tv_usec = now.tv_usec;
+
+		list_move_tail(&e->base.link, &e->base.file_priv->event_list);
+		wake_up_interruptible(&e->base.file_priv->event_wait);
+	}
+
+	exynos_crtc->pending_flip = false;
+	drm_vblank_put(dev, crtc);
+
+out:
+	spin_unlock_irqrestore(&dev->event_lock, flags);
+}
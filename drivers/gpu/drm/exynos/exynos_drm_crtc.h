@@ -34,6 +34,7 @@ struct exynos_drm_overlay *get_exynos_drm_overlay(struct drm_device *dev,
 int exynos_drm_crtc_create(struct drm_device *dev, unsigned int nr);
 int exynos_drm_crtc_enable_vblank(struct drm_device *dev, int crtc);
 void exynos_drm_crtc_disable_vblank(struct drm_device *dev, int crtc);
+void exynos_drm_crtc_finish_pageflip(struct drm_device *dev, int crtc);
 
 /*
  * Exynos specific crtc postion structure.
@@ -46,6 +47,8 @@ void exynos_drm_crtc_disable_vblank(struct drm_device *dev, int crtc);
  * @crtc_y: offset y on hardware screen.
  * @crtc_w: width of hardware screen.
  * @crtc_h: height of hardware screen.
+ * @src_w: width of the framebuffer region to be displayed, 0 for crtc_w.
+ * @src_h: height of the framebuffer region to be displayed, 0 for crtc_h.
  */
 struct exynos_drm_crtc_pos {
 	unsigned int fb_x;
@@ -54,6 +57,8 @@ struct exynos_drm_crtc_pos {
 	unsigned int crtc_y;
 	unsigned int crtc_w;
 	unsigned int crtc_h;
+	unsigned int src_w;
+	unsigned int src_h;
 };
 
 int exynos_drm_overlay_update(struct exynos_drm_overlay *overlay,
@@ -94,6 +94,13 @@ static int exynos_drm_load(struct drm_device *dev, unsigned long flags)
 	if (ret)
 		goto err_crtc;
 
+	/*
+	 * page flips hold a vblank reference only until they complete, so
+	 * the vblank interrupts can be turned off by the drm timer in
+	 * between rather than by the sub drivers.
+	 */
+	dev->vblank_disable_allowed = 1;
+
 	/*
 	 * probe sub drivers such as display controller and hdmi driver,
 	 * that were registered at probe() of platform driver
@@ -81,6 +81,8 @@ struct exynos_drm_overlay_ops {
  * @crtc_y: offset y on hardware screen.
  * @crtc_width: window width to be displayed (hardware screen).
  * @crtc_height: window height to be displayed (hardware screen).
+ * @src_width: width of the framebuffer region scaled to crtc_width.
+ * @src_height: height of the framebuffer region scaled to crtc_height.
  * @mode_width: width of screen mode.
  * @mode_height: height of screen mode.
  * @refresh: refresh rate.
@@ -112,6 +114,8 @@ struct exynos_drm_overlay {
 	unsigned int crtc_y;
 	unsigned int crtc_width;
 	unsigned int crtc_height;
+	unsigned int src_width;
+	unsigned int src_height;
 	unsigned int mode_width;
 	unsigned int mode_height;
 	unsigned int refresh;
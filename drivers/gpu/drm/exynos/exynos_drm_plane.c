@@ -56,7 +56,13 @@ exynos_update_plane(struct drm_plane *plane, struct drm_crtc *crtc,
 	pos.fb_x = x;
 	pos.fb_y = y;
 
-	/* TODO: scale feature */
+	/*
+	 * the source size is only honoured by layers that can scale, such as
+	 * the video layer of the mixer; the others show it unscaled.
+	 */
+	pos.src_w = src_w >> 16;
+	pos.src_h = src_h >> 16;
+
 	ret = exynos_drm_overlay_update(overlay, fb, &crtc->mode, &pos);
 	if (ret < 0)
 		return ret;
@@ -35,6 +35,7 @@
 #include <drm/exynos_drm.h>
 
 #include "exynos_drm_drv.h"
+#include "exynos_drm_crtc.h"
 #include "exynos_drm_hdmi.h"
 
 #define MIXER_WIN_NR		3
@@ -53,6 +54,8 @@ struct hdmi_win_data {
 	unsigned int		crtc_y;
 	unsigned int		crtc_width;
 	unsigned int		crtc_height;
+	unsigned int		src_width;
+	unsigned int		src_height;
 	unsigned int		fb_x;
 	unsigned int		fb_y;
 	unsigned int		fb_width;
@@ -353,6 +356,7 @@ static void vp_video_buffer(struct mixer_context *ctx, int win)
 	unsigned long flags;
 	struct hdmi_win_data *win_data;
 	unsigned int full_width, full_height, width, height;
+	unsigned int src_width, src_height;
 	unsigned int x_ratio, y_ratio;
 	unsigned int src_x_offset, src_y_offset, dst_x_offset, dst_y_offset;
 	unsigned int mode_width, mode_height;
@@ -388,10 +392,12 @@ static void vp_video_buffer(struct mixer_context *ctx, int win)
 	height = win_data->crtc_height;
 	mode_width = win_data->mode_width;
 	mode_height = win_data->mode_height;
+	src_width = win_data->src_width ? win_data->src_width : width;
+	src_height = win_data->src_height ? win_data->src_height : height;
 
 	/* scaling feature: (src << 16) / dst */
-	x_ratio = (width << 16) / width;
-	y_ratio = (height << 16) / height;
+	x_ratio = (src_width << 16) / width;
+	y_ratio = (src_height << 16) / height;
 
 	src_x_offset = win_data->fb_x;
 	src_y_offset = win_data->fb_y;
@@ -441,8 +447,8 @@ static void vp_video_buffer(struct mixer_context *ctx, int win)
 	vp_reg_write(res, VP_IMG_SIZE_C, VP_IMG_HSIZE(full_width) |
 		VP_IMG_VSIZE(full_height / 2));
 
-	vp_reg_write(res, VP_SRC_WIDTH, width);
-	vp_reg_write(res, VP_SRC_HEIGHT, height);
+	vp_reg_write(res, VP_SRC_WIDTH, src_width);
+	vp_reg_write(res, VP_SRC_HEIGHT, src_height);
 	vp_reg_write(res, VP_SRC_H_POSITION,
 			VP_SRC_H_POSITION_VAL(src_x_offset));
 	vp_reg_write(res, VP_SRC_V_POSITION, src_y_offset);
@@ -642,7 +648,7 @@ static void mixer_win_mode_set(void *ctx,
 	if (win == DEFAULT_ZPOS)
 		win = MIXER_DEFAULT_WIN;
 
-	if (win < 0 || win > MIXER_WIN_NR) {
+	if (win < 0 || win >= MIXER_WIN_NR) {
 		DRM_ERROR("overlay plane[%d] is wrong\n", win);
 		return;
 	}
@@ -660,6 +666,8 @@ static void mixer_win_mode_set(void *ctx,
 	win_data->crtc_y = overlay->crtc_y;
 	win_data->crtc_width = overlay->crtc_width;
 	win_data->crtc_height = overlay->crtc_height;
+	win_data->src_width = overlay->src_width;
+	win_data->src_height = overlay->src_height;
 
 	win_data->fb_x = overlay->fb_x;
 	win_data->fb_y = overlay->fb_y;
@@ -682,7 +690,7 @@ static void mixer_win_commit(void *ctx, int zpos)
 	if (win == DEFAULT_ZPOS)
 		win = MIXER_DEFAULT_WIN;
 
-	if (win < 0 || win > MIXER_WIN_NR) {
+	if (win < 0 || win >= MIXER_WIN_NR) {
 		DRM_ERROR("overlay plane[%d] is wrong\n", win);
 		return;
 	}
@@ -705,7 +713,7 @@ static void mixer_win_disable(void *ctx, int zpos)
 	if (win == DEFAULT_ZPOS)
 		win = MIXER_DEFAULT_WIN;
 
-	if (win < 0 || win > MIXER_WIN_NR) {
+	if (win < 0 || win >= MIXER_WIN_NR) {
 		DRM_ERROR("overlay plane[%d] is wrong\n", win);
 		return;
 	}
@@ -730,42 +738,21 @@ static struct exynos_mixer_ops mixer_ops = {
 	.win_disable		= mixer_win_disable,
 };
 
-/* for pageflip event */
-static void mixer_finish_pageflip(struct drm_device *drm_dev, int crtc)
+/*
+ * page flips are applied to the graphic layers; once their shadow
+ * registers hold the base addresses last written, the hardware scans out
+ * the new buffers.
+ */
+static bool mixer_flip_latched(struct mixer_resources *res)
 {
-	struct exynos_drm_private *dev_priv = drm_dev->dev_private;
-	struct drm_pending_vblank_event *e, *t;
-	struct timeval now;
-	unsigned long flags;
-	bool is_checked = false;
-
-	spin_lock_irqsave(&drm_dev->event_lock, flags);
-
-	list_for_each_entry_safe(e, t, &dev_priv->pageflip_event_list,
-			base.link) {
-		/* if event's pipe isn't same as crtc then ignore it. */
-		if (crtc != e->pipe)
-			continue;
-
-		is_checked = true;
-		do_gettimeofday(&now);
-		e->event.sequence = 0;
-		e->event.tv_sec = now.tv_sec;
-		e->event.tv_usec = now.tv_usec;
-
-		list_move_tail(&e->base.link, &e->base.file_priv->event_list);
-		wake_up_interruptible(&e->base.file_priv->event_wait);
-	}
+	int win;
 
-	if (is_checked)
-		/*
-		 * call drm_vblank_put only in case that drm_vblank_get was
-		 * called.
-		 */
-		if (atomic_read(&drm_dev->vblank_refcount[crtc]) > 0)
-			drm_vblank_put(drm_dev, crtc);
+	for (win = 0; win < 2; win++)
+		if (mixer_reg_read(res, MXR_GRAPHIC_BASE(win)) !=
+		    mixer_reg_read(res, MXR_GRAPHIC_BASE_S(win)))
+			return false;
 
-	spin_unlock_irqrestore(&drm_dev->event_lock, flags);
+	return true;
 }
 
 static irqreturn_t mixer_irq_handler(int irq, void *arg)
@@ -773,7 +760,7 @@ static irqreturn_t mixer_irq_handler(int irq, void *arg)
 	struct exynos_drm_hdmi_context *drm_hdmi_ctx = arg;
 	struct mixer_context *ctx = drm_hdmi_ctx->ctx;
 	struct mixer_resources *res = &ctx->mixer_res;
-	u32 val, val_base;
+	u32 val;
 
 	spin_lock(&res->reg_slock);
 
@@ -782,19 +769,16 @@ static irqreturn_t mixer_irq_handler(int irq, void *arg)
 
 	/* handling VSYNC */
 	if (val & MXR_INT_STATUS_VSYNC) {
+		bool latched = mixer_flip_latched(res);
+
 		/* interlace scan need to check shadow register */
-		if (ctx->interlace) {
-			val_base = mixer_reg_read(res, MXR_GRAPHIC_BASE_S(0));
-			if (ctx->win_data[0].dma_addr != val_base)
-				goto out;
-
-			val_base = mixer_reg_read(res, MXR_GRAPHIC_BASE_S(1));
-			if (ctx->win_data[1].dma_addr != val_base)
-				goto out;
-		}
+		if (ctx->interlace && !latched)
+			goto out;
 
 		drm_handle_vblank(drm_hdmi_ctx->drm_dev, ctx->pipe);
-		mixer_finish_pageflip(drm_hdmi_ctx->drm_dev, ctx->pipe);
+		if (latched)
+			exynos_drm_crtc_finish_pageflip(drm_hdmi_ctx->drm_dev,
+							ctx->pipe);
 	}
 
 out:
@@ -16,7 +16,9 @@
 #include <linux/version.h>
 #include <linux/vermagic.h>
 #include "drmP.h"
+#include "mali_drm.h"
 #include "mali_drv.h"
+#include "mali_gem.h"
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,39)
 static struct pci_device_id pciidlist[] = {
@@ -57,12 +59,19 @@ static int mali_drm_unload(struct drm_device *dev)
 	return 0;
 }
 
+static struct drm_ioctl_desc mali_ioctls[] = {
+	DRM_IOCTL_DEF_DRV(MALI_GEM_CREATE, mali_gem_create_ioctl, DRM_UNLOCKED | DRM_AUTH),
+	DRM_IOCTL_DEF_DRV(MALI_GEM_MMAP, mali_gem_mmap_ioctl, DRM_UNLOCKED | DRM_AUTH),
+	DRM_IOCTL_DEF_DRV(MALI_GEM_UMP_ID, mali_gem_ump_id_ioctl, DRM_UNLOCKED | DRM_AUTH),
+	DRM_IOCTL_DEF_DRV(MALI_GEM_UMP_IMPORT, mali_gem_ump_import_ioctl, DRM_UNLOCKED | DRM_AUTH),
+};
+
 static const struct file_operations drm_fops = {
 	.owner = THIS_MODULE,
 	.open = drm_open,
 	.release = drm_release,
 	.unlocked_ioctl = drm_ioctl,
-	.mmap = drm_mmap,
+	.mmap = drm_gem_mmap,
 	.poll = drm_poll,
 	.fasync = drm_fasync,
 };
@@ -70,7 +79,9 @@ static const struct file_operations drm_fops = {
 static struct drm_driver driver = 
 {
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,39)
-	.driver_features = DRIVER_USE_PLATFORM_DEVICE,
+	.driver_features = DRIVER_USE_PLATFORM_DEVICE | DRIVER_GEM,
+#else
+	.driver_features = DRIVER_GEM | DRIVER_PRIME,
 #endif
 	.load = mali_drm_load,
 	.unload = mali_drm_unload,
@@ -85,7 +96,15 @@ static struct drm_driver driver =
 	.get_map_ofs = drm_core_get_map_ofs,
 	.get_reg_ofs = drm_core_get_reg_ofs,
 #endif
-	.ioctls = NULL,
+	.gem_free_object = mali_gem_free_object,
+	.gem_vm_ops = &mali_gem_vm_ops,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,39)
+	.prime_handle_to_fd = drm_gem_prime_handle_to_fd,
+	.prime_fd_to_handle = drm_gem_prime_fd_to_handle,
+	.gem_prime_export = mali_gem_prime_export,
+	.gem_prime_import = mali_gem_prime_import,
+#endif
+	.ioctls = mali_ioctls,
 	.fops = &drm_fops,
 	.name = DRIVER_NAME,
 	.desc = DRIVER_DESC,
@@ -98,7 +117,7 @@ static struct drm_driver driver =
 int mali_drm_init(struct platform_device *dev)
 {
 	printk(KERN_INFO "Mali DRM initialize, driver name: %s, version %d.%d\n", DRIVER_NAME, DRIVER_MAJOR, DRIVER_MINOR);
-	driver.num_ioctls = 0;
+	driver.num_ioctls = ARRAY_SIZE(mali_ioctls);
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,38)
 	driver.platform_device = dev;
 #endif
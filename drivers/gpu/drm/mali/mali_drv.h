@@ -16,10 +16,10 @@
 #define DRIVER_DESC		"DRM module for Mali-200, Mali-400"
 #define DRIVER_LICENSE  "GPLv2"
 #define DRIVER_ALIAS    "platform:mali_drm"
-#define DRIVER_DATE		"20101111"
+#define DRIVER_DATE		"20261017"
 #define DRIVER_VERSION  "0.2"
 #define DRIVER_MAJOR 2
-#define DRIVER_MINOR 1
+#define DRIVER_MINOR 2
 #define DRIVER_PATCHLEVEL 1
 
 #endif /* _MALI_DRV_H_ */
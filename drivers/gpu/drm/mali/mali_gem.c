@@ -0,0 +1,455 @@
+/**
+ * Copyright (C) 2010, 2012 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation, and any use by you of this program is subject to the terms of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained from Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * @file mali_gem.c
+ * GEM buffer objects for Mali DRM, shared with other devices through PRIME
+ */
+#include <linux/dma-buf.h>
+#include <linux/dma-mapping.h>
+#include <linux/highmem.h>
+#include <linux/mm.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include "drmP.h"
+#include "mali_drm.h"
+#include "mali_gem.h"
+#include "ump_kernel_interface_ref_drv.h"
+
+/* Memory behind a UMP handle we created, handed back when UMP drops the last reference */
+struct mali_gem_buffer {
+	struct device *dev;
+	size_t size;
+	void *vaddr;
+	dma_addr_t dma_addr;
+	/* set for buffers imported from a dma-buf */
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	struct work_struct detach_work;
+};
+
+static void mali_gem_buffer_detach(struct work_struct *work)
+{
+	struct mali_gem_buffer *buf = container_of(work, struct mali_gem_buffer, detach_work);
+	struct dma_buf *dma_buf = buf->attach->dmabuf;
+
+	dma_buf_unmap_attachment(buf->attach, buf->sgt, DMA_BIDIRECTIONAL);
+	dma_buf_detach(dma_buf, buf->attach);
+	dma_buf_put(dma_buf);
+	kfree(buf);
+}
+
+static void mali_gem_buffer_release(void *ctx)
+{
+	struct mali_gem_buffer *buf = ctx;
+
+	if (buf->attach) {
+		/*
+		 * UMP lets go from wherever the last reference went, which
+		 * includes mali_gem_free_object() under struct_mutex.  The
+		 * final dma_buf_put() of one of our own exports takes that
+		 * mutex again, so it is done from a worker.
+		 */
+		INIT_WORK(&buf->detach_work, mali_gem_buffer_detach);
+		schedule_work(&buf->detach_work);
+		return;
+	}
+
+	dma_free_writecombine(buf->dev, buf->size, buf->vaddr, buf->dma_addr);
+	kfree(buf);
+}
+
+/* Takes over the caller's reference to ump on success only */
+static struct mali_gem_object *mali_gem_object_create(struct drm_device *dev, ump_dd_handle ump)
+{
+	struct mali_gem_object *mobj;
+	int ret;
+
+	mobj = kzalloc(sizeof(*mobj), GFP_KERNEL);
+	if (!mobj)
+		return ERR_PTR(-ENOMEM);
+
+	mobj->nr_blocks = ump_dd_phys_block_count_get(ump);
+	mobj->blocks = kcalloc(mobj->nr_blocks, sizeof(ump_dd_physical_block), GFP_KERNEL);
+	if (!mobj->blocks) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	if (UMP_DD_SUCCESS != ump_dd_phys_blocks_get(ump, mobj->blocks, mobj->nr_blocks)) {
+		ret = -EINVAL;
+		goto err;
+	}
+
+	ret = drm_gem_private_object_init(dev, &mobj->base, ump_dd_size_get(ump));
+	if (ret)
+		goto err;
+
+	mobj->ump = ump;
+	return mobj;
+
+err:
+	kfree(mobj->blocks);
+	kfree(mobj);
+	return ERR_PTR(ret);
+}
+
+void mali_gem_free_object(struct drm_gem_object *obj)
+{
+	struct mali_gem_object *mobj = to_mali_gem_object(obj);
+
+	if (obj->map_list.map)
+		drm_gem_free_mmap_offset(obj);
+	drm_gem_object_release(obj);
+
+	ump_dd_reference_release(mobj->ump);
+	kfree(mobj->blocks);
+	kfree(mobj);
+}
+
+static int mali_gem_page_phys(struct mali_gem_object *mobj, unsigned long pgoff, unsigned long *phys)
+{
+	unsigned long offset = pgoff << PAGE_SHIFT;
+	unsigned long i;
+
+	for (i = 0; i < mobj->nr_blocks; i++) {
+		if (offset < mobj->blocks[i].size) {
+			*phys = mobj->blocks[i].addr + offset;
+			return 0;
+		}
+		offset -= mobj->blocks[i].size;
+	}
+
+	return -EINVAL;
+}
+
+static int mali_gem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct mali_gem_object *mobj = to_mali_gem_object(vma->vm_private_data);
+	unsigned long address = (unsigned long)vmf->virtual_address;
+	unsigned long phys;
+	int ret;
+
+	if (mali_gem_page_phys(mobj, (address - vma->vm_start) >> PAGE_SHIFT, &phys))
+		return VM_FAULT_SIGBUS;
+
+	ret = vm_insert_pfn(vma, address, phys >> PAGE_SHIFT);
+	switch (ret) {
+	case 0:
+	case -EBUSY:
+		/* -EBUSY: another thread faulted the page in first */
+		return VM_FAULT_NOPAGE;
+	case -ENOMEM:
+		return VM_FAULT_OOM;
+	default:
+		return VM_FAULT_SIGBUS;
+	}
+}
+
+struct vm_operations_struct mali_gem_vm_ops = {
+	.fault = mali_gem_fault,
+	.open = drm_gem_vm_open,
+	.close = drm_gem_vm_close,
+};
+
+int mali_gem_create_ioctl(struct drm_device *dev, void *data, struct drm_file *file_priv)
+{
+	struct drm_mali_gem_create *args = data;
+	struct mali_gem_buffer *buf;
+	struct mali_gem_object *mobj;
+	ump_dd_physical_block block;
+	ump_dd_handle ump;
+	int ret;
+
+	if (args->flags || !args->size || args->size > INT_MAX)
+		return -EINVAL;
+
+	buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	/*
+	 * Contiguous, so the display and video blocks can scan it out too.
+	 * There is no IOMMU in front of mali_drm, so the DMA address is the
+	 * physical address Mali and UMP want.
+	 */
+	buf->dev = dev->dev;
+	buf->size = PAGE_ALIGN(args->size);
+	buf->vaddr = dma_alloc_writecombine(buf->dev, buf->size, &buf->dma_addr, GFP_KERNEL);
+	if (!buf->vaddr) {
+		kfree(buf);
+		return -ENOMEM;
+	}
+
+	block.addr = buf->dma_addr;
+	block.size = buf->size;
+	ump = ump_dd_handle_create_from_phys_blocks_release(&block, 1, mali_gem_buffer_release, buf);
+	if (UMP_DD_HANDLE_INVALID == ump) {
+		mali_gem_buffer_release(buf);
+		return -ENOMEM;
+	}
+
+	mobj = mali_gem_object_create(dev, ump);
+	if (IS_ERR(mobj)) {
+		ump_dd_reference_release(ump);
+		return PTR_ERR(mobj);
+	}
+
+	ret = drm_gem_handle_create(file_priv, &mobj->base, &args->handle);
+	/* the handle holds the object now, or it is freed on failure */
+	drm_gem_object_unreference_unlocked(&mobj->base);
+
+	return ret;
+}
+
+int mali_gem_mmap_ioctl(struct drm_device *dev, void *data, struct drm_file *file_priv)
+{
+	struct drm_mali_gem_mmap *args = data;
+	struct drm_gem_object *obj;
+	int ret = 0;
+
+	obj = drm_gem_object_lookup(dev, file_priv, args->handle);
+	if (!obj)
+		return -ENOENT;
+
+	mutex_lock(&dev->struct_mutex);
+	if (!obj->map_list.map)
+		ret = drm_gem_create_mmap_offset(obj);
+	if (!ret)
+		args->offset = (u64)obj->map_list.hash.key << PAGE_SHIFT;
+	drm_gem_object_unreference(obj);
+	mutex_unlock(&dev->struct_mutex);
+
+	return ret;
+}
+
+int mali_gem_ump_id_ioctl(struct drm_device *dev, void *data, struct drm_file *file_priv)
+{
+	struct drm_mali_gem_ump *args = data;
+	struct drm_gem_object *obj;
+
+	obj = drm_gem_object_lookup(dev, file_priv, args->handle);
+	if (!obj)
+		return -ENOENT;
+
+	args->secure_id = ump_dd_secure_id_get(to_mali_gem_object(obj)->ump);
+	drm_gem_object_unreference_unlocked(obj);
+
+	return 0;
+}
+
+int mali_gem_ump_import_ioctl(struct drm_device *dev, void *data, struct drm_file *file_priv)
+{
+	struct drm_mali_gem_ump *args = data;
+	struct mali_gem_object *mobj;
+	ump_dd_handle ump;
+	int ret;
+
+	ump = ump_dd_handle_create_from_secure_id(args->secure_id);
+	if (UMP_DD_HANDLE_INVALID == ump)
+		return -ENOENT;
+
+	mobj = mali_gem_object_create(dev, ump);
+	if (IS_ERR(mobj)) {
+		ump_dd_reference_release(ump);
+		return PTR_ERR(mobj);
+	}
+
+	ret = drm_gem_handle_create(file_priv, &mobj->base, &args->handle);
+	drm_gem_object_unreference_unlocked(&mobj->base);
+
+	return ret;
+}
+
+static struct sg_table *mali_gem_map_dma_buf(struct dma_buf_attachment *attach,
+					     enum dma_data_direction dir)
+{
+	struct mali_gem_object *mobj = to_mali_gem_object(attach->dmabuf->priv);
+	struct scatterlist *sg;
+	struct sg_table *sgt;
+	int ret;
+	int i;
+
+	sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
+	if (!sgt)
+		return ERR_PTR(-ENOMEM);
+
+	ret = sg_alloc_table(sgt, mobj->nr_blocks, GFP_KERNEL);
+	if (ret)
+		goto err_free;
+
+	for_each_sg(sgt->sgl, sg, sgt->orig_nents, i) {
+		unsigned long pfn = mobj->blocks[i].addr >> PAGE_SHIFT;
+
+		/* UMP memory carved out of the kernel's view has no struct page to hand out */
+		if (!pfn_valid(pfn)) {
+			ret = -EINVAL;
+			goto err_table;
+		}
+		sg_set_page(sg, pfn_to_page(pfn), mobj->blocks[i].size, 0);
+	}
+
+	sgt->nents = dma_map_sg(attach->dev, sgt->sgl, sgt->orig_nents, dir);
+	if (!sgt->nents) {
+		ret = -ENOMEM;
+		goto err_table;
+	}
+
+	return sgt;
+
+err_table:
+	sg_free_table(sgt);
+err_free:
+	kfree(sgt);
+	return ERR_PTR(ret);
+}
+
+static void mali_gem_unmap_dma_buf(struct dma_buf_attachment *attach,
+				   struct sg_table *sgt, enum dma_data_direction dir)
+{
+	dma_unmap_sg(attach->dev, sgt->sgl, sgt->orig_nents, dir);
+	sg_free_table(sgt);
+	kfree(sgt);
+}
+
+static void mali_gem_dmabuf_release(struct dma_buf *dma_buf)
+{
+	struct drm_gem_object *obj = dma_buf->priv;
+
+	if (obj->export_dma_buf == dma_buf) {
+		/* drop the reference the export took */
+		obj->export_dma_buf = NULL;
+		drm_gem_object_unreference_unlocked(obj);
+	}
+}
+
+static struct page *mali_gem_dmabuf_page(struct dma_buf *dma_buf, unsigned long pgoff)
+{
+	struct mali_gem_object *mobj = to_mali_gem_object(dma_buf->priv);
+	unsigned long phys;
+
+	if (mali_gem_page_phys(mobj, pgoff, &phys) || !pfn_valid(phys >> PAGE_SHIFT))
+		return NULL;
+
+	return pfn_to_page(phys >> PAGE_SHIFT);
+}
+
+static void *mali_gem_dmabuf_kmap_atomic(struct dma_buf *dma_buf, unsigned long pgoff)
+{
+	struct page *page = mali_gem_dmabuf_page(dma_buf, pgoff);
+
+	return page ? kmap_atomic(page) : NULL;
+}
+
+static void mali_gem_dmabuf_kunmap_atomic(struct dma_buf *dma_buf, unsigned long pgoff, void *addr)
+{
+	kunmap_atomic(addr);
+}
+
+static void *mali_gem_dmabuf_kmap(struct dma_buf *dma_buf, unsigned long pgoff)
+{
+	struct page *page = mali_gem_dmabuf_page(dma_buf, pgoff);
+
+	return page ? kmap(page) : NULL;
+}
+
+static void mali_gem_dmabuf_kunmap(struct dma_buf *dma_buf, unsigned long pgoff, void *addr)
+{
+	kunmap(mali_gem_dmabuf_page(dma_buf, pgoff));
+}
+
+static const struct dma_buf_ops mali_gem_dmabuf_ops = {
+	.map_dma_buf = mali_gem_map_dma_buf,
+	.unmap_dma_buf = mali_gem_unmap_dma_buf,
+	.release = mali_gem_dmabuf_release,
+	.kmap_atomic = mali_gem_dmabuf_kmap_atomic,
+	.kunmap_atomic = mali_gem_dmabuf_kunmap_atomic,
+	.kmap = mali_gem_dmabuf_kmap,
+	.kunmap = mali_gem_dmabuf_kunmap,
+};
+
+struct dma_buf *mali_gem_prime_export(struct drm_device *dev, struct drm_gem_object *obj, int flags)
+{
+	return dma_buf_export(obj, &mali_gem_dmabuf_ops, obj->size, flags);
+}
+
+/*
+ * Buffers we exported ourselves are imported like any other: the PRIME core
+ * only forgets an imported dma-buf when the object has import_attach set,
+ * so handing back the original object would leave a stale entry behind.
+ */
+struct drm_gem_object *mali_gem_prime_import(struct drm_device *dev, struct dma_buf *dma_buf)
+{
+	struct dma_buf_attachment *attach;
+	ump_dd_physical_block *blocks;
+	struct mali_gem_buffer *buf;
+	struct mali_gem_object *mobj;
+	struct scatterlist *sg;
+	struct sg_table *sgt;
+	ump_dd_handle ump;
+	int ret;
+	int i;
+
+	attach = dma_buf_attach(dma_buf, dev->dev);
+	if (IS_ERR(attach))
+		return ERR_CAST(attach);
+
+	sgt = dma_buf_map_attachment(attach, DMA_BIDIRECTIONAL);
+	if (IS_ERR_OR_NULL(sgt)) {
+		ret = sgt ? PTR_ERR(sgt) : -ENOMEM;
+		goto err_detach;
+	}
+
+	buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+	blocks = kcalloc(sgt->orig_nents, sizeof(*blocks), GFP_KERNEL);
+	if (!buf || !blocks) {
+		ret = -ENOMEM;
+		goto err_unmap;
+	}
+
+	for_each_sg(sgt->sgl, sg, sgt->orig_nents, i) {
+		blocks[i].addr = sg_phys(sg);
+		blocks[i].size = sg->length;
+	}
+
+	buf->dev = dev->dev;
+	buf->size = dma_buf->size;
+	buf->attach = attach;
+	buf->sgt = sgt;
+
+	/* UMP refuses blocks that are not page aligned */
+	ump = ump_dd_handle_create_from_phys_blocks_release(blocks, sgt->orig_nents, mali_gem_buffer_release, buf);
+	kfree(blocks);
+	blocks = NULL;
+	if (UMP_DD_HANDLE_INVALID == ump) {
+		ret = -EINVAL;
+		goto err_unmap;
+	}
+
+	mobj = mali_gem_object_create(dev, ump);
+	if (IS_ERR(mobj)) {
+		/* the release detaches and drops a dma-buf reference, the caller still owns its own */
+		get_dma_buf(dma_buf);
+		ump_dd_reference_release(ump);
+		return ERR_CAST(mobj);
+	}
+
+	mobj->base.import_attach = attach;
+	return &mobj->base;
+
+err_unmap:
+	kfree(blocks);
+	kfree(buf);
+	dma_buf_unmap_attachment(attach, sgt, DMA_BIDIRECTIONAL);
+err_detach:
+	dma_buf_detach(dma_buf, attach);
+	return ERR_PTR(ret);
+}
@@ -0,0 +1,47 @@
+/**
+ * Copyright (C) 2010, 2012 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation, and any use by you of this program is subject to the terms of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained from Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * @file mali_gem.h
+ * GEM buffer objects for Mali DRM
+ */
+#ifndef _MALI_GEM_H_
+#define _MALI_GEM_H_
+
+#include "ump_kernel_interface.h"
+
+/**
+ * Every object is backed by a UMP handle, so the same memory can be given
+ * to Mali and the X driver by secure ID and to other devices by dma-buf.
+ * The object holds one reference to the handle; the memory itself is
+ * released by UMP when the last reference, wherever it is, goes away.
+ */
+struct mali_gem_object {
+	struct drm_gem_object base;
+	ump_dd_handle ump;
+	unsigned long nr_blocks;
+	ump_dd_physical_block *blocks;
+};
+
+#define to_mali_gem_object(x) container_of(x, struct mali_gem_object, base)
+
+extern struct vm_operations_struct mali_gem_vm_ops;
+
+void mali_gem_free_object(struct drm_gem_object *obj);
+
+int mali_gem_create_ioctl(struct drm_device *dev, void *data, struct drm_file *file_priv);
+int mali_gem_mmap_ioctl(struct drm_device *dev, void *data, struct drm_file *file_priv);
+int mali_gem_ump_id_ioctl(struct drm_device *dev, void *data, struct drm_file *file_priv);
+int mali_gem_ump_import_ioctl(struct drm_device *dev, void *data, struct drm_file *file_priv);
+
+struct dma_buf *mali_gem_prime_export(struct drm_device *dev, struct drm_gem_object *obj, int flags);
+struct drm_gem_object *mali_gem_prime_import(struct drm_device *dev, struct dma_buf *dma_buf);
+
+#endif /* _MALI_GEM_H_ */
@@ -0,0 +1,109 @@
+/*
+ * drivers/gpu/ion/exynos/exynos_ion.c
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/err.h>
+#include <linux/ion.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include "../ion_priv.h"
+
+struct exynos_ion {
+	struct ion_device *idev;
+	int num_heaps;
+	struct ion_heap *heaps[];
+};
+
+static int exynos_ion_probe(struct platform_device *pdev)
+{
+	struct ion_platform_data *pdata = pdev->dev.platform_data;
+	struct exynos_ion *ion;
+	int err;
+	int i;
+
+	if (!pdata)
+		return -ENODEV;
+
+	ion = kzalloc(sizeof(struct exynos_ion) +
+		      sizeof(struct ion_heap *) * pdata->nr, GFP_KERNEL);
+	if (!ion)
+		return -ENOMEM;
+	ion->num_heaps = pdata->nr;
+
+	ion->idev = ion_device_create(NULL);
+	if (IS_ERR_OR_NULL(ion->idev)) {
+		err = PTR_ERR(ion->idev);
+		kfree(ion);
+		return err;
+	}
+
+	/* create the heaps as specified in the board file */
+	for (i = 0; i < ion->num_heaps; i++) {
+		struct ion_platform_heap *heap_data = &pdata->heaps[i];
+
+		/* DMA heaps default to the CMA area of the ion device itself */
+		if (heap_data->type == ION_HEAP_TYPE_DMA && !heap_data->priv)
+			heap_data->priv = &pdev->dev;
+
+		ion->heaps[i] = ion_heap_create(heap_data);
+		if (IS_ERR_OR_NULL(ion->heaps[i])) {
+			err = PTR_ERR(ion->heaps[i]);
+			ion->heaps[i] = NULL;
+			goto err;
+		}
+		ion_device_add_heap(ion->idev, ion->heaps[i]);
+	}
+	platform_set_drvdata(pdev, ion);
+	return 0;
+err:
+	ion_device_destroy(ion->idev);
+	for (i = 0; i < ion->num_heaps; i++) {
+		if (ion->heaps[i])
+			ion_heap_destroy(ion->heaps[i]);
+	}
+	kfree(ion);
+	return err;
+}
+
+static int exynos_ion_remove(struct platform_device *pdev)
+{
+	struct exynos_ion *ion = platform_get_drvdata(pdev);
+	int i;
+
+	ion_device_destroy(ion->idev);
+	for (i = 0; i < ion->num_heaps; i++)
+		ion_heap_destroy(ion->heaps[i]);
+	kfree(ion);
+	return 0;
+}
+
+static struct platform_driver exynos_ion_driver = {
+	.probe = exynos_ion_probe,
+	.remove = exynos_ion_remove,
+	.driver = { .name = "ion-exynos" }
+};
+
+static int __init exynos_ion_init(void)
+{
+	return platform_driver_register(&exynos_ion_driver);
+}
+
+static void __exit exynos_ion_exit(void)
+{
+	platform_driver_unregister(&exynos_ion_driver);
+}
+
+module_init(exynos_ion_init);
+module_exit(exynos_ion_exit);
+MODULE_LICENSE("GPL");
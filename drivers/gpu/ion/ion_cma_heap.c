@@ -0,0 +1,224 @@
+/*
+ * drivers/gpu/ion/ion_cma_heap.c
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/device.h>
+#include <linux/dma-contiguous.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/ion.h>
+#include <linux/mm.h>
+#include <linux/scatterlist.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <asm/atomic.h>
+#include "ion_priv.h"
+
+/*
+ * Physically contiguous buffers from the CMA area of a device.  While no
+ * buffer uses it, the area holds movable pages like any other memory, so
+ * it is not lost to the page cache the way a carveout is.
+ *
+ * Uncached buffers go through the DMA API, which also makes the kernel's
+ * own mapping of the pages write-combined.  Cached buffers take the pages
+ * straight from CMA and keep the kernel's cached mapping.
+ */
+struct ion_cma_heap {
+	struct ion_heap heap;
+	struct device *dev;
+	atomic_t buffers;
+	atomic_t bytes;
+	atomic_t failed;
+};
+
+struct ion_cma_buffer_info {
+	struct page *page;
+	void *cpu_addr;
+	dma_addr_t handle;
+};
+
+#define to_cma_heap(x) container_of(x, struct ion_cma_heap, heap)
+
+static int ion_cma_heap_allocate(struct ion_heap *heap,
+				 struct ion_buffer *buffer,
+				 unsigned long len, unsigned long align,
+				 unsigned long flags)
+{
+	struct ion_cma_heap *cma_heap = to_cma_heap(heap);
+	struct ion_cma_buffer_info *info;
+	unsigned long size = PAGE_ALIGN(len);
+
+	info = kzalloc(sizeof(struct ion_cma_buffer_info), GFP_KERNEL);
+	if (!info)
+		return -ENOMEM;
+
+	if (flags & ION_FLAG_UNCACHED) {
+		info->cpu_addr = dma_alloc_writecombine(cma_heap->dev, size,
+							&info->handle,
+							GFP_KERNEL);
+		if (!info->cpu_addr)
+			goto err;
+		info->page = pfn_to_page(dma_to_pfn(cma_heap->dev,
+						    info->handle));
+	} else {
+		info->page = dma_alloc_from_contiguous(cma_heap->dev,
+						       size >> PAGE_SHIFT,
+						       align ? get_order(align) : 0);
+		if (!info->page)
+			goto err;
+		/*
+		 * CMA pages held someone else's data until they migrated.
+		 * CMA areas are in lowmem, so the linear mapping can be used.
+		 */
+		memset(page_address(info->page), 0, size);
+		ion_heap_clean_pages(info->page, size);
+		info->cpu_addr = page_address(info->page);
+		info->handle = page_to_phys(info->page);
+	}
+
+	buffer->priv_virt = info;
+	atomic_inc(&cma_heap->buffers);
+	atomic_add(size, &cma_heap->bytes);
+	return 0;
+
+err:
+	atomic_inc(&cma_heap->failed);
+	kfree(info);
+	return -ENOMEM;
+}
+
+static void ion_cma_heap_free(struct ion_buffer *buffer)
+{
+	struct ion_cma_heap *cma_heap = to_cma_heap(buffer->heap);
+	struct ion_cma_buffer_info *info = buffer->priv_virt;
+	unsigned long size = PAGE_ALIGN(buffer->size);
+
+	if (buffer->flags & ION_FLAG_UNCACHED)
+		dma_free_writecombine(cma_heap->dev, size, info->cpu_addr,
+				      info->handle);
+	else
+		dma_release_from_contiguous(cma_heap->dev, info->page,
+					    size >> PAGE_SHIFT);
+
+	atomic_dec(&cma_heap->buffers);
+	atomic_sub(size, &cma_heap->bytes);
+	kfree(info);
+}
+
+static int ion_cma_heap_phys(struct ion_heap *heap, struct ion_buffer *buffer,
+			     ion_phys_addr_t *addr, size_t *len)
+{
+	struct ion_cma_buffer_info *info = buffer->priv_virt;
+
+	*addr = page_to_phys(info->page);
+	*len = buffer->size;
+	return 0;
+}
+
+static struct scatterlist *ion_cma_heap_map_dma(struct ion_heap *heap,
+						struct ion_buffer *buffer)
+{
+	struct ion_cma_buffer_info *info = buffer->priv_virt;
+	struct scatterlist *sglist;
+
+	sglist = vmalloc(sizeof(struct scatterlist));
+	if (!sglist)
+		return ERR_PTR(-ENOMEM);
+	sg_init_table(sglist, 1);
+	sg_set_page(sglist, info->page, PAGE_ALIGN(buffer->size), 0);
+	return sglist;
+}
+
+static void ion_cma_heap_unmap_dma(struct ion_heap *heap,
+				   struct ion_buffer *buffer)
+{
+	if (buffer->sglist)
+		vfree(buffer->sglist);
+}
+
+static void *ion_cma_heap_map_kernel(struct ion_heap *heap,
+				     struct ion_buffer *buffer)
+{
+	struct ion_cma_buffer_info *info = buffer->priv_virt;
+
+	return info->cpu_addr;
+}
+
+static void ion_cma_heap_unmap_kernel(struct ion_heap *heap,
+				      struct ion_buffer *buffer)
+{
+}
+
+static int ion_cma_heap_map_user(struct ion_heap *heap,
+				 struct ion_buffer *buffer,
+				 struct vm_area_struct *vma)
+{
+	struct ion_cma_buffer_info *info = buffer->priv_virt;
+
+	if (buffer->flags & ION_FLAG_UNCACHED)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+
+	return remap_pfn_range(vma, vma->vm_start,
+			       page_to_pfn(info->page) + vma->vm_pgoff,
+			       vma->vm_end - vma->vm_start,
+			       vma->vm_page_prot);
+}
+
+static int ion_cma_heap_debug_show(struct ion_heap *heap, struct seq_file *s)
+{
+	struct ion_cma_heap *cma_heap = to_cma_heap(heap);
+
+	seq_printf(s, "\n%16.s %16.s %16.s\n", "buffers", "bytes", "failed");
+	seq_printf(s, "%16d %16d %16d\n", atomic_read(&cma_heap->buffers),
+		   atomic_read(&cma_heap->bytes),
+		   atomic_read(&cma_heap->failed));
+	return 0;
+}
+
+static struct ion_heap_ops cma_heap_ops = {
+	.allocate = ion_cma_heap_allocate,
+	.free = ion_cma_heap_free,
+	.phys = ion_cma_heap_phys,
+	.map_dma = ion_cma_heap_map_dma,
+	.unmap_dma = ion_cma_heap_unmap_dma,
+	.map_kernel = ion_cma_heap_map_kernel,
+	.unmap_kernel = ion_cma_heap_unmap_kernel,
+	.map_user = ion_cma_heap_map_user,
+	.debug_show = ion_cma_heap_debug_show,
+};
+
+struct ion_heap *ion_cma_heap_create(struct ion_platform_heap *heap_data)
+{
+	struct ion_cma_heap *cma_heap;
+
+	if (!heap_data->priv) {
+		pr_err("%s: heap %s has no device to allocate for\n",
+		       __func__, heap_data->name);
+		return ERR_PTR(-EINVAL);
+	}
+
+	cma_heap = kzalloc(sizeof(struct ion_cma_heap), GFP_KERNEL);
+	if (!cma_heap)
+		return ERR_PTR(-ENOMEM);
+
+	cma_heap->heap.ops = &cma_heap_ops;
+	cma_heap->heap.type = ION_HEAP_TYPE_DMA;
+	cma_heap->dev = heap_data->priv;
+	return &cma_heap->heap;
+}
+
+void ion_cma_heap_destroy(struct ion_heap *heap)
+{
+	kfree(to_cma_heap(heap));
+}
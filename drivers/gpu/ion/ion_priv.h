@@ -17,10 +17,12 @@
 #ifndef _ION_PRIV_H
 #define _ION_PRIV_H
 
+#include <linux/err.h>
 #include <linux/kref.h>
 #include <linux/mm_types.h>
 #include <linux/mutex.h>
 #include <linux/rbtree.h>
+#include <linux/seq_file.h>
 #include <linux/ion.h>
 
 struct ion_mapping;
@@ -84,6 +86,8 @@ struct ion_buffer {
  * @map_kernel		map memory to the kernel
  * @unmap_kernel	unmap memory to the kernel
  * @map_user		map memory to userspace
+ * @debug_show		optional, adds heap specific state to the heap's
+ *			debugfs file
  */
 struct ion_heap_ops {
 	int (*allocate) (struct ion_heap *heap,
@@ -99,6 +103,7 @@ struct ion_heap_ops {
 	void (*unmap_kernel) (struct ion_heap *heap, struct ion_buffer *buffer);
 	int (*map_user) (struct ion_heap *mapper, struct ion_buffer *buffer,
 			 struct vm_area_struct *vma);
+	int (*debug_show) (struct ion_heap *heap, struct seq_file *s);
 };
 
 /**
@@ -167,6 +172,27 @@ void ion_system_contig_heap_destroy(struct ion_heap *);
 
 struct ion_heap *ion_carveout_heap_create(struct ion_platform_heap *);
 void ion_carveout_heap_destroy(struct ion_heap *);
+
+#ifdef CONFIG_CMA
+struct ion_heap *ion_cma_heap_create(struct ion_platform_heap *);
+void ion_cma_heap_destroy(struct ion_heap *);
+#else
+static inline struct ion_heap *ion_cma_heap_create(struct ion_platform_heap *d)
+{
+	return ERR_PTR(-ENODEV);
+}
+
+static inline void ion_cma_heap_destroy(struct ion_heap *heap)
+{
+}
+#endif
+
+/**
+ * ion_heap_clean_pages - write back and invalidate a block of pages
+ * @page:		first page of the block, may be in highmem
+ * @size:		size of the block in bytes
+ */
+void ion_heap_clean_pages(struct page *page, size_t size);
 /**
  * kernel api to allocate/free from carveout -- used when carveout is
  * used to back an architecture specific custom heap
@@ -181,4 +207,36 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  */
 #define ION_CARVEOUT_ALLOCATE_FAIL -1
 
+/**
+ * struct ion_page_pool - pool of blocks of pages ready to hand out
+ * @high_count:		number of highmem blocks in the pool
+ * @low_count:		number of lowmem blocks in the pool
+ * @high_items:		highmem blocks
+ * @low_items:		lowmem blocks
+ * @mutex:		protects the lists and counts
+ * @gfp_mask:		gfp_mask used to refill from the page allocator
+ * @order:		order of the blocks in the pool
+ *
+ * Blocks are zeroed before they go back into a pool, so they can be handed
+ * out again without touching them.  Highmem and lowmem are kept apart so
+ * the shrinker can give back lowmem first.
+ */
+struct ion_page_pool {
+	int high_count;
+	int low_count;
+	struct list_head high_items;
+	struct list_head low_items;
+	struct mutex mutex;
+	gfp_t gfp_mask;
+	unsigned int order;
+};
+
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
+void ion_page_pool_destroy(struct ion_page_pool *);
+struct page *ion_page_pool_alloc(struct ion_page_pool *, bool *from_pool);
+void ion_page_pool_free(struct ion_page_pool *, struct page *);
+int ion_page_pool_total(struct ion_page_pool *, bool high);
+int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
+			 int nr_to_scan);
+
 #endif /* _ION_PRIV_H */
@@ -14,56 +14,208 @@
  *
  */
 
+#include <asm/page.h>
 #include <linux/err.h>
+#include <linux/highmem.h>
 #include <linux/ion.h>
 #include <linux/mm.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include "ion_priv.h"
 
+/*
+ * Buffers are built from the largest blocks that are readily available,
+ * which keeps the scatterlists short and the TLB footprint of the user
+ * mappings small.  The larger orders never wait for reclaim or compaction,
+ * they just fall back to the next order down.
+ */
+static unsigned int orders[] = {8, 4, 0};
+#define NUM_ORDERS ARRAY_SIZE(orders)
+
+static gfp_t high_order_gfp_flags = (GFP_HIGHUSER | __GFP_NOWARN |
+				     __GFP_NORETRY | __GFP_NO_KSWAPD) &
+				    ~__GFP_WAIT;
+static gfp_t low_order_gfp_flags = GFP_HIGHUSER | __GFP_NOWARN;
+
+static int order_to_index(unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++)
+		if (order == orders[i])
+			return i;
+	BUG();
+	return -1;
+}
+
+static unsigned long order_to_size(unsigned int order)
+{
+	return PAGE_SIZE << order;
+}
+
+/*
+ * Uncached and cached buffers get separate pools: blocks for uncached
+ * buffers must have no lines left in the CPU caches, and cleaning them
+ * once when they enter the pool is cheaper than on every allocation.
+ */
+struct ion_system_heap {
+	struct ion_heap heap;
+	struct ion_page_pool *uncached_pools[NUM_ORDERS];
+	struct ion_page_pool *cached_pools[NUM_ORDERS];
+	struct shrinker shrinker;
+};
+
+struct page_info {
+	struct page *page;
+	unsigned int order;
+	struct list_head list;
+};
+
+/* buffer->priv_virt of system heap buffers */
+struct ion_system_buffer_info {
+	struct list_head pages;
+	int nents;
+};
+
+static struct ion_page_pool *ion_system_heap_pool(struct ion_system_heap *heap,
+						  struct ion_buffer *buffer,
+						  unsigned int order)
+{
+	int i = order_to_index(order);
+
+	if (buffer->flags & ION_FLAG_UNCACHED)
+		return heap->uncached_pools[i];
+	return heap->cached_pools[i];
+}
+
+static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
+						 struct ion_buffer *buffer,
+						 unsigned long size,
+						 unsigned int max_order)
+{
+	struct ion_page_pool *pool;
+	struct page_info *info;
+	struct page *page;
+	bool from_pool;
+	int i;
+
+	info = kmalloc(sizeof(struct page_info), GFP_KERNEL);
+	if (!info)
+		return NULL;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		if (size < order_to_size(orders[i]))
+			continue;
+		if (max_order < orders[i])
+			continue;
+
+		pool = ion_system_heap_pool(heap, buffer, orders[i]);
+		page = ion_page_pool_alloc(pool, &from_pool);
+		if (!page)
+			continue;
+
+		/* blocks only enter the uncached pools clean */
+		if ((buffer->flags & ION_FLAG_UNCACHED) && !from_pool)
+			ion_heap_clean_pages(page, order_to_size(orders[i]));
+
+		info->page = page;
+		info->order = orders[i];
+		return info;
+	}
+
+	kfree(info);
+	return NULL;
+}
+
+static void free_buffer_page(struct ion_system_heap *heap,
+			     struct ion_buffer *buffer, struct page_info *info)
+{
+	int i;
+
+	/* the next owner must not see this buffer's data */
+	for (i = 0; i < (1 << info->order); i++)
+		clear_highpage(info->page + i);
+	if (buffer->flags & ION_FLAG_UNCACHED)
+		ion_heap_clean_pages(info->page, order_to_size(info->order));
+
+	ion_page_pool_free(ion_system_heap_pool(heap, buffer, info->order),
+			   info->page);
+	list_del(&info->list);
+	kfree(info);
+}
+
 static int ion_system_heap_allocate(struct ion_heap *heap,
 				     struct ion_buffer *buffer,
 				     unsigned long size, unsigned long align,
 				     unsigned long flags)
 {
-	buffer->priv_virt = vmalloc_user(size);
-	if (!buffer->priv_virt)
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
+	struct ion_system_buffer_info *binfo;
+	struct page_info *info, *tmp_info;
+	unsigned long size_remaining = PAGE_ALIGN(size);
+	unsigned int max_order = orders[0];
+
+	binfo = kzalloc(sizeof(struct ion_system_buffer_info), GFP_KERNEL);
+	if (!binfo)
 		return -ENOMEM;
+	INIT_LIST_HEAD(&binfo->pages);
+	buffer->priv_virt = binfo;
+
+	while (size_remaining > 0) {
+		info = alloc_largest_available(sys_heap, buffer,
+					       size_remaining, max_order);
+		if (!info)
+			goto err;
+		list_add_tail(&info->list, &binfo->pages);
+		size_remaining -= order_to_size(info->order);
+		max_order = info->order;
+		binfo->nents++;
+	}
+
 	return 0;
+
+err:
+	list_for_each_entry_safe(info, tmp_info, &binfo->pages, list)
+		free_buffer_page(sys_heap, buffer, info);
+	kfree(binfo);
+	return -ENOMEM;
 }
 
 void ion_system_heap_free(struct ion_buffer *buffer)
 {
-	vfree(buffer->priv_virt);
+	struct ion_system_heap *sys_heap = container_of(buffer->heap,
+							struct ion_system_heap,
+							heap);
+	struct ion_system_buffer_info *binfo = buffer->priv_virt;
+	struct page_info *info, *tmp_info;
+
+	list_for_each_entry_safe(info, tmp_info, &binfo->pages, list)
+		free_buffer_page(sys_heap, buffer, info);
+	kfree(binfo);
 }
 
 struct scatterlist *ion_system_heap_map_dma(struct ion_heap *heap,
 					    struct ion_buffer *buffer)
 {
-	struct scatterlist *sglist;
-	struct page *page;
-	int i;
-	int npages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
-	void *vaddr = buffer->priv_virt;
+	struct ion_system_buffer_info *binfo = buffer->priv_virt;
+	struct scatterlist *sglist, *sg;
+	struct page_info *info;
 
-	sglist = vmalloc(npages * sizeof(struct scatterlist));
+	sglist = vmalloc(binfo->nents * sizeof(struct scatterlist));
 	if (!sglist)
 		return ERR_PTR(-ENOMEM);
-	memset(sglist, 0, npages * sizeof(struct scatterlist));
-	sg_init_table(sglist, npages);
-	for (i = 0; i < npages; i++) {
-		page = vmalloc_to_page(vaddr);
-		if (!page)
-			goto end;
-		sg_set_page(&sglist[i], page, PAGE_SIZE, 0);
-		vaddr += PAGE_SIZE;
+	sg_init_table(sglist, binfo->nents);
+	sg = sglist;
+	list_for_each_entry(info, &binfo->pages, list) {
+		sg_set_page(sg, info->page, order_to_size(info->order), 0);
+		sg = sg_next(sg);
 	}
 	/* XXX do cache maintenance for dma? */
 	return sglist;
-end:
-	vfree(sglist);
-	return NULL;
 }
 
 void ion_system_heap_unmap_dma(struct ion_heap *heap,
@@ -74,24 +226,115 @@ void ion_system_heap_unmap_dma(struct ion_heap *heap,
 		vfree(buffer->sglist);
 }
 
+/*
+ * The blocks are mostly highmem, so the kernel mapping is only made when a
+ * client asks for one, and only lives as long as it is used.
+ */
 void *ion_system_heap_map_kernel(struct ion_heap *heap,
 				 struct ion_buffer *buffer)
 {
-	return buffer->priv_virt;
+	struct ion_system_buffer_info *binfo = buffer->priv_virt;
+	int npages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
+	struct page **pages, **tmp;
+	struct page_info *info;
+	pgprot_t pgprot;
+	void *vaddr;
+	int i;
+
+	if (buffer->flags & ION_FLAG_UNCACHED)
+		pgprot = pgprot_writecombine(PAGE_KERNEL);
+	else
+		pgprot = PAGE_KERNEL;
+
+	pages = vmalloc(sizeof(struct page *) * npages);
+	if (!pages)
+		return ERR_PTR(-ENOMEM);
+
+	tmp = pages;
+	list_for_each_entry(info, &binfo->pages, list) {
+		for (i = 0; i < (1 << info->order) && tmp < pages + npages; i++)
+			*(tmp++) = info->page + i;
+	}
+
+	vaddr = vmap(pages, npages, VM_MAP, pgprot);
+	vfree(pages);
+	if (!vaddr)
+		return ERR_PTR(-ENOMEM);
+
+	return vaddr;
 }
 
 void ion_system_heap_unmap_kernel(struct ion_heap *heap,
 				  struct ion_buffer *buffer)
 {
+	vunmap(buffer->vaddr);
 }
 
 int ion_system_heap_map_user(struct ion_heap *heap, struct ion_buffer *buffer,
 			     struct vm_area_struct *vma)
 {
-	return remap_vmalloc_range(vma, buffer->priv_virt, vma->vm_pgoff);
+	struct ion_system_buffer_info *binfo = buffer->priv_virt;
+	unsigned long addr = vma->vm_start;
+	unsigned long offset = vma->vm_pgoff * PAGE_SIZE;
+	struct page_info *info;
+	int ret;
+
+	if (buffer->flags & ION_FLAG_UNCACHED)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+
+	list_for_each_entry(info, &binfo->pages, list) {
+		unsigned long remainder = vma->vm_end - addr;
+		unsigned long len = order_to_size(info->order);
+
+		if (offset >= len) {
+			offset -= len;
+			continue;
+		}
+
+		len -= offset;
+		if (len > remainder)
+			len = remainder;
+		ret = remap_pfn_range(vma, addr,
+				      page_to_pfn(info->page) +
+				      (offset >> PAGE_SHIFT),
+				      len, vma->vm_page_prot);
+		if (ret)
+			return ret;
+
+		addr += len;
+		offset = 0;
+		if (addr >= vma->vm_end)
+			break;
+	}
+
+	return 0;
+}
+
+static int ion_system_heap_debug_show(struct ion_heap *heap,
+				      struct seq_file *s)
+{
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
+	int i;
+
+	seq_printf(s, "\n%8.s %16.s %16.s %16.s %16.s\n", "order",
+		   "cached high", "cached low", "uncached high",
+		   "uncached low");
+	for (i = 0; i < NUM_ORDERS; i++) {
+		struct ion_page_pool *cached = sys_heap->cached_pools[i];
+		struct ion_page_pool *uncached = sys_heap->uncached_pools[i];
+
+		seq_printf(s, "%8u %16lu %16lu %16lu %16lu\n", orders[i],
+			   (unsigned long)cached->high_count * order_to_size(orders[i]),
+			   (unsigned long)cached->low_count * order_to_size(orders[i]),
+			   (unsigned long)uncached->high_count * order_to_size(orders[i]),
+			   (unsigned long)uncached->low_count * order_to_size(orders[i]));
+	}
+	return 0;
 }
 
-static struct ion_heap_ops vmalloc_ops = {
+static struct ion_heap_ops system_heap_ops = {
 	.allocate = ion_system_heap_allocate,
 	.free = ion_system_heap_free,
 	.map_dma = ion_system_heap_map_dma,
@@ -99,23 +342,108 @@ static struct ion_heap_ops vmalloc_ops = {
 	.map_kernel = ion_system_heap_map_kernel,
 	.unmap_kernel = ion_system_heap_unmap_kernel,
 	.map_user = ion_system_heap_map_user,
+	.debug_show = ion_system_heap_debug_show,
 };
 
+/*
+ * Hand pooled blocks back under memory pressure, lowmem first and highmem
+ * only when the reclaim can use it.  Counts are in pages.
+ */
+static int ion_system_heap_shrink(struct shrinker *shrinker,
+				  struct shrink_control *sc)
+{
+	struct ion_system_heap *sys_heap = container_of(shrinker,
+							struct ion_system_heap,
+							shrinker);
+	int nr_total = 0;
+	int nr_freed = 0;
+	int i;
+
+	for (i = 0; i < NUM_ORDERS && nr_freed < sc->nr_to_scan; i++) {
+		nr_freed += ion_page_pool_shrink(sys_heap->uncached_pools[i],
+						 sc->gfp_mask,
+						 sc->nr_to_scan - nr_freed);
+		if (nr_freed >= sc->nr_to_scan)
+			break;
+		nr_freed += ion_page_pool_shrink(sys_heap->cached_pools[i],
+						 sc->gfp_mask,
+						 sc->nr_to_scan - nr_freed);
+	}
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		nr_total += ion_page_pool_shrink(sys_heap->uncached_pools[i],
+						 sc->gfp_mask, 0);
+		nr_total += ion_page_pool_shrink(sys_heap->cached_pools[i],
+						 sc->gfp_mask, 0);
+	}
+
+	return nr_total;
+}
+
+static void ion_system_heap_destroy_pools(struct ion_page_pool **pools)
+{
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++)
+		if (pools[i])
+			ion_page_pool_destroy(pools[i]);
+}
+
+static int ion_system_heap_create_pools(struct ion_page_pool **pools)
+{
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		gfp_t gfp_flags = low_order_gfp_flags;
+
+		if (orders[i] > 0)
+			gfp_flags = high_order_gfp_flags;
+		pools[i] = ion_page_pool_create(gfp_flags, orders[i]);
+		if (!pools[i]) {
+			ion_system_heap_destroy_pools(pools);
+			return -ENOMEM;
+		}
+	}
+	return 0;
+}
+
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 {
-	struct ion_heap *heap;
+	struct ion_system_heap *heap;
 
-	heap = kzalloc(sizeof(struct ion_heap), GFP_KERNEL);
+	heap = kzalloc(sizeof(struct ion_system_heap), GFP_KERNEL);
 	if (!heap)
 		return ERR_PTR(-ENOMEM);
-	heap->ops = &vmalloc_ops;
-	heap->type = ION_HEAP_TYPE_SYSTEM;
-	return heap;
+	heap->heap.ops = &system_heap_ops;
+	heap->heap.type = ION_HEAP_TYPE_SYSTEM;
+
+	if (ion_system_heap_create_pools(heap->uncached_pools))
+		goto err_free_heap;
+	if (ion_system_heap_create_pools(heap->cached_pools))
+		goto err_destroy_uncached;
+
+	heap->shrinker.shrink = ion_system_heap_shrink;
+	heap->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&heap->shrinker);
+	return &heap->heap;
+
+err_destroy_uncached:
+	ion_system_heap_destroy_pools(heap->uncached_pools);
+err_free_heap:
+	kfree(heap);
+	return ERR_PTR(-ENOMEM);
 }
 
 void ion_system_heap_destroy(struct ion_heap *heap)
 {
-	kfree(heap);
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
+
+	unregister_shrinker(&sys_heap->shrinker);
+	ion_system_heap_destroy_pools(sys_heap->uncached_pools);
+	ion_system_heap_destroy_pools(sys_heap->cached_pools);
+	kfree(sys_heap);
 }
 
 static int ion_system_contig_heap_allocate(struct ion_heap *heap,
@@ -157,6 +485,17 @@ struct scatterlist *ion_system_contig_heap_map_dma(struct ion_heap *heap,
 	return sglist;
 }
 
+void *ion_system_contig_heap_map_kernel(struct ion_heap *heap,
+					struct ion_buffer *buffer)
+{
+	return buffer->priv_virt;
+}
+
+void ion_system_contig_heap_unmap_kernel(struct ion_heap *heap,
+					 struct ion_buffer *buffer)
+{
+}
+
 int ion_system_contig_heap_map_user(struct ion_heap *heap,
 				    struct ion_buffer *buffer,
 				    struct vm_area_struct *vma)
@@ -174,8 +513,8 @@ static struct ion_heap_ops kmalloc_ops = {
 	.phys = ion_system_contig_heap_phys,
 	.map_dma = ion_system_contig_heap_map_dma,
 	.unmap_dma = ion_system_heap_unmap_dma,
-	.map_kernel = ion_system_heap_map_kernel,
-	.unmap_kernel = ion_system_heap_unmap_kernel,
+	.map_kernel = ion_system_contig_heap_map_kernel,
+	.unmap_kernel = ion_system_contig_heap_unmap_kernel,
 	.map_user = ion_system_contig_heap_map_user,
 };
 
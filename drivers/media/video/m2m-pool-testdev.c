@@ -0,0 +1,953 @@
+/*
+ * A virtual v4l2-mem2mem device pool example.
+ *
+ * This is a virtual device driver for testing the mem-to-mem device pool.
+ * It has one video node, and simulates several engines behind it, each of
+ * which copies the source buffer to the destination buffer and issues an
+ * "irq" (simulated by a timer of its own). The jobs of all open instances
+ * are spread over the engines by the pool; the utilization of each engine
+ * can be read from the "stats" attribute of the platform device, and is
+ * reset by writing to it.
+ *
+ * Based on mem2mem_testdev.c,
+ * Copyright (c) 2009-2010 Samsung Electronics Co., Ltd.
+ * Pawel Osciak, <pawel@osciak.com>
+ * Marek Szyprowski, <m.szyprowski@samsung.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version
+ */
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/timer.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#include <linux/platform_device.h>
+#include <media/v4l2-m2m-pool.h>
+#include <media/v4l2-device.h>
+#include <media/v4l2-ioctl.h>
+#include <media/videobuf2-vmalloc.h>
+
+#define M2MPOOL_TEST_MODULE_NAME "m2m-pool-testdev"
+
+MODULE_DESCRIPTION("Virtual device for mem2mem device pool testing");
+MODULE_LICENSE("GPL");
+MODULE_VERSION("0.1");
+
+static unsigned int units = 4;
+module_param(units, uint, 0444);
+MODULE_PARM_DESC(units, "Number of simulated engines");
+
+#define MIN_W 32
+#define MIN_H 32
+#define MAX_W 640
+#define MAX_H 480
+#define DIM_ALIGN_MASK 0x08 /* 8-alignment for dimensions */
+
+#define M2MPOOL_NAME		"m2m-pool-testdev"
+
+/* In bytes, per queue */
+#define M2MPOOL_VID_MEM_LIMIT	(16 * 1024 * 1024)
+
+/* Default transaction time in msec */
+#define M2MPOOL_DEF_TRANSTIME	40
+#define M2MPOOL_MAX_TRANSTIME	10000
+
+#define dprintk(dev, fmt, arg...) \
+	v4l2_dbg(1, 1, &dev->v4l2_dev, "%s: " fmt, __func__, ## arg)
+
+
+void m2mpool_dev_release(struct device *dev)
+{}
+
+static struct platform_device m2mpool_pdev = {
+	.name		= M2MPOOL_NAME,
+	.dev.release	= m2mpool_dev_release,
+};
+
+struct m2mpool_fmt {
+	char	*name;
+	u32	fourcc;
+	int	depth;
+};
+
+static struct m2mpool_fmt formats[] = {
+	{
+		.name	= "RGB565 (BE)",
+		.fourcc	= V4L2_PIX_FMT_RGB565X, /* rrrrrggg gggbbbbb */
+		.depth	= 16,
+	},
+	{
+		.name	= "4:2:2, packed, YUYV",
+		.fourcc	= V4L2_PIX_FMT_YUYV,
+		.depth	= 16,
+	},
+};
+
+#define NUM_FORMATS ARRAY_SIZE(formats)
+
+/* Per-queue, per-instance data */
+struct m2mpool_q_data {
+	unsigned int		width;
+	unsigned int		height;
+	unsigned int		sizeimage;
+	struct m2mpool_fmt	*fmt;
+};
+
+enum {
+	V4L2_M2M_SRC = 0,
+	V4L2_M2M_DST = 1,
+};
+
+#define V4L2_CID_TRANS_TIME_MSEC	V4L2_CID_PRIVATE_BASE
+#define V4L2_CID_UNIT_MASK		(V4L2_CID_PRIVATE_BASE + 2)
+
+static struct v4l2_queryctrl m2mpool_ctrls[] = {
+	{
+		.id		= V4L2_CID_TRANS_TIME_MSEC,
+		.type		= V4L2_CTRL_TYPE_INTEGER,
+		.name		= "Transaction time (msec)",
+		.minimum	= 1,
+		.maximum	= M2MPOOL_MAX_TRANSTIME,
+		.step		= 1,
+		.default_value	= M2MPOOL_DEF_TRANSTIME,
+		.flags		= 0,
+	}, {
+		/* Restricts the instance to some engines, as if only those
+		 * supported its configuration */
+		.id		= V4L2_CID_UNIT_MASK,
+		.type		= V4L2_CTRL_TYPE_INTEGER,
+		.name		= "Allowed engines mask",
+		.minimum	= 1,
+		.maximum	= (1 << V4L2_M2M_POOL_MAX_UNITS) - 1,
+		.step		= 1,
+		.default_value	= (1 << V4L2_M2M_POOL_MAX_UNITS) - 1,
+		.flags		= 0,
+	},
+};
+
+static struct m2mpool_fmt *find_format(struct v4l2_format *f)
+{
+	unsigned int k;
+
+	for (k = 0; k < NUM_FORMATS; k++) {
+		if (formats[k].fourcc == f->fmt.pix.pixelformat)
+			return &formats[k];
+	}
+
+	return NULL;
+}
+
+struct m2mpool_dev;
+
+/* One simulated engine */
+struct m2mpool_unit {
+	struct m2mpool_dev	*dev;
+	int			id;
+	char			name[16];
+	struct timer_list	timer;
+};
+
+struct m2mpool_dev {
+	struct v4l2_device	v4l2_dev;
+	struct video_device	*vfd;
+
+	atomic_t		num_inst;
+	struct mutex		dev_mutex;
+	spinlock_t		irqlock;
+
+	struct v4l2_m2m_pool	*pool;
+	unsigned int		num_units;
+	struct m2mpool_unit	unit[V4L2_M2M_POOL_MAX_UNITS];
+};
+
+struct m2mpool_ctx {
+	struct m2mpool_dev	*dev;
+
+	struct m2mpool_q_data	q_data[2];
+
+	/* Transaction time (i.e. simulated processing time) in milliseconds */
+	u32			transtime;
+	/* Engines this instance may run on */
+	u32			unit_mask;
+
+	struct v4l2_m2m_pool_ctx *pctx;
+	struct v4l2_m2m_ctx	*m2m_ctx;
+};
+
+static struct m2mpool_q_data *get_q_data(struct m2mpool_ctx *ctx,
+					 enum v4l2_buf_type type)
+{
+	switch (type) {
+	case V4L2_BUF_TYPE_VIDEO_OUTPUT:
+		return &ctx->q_data[V4L2_M2M_SRC];
+	case V4L2_BUF_TYPE_VIDEO_CAPTURE:
+		return &ctx->q_data[V4L2_M2M_DST];
+	default:
+		BUG();
+	}
+	return NULL;
+}
+
+static struct v4l2_queryctrl *get_ctrl(int id)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(m2mpool_ctrls); ++i) {
+		if (id == m2mpool_ctrls[i].id)
+			return &m2mpool_ctrls[i];
+	}
+
+	return NULL;
+}
+
+static int device_process(struct m2mpool_ctx *ctx,
+			  struct vb2_buffer *in_vb,
+			  struct vb2_buffer *out_vb)
+{
+	struct m2mpool_dev *dev = ctx->dev;
+	u8 *p_in, *p_out;
+
+	p_in = vb2_plane_vaddr(in_vb, 0);
+	p_out = vb2_plane_vaddr(out_vb, 0);
+	if (!p_in || !p_out) {
+		v4l2_err(&dev->v4l2_dev,
+			 "Acquiring kernel pointers to buffers failed\n");
+		return -EFAULT;
+	}
+
+	if (vb2_get_plane_payload(in_vb, 0) > vb2_plane_size(out_vb, 0)) {
+		v4l2_err(&dev->v4l2_dev, "Output buffer is too small\n");
+		return -EINVAL;
+	}
+
+	memcpy(p_out, p_in, vb2_get_plane_payload(in_vb, 0));
+	out_vb->v4l2_buf.timestamp = in_vb->v4l2_buf.timestamp;
+
+	return 0;
+}
+
+/*
+ * mem2mem pool callbacks
+ */
+
+static void unit_run(void *unit_priv, void *priv)
+{
+	struct m2mpool_unit *unit = unit_priv;
+	struct m2mpool_ctx *ctx = priv;
+	struct vb2_buffer *src_buf, *dst_buf;
+
+	src_buf = v4l2_m2m_next_src_buf(ctx->m2m_ctx);
+	dst_buf = v4l2_m2m_next_dst_buf(ctx->m2m_ctx);
+
+	device_process(ctx, src_buf, dst_buf);
+
+	/* Run a timer, which simulates a hardware irq  */
+	dprintk(unit->dev, "Scheduling a simulated irq on %s\n", unit->name);
+	mod_timer(&unit->timer, jiffies + msecs_to_jiffies(ctx->transtime));
+}
+
+static int unit_fits(void *unit_priv, void *priv)
+{
+	struct m2mpool_unit *unit = unit_priv;
+	struct m2mpool_ctx *ctx = priv;
+
+	return (ctx->unit_mask & (1 << unit->id)) != 0;
+}
+
+static struct v4l2_m2m_pool_ops pool_ops = {
+	.unit_run	= unit_run,
+	.unit_fits	= unit_fits,
+};
+
+static void unit_isr(unsigned long priv)
+{
+	struct m2mpool_unit *unit = (struct m2mpool_unit *)priv;
+	struct m2mpool_dev *dev = unit->dev;
+	struct m2mpool_ctx *curr_ctx;
+	struct vb2_buffer *src_vb, *dst_vb;
+	unsigned long flags;
+
+	curr_ctx = v4l2_m2m_pool_get_curr_priv(dev->pool, unit->id);
+	if (NULL == curr_ctx) {
+		printk(KERN_ERR
+			"Instance released before the end of transaction\n");
+		return;
+	}
+
+	src_vb = v4l2_m2m_src_buf_remove(curr_ctx->m2m_ctx);
+	dst_vb = v4l2_m2m_dst_buf_remove(curr_ctx->m2m_ctx);
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	v4l2_m2m_buf_done(src_vb, VB2_BUF_STATE_DONE);
+	v4l2_m2m_buf_done(dst_vb, VB2_BUF_STATE_DONE);
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+
+	dprintk(dev, "Finishing transaction on %s\n", unit->name);
+	v4l2_m2m_pool_job_finish(curr_ctx->pctx);
+}
+
+/*
+ * mem2mem callbacks of the instances
+ */
+
+static void device_run(void *priv)
+{
+	struct m2mpool_ctx *ctx = priv;
+
+	v4l2_m2m_pool_job_queue(ctx->pctx);
+}
+
+static int job_ready(void *priv)
+{
+	struct m2mpool_ctx *ctx = priv;
+
+	return v4l2_m2m_pool_job_ready(ctx->pctx);
+}
+
+static void job_abort(void *priv)
+{
+	struct m2mpool_ctx *ctx = priv;
+
+	v4l2_m2m_pool_job_abort(ctx->pctx);
+}
+
+static void m2mpool_lock(void *priv)
+{
+	struct m2mpool_ctx *ctx = priv;
+	struct m2mpool_dev *dev = ctx->dev;
+	mutex_lock(&dev->dev_mutex);
+}
+
+static void m2mpool_unlock(void *priv)
+{
+	struct m2mpool_ctx *ctx = priv;
+	struct m2mpool_dev *dev = ctx->dev;
+	mutex_unlock(&dev->dev_mutex);
+}
+
+static struct v4l2_m2m_ops m2m_ops = {
+	.device_run	= device_run,
+	.job_ready	= job_ready,
+	.job_abort	= job_abort,
+	.lock		= m2mpool_lock,
+	.unlock		= m2mpool_unlock,
+};
+
+/*
+ * video ioctls
+ */
+static int vidioc_querycap(struct file *file, void *priv,
+			   struct v4l2_capability *cap)
+{
+	strncpy(cap->driver, M2MPOOL_NAME, sizeof(cap->driver) - 1);
+	strncpy(cap->card, M2MPOOL_NAME, sizeof(cap->card) - 1);
+	cap->bus_info[0] = 0;
+	cap->capabilities = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_OUTPUT
+			  | V4L2_CAP_STREAMING;
+
+	return 0;
+}
+
+static int vidioc_enum_fmt(struct file *file, void *priv,
+			   struct v4l2_fmtdesc *f)
+{
+	if (f->index >= NUM_FORMATS)
+		return -EINVAL;
+
+	strncpy(f->description, formats[f->index].name,
+		sizeof(f->description) - 1);
+	f->pixelformat = formats[f->index].fourcc;
+	return 0;
+}
+
+static int vidioc_g_fmt(struct file *file, void *priv, struct v4l2_format *f)
+{
+	struct m2mpool_ctx *ctx = priv;
+	struct m2mpool_q_data *q_data;
+	struct vb2_queue *vq;
+
+	vq = v4l2_m2m_get_vq(ctx->m2m_ctx, f->type);
+	if (!vq)
+		return -EINVAL;
+
+	q_data = get_q_data(ctx, f->type);
+
+	f->fmt.pix.width	= q_data->width;
+	f->fmt.pix.height	= q_data->height;
+	f->fmt.pix.field	= V4L2_FIELD_NONE;
+	f->fmt.pix.pixelformat	= q_data->fmt->fourcc;
+	f->fmt.pix.bytesperline	= (q_data->width * q_data->fmt->depth) >> 3;
+	f->fmt.pix.sizeimage	= q_data->sizeimage;
+
+	return 0;
+}
+
+static int vidioc_try_fmt(struct file *file, void *priv,
+			  struct v4l2_format *f)
+{
+	struct m2mpool_ctx *ctx = priv;
+	struct m2mpool_fmt *fmt;
+
+	fmt = find_format(f);
+	if (!fmt) {
+		v4l2_err(&ctx->dev->v4l2_dev,
+			 "Fourcc format (0x%08x) invalid.\n",
+			 f->fmt.pix.pixelformat);
+		return -EINVAL;
+	}
+
+	if (f->fmt.pix.field == V4L2_FIELD_ANY)
+		f->fmt.pix.field = V4L2_FIELD_NONE;
+	else if (f->fmt.pix.field != V4L2_FIELD_NONE)
+		return -EINVAL;
+
+	f->fmt.pix.height = clamp_t(u32, f->fmt.pix.height, MIN_H, MAX_H);
+	f->fmt.pix.width = clamp_t(u32, f->fmt.pix.width, MIN_W, MAX_W);
+
+	f->fmt.pix.width &= ~DIM_ALIGN_MASK;
+	f->fmt.pix.bytesperline = (f->fmt.pix.width * fmt->depth) >> 3;
+	f->fmt.pix.sizeimage = f->fmt.pix.height * f->fmt.pix.bytesperline;
+
+	return 0;
+}
+
+static int vidioc_s_fmt(struct file *file, void *priv, struct v4l2_format *f)
+{
+	struct m2mpool_ctx *ctx = priv;
+	struct m2mpool_q_data *q_data;
+	struct vb2_queue *vq;
+	int ret;
+
+	ret = vidioc_try_fmt(file, priv, f);
+	if (ret)
+		return ret;
+
+	vq = v4l2_m2m_get_vq(ctx->m2m_ctx, f->type);
+	if (!vq)
+		return -EINVAL;
+
+	if (vb2_is_busy(vq)) {
+		v4l2_err(&ctx->dev->v4l2_dev, "%s queue busy\n", __func__);
+		return -EBUSY;
+	}
+
+	q_data = get_q_data(ctx, f->type);
+	q_data->fmt		= find_format(f);
+	q_data->width		= f->fmt.pix.width;
+	q_data->height		= f->fmt.pix.height;
+	q_data->sizeimage	= f->fmt.pix.sizeimage;
+
+	dprintk(ctx->dev,
+		"Setting format for type %d, wxh: %dx%d, fmt: %d\n",
+		f->type, q_data->width, q_data->height, q_data->fmt->fourcc);
+
+	return 0;
+}
+
+static int vidioc_reqbufs(struct file *file, void *priv,
+			  struct v4l2_requestbuffers *reqbufs)
+{
+	struct m2mpool_ctx *ctx = priv;
+
+	return v4l2_m2m_reqbufs(file, ctx->m2m_ctx, reqbufs);
+}
+
+static int vidioc_querybuf(struct file *file, void *priv,
+			   struct v4l2_buffer *buf)
+{
+	struct m2mpool_ctx *ctx = priv;
+
+	return v4l2_m2m_querybuf(file, ctx->m2m_ctx, buf);
+}
+
+static int vidioc_qbuf(struct file *file, void *priv, struct v4l2_buffer *buf)
+{
+	struct m2mpool_ctx *ctx = priv;
+
+	return v4l2_m2m_qbuf(file, ctx->m2m_ctx, buf);
+}
+
+static int vidioc_dqbuf(struct file *file, void *priv, struct v4l2_buffer *buf)
+{
+	struct m2mpool_ctx *ctx = priv;
+
+	return v4l2_m2m_dqbuf(file, ctx->m2m_ctx, buf);
+}
+
+static int vidioc_streamon(struct file *file, void *priv,
+			   enum v4l2_buf_type type)
+{
+	struct m2mpool_ctx *ctx = priv;
+
+	return v4l2_m2m_streamon(file, ctx->m2m_ctx, type);
+}
+
+static int vidioc_streamoff(struct file *file, void *priv,
+			    enum v4l2_buf_type type)
+{
+	struct m2mpool_ctx *ctx = priv;
+
+	return v4l2_m2m_streamoff(file, ctx->m2m_ctx, type);
+}
+
+static int vidioc_queryctrl(struct file *file, void *priv,
+			    struct v4l2_queryctrl *qc)
+{
+	struct v4l2_queryctrl *c;
+
+	c = get_ctrl(qc->id);
+	if (!c)
+		return -EINVAL;
+
+	*qc = *c;
+	return 0;
+}
+
+static int vidioc_g_ctrl(struct file *file, void *priv,
+			 struct v4l2_control *ctrl)
+{
+	struct m2mpool_ctx *ctx = priv;
+
+	switch (ctrl->id) {
+	case V4L2_CID_TRANS_TIME_MSEC:
+		ctrl->value = ctx->transtime;
+		break;
+
+	case V4L2_CID_UNIT_MASK:
+		ctrl->value = ctx->unit_mask;
+		break;
+
+	default:
+		v4l2_err(&ctx->dev->v4l2_dev, "Invalid control\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int vidioc_s_ctrl(struct file *file, void *priv,
+			 struct v4l2_control *ctrl)
+{
+	struct m2mpool_ctx *ctx = priv;
+	struct v4l2_queryctrl *c;
+
+	c = get_ctrl(ctrl->id);
+	if (!c)
+		return -EINVAL;
+
+	if (ctrl->value < c->minimum || ctrl->value > c->maximum) {
+		v4l2_err(&ctx->dev->v4l2_dev, "Value out of range\n");
+		return -ERANGE;
+	}
+
+	switch (ctrl->id) {
+	case V4L2_CID_TRANS_TIME_MSEC:
+		ctx->transtime = ctrl->value;
+		break;
+
+	case V4L2_CID_UNIT_MASK:
+		if (!(ctrl->value & ((1 << ctx->dev->num_units) - 1)))
+			return -EINVAL;
+		ctx->unit_mask = ctrl->value;
+		break;
+	}
+
+	return 0;
+}
+
+static const struct v4l2_ioctl_ops m2mpool_ioctl_ops = {
+	.vidioc_querycap	= vidioc_querycap,
+
+	.vidioc_enum_fmt_vid_cap = vidioc_enum_fmt,
+	.vidioc_g_fmt_vid_cap	= vidioc_g_fmt,
+	.vidioc_try_fmt_vid_cap	= vidioc_try_fmt,
+	.vidioc_s_fmt_vid_cap	= vidioc_s_fmt,
+
+	.vidioc_enum_fmt_vid_out = vidioc_enum_fmt,
+	.vidioc_g_fmt_vid_out	= vidioc_g_fmt,
+	.vidioc_try_fmt_vid_out	= vidioc_try_fmt,
+	.vidioc_s_fmt_vid_out	= vidioc_s_fmt,
+
+	.vidioc_reqbufs		= vidioc_reqbufs,
+	.vidioc_querybuf	= vidioc_querybuf,
+
+	.vidioc_qbuf		= vidioc_qbuf,
+	.vidioc_dqbuf		= vidioc_dqbuf,
+
+	.vidioc_streamon	= vidioc_streamon,
+	.vidioc_streamoff	= vidioc_streamoff,
+
+	.vidioc_queryctrl	= vidioc_queryctrl,
+	.vidioc_g_ctrl		= vidioc_g_ctrl,
+	.vidioc_s_ctrl		= vidioc_s_ctrl,
+};
+
+
+/*
+ * Queue operations
+ */
+
+static int m2mpool_queue_setup(struct vb2_queue *vq,
+				const struct v4l2_format *fmt,
+				unsigned int *nbuffers, unsigned int *nplanes,
+				unsigned int sizes[], void *alloc_ctxs[])
+{
+	struct m2mpool_ctx *ctx = vb2_get_drv_priv(vq);
+	struct m2mpool_q_data *q_data;
+	unsigned int size, count = *nbuffers;
+
+	q_data = get_q_data(ctx, vq->type);
+	size = q_data->sizeimage;
+
+	while (size * count > M2MPOOL_VID_MEM_LIMIT)
+		(count)--;
+
+	*nplanes = 1;
+	*nbuffers = count;
+	sizes[0] = size;
+
+	dprintk(ctx->dev, "get %d buffer(s) of size %d each.\n", count, size);
+
+	return 0;
+}
+
+static int m2mpool_buf_prepare(struct vb2_buffer *vb)
+{
+	struct m2mpool_ctx *ctx = vb2_get_drv_priv(vb->vb2_queue);
+	struct m2mpool_q_data *q_data;
+
+	q_data = get_q_data(ctx, vb->vb2_queue->type);
+
+	if (vb2_plane_size(vb, 0) < q_data->sizeimage) {
+		dprintk(ctx->dev, "%s data will not fit into plane (%lu < %lu)\n",
+				__func__, vb2_plane_size(vb, 0), (long)q_data->sizeimage);
+		return -EINVAL;
+	}
+
+	vb2_set_plane_payload(vb, 0, q_data->sizeimage);
+
+	return 0;
+}
+
+static void m2mpool_buf_queue(struct vb2_buffer *vb)
+{
+	struct m2mpool_ctx *ctx = vb2_get_drv_priv(vb->vb2_queue);
+	v4l2_m2m_buf_queue(ctx->m2m_ctx, vb);
+}
+
+static int m2mpool_start_streaming(struct vb2_queue *q, unsigned int count)
+{
+	struct m2mpool_ctx *ctx = vb2_get_drv_priv(q);
+
+	v4l2_m2m_pool_ctx_start(ctx->pctx);
+	return 0;
+}
+
+static int m2mpool_stop_streaming(struct vb2_queue *q)
+{
+	struct m2mpool_ctx *ctx = vb2_get_drv_priv(q);
+	int ret;
+
+	ret = v4l2_m2m_pool_ctx_stop(ctx->pctx,
+				     msecs_to_jiffies(ctx->transtime) + HZ);
+	if (ret)
+		v4l2_err(&ctx->dev->v4l2_dev, "Running job did not complete\n");
+	return 0;
+}
+
+static void m2mpool_wait_prepare(struct vb2_queue *q)
+{
+	struct m2mpool_ctx *ctx = vb2_get_drv_priv(q);
+	m2mpool_unlock(ctx);
+}
+
+static void m2mpool_wait_finish(struct vb2_queue *q)
+{
+	struct m2mpool_ctx *ctx = vb2_get_drv_priv(q);
+	m2mpool_lock(ctx);
+}
+
+static struct vb2_ops m2mpool_qops = {
+	.queue_setup	 = m2mpool_queue_setup,
+	.buf_prepare	 = m2mpool_buf_prepare,
+	.buf_queue	 = m2mpool_buf_queue,
+	.start_streaming = m2mpool_start_streaming,
+	.stop_streaming	 = m2mpool_stop_streaming,
+	.wait_prepare	 = m2mpool_wait_prepare,
+	.wait_finish	 = m2mpool_wait_finish,
+};
+
+static int queue_init(void *priv, struct vb2_queue *src_vq, struct vb2_queue *dst_vq)
+{
+	struct m2mpool_ctx *ctx = priv;
+	int ret;
+
+	memset(src_vq, 0, sizeof(*src_vq));
+	src_vq->type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	src_vq->io_modes = VB2_MMAP;
+	src_vq->drv_priv = ctx;
+	src_vq->buf_struct_size = sizeof(struct v4l2_m2m_buffer);
+	src_vq->ops = &m2mpool_qops;
+	src_vq->mem_ops = &vb2_vmalloc_memops;
+
+	ret = vb2_queue_init(src_vq);
+	if (ret)
+		return ret;
+
+	memset(dst_vq, 0, sizeof(*dst_vq));
+	dst_vq->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	dst_vq->io_modes = VB2_MMAP;
+	dst_vq->drv_priv = ctx;
+	dst_vq->buf_struct_size = sizeof(struct v4l2_m2m_buffer);
+	dst_vq->ops = &m2mpool_qops;
+	dst_vq->mem_ops = &vb2_vmalloc_memops;
+
+	return vb2_queue_init(dst_vq);
+}
+
+/*
+ * File operations
+ */
+static int m2mpool_open(struct file *file)
+{
+	struct m2mpool_dev *dev = video_drvdata(file);
+	struct m2mpool_ctx *ctx;
+	int i;
+
+	ctx = kzalloc(sizeof *ctx, GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	file->private_data = ctx;
+	ctx->dev = dev;
+	ctx->transtime = M2MPOOL_DEF_TRANSTIME;
+	ctx->unit_mask = (1 << V4L2_M2M_POOL_MAX_UNITS) - 1;
+
+	for (i = 0; i < 2; i++) {
+		ctx->q_data[i].fmt = &formats[0];
+		ctx->q_data[i].width = MAX_W;
+		ctx->q_data[i].height = MAX_H;
+		ctx->q_data[i].sizeimage = MAX_W * MAX_H * formats[0].depth >> 3;
+	}
+
+	ctx->pctx = v4l2_m2m_pool_ctx_init(dev->pool, &m2m_ops, ctx,
+					   &queue_init);
+	if (IS_ERR(ctx->pctx)) {
+		int ret = PTR_ERR(ctx->pctx);
+
+		kfree(ctx);
+		return ret;
+	}
+	ctx->m2m_ctx = ctx->pctx->m2m_ctx;
+
+	atomic_inc(&dev->num_inst);
+
+	dprintk(dev, "Created instance %p, m2m_ctx: %p\n", ctx, ctx->m2m_ctx);
+
+	return 0;
+}
+
+static int m2mpool_release(struct file *file)
+{
+	struct m2mpool_dev *dev = video_drvdata(file);
+	struct m2mpool_ctx *ctx = file->private_data;
+
+	dprintk(dev, "Releasing instance %p\n", ctx);
+
+	v4l2_m2m_pool_ctx_release(ctx->pctx);
+	kfree(ctx);
+
+	atomic_dec(&dev->num_inst);
+
+	return 0;
+}
+
+static unsigned int m2mpool_poll(struct file *file,
+				 struct poll_table_struct *wait)
+{
+	struct m2mpool_ctx *ctx = file->private_data;
+
+	return v4l2_m2m_poll(file, ctx->m2m_ctx, wait);
+}
+
+static int m2mpool_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct m2mpool_ctx *ctx = file->private_data;
+
+	return v4l2_m2m_mmap(file, ctx->m2m_ctx, vma);
+}
+
+static const struct v4l2_file_operations m2mpool_fops = {
+	.owner		= THIS_MODULE,
+	.open		= m2mpool_open,
+	.release	= m2mpool_release,
+	.poll		= m2mpool_poll,
+	.unlocked_ioctl	= video_ioctl2,
+	.mmap		= m2mpool_mmap,
+};
+
+static struct video_device m2mpool_videodev = {
+	.name		= M2MPOOL_NAME,
+	.fops		= &m2mpool_fops,
+	.ioctl_ops	= &m2mpool_ioctl_ops,
+	.minor		= -1,
+	.release	= video_device_release,
+};
+
+static ssize_t m2mpool_stats_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct m2mpool_dev *m2mpool_dev = dev_get_drvdata(dev);
+
+	return v4l2_m2m_pool_show_stats(m2mpool_dev->pool, buf);
+}
+
+static ssize_t m2mpool_stats_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct m2mpool_dev *m2mpool_dev = dev_get_drvdata(dev);
+
+	v4l2_m2m_pool_reset_stats(m2mpool_dev->pool);
+	return count;
+}
+
+static DEVICE_ATTR(stats, S_IWUSR | S_IRUGO,
+		   m2mpool_stats_show, m2mpool_stats_store);
+
+static int m2mpool_probe(struct platform_device *pdev)
+{
+	struct m2mpool_dev *dev;
+	struct m2mpool_unit *unit;
+	struct video_device *vfd;
+	int i, ret;
+
+	dev = kzalloc(sizeof *dev, GFP_KERNEL);
+	if (!dev)
+		return -ENOMEM;
+
+	spin_lock_init(&dev->irqlock);
+
+	ret = v4l2_device_register(&pdev->dev, &dev->v4l2_dev);
+	if (ret)
+		goto free_dev;
+
+	atomic_set(&dev->num_inst, 0);
+	mutex_init(&dev->dev_mutex);
+
+	dev->pool = v4l2_m2m_pool_init(&pool_ops);
+	if (IS_ERR(dev->pool)) {
+		v4l2_err(&dev->v4l2_dev, "Failed to init mem2mem pool\n");
+		ret = PTR_ERR(dev->pool);
+		goto unreg_dev;
+	}
+
+	dev->num_units = clamp_t(unsigned int, units, 1,
+				 V4L2_M2M_POOL_MAX_UNITS);
+	for (i = 0; i < dev->num_units; i++) {
+		unit = &dev->unit[i];
+		unit->dev = dev;
+		snprintf(unit->name, sizeof(unit->name), "unit%d", i);
+		setup_timer(&unit->timer, unit_isr, (long)unit);
+		unit->id = v4l2_m2m_pool_add_unit(dev->pool, unit, unit->name);
+	}
+
+	vfd = video_device_alloc();
+	if (!vfd) {
+		v4l2_err(&dev->v4l2_dev, "Failed to allocate video device\n");
+		ret = -ENOMEM;
+		goto rel_pool;
+	}
+
+	*vfd = m2mpool_videodev;
+	vfd->lock = &dev->dev_mutex;
+	video_set_drvdata(vfd, dev);
+	dev->vfd = vfd;
+	platform_set_drvdata(pdev, dev);
+
+	ret = video_register_device(vfd, VFL_TYPE_GRABBER, -1);
+	if (ret) {
+		v4l2_err(&dev->v4l2_dev, "Failed to register video device\n");
+		goto rel_vdev;
+	}
+
+	ret = device_create_file(&pdev->dev, &dev_attr_stats);
+	if (ret)
+		goto unreg_vdev;
+
+	v4l2_info(&dev->v4l2_dev, M2MPOOL_TEST_MODULE_NAME
+		  " with %u engines registered as /dev/video%d\n",
+		  dev->num_units, vfd->num);
+
+	return 0;
+
+unreg_vdev:
+	video_unregister_device(vfd);
+	vfd = NULL;
+rel_vdev:
+	if (vfd)
+		video_device_release(vfd);
+rel_pool:
+	v4l2_m2m_pool_release(dev->pool);
+unreg_dev:
+	v4l2_device_unregister(&dev->v4l2_dev);
+free_dev:
+	kfree(dev);
+
+	return ret;
+}
+
+static int m2mpool_remove(struct platform_device *pdev)
+{
+	struct m2mpool_dev *dev =
+		(struct m2mpool_dev *)platform_get_drvdata(pdev);
+	int i;
+
+	v4l2_info(&dev->v4l2_dev, "Removing " M2MPOOL_TEST_MODULE_NAME);
+	device_remove_file(&pdev->dev, &dev_attr_stats);
+	video_unregister_device(dev->vfd);
+	for (i = 0; i < dev->num_units; i++)
+		del_timer_sync(&dev->unit[i].timer);
+	v4l2_m2m_pool_release(dev->pool);
+	v4l2_device_unregister(&dev->v4l2_dev);
+	kfree(dev);
+
+	return 0;
+}
+
+static struct platform_driver m2mpool_pdrv = {
+	.probe		= m2mpool_probe,
+	.remove		= m2mpool_remove,
+	.driver		= {
+		.name	= M2MPOOL_NAME,
+		.owner	= THIS_MODULE,
+	},
+};
+
+static void __exit m2mpool_exit(void)
+{
+	platform_driver_unregister(&m2mpool_pdrv);
+	platform_device_unregister(&m2mpool_pdev);
+}
+
+static int __init m2mpool_init(void)
+{
+	int ret;
+
+	ret = platform_device_register(&m2mpool_pdev);
+	if (ret)
+		return ret;
+
+	ret = platform_driver_register(&m2mpool_pdrv);
+	if (ret)
+		platform_device_unregister(&m2mpool_pdev);
+
+	return ret;
+}
+
+module_init(m2mpool_init);
+module_exit(m2mpool_exit);
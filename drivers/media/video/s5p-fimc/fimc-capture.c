@@ -420,11 +420,14 @@ static int fimc_capture_open(struct file *file)
 	pm_runtime_get_sync(&fimc->pdev->dev);
 
 	if (++fimc->vid_cap.refcnt == 1) {
+		/* Take this FIMC out of the virtual mem2mem device's pool */
+		fimc_vm2m_unit_get(fimc);
 		ret = fimc_pipeline_initialize(fimc,
 			       &fimc->vid_cap.vfd->entity, true);
 		if (ret < 0) {
 			dev_err(&fimc->pdev->dev,
 				"Video pipeline initialization failed\n");
+			fimc_vm2m_unit_put(fimc);
 			pm_runtime_put_sync(&fimc->pdev->dev);
 			fimc->vid_cap.refcnt--;
 			v4l2_fh_release(file);
@@ -450,6 +453,7 @@ static int fimc_capture_close(struct file *file)
 		fimc_stop_capture(fimc, false);
 		fimc_pipeline_shutdown(fimc);
 		clear_bit(ST_CAPT_SUSPENDED, &fimc->state);
+		fimc_vm2m_unit_put(fimc);
 	}
 
 	pm_runtime_put(&fimc->pdev->dev);
@@ -1028,6 +1032,14 @@ static int fimc_cap_dqbuf(struct file *file, void *priv,
 	return vb2_dqbuf(&fimc->vid_cap.vbq, buf, file->f_flags & O_NONBLOCK);
 }
 
+static int fimc_cap_expbuf(struct file *file, void *priv,
+			   struct v4l2_exportbuffer *eb)
+{
+	struct fimc_dev *fimc = video_drvdata(file);
+
+	return vb2_expbuf(&fimc->vid_cap.vbq, eb);
+}
+
 static int fimc_cap_create_bufs(struct file *file, void *priv,
 				struct v4l2_create_buffers *create)
 {
@@ -1155,6 +1167,7 @@ static const struct v4l2_ioctl_ops fimc_capture_ioctl_ops = {
 
 	.vidioc_qbuf			= fimc_cap_qbuf,
 	.vidioc_dqbuf			= fimc_cap_dqbuf,
+	.vidioc_expbuf			= fimc_cap_expbuf,
 
 	.vidioc_prepare_buf		= fimc_cap_prepare_buf,
 	.vidioc_create_bufs		= fimc_cap_create_bufs,
@@ -1539,7 +1552,7 @@ int fimc_register_capture_device(struct fimc_dev *fimc,
 	q = &fimc->vid_cap.vbq;
 	memset(q, 0, sizeof(*q));
 	q->type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-	q->io_modes = VB2_MMAP | VB2_USERPTR;
+	q->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
 	q->drv_priv = fimc->vid_cap.ctx;
 	q->ops = &fimc_capture_qops;
 	q->mem_ops = &vb2_dma_contig_memops;
@@ -306,11 +306,30 @@ static void fimc_m2m_job_finish(struct fimc_ctx *ctx, int vb_state)
 	if (src_vb && dst_vb) {
 		v4l2_m2m_buf_done(src_vb, vb_state);
 		v4l2_m2m_buf_done(dst_vb, vb_state);
-		v4l2_m2m_job_finish(ctx->fimc_dev->m2m.m2m_dev,
-				    ctx->m2m_ctx);
+		if (ctx->pool_ctx)
+			v4l2_m2m_pool_job_finish(ctx->pool_ctx);
+		else
+			v4l2_m2m_job_finish(ctx->fimc_dev->m2m.m2m_dev,
+					    ctx->m2m_ctx);
 	}
 }
 
+/*
+ * Return the context of the memory-to-memory job running on this FIMC,
+ * whether it came from the FIMC's own video node or the virtual one.
+ */
+static struct fimc_ctx *fimc_m2m_get_curr_ctx(struct fimc_dev *fimc)
+{
+	struct fimc_ctx *ctx = NULL;
+
+	if (fimc->m2m.vm2m)
+		ctx = v4l2_m2m_pool_get_curr_priv(fimc->m2m.vm2m->pool,
+						  fimc->m2m.pool_unit);
+	if (ctx == NULL)
+		ctx = v4l2_m2m_get_curr_priv(fimc->m2m.m2m_dev);
+	return ctx;
+}
+
 /* Complete the transaction which has been scheduled for execution. */
 static int fimc_m2m_shutdown(struct fimc_ctx *ctx)
 {
@@ -329,11 +348,44 @@ static int fimc_m2m_shutdown(struct fimc_ctx *ctx)
 	return ret == 0 ? -ETIMEDOUT : ret;
 }
 
+/* Jobs of the virtual device's contexts may run on any of the FIMCs */
+static int fimc_vm2m_pm_get(struct fimc_vm2m_device *vm2m)
+{
+	int i, ret;
+
+	for (i = 0; i < vm2m->num_fimc; i++) {
+		ret = pm_runtime_get_sync(&vm2m->fimc[i]->pdev->dev);
+		if (ret < 0)
+			goto err;
+	}
+	return 0;
+err:
+	pm_runtime_put(&vm2m->fimc[i]->pdev->dev);
+	while (--i >= 0)
+		pm_runtime_put(&vm2m->fimc[i]->pdev->dev);
+	return ret;
+}
+
+static void fimc_vm2m_pm_put(struct fimc_vm2m_device *vm2m)
+{
+	int i;
+
+	for (i = 0; i < vm2m->num_fimc; i++)
+		pm_runtime_put(&vm2m->fimc[i]->pdev->dev);
+}
+
 static int start_streaming(struct vb2_queue *q, unsigned int count)
 {
 	struct fimc_ctx *ctx = q->drv_priv;
 	int ret;
 
+	if (ctx->vm2m) {
+		ret = fimc_vm2m_pm_get(ctx->vm2m);
+		if (!ret)
+			v4l2_m2m_pool_ctx_start(ctx->pool_ctx);
+		return ret;
+	}
+
 	ret = pm_runtime_get_sync(&ctx->fimc_dev->pdev->dev);
 	return ret > 0 ? 0 : ret;
 }
@@ -343,6 +395,15 @@ static int stop_streaming(struct vb2_queue *q)
 	struct fimc_ctx *ctx = q->drv_priv;
 	int ret;
 
+	if (ctx->vm2m) {
+		ret = v4l2_m2m_pool_ctx_stop(ctx->pool_ctx,
+					     FIMC_SHUTDOWN_TIMEOUT);
+		if (ret == -ETIMEDOUT)
+			fimc_m2m_job_finish(ctx, VB2_BUF_STATE_ERROR);
+		fimc_vm2m_pm_put(ctx->vm2m);
+		return 0;
+	}
+
 	ret = fimc_m2m_shutdown(ctx);
 	if (ret == -ETIMEDOUT)
 		fimc_m2m_job_finish(ctx, VB2_BUF_STATE_ERROR);
@@ -425,7 +486,7 @@ static irqreturn_t fimc_irq_handler(int irq, void *priv)
 			wake_up(&fimc->irq_queue);
 			goto out;
 		}
-		ctx = v4l2_m2m_get_curr_priv(fimc->m2m.m2m_dev);
+		ctx = fimc_m2m_get_curr_ctx(fimc);
 		if (ctx != NULL) {
 			spin_unlock(&fimc->slock);
 			fimc_m2m_job_finish(ctx, VB2_BUF_STATE_DONE);
@@ -718,7 +779,9 @@ static int fimc_queue_setup(struct vb2_queue *vq, const struct v4l2_format *fmt,
 	*num_planes = f->fmt->memplanes;
 	for (i = 0; i < f->fmt->memplanes; i++) {
 		sizes[i] = (f->f_width * f->f_height * f->fmt->depth[i]) / 8;
-		allocators[i] = ctx->fimc_dev->alloc_ctx;
+		/* The FIMC of a virtual device's context changes per job */
+		allocators[i] = ctx->vm2m ? ctx->vm2m->fimc[0]->alloc_ctx :
+					    ctx->fimc_dev->alloc_ctx;
 	}
 	return 0;
 }
@@ -752,13 +815,13 @@ static void fimc_buf_queue(struct vb2_buffer *vb)
 static void fimc_lock(struct vb2_queue *vq)
 {
 	struct fimc_ctx *ctx = vb2_get_drv_priv(vq);
-	mutex_lock(&ctx->fimc_dev->lock);
+	mutex_lock(ctx->fh.vdev->lock);
 }
 
 static void fimc_unlock(struct vb2_queue *vq)
 {
 	struct fimc_ctx *ctx = vb2_get_drv_priv(vq);
-	mutex_unlock(&ctx->fimc_dev->lock);
+	mutex_unlock(ctx->fh.vdev->lock);
 }
 
 static struct vb2_ops fimc_qops = {
@@ -780,7 +843,7 @@ static struct vb2_ops fimc_qops = {
 static int __fimc_s_ctrl(struct fimc_ctx *ctx, struct v4l2_ctrl *ctrl)
 {
 	struct fimc_dev *fimc = ctx->fimc_dev;
-	struct samsung_fimc_variant *variant = fimc->variant;
+	struct samsung_fimc_variant *variant = ctx_get_variant(ctx);
 	unsigned int flags = FIMC_DST_FMT | FIMC_SRC_FMT;
 	int ret = 0;
 
@@ -797,7 +860,7 @@ static int __fimc_s_ctrl(struct fimc_ctx *ctx, struct v4l2_ctrl *ctrl)
 		break;
 
 	case V4L2_CID_ROTATE:
-		if (fimc_capture_pending(fimc) ||
+		if ((!ctx->vm2m && fimc_capture_pending(fimc)) ||
 		    (ctx->state & flags) == flags) {
 			ret = fimc_check_scaler_ratio(ctx, ctx->s_frame.width,
 					ctx->s_frame.height, ctx->d_frame.width,
@@ -817,7 +880,8 @@ static int __fimc_s_ctrl(struct fimc_ctx *ctx, struct v4l2_ctrl *ctrl)
 		break;
 	}
 	ctx->state |= FIMC_PARAMS;
-	set_bit(ST_CAPT_APPLY_CFG, &fimc->state);
+	if (!ctx->vm2m)
+		set_bit(ST_CAPT_APPLY_CFG, &fimc->state);
 	return 0;
 }
 
@@ -840,7 +904,7 @@ static const struct v4l2_ctrl_ops fimc_ctrl_ops = {
 
 int fimc_ctrls_create(struct fimc_ctx *ctx)
 {
-	struct samsung_fimc_variant *variant = ctx->fimc_dev->variant;
+	struct samsung_fimc_variant *variant = ctx_get_variant(ctx);
 	unsigned int max_alpha = fimc_get_alpha_mask(ctx->d_frame.fmt);
 
 	if (ctx->ctrls_rdy)
@@ -903,10 +967,9 @@ void fimc_ctrls_activate(struct fimc_ctx *ctx, bool active)
 /* Update maximum value of the alpha color control */
 void fimc_alpha_ctrl_update(struct fimc_ctx *ctx)
 {
-	struct fimc_dev *fimc = ctx->fimc_dev;
 	struct v4l2_ctrl *ctrl = ctx->ctrl_alpha;
 
-	if (ctrl == NULL || !fimc->variant->has_alpha)
+	if (ctrl == NULL || !ctx_get_variant(ctx)->has_alpha)
 		return;
 
 	v4l2_ctrl_lock(ctrl);
@@ -1075,8 +1138,7 @@ struct fimc_fmt *fimc_find_format(const u32 *pixelformat, const u32 *mbus_code,
 
 static int fimc_try_fmt_mplane(struct fimc_ctx *ctx, struct v4l2_format *f)
 {
-	struct fimc_dev *fimc = ctx->fimc_dev;
-	struct samsung_fimc_variant *variant = fimc->variant;
+	struct samsung_fimc_variant *variant = ctx_get_variant(ctx);
 	struct v4l2_pix_format_mplane *pix = &f->fmt.pix_mp;
 	struct fimc_fmt *fmt;
 	u32 max_w, mod_x, mod_y;
@@ -1133,7 +1195,6 @@ static int fimc_m2m_s_fmt_mplane(struct file *file, void *fh,
 				 struct v4l2_format *f)
 {
 	struct fimc_ctx *ctx = fh_to_ctx(fh);
-	struct fimc_dev *fimc = ctx->fimc_dev;
 	struct vb2_queue *vq;
 	struct fimc_frame *frame;
 	struct v4l2_pix_format_mplane *pix;
@@ -1146,7 +1207,7 @@ static int fimc_m2m_s_fmt_mplane(struct file *file, void *fh,
 	vq = v4l2_m2m_get_vq(ctx->m2m_ctx, f->type);
 
 	if (vb2_is_busy(vq)) {
-		v4l2_err(fimc->m2m.vfd, "queue (%d) busy\n", f->type);
+		v4l2_err(ctx->fh.vdev, "queue (%d) busy\n", f->type);
 		return -EBUSY;
 	}
 
@@ -1215,6 +1276,14 @@ static int fimc_m2m_dqbuf(struct file *file, void *fh,
 	return v4l2_m2m_dqbuf(file, ctx->m2m_ctx, buf);
 }
 
+static int fimc_m2m_expbuf(struct file *file, void *fh,
+			   struct v4l2_exportbuffer *eb)
+{
+	struct fimc_ctx *ctx = fh_to_ctx(fh);
+
+	return v4l2_m2m_expbuf(file, ctx->m2m_ctx, eb);
+}
+
 static int fimc_m2m_streamon(struct file *file, void *fh,
 			     enum v4l2_buf_type type)
 {
@@ -1277,13 +1346,13 @@ static int fimc_m2m_g_crop(struct file *file, void *fh, struct v4l2_crop *cr)
 
 static int fimc_m2m_try_crop(struct fimc_ctx *ctx, struct v4l2_crop *cr)
 {
-	struct fimc_dev *fimc = ctx->fimc_dev;
+	struct samsung_fimc_variant *variant = ctx_get_variant(ctx);
 	struct fimc_frame *f;
 	u32 min_size, halign, depth = 0;
 	int i;
 
 	if (cr->c.top < 0 || cr->c.left < 0) {
-		v4l2_err(fimc->m2m.vfd,
+		v4l2_err(ctx->fh.vdev,
 			"doesn't support negative values for top & left\n");
 		return -EINVAL;
 	}
@@ -1295,13 +1364,13 @@ static int fimc_m2m_try_crop(struct fimc_ctx *ctx, struct v4l2_crop *cr)
 		return -EINVAL;
 
 	min_size = (f == &ctx->s_frame) ?
-		fimc->variant->min_inp_pixsize : fimc->variant->min_out_pixsize;
+		variant->min_inp_pixsize : variant->min_out_pixsize;
 
 	/* Get pixel alignment constraints. */
-	if (fimc->variant->min_vsize_align == 1)
+	if (variant->min_vsize_align == 1)
 		halign = fimc_fmt_is_rgb(f->fmt->color) ? 0 : 1;
 	else
-		halign = ffs(fimc->variant->min_vsize_align) - 1;
+		halign = ffs(variant->min_vsize_align) - 1;
 
 	for (i = 0; i < f->fmt->colplanes; i++)
 		depth += f->fmt->depth[i];
@@ -1318,7 +1387,7 @@ static int fimc_m2m_try_crop(struct fimc_ctx *ctx, struct v4l2_crop *cr)
 		cr->c.top = f->o_height - cr->c.height;
 
 	cr->c.left = round_down(cr->c.left, min_size);
-	cr->c.top  = round_down(cr->c.top, fimc->variant->hor_offs_align);
+	cr->c.top  = round_down(cr->c.top, variant->hor_offs_align);
 
 	dbg("l:%d, t:%d, w:%d, h:%d, f_w: %d, f_h: %d",
 	    cr->c.left, cr->c.top, cr->c.width, cr->c.height,
@@ -1330,7 +1399,6 @@ static int fimc_m2m_try_crop(struct fimc_ctx *ctx, struct v4l2_crop *cr)
 static int fimc_m2m_s_crop(struct file *file, void *fh, struct v4l2_crop *cr)
 {
 	struct fimc_ctx *ctx = fh_to_ctx(fh);
-	struct fimc_dev *fimc = ctx->fimc_dev;
 	struct fimc_frame *f;
 	int ret;
 
@@ -1353,7 +1421,7 @@ static int fimc_m2m_s_crop(struct file *file, void *fh, struct v4l2_crop *cr)
 					cr->c.height, ctx->rotation);
 		}
 		if (ret) {
-			v4l2_err(fimc->m2m.vfd, "Out of scaler range\n");
+			v4l2_err(ctx->fh.vdev, "Out of scaler range\n");
 			return -EINVAL;
 		}
 	}
@@ -1388,6 +1456,7 @@ static const struct v4l2_ioctl_ops fimc_m2m_ioctl_ops = {
 
 	.vidioc_qbuf			= fimc_m2m_qbuf,
 	.vidioc_dqbuf			= fimc_m2m_dqbuf,
+	.vidioc_expbuf			= fimc_m2m_expbuf,
 
 	.vidioc_streamon		= fimc_m2m_streamon,
 	.vidioc_streamoff		= fimc_m2m_streamoff,
@@ -1406,7 +1475,7 @@ static int queue_init(void *priv, struct vb2_queue *src_vq,
 
 	memset(src_vq, 0, sizeof(*src_vq));
 	src_vq->type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-	src_vq->io_modes = VB2_MMAP | VB2_USERPTR;
+	src_vq->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
 	src_vq->drv_priv = ctx;
 	src_vq->ops = &fimc_qops;
 	src_vq->mem_ops = &vb2_dma_contig_memops;
@@ -1418,7 +1487,7 @@ static int queue_init(void *priv, struct vb2_queue *src_vq,
 
 	memset(dst_vq, 0, sizeof(*dst_vq));
 	dst_vq->type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-	dst_vq->io_modes = VB2_MMAP | VB2_USERPTR;
+	dst_vq->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
 	dst_vq->drv_priv = ctx;
 	dst_vq->ops = &fimc_qops;
 	dst_vq->mem_ops = &vb2_dma_contig_memops;
@@ -1475,8 +1544,10 @@ static int fimc_m2m_open(struct file *file)
 		goto error_c;
 	}
 
-	if (fimc->m2m.refcnt++ == 0)
+	if (fimc->m2m.refcnt++ == 0) {
 		set_bit(ST_M2M_RUN, &fimc->state);
+		fimc_vm2m_unit_get(fimc);
+	}
 	return 0;
 
 error_c:
@@ -1501,8 +1572,10 @@ static int fimc_m2m_release(struct file *file)
 	v4l2_fh_del(&ctx->fh);
 	v4l2_fh_exit(&ctx->fh);
 
-	if (--fimc->m2m.refcnt <= 0)
+	if (--fimc->m2m.refcnt <= 0) {
 		clear_bit(ST_M2M_RUN, &fimc->state);
+		fimc_vm2m_unit_put(fimc);
+	}
 	kfree(ctx);
 	return 0;
 }
@@ -1598,6 +1671,278 @@ void fimc_unregister_m2m_device(struct fimc_dev *fimc)
 	}
 }
 
+/*
+ * The virtual memory-to-memory device: one video node whose contexts have
+ * their jobs run by whichever FIMC is idle and least loaded. An instance
+ * is taken out of the pool while its own m2m or capture node is in use.
+ */
+static void fimc_vm2m_unit_run(void *unit_priv, void *priv)
+{
+	struct fimc_dev *fimc = unit_priv;
+	struct fimc_ctx *ctx = priv;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctx->slock, flags);
+	if (ctx->fimc_dev != fimc) {
+		/* The previous job ran elsewhere, set up this FIMC fully */
+		ctx->fimc_dev = fimc;
+		ctx->state |= FIMC_PARAMS;
+	}
+	spin_unlock_irqrestore(&ctx->slock, flags);
+
+	fimc_dma_run(ctx);
+}
+
+static int fimc_vm2m_unit_fits(void *unit_priv, void *priv)
+{
+	struct fimc_dev *fimc = unit_priv;
+	struct samsung_fimc_variant *variant = fimc->variant;
+	struct fimc_pix_limit *pl = variant->pix_limit;
+	struct fimc_ctx *ctx = priv;
+	bool rotation = ctx->rotation == 90 || ctx->rotation == 270;
+
+	if (rotation && !variant->has_out_rot)
+		return 0;
+	if (ctx->s_frame.width > pl->scaler_en_w)
+		return 0;
+
+	return ctx->d_frame.width <=
+		(rotation ? pl->out_rot_en_w : pl->out_rot_dis_w);
+}
+
+static struct v4l2_m2m_pool_ops fimc_vm2m_pool_ops = {
+	.unit_run	= fimc_vm2m_unit_run,
+	.unit_fits	= fimc_vm2m_unit_fits,
+};
+
+static void fimc_vm2m_device_run(void *priv)
+{
+	struct fimc_ctx *ctx = priv;
+
+	v4l2_m2m_pool_job_queue(ctx->pool_ctx);
+}
+
+static int fimc_vm2m_job_ready(void *priv)
+{
+	struct fimc_ctx *ctx = priv;
+
+	return v4l2_m2m_pool_job_ready(ctx->pool_ctx);
+}
+
+static void fimc_vm2m_job_abort(void *priv)
+{
+	struct fimc_ctx *ctx = priv;
+
+	v4l2_m2m_pool_job_abort(ctx->pool_ctx);
+}
+
+static struct v4l2_m2m_ops fimc_vm2m_ops = {
+	.device_run	= fimc_vm2m_device_run,
+	.job_ready	= fimc_vm2m_job_ready,
+	.job_abort	= fimc_vm2m_job_abort,
+};
+
+static int fimc_vm2m_open(struct file *file)
+{
+	struct fimc_vm2m_device *vm2m = video_drvdata(file);
+	struct fimc_ctx *ctx;
+	int ret;
+
+	dbg("pid: %d", task_pid_nr(current));
+
+	ctx = kzalloc(sizeof *ctx, GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	v4l2_fh_init(&ctx->fh, vm2m->vfd);
+	ctx->vm2m = vm2m;
+	ctx->fimc_dev = vm2m->fimc[0];
+
+	/* Default color format */
+	ctx->s_frame.fmt = &fimc_formats[0];
+	ctx->d_frame.fmt = &fimc_formats[0];
+
+	ret = fimc_ctrls_create(ctx);
+	if (ret)
+		goto error_fh;
+
+	/* Use separate control handler per file handle */
+	ctx->fh.ctrl_handler = &ctx->ctrl_handler;
+	file->private_data = &ctx->fh;
+	v4l2_fh_add(&ctx->fh);
+
+	/* Setup the device context for memory-to-memory mode */
+	ctx->state = FIMC_CTX_M2M;
+	ctx->flags = 0;
+	ctx->in_path = FIMC_DMA;
+	ctx->out_path = FIMC_DMA;
+	spin_lock_init(&ctx->slock);
+
+	ctx->pool_ctx = v4l2_m2m_pool_ctx_init(vm2m->pool, &fimc_vm2m_ops,
+					       ctx, queue_init);
+	if (IS_ERR(ctx->pool_ctx)) {
+		ret = PTR_ERR(ctx->pool_ctx);
+		goto error_c;
+	}
+	ctx->m2m_ctx = ctx->pool_ctx->m2m_ctx;
+	return 0;
+
+error_c:
+	fimc_ctrls_delete(ctx);
+error_fh:
+	v4l2_fh_del(&ctx->fh);
+	v4l2_fh_exit(&ctx->fh);
+	kfree(ctx);
+	return ret;
+}
+
+static int fimc_vm2m_release(struct file *file)
+{
+	struct fimc_ctx *ctx = fh_to_ctx(file->private_data);
+	struct fimc_vm2m_device *vm2m = ctx->vm2m;
+	struct fimc_dev *fimc;
+	unsigned long flags;
+	int i;
+
+	dbg("pid: %d", task_pid_nr(current));
+
+	v4l2_m2m_pool_ctx_release(ctx->pool_ctx);
+	fimc_ctrls_delete(ctx);
+	v4l2_fh_del(&ctx->fh);
+	v4l2_fh_exit(&ctx->fh);
+
+	/* A new context allocated here must not skip the H/W setup */
+	for (i = 0; i < vm2m->num_fimc; i++) {
+		fimc = vm2m->fimc[i];
+		spin_lock_irqsave(&fimc->slock, flags);
+		if (fimc->m2m.ctx == ctx)
+			fimc->m2m.ctx = NULL;
+		spin_unlock_irqrestore(&fimc->slock, flags);
+	}
+	kfree(ctx);
+	return 0;
+}
+
+static const struct v4l2_file_operations fimc_vm2m_fops = {
+	.owner		= THIS_MODULE,
+	.open		= fimc_vm2m_open,
+	.release	= fimc_vm2m_release,
+	.poll		= fimc_m2m_poll,
+	.unlocked_ioctl	= video_ioctl2,
+	.mmap		= fimc_m2m_mmap,
+};
+
+/* Take the FIMC out of the virtual device's pool, for its own nodes' use */
+void fimc_vm2m_unit_get(struct fimc_dev *fimc)
+{
+	struct fimc_vm2m_device *vm2m = fimc->m2m.vm2m;
+
+	if (vm2m && v4l2_m2m_pool_unit_disable(vm2m->pool,
+			fimc->m2m.pool_unit, FIMC_SHUTDOWN_TIMEOUT))
+		dev_warn(&fimc->pdev->dev, "virtual m2m job timed out\n");
+}
+
+void fimc_vm2m_unit_put(struct fimc_dev *fimc)
+{
+	struct fimc_vm2m_device *vm2m = fimc->m2m.vm2m;
+
+	if (vm2m)
+		v4l2_m2m_pool_unit_enable(vm2m->pool, fimc->m2m.pool_unit);
+}
+
+int fimc_register_vm2m_device(struct fimc_vm2m_device *vm2m,
+			      struct fimc_dev **fimc, int num_fimc,
+			      struct v4l2_device *v4l2_dev)
+{
+	struct samsung_fimc_variant *var, *best;
+	struct video_device *vfd;
+	int i, unit, ret;
+
+	mutex_init(&vm2m->lock);
+	vm2m->pool = v4l2_m2m_pool_init(&fimc_vm2m_pool_ops);
+	if (IS_ERR(vm2m->pool)) {
+		v4l2_err(v4l2_dev, "failed to initialize v4l2-m2m pool\n");
+		ret = PTR_ERR(vm2m->pool);
+		vm2m->pool = NULL;
+		return ret;
+	}
+
+	for (i = 0; i < num_fimc; i++) {
+		if (fimc[i] == NULL)
+			continue;
+		unit = v4l2_m2m_pool_add_unit(vm2m->pool, fimc[i],
+					      dev_name(&fimc[i]->pdev->dev));
+		if (unit < 0)
+			break;
+		fimc[i]->m2m.vm2m = vm2m;
+		fimc[i]->m2m.pool_unit = unit;
+		vm2m->fimc[vm2m->num_fimc++] = fimc[i];
+
+		/* Prefer the output rotator, then the widest scaler input */
+		var = fimc[i]->variant;
+		best = vm2m->variant;
+		if (best == NULL || var->has_out_rot > best->has_out_rot ||
+		    (var->has_out_rot == best->has_out_rot &&
+		     var->pix_limit->scaler_en_w > best->pix_limit->scaler_en_w))
+			vm2m->variant = var;
+	}
+	/* Nothing to dispatch to, don't create the node */
+	if (vm2m->num_fimc == 0) {
+		ret = 0;
+		goto err_pool;
+	}
+
+	vfd = video_device_alloc();
+	if (!vfd) {
+		v4l2_err(v4l2_dev, "Failed to allocate video device\n");
+		ret = -ENOMEM;
+		goto err_pool;
+	}
+
+	vfd->fops	= &fimc_vm2m_fops;
+	vfd->ioctl_ops	= &fimc_m2m_ioctl_ops;
+	vfd->v4l2_dev	= v4l2_dev;
+	vfd->minor	= -1;
+	vfd->release	= video_device_release;
+	vfd->lock	= &vm2m->lock;
+
+	snprintf(vfd->name, sizeof(vfd->name), "%s.vm2m", FIMC_MODULE_NAME);
+	video_set_drvdata(vfd, vm2m);
+	vm2m->vfd = vfd;
+
+	ret = media_entity_init(&vfd->entity, 0, NULL, 0);
+	if (!ret)
+		return 0;
+
+	video_device_release(vfd);
+	vm2m->vfd = NULL;
+err_pool:
+	for (i = 0; i < vm2m->num_fimc; i++)
+		vm2m->fimc[i]->m2m.vm2m = NULL;
+	vm2m->num_fimc = 0;
+	v4l2_m2m_pool_release(vm2m->pool);
+	vm2m->pool = NULL;
+	return ret;
+}
+
+void fimc_unregister_vm2m_device(struct fimc_vm2m_device *vm2m)
+{
+	int i;
+
+	if (vm2m->vfd) {
+		media_entity_cleanup(&vm2m->vfd->entity);
+		/* Can also be called if video device wasn't registered */
+		video_unregister_device(vm2m->vfd);
+		vm2m->vfd = NULL;
+	}
+	for (i = 0; i < vm2m->num_fimc; i++)
+		vm2m->fimc[i]->m2m.vm2m = NULL;
+	vm2m->num_fimc = 0;
+	if (vm2m->pool) {
+		v4l2_m2m_pool_release(vm2m->pool);
+		vm2m->pool = NULL;
+	}
+}
+
 static void fimc_clk_put(struct fimc_dev *fimc)
 {
 	int i;
@@ -1665,7 +2010,7 @@ static int fimc_m2m_resume(struct fimc_dev *fimc)
 	spin_unlock_irqrestore(&fimc->slock, flags);
 
 	if (test_and_clear_bit(ST_M2M_SUSPENDED, &fimc->state))
-		fimc_m2m_job_finish(fimc->m2m.ctx,
+		fimc_m2m_job_finish(fimc_m2m_get_curr_ctx(fimc),
 				    VB2_BUF_STATE_ERROR);
 	return 0;
 }
@@ -23,6 +23,7 @@
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-mem2mem.h>
+#include <media/v4l2-m2m-pool.h>
 #include <media/v4l2-mediabus.h>
 #include <media/s5p_fimc.h>
 
@@ -291,18 +292,43 @@ struct fimc_frame {
 	u8			alpha;
 };
 
+struct fimc_vm2m_device;
+
 /**
  * struct fimc_m2m_device - v4l2 memory-to-memory device data
  * @vfd: the video device node for v4l2 m2m mode
  * @m2m_dev: v4l2 memory-to-memory device data
  * @ctx: hardware context data
  * @refcnt: the reference counter
+ * @vm2m: the virtual mem-to-mem device this instance runs jobs for, or NULL
+ * @pool_unit: index of this instance in the job pool of @vm2m
  */
 struct fimc_m2m_device {
 	struct video_device	*vfd;
 	struct v4l2_m2m_dev	*m2m_dev;
 	struct fimc_ctx		*ctx;
 	int			refcnt;
+	struct fimc_vm2m_device	*vm2m;
+	int			pool_unit;
+};
+
+/**
+ * struct fimc_vm2m_device - memory-to-memory device backed by all FIMCs
+ * @vfd: the video device node
+ * @pool: the pool dispatching the jobs of all contexts to the FIMCs
+ * @fimc: the FIMC instances, indexed by their pool unit number
+ * @num_fimc: number of the FIMC instances in @fimc
+ * @variant: the most capable of the instances' variants, used for
+ *	     the format and control limits of the node
+ * @lock: the mutex serializing ioctls on the node
+ */
+struct fimc_vm2m_device {
+	struct video_device	*vfd;
+	struct v4l2_m2m_pool	*pool;
+	struct fimc_dev		*fimc[FIMC_MAX_DEVS];
+	int			num_fimc;
+	struct samsung_fimc_variant *variant;
+	struct mutex		lock;
 };
 
 #define FIMC_SD_PAD_SINK	0
@@ -483,6 +509,8 @@ struct fimc_dev {
  * @state:		flags to keep track of user configuration
  * @fimc_dev:		the FIMC device this context applies to
  * @m2m_ctx:		memory-to-memory device context
+ * @vm2m:		the virtual mem-to-mem device of the context, or NULL
+ * @pool_ctx:		the job pool context, for contexts of @vm2m
  * @fh:			v4l2 file handle
  * @ctrl_handler:	v4l2 controls handler
  * @ctrl_rotate		image rotation control
@@ -510,6 +538,8 @@ struct fimc_ctx {
 	u32			state;
 	struct fimc_dev		*fimc_dev;
 	struct v4l2_m2m_ctx	*m2m_ctx;
+	struct fimc_vm2m_device	*vm2m;
+	struct v4l2_m2m_pool_ctx *pool_ctx;
 	struct v4l2_fh		fh;
 	struct v4l2_ctrl_handler ctrl_handler;
 	struct v4l2_ctrl	*ctrl_rotate;
@@ -644,6 +674,17 @@ static inline void fimc_hw_set_dma_seq(struct fimc_dev *dev, u32 mask)
 	writel(mask, dev->regs + S5P_CIFCNTSEQ);
 }
 
+/*
+ * The hardware limits to check the user configuration against. A context
+ * of the virtual mem-to-mem device may run on any FIMC instance, so it is
+ * checked against the most capable one; the jobs are only dispatched to
+ * the instances able to run them.
+ */
+static inline struct samsung_fimc_variant *ctx_get_variant(struct fimc_ctx *ctx)
+{
+	return ctx->vm2m ? ctx->vm2m->variant : ctx->fimc_dev->variant;
+}
+
 static inline struct fimc_frame *ctx_get_frame(struct fimc_ctx *ctx,
 					       enum v4l2_buf_type type)
 {
@@ -735,6 +776,12 @@ void fimc_capture_irq_handler(struct fimc_dev *fimc, bool done);
 int fimc_register_m2m_device(struct fimc_dev *fimc,
 			     struct v4l2_device *v4l2_dev);
 void fimc_unregister_m2m_device(struct fimc_dev *fimc);
+int fimc_register_vm2m_device(struct fimc_vm2m_device *vm2m,
+			      struct fimc_dev **fimc, int num_fimc,
+			      struct v4l2_device *v4l2_dev);
+void fimc_unregister_vm2m_device(struct fimc_vm2m_device *vm2m);
+void fimc_vm2m_unit_get(struct fimc_dev *fimc);
+void fimc_vm2m_unit_put(struct fimc_dev *fimc);
 int fimc_register_driver(void);
 void fimc_unregister_driver(void);
 
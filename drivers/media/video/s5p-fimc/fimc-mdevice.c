@@ -346,6 +346,10 @@ static int fimc_md_register_platform_entities(struct fimc_md *fmd)
 				     fimc_register_callback);
 	if (ret)
 		return ret;
+	ret = fimc_register_vm2m_device(&fmd->vm2m, fmd->fimc, FIMC_MAX_DEVS,
+					&fmd->v4l2_dev);
+	if (ret)
+		return ret;
 
 	driver = driver_find(CSIS_DRIVER_NAME, &platform_bus_type);
 	if (driver)
@@ -358,6 +362,7 @@ static void fimc_md_unregister_entities(struct fimc_md *fmd)
 {
 	int i;
 
+	fimc_unregister_vm2m_device(&fmd->vm2m);
 	for (i = 0; i < FIMC_MAX_DEVS; i++) {
 		if (fmd->fimc[i] == NULL)
 			continue;
@@ -405,6 +410,14 @@ static int fimc_md_register_video_nodes(struct fimc_md *fmd)
 			  vdev->name, video_device_node_name(vdev));
 	}
 
+	vdev = fmd->vm2m.vfd;
+	if (!ret && vdev) {
+		ret = video_register_device(vdev, VFL_TYPE_GRABBER, -1);
+		if (!ret)
+			v4l2_info(&fmd->v4l2_dev, "Registered %s as /dev/%s\n",
+				  vdev->name, video_device_node_name(vdev));
+	}
+
 	return ret;
 }
 
@@ -744,6 +757,36 @@ static ssize_t fimc_md_sysfs_store(struct device *dev,
 static DEVICE_ATTR(subdev_conf_mode, S_IWUSR | S_IRUGO,
 		   fimc_md_sysfs_show, fimc_md_sysfs_store);
 
+static ssize_t fimc_md_vm2m_stats_show(struct device *dev,
+				       struct device_attribute *attr, char *buf)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct fimc_md *fmd = platform_get_drvdata(pdev);
+
+	if (fmd->vm2m.pool == NULL)
+		return 0;
+	return v4l2_m2m_pool_show_stats(fmd->vm2m.pool, buf);
+}
+
+static ssize_t fimc_md_vm2m_stats_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct fimc_md *fmd = platform_get_drvdata(pdev);
+
+	if (fmd->vm2m.pool)
+		v4l2_m2m_pool_reset_stats(fmd->vm2m.pool);
+	return count;
+}
+/*
+ * Per FIMC utilization of the virtual mem-to-mem device: jobs run, busy
+ * and queueing time and the busy share since the last reset. Writing
+ * anything resets the counters.
+ */
+static DEVICE_ATTR(vm2m_stats, S_IWUSR | S_IRUGO,
+		   fimc_md_vm2m_stats_show, fimc_md_vm2m_stats_store);
+
 static int __devinit fimc_md_probe(struct platform_device *pdev)
 {
 	struct v4l2_device *v4l2_dev;
@@ -803,10 +846,14 @@ static int __devinit fimc_md_probe(struct platform_device *pdev)
 		goto err3;
 
 	ret = device_create_file(&pdev->dev, &dev_attr_subdev_conf_mode);
-	if (!ret) {
-		platform_set_drvdata(pdev, fmd);
+	if (ret)
+		goto err3;
+	platform_set_drvdata(pdev, fmd);
+	ret = device_create_file(&pdev->dev, &dev_attr_vm2m_stats);
+	if (!ret)
 		return 0;
-	}
+	device_remove_file(&pdev->dev, &dev_attr_subdev_conf_mode);
+	platform_set_drvdata(pdev, NULL);
 err3:
 	media_device_unregister(&fmd->media_dev);
 	fimc_md_put_clocks(fmd);
@@ -822,6 +869,7 @@ static int __devexit fimc_md_remove(struct platform_device *pdev)
 
 	if (!fmd)
 		return 0;
+	device_remove_file(&pdev->dev, &dev_attr_vm2m_stats);
 	device_remove_file(&pdev->dev, &dev_attr_subdev_conf_mode);
 	fimc_md_unregister_entities(fmd);
 	media_device_unregister(&fmd->media_dev);
@@ -62,6 +62,7 @@ struct fimc_sensor_info {
  * @num_sensors: actual number of registered sensors
  * @camclk: external sensor clock information
  * @fimc: array of registered fimc devices
+ * @vm2m: memory-to-memory device dispatching jobs to all fimc devices
  * @media_dev: top level media device
  * @v4l2_dev: top level v4l2_device holding up the subdevs
  * @pdev: platform device this media device is hooked up into
@@ -74,6 +75,7 @@ struct fimc_md {
 	int num_sensors;
 	struct fimc_camclk_info camclk[FIMC_MAX_CAMCLKS];
 	struct fimc_dev *fimc[FIMC_MAX_DEVS];
+	struct fimc_vm2m_device vm2m;
 	struct media_device media_dev;
 	struct v4l2_device v4l2_dev;
 	struct platform_device *pdev;
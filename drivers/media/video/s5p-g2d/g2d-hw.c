@@ -24,22 +24,26 @@ void g2d_reset(struct g2d_dev *d)
 	w(1, SOFT_RESET_REG);
 }
 
-void g2d_set_src_size(struct g2d_dev *d, struct g2d_frame *f)
+void g2d_set_src_rect(struct g2d_dev *d, u32 left, u32 top,
+		      u32 right, u32 bottom)
 {
 	u32 n;
 
-	w(f->stride & 0xFFFF, SRC_STRIDE_REG);
-
-	n = f->o_height & 0xFFF;
+	n = top & 0xFFF;
 	n <<= 16;
-	n |= f->o_width & 0xFFF;
+	n |= left & 0xFFF;
 	w(n, SRC_LEFT_TOP_REG);
 
-	n = f->bottom & 0xFFF;
+	n = bottom & 0xFFF;
 	n <<= 16;
-	n |= f->right & 0xFFF;
+	n |= right & 0xFFF;
 	w(n, SRC_RIGHT_BOTTOM_REG);
+}
 
+void g2d_set_src_size(struct g2d_dev *d, struct g2d_frame *f)
+{
+	w(f->stride & 0xFFFF, SRC_STRIDE_REG);
+	g2d_set_src_rect(d, f->o_width, f->o_height, f->right, f->bottom);
 	w(f->fmt->hw, SRC_COLOR_MODE_REG);
 }
 
@@ -48,22 +52,26 @@ void g2d_set_src_addr(struct g2d_dev *d, dma_addr_t a)
 	w(a, SRC_BASE_ADDR_REG);
 }
 
-void g2d_set_dst_size(struct g2d_dev *d, struct g2d_frame *f)
+void g2d_set_dst_rect(struct g2d_dev *d, u32 left, u32 top,
+		      u32 right, u32 bottom)
 {
 	u32 n;
 
-	w(f->stride & 0xFFFF, DST_STRIDE_REG);
-
-	n = f->o_height & 0xFFF;
+	n = top & 0xFFF;
 	n <<= 16;
-	n |= f->o_width & 0xFFF;
+	n |= left & 0xFFF;
 	w(n, DST_LEFT_TOP_REG);
 
-	n = f->bottom & 0xFFF;
+	n = bottom & 0xFFF;
 	n <<= 16;
-	n |= f->right & 0xFFF;
+	n |= right & 0xFFF;
 	w(n, DST_RIGHT_BOTTOM_REG);
+}
 
+void g2d_set_dst_size(struct g2d_dev *d, struct g2d_frame *f)
+{
+	w(f->stride & 0xFFFF, DST_STRIDE_REG);
+	g2d_set_dst_rect(d, f->o_width, f->o_height, f->right, f->bottom);
 	w(f->fmt->hw, DST_COLOR_MODE_REG);
 }
 
@@ -18,6 +18,7 @@
 #include <linux/slab.h>
 #include <linux/clk.h>
 #include <linux/interrupt.h>
+#include <linux/uaccess.h>
 
 #include <linux/platform_device.h>
 #include <media/v4l2-mem2mem.h>
@@ -142,11 +143,22 @@ static void g2d_buf_queue(struct vb2_buffer *vb)
 	v4l2_m2m_buf_queue(ctx->m2m_ctx, vb);
 }
 
+static void g2d_buf_cleanup(struct vb2_buffer *vb)
+{
+	struct g2d_ctx *ctx = vb2_get_drv_priv(vb->vb2_queue);
+	unsigned int i = vb->v4l2_buf.index;
+
+	if (vb->vb2_queue->type == V4L2_BUF_TYPE_VIDEO_OUTPUT) {
+		kfree(ctx->cmdlist[i]);
+		ctx->cmdlist[i] = NULL;
+	}
+}
 
 static struct vb2_ops g2d_qops = {
 	.queue_setup	= g2d_queue_setup,
 	.buf_prepare	= g2d_buf_prepare,
 	.buf_queue	= g2d_buf_queue,
+	.buf_cleanup	= g2d_buf_cleanup,
 };
 
 static int queue_init(void *priv, struct vb2_queue *src_vq,
@@ -157,7 +169,7 @@ static int queue_init(void *priv, struct vb2_queue *src_vq,
 
 	memset(src_vq, 0, sizeof(*src_vq));
 	src_vq->type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
-	src_vq->io_modes = VB2_MMAP | VB2_USERPTR;
+	src_vq->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
 	src_vq->drv_priv = ctx;
 	src_vq->ops = &g2d_qops;
 	src_vq->mem_ops = &vb2_dma_contig_memops;
@@ -169,7 +181,7 @@ static int queue_init(void *priv, struct vb2_queue *src_vq,
 
 	memset(dst_vq, 0, sizeof(*dst_vq));
 	dst_vq->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	dst_vq->io_modes = VB2_MMAP | VB2_USERPTR;
+	dst_vq->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
 	dst_vq->drv_priv = ctx;
 	dst_vq->ops = &g2d_qops;
 	dst_vq->mem_ops = &vb2_dma_contig_memops;
@@ -244,6 +256,17 @@ static int g2d_s_ctrl(struct v4l2_ctrl *ctrl)
 	return 0;
 }
 
+/* Command lists are checked against the formats, drop them on a change */
+static void g2d_free_cmdlists(struct g2d_ctx *ctx)
+{
+	int i;
+
+	for (i = 0; i < VIDEO_MAX_FRAME; i++) {
+		kfree(ctx->cmdlist[i]);
+		ctx->cmdlist[i] = NULL;
+	}
+}
+
 static const struct v4l2_ctrl_ops g2d_ctrl_ops = {
 	.s_ctrl		= g2d_s_ctrl,
 };
@@ -339,6 +362,7 @@ static int g2d_release(struct file *file)
 	struct g2d_ctx *ctx = fh2ctx(file->private_data);
 
 	v4l2_m2m_ctx_release(ctx->m2m_ctx);
+	g2d_free_cmdlists(ctx);
 	v4l2_ctrl_handler_free(&ctx->ctrl_handler);
 	v4l2_fh_del(&ctx->fh);
 	v4l2_fh_exit(&ctx->fh);
@@ -461,6 +485,7 @@ static int vidioc_s_fmt(struct file *file, void *prv, struct v4l2_format *f)
 	frm->fmt	= fmt;
 	frm->stride	= f->fmt.pix.bytesperline;
 	ctx->source	= SRC_NORMAL;
+	g2d_free_cmdlists(ctx);
 	return 0;
 }
 
@@ -502,6 +527,13 @@ static int vidioc_dqbuf(struct file *file, void *priv, struct v4l2_buffer *buf)
 	return v4l2_m2m_dqbuf(file, ctx->m2m_ctx, buf);
 }
 
+static int vidioc_expbuf(struct file *file, void *priv,
+			 struct v4l2_exportbuffer *eb)
+{
+	struct g2d_ctx *ctx = priv;
+	return v4l2_m2m_expbuf(file, ctx->m2m_ctx, eb);
+}
+
 
 static int vidioc_streamon(struct file *file, void *priv,
 					enum v4l2_buf_type type)
@@ -592,6 +624,98 @@ static int vidioc_s_crop(struct file *file, void *prv, struct v4l2_crop *cr)
 	return 0;
 }
 
+static int g2d_check_rect(struct g2d_frame *f, struct v4l2_rect *r)
+{
+	if (r->left < 0 || r->top < 0 || r->width == 0 || r->height == 0)
+		return -EINVAL;
+	if (r->width > f->width || r->left > f->width - r->width ||
+	    r->height > f->height || r->top > f->height - r->height)
+		return -EINVAL;
+	/* The rectangle registers are only 12 bits wide */
+	if (r->left + r->width > 0xFFF || r->top + r->height > 0xFFF)
+		return -EINVAL;
+	return 0;
+}
+
+static int g2d_check_op(struct g2d_ctx *ctx, struct s5p_g2d_op *op)
+{
+	switch (op->type) {
+	case S5P_G2D_OP_FILL:
+		return g2d_check_rect(&ctx->out, &op->dst);
+	case S5P_G2D_OP_ROP:
+		if (op->rop3 > 0xff)
+			return -EINVAL;
+		if (op->src.width != op->dst.width ||
+		    op->src.height != op->dst.height)
+			return -EINVAL;
+		/* fall through */
+	case S5P_G2D_OP_BLIT:
+		if (g2d_check_rect(&ctx->in, &op->src))
+			return -EINVAL;
+		return g2d_check_rect(&ctx->out, &op->dst);
+	default:
+		return -EINVAL;
+	}
+}
+
+/* Attach a command list to an OUTPUT buffer, see linux/s5p_g2d.h */
+static int g2d_s_cmdlist(struct g2d_ctx *ctx, struct s5p_g2d_cmdlist *c)
+{
+	struct g2d_dev *dev = ctx->dev;
+	struct g2d_cmdlist *cl = NULL;
+	struct vb2_queue *vq;
+	struct vb2_buffer *vb;
+	unsigned int i;
+	int ret;
+
+	vq = v4l2_m2m_get_vq(ctx->m2m_ctx, V4L2_BUF_TYPE_VIDEO_OUTPUT);
+	if (c->index >= vq->num_buffers || c->count > S5P_G2D_MAX_OPS)
+		return -EINVAL;
+	vb = vq->bufs[c->index];
+	if (vb->state == VB2_BUF_STATE_QUEUED ||
+	    vb->state == VB2_BUF_STATE_ACTIVE)
+		return -EBUSY;
+
+	if (c->count) {
+		cl = kmalloc(sizeof(*cl) + c->count * sizeof(cl->ops[0]),
+			     GFP_KERNEL);
+		if (!cl)
+			return -ENOMEM;
+		cl->count = c->count;
+		if (copy_from_user(cl->ops, (void __user *)(unsigned long)c->ops,
+				   c->count * sizeof(cl->ops[0]))) {
+			kfree(cl);
+			return -EFAULT;
+		}
+		for (i = 0; i < cl->count; i++) {
+			ret = g2d_check_op(ctx, &cl->ops[i]);
+			if (ret) {
+				v4l2_err(&dev->v4l2_dev,
+					 "invalid command list entry %u\n", i);
+				kfree(cl);
+				return ret;
+			}
+		}
+	}
+
+	kfree(ctx->cmdlist[c->index]);
+	ctx->cmdlist[c->index] = cl;
+	return 0;
+}
+
+static long vidioc_default(struct file *file, void *priv, bool valid_prio,
+			   int cmd, void *arg)
+{
+	struct g2d_ctx *ctx = priv;
+
+	switch (cmd) {
+	case S5P_G2D_IOC_S_CMDLIST:
+		return g2d_s_cmdlist(ctx, arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
 static void g2d_lock(void *prv)
 {
 	struct g2d_ctx *ctx = prv;
@@ -610,21 +734,67 @@ static void job_abort(void *prv)
 {
 	struct g2d_ctx *ctx = prv;
 	struct g2d_dev *dev = ctx->dev;
+	unsigned long flags;
 	int ret;
 
 	if (dev->curr == 0) /* No job currently running */
 		return;
 
+	/* Stop a command list after the operation in progress */
+	spin_lock_irqsave(&dev->ctrl_lock, flags);
+	dev->cmd_left = 0;
+	spin_unlock_irqrestore(&dev->ctrl_lock, flags);
+
 	ret = wait_event_timeout(dev->irq_queue,
 		dev->curr == 0,
 		msecs_to_jiffies(G2D_TIMEOUT));
 }
 
+/* Program and start one operation of a command list */
+static void g2d_run_op(struct g2d_dev *dev, struct s5p_g2d_op *op)
+{
+	struct v4l2_rect *s = &op->src, *d = &op->dst;
+	u32 cmd = 0;
+
+	g2d_set_dst_rect(dev, d->left, d->top,
+			 d->left + d->width, d->top + d->height);
+
+	switch (op->type) {
+	case S5P_G2D_OP_FILL:
+		g2d_select_src(dev, SRC_FG_COLOR);
+		g2d_set_fg_color(dev, op->color);
+		g2d_set_third_operand(dev, (1 << 4) | 1);
+		g2d_set_rop4(dev, ROP4_PATTERN);
+		break;
+	case S5P_G2D_OP_ROP:
+		/* The pattern is the foreground color */
+		g2d_set_src_rect(dev, s->left, s->top,
+				 s->left + s->width, s->top + s->height);
+		g2d_select_src(dev, SRC_NORMAL);
+		g2d_set_fg_color(dev, op->color);
+		g2d_set_third_operand(dev, (1 << 4) | 1);
+		g2d_set_rop4(dev, op->rop3 << 8 | op->rop3);
+		break;
+	default:
+		g2d_set_src_rect(dev, s->left, s->top,
+				 s->left + s->width, s->top + s->height);
+		g2d_select_src(dev, SRC_NORMAL);
+		g2d_set_third_operand(dev, 0);
+		g2d_set_rop4(dev, ROP4_COPY);
+		if (s->width != d->width || s->height != d->height)
+			cmd |= g2d_cmd_stretch(1);
+		break;
+	}
+	g2d_set_cmd(dev, cmd);
+	g2d_start(dev);
+}
+
 static void device_run(void *prv)
 {
 	struct g2d_ctx *ctx = prv;
 	struct g2d_dev *dev = ctx->dev;
 	struct vb2_buffer *src, *dst;
+	struct g2d_cmdlist *cl;
 	unsigned long flags;
 	u32 cmd = 0;
 	dma_addr_t dma_src, dma_dst;
@@ -661,6 +831,18 @@ static void device_run(void *prv)
 	g2d_set_direction_src_and_mask(dev, ctx->src_direction);
 	g2d_set_direction_dst_and_pattern(dev, ctx->dst_direction);
 
+	/* A command list replaces the single blit: the addresses, formats
+	   and directions set above are shared by all its operations, the
+	   first one is started here and the rest from g2d_isr() */
+	cl = ctx->cmdlist[src->v4l2_buf.index];
+	if (cl) {
+		dev->cmd_op = cl->ops;
+		dev->cmd_left = cl->count - 1;
+		g2d_run_op(dev, dev->cmd_op);
+		spin_unlock_irqrestore(&dev->ctrl_lock, flags);
+		return;
+	}
+
 	/* We set blitting operation to solid if input width and
 	   height is specified to one pixel */
 	if (ctx->in.width == 1 && ctx->in.height == 1) {
@@ -697,10 +879,21 @@ static irqreturn_t g2d_isr(int irq, void *prv)
 	struct vb2_buffer *src, *dst;
 
 	g2d_clear_int(dev);
-	clk_disable(dev->gate);
 
 	BUG_ON(ctx == 0);
 
+	/* Run the whole command list before completing the job */
+	spin_lock(&dev->ctrl_lock);
+	if (dev->cmd_left) {
+		dev->cmd_left--;
+		g2d_run_op(dev, ++dev->cmd_op);
+		spin_unlock(&dev->ctrl_lock);
+		return IRQ_HANDLED;
+	}
+	spin_unlock(&dev->ctrl_lock);
+
+	clk_disable(dev->gate);
+
 	src = v4l2_m2m_src_buf_remove(ctx->m2m_ctx);
 	dst = v4l2_m2m_dst_buf_remove(ctx->m2m_ctx);
 
@@ -743,6 +936,7 @@ static const struct v4l2_ioctl_ops g2d_ioctl_ops = {
 
 	.vidioc_qbuf			= vidioc_qbuf,
 	.vidioc_dqbuf			= vidioc_dqbuf,
+	.vidioc_expbuf			= vidioc_expbuf,
 
 	.vidioc_streamon		= vidioc_streamon,
 	.vidioc_streamoff		= vidioc_streamoff,
@@ -750,6 +944,8 @@ static const struct v4l2_ioctl_ops g2d_ioctl_ops = {
 	.vidioc_g_crop			= vidioc_g_crop,
 	.vidioc_s_crop			= vidioc_s_crop,
 	.vidioc_cropcap			= vidioc_cropcap,
+
+	.vidioc_default			= vidioc_default,
 };
 
 static struct video_device g2d_videodev = {
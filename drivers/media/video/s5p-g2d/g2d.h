@@ -12,6 +12,7 @@
 
 #include <media/v4l2-device.h>
 #include <media/v4l2-ctrls.h>
+#include <linux/s5p_g2d.h>
 
 #define G2D_NAME "s5p-g2d"
 
@@ -28,6 +29,9 @@ struct g2d_dev {
 	struct clk		*clk;
 	struct clk		*gate;
 	struct g2d_ctx		*curr;
+	/* Command list of the running job, see g2d_isr() */
+	struct s5p_g2d_op	*cmd_op;
+	unsigned int		cmd_left;
 	int irq;
 	wait_queue_head_t	irq_queue;
 };
@@ -70,7 +74,13 @@ struct g2d_ctx {
 	u32 dst_direction;
 	u32 source;
 	u32 fg_color;
+	/* Command lists of the OUTPUT buffers, by buffer index */
+	struct g2d_cmdlist	*cmdlist[VIDEO_MAX_FRAME];
+};
 
+struct g2d_cmdlist {
+	unsigned int		count;
+	struct s5p_g2d_op	ops[0];
 };
 
 struct g2d_fmt {
@@ -83,8 +93,12 @@ struct g2d_fmt {
 
 void g2d_reset(struct g2d_dev *d);
 void g2d_set_src_size(struct g2d_dev *d, struct g2d_frame *f);
+void g2d_set_src_rect(struct g2d_dev *d, u32 left, u32 top,
+		      u32 right, u32 bottom);
 void g2d_set_src_addr(struct g2d_dev *d, dma_addr_t a);
 void g2d_set_dst_size(struct g2d_dev *d, struct g2d_frame *f);
+void g2d_set_dst_rect(struct g2d_dev *d, u32 left, u32 top,
+		      u32 right, u32 bottom);
 void g2d_set_dst_addr(struct g2d_dev *d, dma_addr_t a);
 void g2d_start(struct g2d_dev *d);
 void g2d_clear_int(struct g2d_dev *d);
@@ -19,6 +19,7 @@
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
+#include <linux/s5p_jpeg.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
@@ -212,6 +213,11 @@ static inline struct s5p_jpeg_ctx *fh_to_ctx(struct v4l2_fh *fh)
 	return container_of(fh, struct s5p_jpeg_ctx, fh);
 }
 
+static inline struct s5p_jpeg_buf *vb_to_jpeg_buf(struct vb2_buffer *vb)
+{
+	return container_of(vb, struct s5p_jpeg_buf, mb.vb);
+}
+
 static inline void jpeg_set_qtbl(void __iomem *regs, const unsigned char *qtbl,
 		   unsigned long tab, int len)
 {
@@ -568,7 +574,7 @@ static int s5p_jpeg_g_fmt(struct file *file, void *priv, struct v4l2_format *f)
 		return -EINVAL;
 
 	if (f->type == V4L2_BUF_TYPE_VIDEO_CAPTURE &&
-	    ct->mode == S5P_JPEG_DECODE && !ct->hdr_parsed)
+	    ct->mode == S5P_JPEG_DECODE && !ct->hdr_parsed && !ct->batch)
 		return -EINVAL;
 	q_data = get_q_data(ct, f->type);
 	BUG_ON(q_data == NULL);
@@ -797,6 +803,14 @@ static int s5p_jpeg_dqbuf(struct file *file, void *priv,
 	return v4l2_m2m_dqbuf(file, ctx->m2m_ctx, buf);
 }
 
+static int s5p_jpeg_expbuf(struct file *file, void *priv,
+			   struct v4l2_exportbuffer *eb)
+{
+	struct s5p_jpeg_ctx *ctx = fh_to_ctx(priv);
+
+	return v4l2_m2m_expbuf(file, ctx->m2m_ctx, eb);
+}
+
 static int s5p_jpeg_streamon(struct file *file, void *priv,
 			   enum v4l2_buf_type type)
 {
@@ -845,6 +859,58 @@ int s5p_jpeg_g_selection(struct file *file, void *priv,
 	return 0;
 }
 
+static unsigned int s5p_jpeg_v4l2_subsampling(unsigned short subsampling)
+{
+	WARN_ON(subsampling > S5P_SUBSAMPLING_MODE_GRAY);
+	if (subsampling > 2)
+		return V4L2_JPEG_CHROMA_SUBSAMPLING_GRAY;
+	return subsampling;
+}
+
+static int s5p_jpeg_g_image(struct s5p_jpeg_ctx *ctx,
+			    struct s5p_jpeg_image *img)
+{
+	struct vb2_queue *vq;
+	struct s5p_jpeg_buf *buf;
+	struct s5p_jpeg_fmt *fmt = ctx->cap_q.fmt;
+	unsigned short subsampling;
+	unsigned long flags;
+
+	if (ctx->mode != S5P_JPEG_DECODE || !ctx->batch)
+		return -EINVAL;
+
+	vq = v4l2_m2m_get_vq(ctx->m2m_ctx, V4L2_BUF_TYPE_VIDEO_CAPTURE);
+	if (img->index >= vq->num_buffers)
+		return -EINVAL;
+	buf = vb_to_jpeg_buf(vq->bufs[img->index]);
+
+	spin_lock_irqsave(&ctx->jpeg->slock, flags);
+	img->width = buf->w;
+	img->height = buf->h;
+	subsampling = buf->subsampling;
+	spin_unlock_irqrestore(&ctx->jpeg->slock, flags);
+
+	img->bytesperline = img->width;
+	if (fmt->colplanes == 1)
+		img->bytesperline = (img->width * fmt->depth) >> 3;
+	img->subsampling = s5p_jpeg_v4l2_subsampling(subsampling);
+	memset(img->reserved, 0, sizeof(img->reserved));
+	return 0;
+}
+
+static long s5p_jpeg_default(struct file *file, void *priv, bool valid_prio,
+			     int cmd, void *arg)
+{
+	struct s5p_jpeg_ctx *ctx = fh_to_ctx(priv);
+
+	switch (cmd) {
+	case S5P_JPEG_IOC_G_IMAGE:
+		return s5p_jpeg_g_image(ctx, arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
 /*
  * V4L2 controls
  */
@@ -858,12 +924,7 @@ static int s5p_jpeg_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
 	switch (ctrl->id) {
 	case V4L2_CID_JPEG_CHROMA_SUBSAMPLING:
 		spin_lock_irqsave(&jpeg->slock, flags);
-
-		WARN_ON(ctx->subsampling > S5P_SUBSAMPLING_MODE_GRAY);
-		if (ctx->subsampling > 2)
-			ctrl->val = V4L2_JPEG_CHROMA_SUBSAMPLING_GRAY;
-		else
-			ctrl->val = ctx->subsampling;
+		ctrl->val = s5p_jpeg_v4l2_subsampling(ctx->subsampling);
 		spin_unlock_irqrestore(&jpeg->slock, flags);
 		break;
 	}
@@ -876,6 +937,14 @@ static int s5p_jpeg_s_ctrl(struct v4l2_ctrl *ctrl)
 	struct s5p_jpeg_ctx *ctx = ctrl_to_ctx(ctrl);
 	unsigned long flags;
 
+	/* The buffers of either mode do not suit the other */
+	if (ctrl->id == V4L2_CID_S5P_JPEG_BATCH &&
+	    (vb2_is_busy(v4l2_m2m_get_vq(ctx->m2m_ctx,
+					 V4L2_BUF_TYPE_VIDEO_OUTPUT)) ||
+	     vb2_is_busy(v4l2_m2m_get_vq(ctx->m2m_ctx,
+					 V4L2_BUF_TYPE_VIDEO_CAPTURE))))
+		return -EBUSY;
+
 	spin_lock_irqsave(&ctx->jpeg->slock, flags);
 
 	switch (ctrl->id) {
@@ -888,6 +957,9 @@ static int s5p_jpeg_s_ctrl(struct v4l2_ctrl *ctrl)
 	case V4L2_CID_JPEG_CHROMA_SUBSAMPLING:
 		ctx->subsampling = ctrl->val;
 		break;
+	case V4L2_CID_S5P_JPEG_BATCH:
+		ctx->batch = ctrl->val;
+		break;
 	}
 
 	spin_unlock_irqrestore(&ctx->jpeg->slock, flags);
@@ -899,12 +971,23 @@ static const struct v4l2_ctrl_ops s5p_jpeg_ctrl_ops = {
 	.s_ctrl			= s5p_jpeg_s_ctrl,
 };
 
+static const struct v4l2_ctrl_config s5p_jpeg_batch_ctrl = {
+	.ops	= &s5p_jpeg_ctrl_ops,
+	.id	= V4L2_CID_S5P_JPEG_BATCH,
+	.name	= "Batched Decoding",
+	.type	= V4L2_CTRL_TYPE_BOOLEAN,
+	.min	= 0,
+	.max	= 1,
+	.step	= 1,
+	.def	= 0,
+};
+
 static int s5p_jpeg_controls_create(struct s5p_jpeg_ctx *ctx)
 {
 	unsigned int mask = ~0x27; /* 444, 422, 420, GRAY */
 	struct v4l2_ctrl *ctrl;
 
-	v4l2_ctrl_handler_init(&ctx->ctrl_handler, 3);
+	v4l2_ctrl_handler_init(&ctx->ctrl_handler, 4);
 
 	if (ctx->mode == S5P_JPEG_ENCODE) {
 		v4l2_ctrl_new_std(&ctx->ctrl_handler, &s5p_jpeg_ctrl_ops,
@@ -922,6 +1005,10 @@ static int s5p_jpeg_controls_create(struct s5p_jpeg_ctx *ctx)
 				      V4L2_JPEG_CHROMA_SUBSAMPLING_GRAY, mask,
 				      V4L2_JPEG_CHROMA_SUBSAMPLING_422);
 
+	if (ctx->mode == S5P_JPEG_DECODE)
+		v4l2_ctrl_new_custom(&ctx->ctrl_handler, &s5p_jpeg_batch_ctrl,
+				     NULL);
+
 	if (ctx->ctrl_handler.error)
 		return ctx->ctrl_handler.error;
 
@@ -951,11 +1038,14 @@ static const struct v4l2_ioctl_ops s5p_jpeg_ioctl_ops = {
 
 	.vidioc_qbuf			= s5p_jpeg_qbuf,
 	.vidioc_dqbuf			= s5p_jpeg_dqbuf,
+	.vidioc_expbuf			= s5p_jpeg_expbuf,
 
 	.vidioc_streamon		= s5p_jpeg_streamon,
 	.vidioc_streamoff		= s5p_jpeg_streamoff,
 
 	.vidioc_g_selection		= s5p_jpeg_g_selection,
+
+	.vidioc_default			= s5p_jpeg_default,
 };
 
 /*
@@ -1043,7 +1133,7 @@ static int s5p_jpeg_job_ready(void *priv)
 {
 	struct s5p_jpeg_ctx *ctx = priv;
 
-	if (ctx->mode == S5P_JPEG_DECODE)
+	if (ctx->mode == S5P_JPEG_DECODE && !ctx->batch)
 		return ctx->hdr_parsed;
 	return 1;
 }
@@ -1080,9 +1170,10 @@ static int s5p_jpeg_queue_setup(struct vb2_queue *vq,
 
 	/*
 	 * header is parsed during decoding and parsed information stored
-	 * in the context so we do not allow another buffer to overwrite it
+	 * in the context so we do not allow another buffer to overwrite it,
+	 * unless in batch mode, where it is stored with each buffer
 	 */
-	if (ctx->mode == S5P_JPEG_DECODE)
+	if (ctx->mode == S5P_JPEG_DECODE && !ctx->batch)
 		count = 1;
 
 	*nbuffers = count;
@@ -1101,6 +1192,17 @@ static int s5p_jpeg_buf_prepare(struct vb2_buffer *vb)
 	q_data = get_q_data(ctx, vb->vb2_queue->type);
 	BUG_ON(q_data == NULL);
 
+	/*
+	 * The decoder parses the header of a source buffer in buf_queue;
+	 * imported DMABUF planes have no kernel mapping to parse it from
+	 */
+	if (ctx->mode == S5P_JPEG_DECODE &&
+	    vb->vb2_queue->type == V4L2_BUF_TYPE_VIDEO_OUTPUT &&
+	    !vb2_plane_vaddr(vb, 0)) {
+		pr_err("%s source buffer has no kernel mapping\n", __func__);
+		return -EINVAL;
+	}
+
 	if (vb2_plane_size(vb, 0) < q_data->size) {
 		pr_err("%s data will not fit into plane (%lu < %lu)\n",
 				__func__, vb2_plane_size(vb, 0),
@@ -1113,36 +1215,76 @@ static int s5p_jpeg_buf_prepare(struct vb2_buffer *vb)
 	return 0;
 }
 
+/*
+ * In batch mode the capture format stays as set by the application and
+ * every source buffer keeps the size of its own image, which has to fit
+ * into the capture buffers
+ */
+static bool s5p_jpeg_batch_fit(struct s5p_jpeg_ctx *ctx,
+			       struct vb2_buffer *vb,
+			       struct s5p_jpeg_q_data *hdr)
+{
+	struct s5p_jpeg_buf *buf = vb_to_jpeg_buf(vb);
+	struct s5p_jpeg_fmt *fmt = ctx->cap_q.fmt;
+
+	buf->w = hdr->w;
+	buf->h = hdr->h;
+	jpeg_bound_align_image(&buf->w, S5P_JPEG_MIN_WIDTH,
+			       S5P_JPEG_MAX_WIDTH, fmt->h_align,
+			       &buf->h, S5P_JPEG_MIN_HEIGHT,
+			       S5P_JPEG_MAX_HEIGHT, fmt->v_align);
+	buf->size = buf->w * buf->h * fmt->depth >> 3;
+
+	return buf->w >= hdr->w && buf->h >= hdr->h &&
+	       buf->size <= ctx->cap_q.size;
+}
+
+/* Outside of batch mode the header sets the formats of the context */
+static void s5p_jpeg_set_hdr(struct s5p_jpeg_ctx *ctx,
+			     struct s5p_jpeg_q_data *hdr)
+{
+	struct s5p_jpeg_q_data *q_data;
+
+	q_data = &ctx->out_q;
+	q_data->w = hdr->w;
+	q_data->h = hdr->h;
+
+	q_data = &ctx->cap_q;
+	q_data->w = hdr->w;
+	q_data->h = hdr->h;
+
+	jpeg_bound_align_image(&q_data->w, S5P_JPEG_MIN_WIDTH,
+			       S5P_JPEG_MAX_WIDTH, q_data->fmt->h_align,
+			       &q_data->h, S5P_JPEG_MIN_HEIGHT,
+			       S5P_JPEG_MAX_HEIGHT, q_data->fmt->v_align
+			      );
+	q_data->size = q_data->w * q_data->h * q_data->fmt->depth >> 3;
+}
+
 static void s5p_jpeg_buf_queue(struct vb2_buffer *vb)
 {
 	struct s5p_jpeg_ctx *ctx = vb2_get_drv_priv(vb->vb2_queue);
 
 	if (ctx->mode == S5P_JPEG_DECODE &&
 	    vb->vb2_queue->type == V4L2_BUF_TYPE_VIDEO_OUTPUT) {
-		struct s5p_jpeg_q_data tmp, *q_data;
-		ctx->hdr_parsed = s5p_jpeg_parse_hdr(&tmp,
+		struct s5p_jpeg_q_data tmp;
+		bool parsed;
+
+		parsed = s5p_jpeg_parse_hdr(&tmp,
 		     (unsigned long)vb2_plane_vaddr(vb, 0),
 		     min((unsigned long)ctx->out_q.size,
 			 vb2_get_plane_payload(vb, 0)));
-		if (!ctx->hdr_parsed) {
+		if (ctx->batch) {
+			parsed = parsed && s5p_jpeg_batch_fit(ctx, vb, &tmp);
+		} else {
+			ctx->hdr_parsed = parsed;
+			if (parsed)
+				s5p_jpeg_set_hdr(ctx, &tmp);
+		}
+		if (!parsed) {
 			vb2_buffer_done(vb, VB2_BUF_STATE_ERROR);
 			return;
 		}
-
-		q_data = &ctx->out_q;
-		q_data->w = tmp.w;
-		q_data->h = tmp.h;
-
-		q_data = &ctx->cap_q;
-		q_data->w = tmp.w;
-		q_data->h = tmp.h;
-
-		jpeg_bound_align_image(&q_data->w, S5P_JPEG_MIN_WIDTH,
-				       S5P_JPEG_MAX_WIDTH, q_data->fmt->h_align,
-				       &q_data->h, S5P_JPEG_MIN_HEIGHT,
-				       S5P_JPEG_MAX_HEIGHT, q_data->fmt->v_align
-				      );
-		q_data->size = q_data->w * q_data->h * q_data->fmt->depth >> 3;
 	}
 	if (ctx->m2m_ctx)
 		v4l2_m2m_buf_queue(ctx->m2m_ctx, vb);
@@ -1199,9 +1341,9 @@ static int queue_init(void *priv, struct vb2_queue *src_vq,
 
 	memset(src_vq, 0, sizeof(*src_vq));
 	src_vq->type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
-	src_vq->io_modes = VB2_MMAP | VB2_USERPTR;
+	src_vq->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
 	src_vq->drv_priv = ctx;
-	src_vq->buf_struct_size = sizeof(struct v4l2_m2m_buffer);
+	src_vq->buf_struct_size = sizeof(struct s5p_jpeg_buf);
 	src_vq->ops = &s5p_jpeg_qops;
 	src_vq->mem_ops = &vb2_dma_contig_memops;
 
@@ -1211,9 +1353,9 @@ static int queue_init(void *priv, struct vb2_queue *src_vq,
 
 	memset(dst_vq, 0, sizeof(*dst_vq));
 	dst_vq->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	dst_vq->io_modes = VB2_MMAP | VB2_USERPTR;
+	dst_vq->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
 	dst_vq->drv_priv = ctx;
-	dst_vq->buf_struct_size = sizeof(struct v4l2_m2m_buffer);
+	dst_vq->buf_struct_size = sizeof(struct s5p_jpeg_buf);
 	dst_vq->ops = &s5p_jpeg_qops;
 	dst_vq->mem_ops = &vb2_dma_contig_memops;
 
@@ -1263,6 +1405,17 @@ static irqreturn_t s5p_jpeg_irq(int irq, void *dev_id)
 		payload_size = jpeg_compressed_size(jpeg->regs);
 	}
 
+	if (curr_ctx->mode == S5P_JPEG_DECODE && curr_ctx->batch) {
+		struct s5p_jpeg_buf *src = vb_to_jpeg_buf(src_buf);
+		struct s5p_jpeg_buf *dst = vb_to_jpeg_buf(dst_buf);
+
+		dst->w = src->w;
+		dst->h = src->h;
+		dst->size = src->size;
+		dst->subsampling = jpeg_get_subsampling_mode(jpeg->regs);
+		vb2_set_plane_payload(dst_buf, 0, src->size);
+	}
+
 	v4l2_m2m_buf_done(src_buf, state);
 	if (curr_ctx->mode == S5P_JPEG_ENCODE)
 		vb2_set_plane_payload(dst_buf, 0, payload_size);
@@ -16,6 +16,7 @@
 #include <media/v4l2-device.h>
 #include <media/v4l2-fh.h>
 #include <media/v4l2-ctrls.h>
+#include <media/v4l2-mem2mem.h>
 
 #define S5P_JPEG_M2M_NAME		"s5p-jpeg"
 
@@ -121,6 +122,8 @@ struct s5p_jpeg_q_data {
  * @out_q:		source (output) queue information
  * @cap_fmt:		destination (capture) queue queue information
  * @hdr_parsed:		set if header has been parsed during decompression
+ * @batch:		decompress a series of images without renegotiating
+ *			the formats, see V4L2_CID_S5P_JPEG_BATCH
  * @ctrl_handler:	controls handler
  */
 struct s5p_jpeg_ctx {
@@ -134,9 +137,26 @@ struct s5p_jpeg_ctx {
 	struct s5p_jpeg_q_data	cap_q;
 	struct v4l2_fh		fh;
 	bool			hdr_parsed;
+	bool			batch;
 	struct v4l2_ctrl_handler ctrl_handler;
 };
 
+/**
+ * s5p_jpeg_buf - videobuf2 buffer with the image it holds in batch mode
+ * @mb:			mem2mem buffer, must be first
+ * @w:			image width, aligned as the capture format
+ * @h:			image height, aligned as the capture format
+ * @size:		decoded image size in bytes
+ * @subsampling:	subsampling of the decoded image (capture only)
+ */
+struct s5p_jpeg_buf {
+	struct v4l2_m2m_buffer	mb;
+	u32			w;
+	u32			h;
+	u32			size;
+	unsigned short		subsampling;
+};
+
 /**
  * s5p_jpeg_buffer - description of memory containing input JPEG data
  * @size:	buffer size
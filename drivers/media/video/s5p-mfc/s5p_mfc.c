@@ -12,8 +12,10 @@
 
 #include <linux/clk.h>
 #include <linux/delay.h>
+#include <linux/dma-contiguous.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/sched.h>
@@ -120,6 +122,9 @@ static void s5p_mfc_watchdog_worker(struct work_struct *work)
 		clear_work_bit(ctx);
 		wake_up_ctx(ctx, S5P_FIMV_R2H_CMD_ERR_RET, 0);
 	}
+	spin_lock(&dev->condlock);
+	s5p_mfc_sched_done(&dev->sched, ktime_to_us(ktime_get()));
+	spin_unlock(&dev->condlock);
 	clear_bit(0, &dev->hw_lock);
 	spin_unlock_irqrestore(&dev->irqlock, flags);
 	/* Double check if there is at least one instance running.
@@ -345,6 +350,10 @@ static void s5p_mfc_handle_frame(struct s5p_mfc_ctx *ctx,
 			ctx->consumed_stream = 0;
 			list_del(&src_buf->list);
 			ctx->src_queue_cnt--;
+			spin_lock(&dev->condlock);
+			s5p_mfc_sched_frame_done(&dev->sched, ctx->num,
+				ktime_us_delta(ktime_get(), src_buf->queued));
+			spin_unlock(&dev->condlock);
 			if (s5p_mfc_err_dec(err) > 0)
 				vb2_buffer_done(src_buf->b, VB2_BUF_STATE_ERROR);
 			else
@@ -550,6 +559,10 @@ static irqreturn_t s5p_mfc_irq(int irq, void *priv)
 	mfc_debug_enter();
 	/* Reset the timeout watchdog */
 	atomic_set(&dev->watchdog_cnt, 0);
+	/* Charge the command that has just finished to its context */
+	spin_lock(&dev->condlock);
+	s5p_mfc_sched_done(&dev->sched, ktime_to_us(ktime_get()));
+	spin_unlock(&dev->condlock);
 	ctx = dev->ctx[dev->curr_ctx];
 	/* Get the reason of interrupt and the error code */
 	reason = s5p_mfc_get_int_reason();
@@ -674,6 +687,7 @@ static int s5p_mfc_open(struct file *file)
 	/* Mark context as idle */
 	spin_lock_irqsave(&dev->condlock, flags);
 	clear_bit(ctx->num, &dev->ctx_work_bits);
+	s5p_mfc_sched_ctx_init(&dev->sched, ctx->num);
 	spin_unlock_irqrestore(&dev->condlock, flags);
 	dev->ctx[ctx->num] = ctx;
 	if (s5p_mfc_get_node_type(file) == MFCNODE_DECODER) {
@@ -728,10 +742,12 @@ static int s5p_mfc_open(struct file *file)
 	q->type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
 	q->drv_priv = &ctx->fh;
 	if (s5p_mfc_get_node_type(file) == MFCNODE_DECODER) {
+		/* DPBs are registered in buf_init, which only runs at REQBUFS
+		 * for MMAP buffers */
 		q->io_modes = VB2_MMAP;
 		q->ops = get_dec_queue_ops();
 	} else if (s5p_mfc_get_node_type(file) == MFCNODE_ENCODER) {
-		q->io_modes = VB2_MMAP | VB2_USERPTR;
+		q->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
 		q->ops = get_enc_queue_ops();
 	} else {
 		ret = -ENOENT;
@@ -749,10 +765,10 @@ static int s5p_mfc_open(struct file *file)
 	q->io_modes = VB2_MMAP;
 	q->drv_priv = &ctx->fh;
 	if (s5p_mfc_get_node_type(file) == MFCNODE_DECODER) {
-		q->io_modes = VB2_MMAP;
+		q->io_modes = VB2_MMAP | VB2_DMABUF;
 		q->ops = get_dec_queue_ops();
 	} else if (s5p_mfc_get_node_type(file) == MFCNODE_ENCODER) {
-		q->io_modes = VB2_MMAP | VB2_USERPTR;
+		q->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
 		q->ops = get_enc_queue_ops();
 	} else {
 		ret = -ENOENT;
@@ -939,6 +955,98 @@ static int match_child(struct device *dev, void *data)
 	return !strcmp(dev_name(dev), (char *)data);
 }
 
+static const char *s5p_mfc_type_name(struct s5p_mfc_ctx *ctx)
+{
+	return ctx->type == MFCINST_DECODER ? "decoder" : "encoder";
+}
+
+static ssize_t s5p_mfc_sched_stats_show(struct device *d,
+				struct device_attribute *attr, char *buf)
+{
+	struct s5p_mfc_dev *dev = platform_get_drvdata(to_platform_device(d));
+	struct s5p_mfc_sched_stats st;
+	unsigned int weight;
+	unsigned long flags;
+	ssize_t n = 0;
+	int i;
+
+	mutex_lock(&dev->mfc_mutex);
+	for (i = 0; i < MFC_NUM_CONTEXTS; i++) {
+		if (!dev->ctx[i])
+			continue;
+		spin_lock_irqsave(&dev->condlock, flags);
+		st = dev->sched.stats[i];
+		weight = dev->sched.weight[i];
+		spin_unlock_irqrestore(&dev->condlock, flags);
+		n += scnprintf(buf + n, PAGE_SIZE - n,
+			"%d %s: weight %u, %u runs, busy %llu us (max %u), "
+			"%u frames, latency %llu us (max %u), "
+			"queue %llu (max %u)\n",
+			i, s5p_mfc_type_name(dev->ctx[i]), weight, st.runs,
+			st.busy_us, st.max_busy_us, st.frames,
+			st.frames ? div_u64(st.latency_us, st.frames) : 0,
+			st.max_latency_us,
+			st.runs ? div_u64(st.depth, st.runs) : 0,
+			st.max_depth);
+	}
+	mutex_unlock(&dev->mfc_mutex);
+	return n;
+}
+
+static ssize_t s5p_mfc_sched_stats_store(struct device *d,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct s5p_mfc_dev *dev = platform_get_drvdata(to_platform_device(d));
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->condlock, flags);
+	s5p_mfc_sched_reset_stats(&dev->sched);
+	spin_unlock_irqrestore(&dev->condlock, flags);
+	return count;
+}
+/*
+ * Per context scheduling weight, commands run and hardware time used,
+ * and for decoders the average time from queueing a stream buffer to its
+ * completion and the average source queue depth. Writing anything resets
+ * the counters.
+ */
+static DEVICE_ATTR(sched_stats, S_IWUSR | S_IRUGO,
+		   s5p_mfc_sched_stats_show, s5p_mfc_sched_stats_store);
+
+static ssize_t s5p_mfc_mem_stats_show(struct device *d,
+				struct device_attribute *attr, char *buf)
+{
+	struct s5p_mfc_dev *dev = platform_get_drvdata(to_platform_device(d));
+	struct device *port[] = { dev->mem_dev_l, dev->mem_dev_r };
+	static const char * const name[] = { "l", "r" };
+	struct dma_contiguous_stats st;
+	ssize_t n = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(port); i++) {
+		if (dma_contiguous_get_stats(port[i], &st))
+			continue;
+		n += scnprintf(buf + n, PAGE_SIZE - n,
+			"%s: %lu KiB, used %lu KiB (max %lu), free %lu KiB, "
+			"%u allocs, %u failed, %u busy, "
+			"reclaim %llu us (last %u, max %u)\n",
+			name[i], st.size >> 10, st.used >> 10,
+			st.max_used >> 10, (st.size - st.used) >> 10,
+			st.allocs, st.fails, st.busy,
+			st.allocs ? div_u64(st.total_us, st.allocs) : 0,
+			st.last_us, st.max_us);
+	}
+	return n;
+}
+/*
+ * Usage of the contiguous areas of both memory ports. Whatever is free is
+ * used for movable pages, such as the page cache, until the MFC needs it
+ * back; the reclaim times are those of the allocations from each area,
+ * which include migrating those pages out.
+ */
+static DEVICE_ATTR(mem_stats, S_IRUGO, s5p_mfc_mem_stats_show, NULL);
+
 /* MFC probe function */
 static int s5p_mfc_probe(struct platform_device *pdev)
 {
@@ -956,6 +1064,7 @@ static int s5p_mfc_probe(struct platform_device *pdev)
 
 	spin_lock_init(&dev->irqlock);
 	spin_lock_init(&dev->condlock);
+	s5p_mfc_sched_init(&dev->sched);
 	dev->plat_dev = pdev;
 	if (!dev->plat_dev) {
 		dev_err(&pdev->dev, "No platform data specified\n");
@@ -1094,6 +1203,11 @@ static int s5p_mfc_probe(struct platform_device *pdev)
 	dev->watchdog_timer.data = (unsigned long)dev;
 	dev->watchdog_timer.function = s5p_mfc_watchdog;
 
+	if (device_create_file(&pdev->dev, &dev_attr_sched_stats))
+		mfc_err("Failed to create the scheduler statistics file\n");
+	if (device_create_file(&pdev->dev, &dev_attr_mem_stats))
+		mfc_err("Failed to create the memory statistics file\n");
+
 	pr_debug("%s--\n", __func__);
 	return 0;
 
@@ -1138,6 +1252,8 @@ static int __devexit s5p_mfc_remove(struct platform_device *pdev)
 
 	v4l2_info(&dev->v4l2_dev, "Removing %s\n", pdev->name);
 
+	device_remove_file(&pdev->dev, &dev_attr_mem_stats);
+	device_remove_file(&pdev->dev, &dev_attr_sched_stats);
 	del_timer_sync(&dev->watchdog_timer);
 	flush_workqueue(dev->watchdog_workqueue);
 	destroy_workqueue(dev->watchdog_workqueue);
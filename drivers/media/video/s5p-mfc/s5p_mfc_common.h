@@ -17,6 +17,8 @@
 #define S5P_MFC_COMMON_H_
 
 #include "regs-mfc.h"
+#include "s5p_mfc_sched.h"
+#include <linux/ktime.h>
 #include <linux/platform_device.h>
 #include <linux/videodev2.h>
 #include <media/v4l2-ctrls.h>
@@ -61,7 +63,7 @@ static inline dma_addr_t s5p_mfc_mem_cookie(void *a, void *b)
 /* MFC definitions */
 #define MFC_MAX_EXTRA_DPB       5
 #define MFC_MAX_BUFFERS		32
-#define MFC_NUM_CONTEXTS	4
+/* MFC_NUM_CONTEXTS is in s5p_mfc_sched.h */
 /* Interrupt timeout */
 #define MFC_INT_TIMEOUT		2000
 /* Busy wait timeout */
@@ -154,6 +156,7 @@ struct s5p_mfc_ctx;
 struct s5p_mfc_buf {
 	struct list_head list;
 	struct vb2_buffer *b;
+	ktime_t queued;
 	union {
 		struct {
 			size_t luma;
@@ -205,6 +208,8 @@ struct s5p_mfc_pm {
  * @ctx:		array of driver contexts
  * @curr_ctx:		number of the currently running context
  * @ctx_work_bits:	used to mark which contexts are waiting for hardware
+ * @sched:		chooses which of the waiting contexts runs next,
+ *			protected by condlock
  * @watchdog_cnt:	counter for the watchdog
  * @watchdog_workqueue:	workqueue for the watchdog
  * @watchdog_work:	worker for the watchdog
@@ -241,6 +246,7 @@ struct s5p_mfc_dev {
 	struct s5p_mfc_ctx *ctx[MFC_NUM_CONTEXTS];
 	int curr_ctx;
 	unsigned long ctx_work_bits;
+	struct s5p_mfc_sched sched;
 	atomic_t watchdog_cnt;
 	struct timer_list watchdog_timer;
 	struct workqueue_struct *watchdog_workqueue;
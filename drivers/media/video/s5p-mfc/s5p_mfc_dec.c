@@ -177,6 +177,15 @@ static struct mfc_control controls[] = {
 		.default_value = 0,
 		.is_volatile = 1,
 	},
+	{
+		.id = V4L2_CID_MPEG_MFC51_VIDEO_SCHED_WEIGHT,
+		.type = V4L2_CTRL_TYPE_INTEGER,
+		.name = "Scheduling Weight",
+		.minimum = 1,
+		.maximum = MFC_SCHED_WEIGHT_MAX,
+		.step = 1,
+		.default_value = MFC_SCHED_WEIGHT_DEF,
+	},
 };
 
 #define NUM_CTRLS ARRAY_SIZE(controls)
@@ -426,8 +435,16 @@ static int vidioc_reqbufs(struct file *file, void *priv,
 	int ret = 0;
 	unsigned long flags;
 
-	if (reqbufs->memory != V4L2_MEMORY_MMAP) {
-		mfc_err("Only V4L2_MEMORY_MAP is supported\n");
+	if (reqbufs->memory != V4L2_MEMORY_MMAP &&
+	    reqbufs->memory != V4L2_MEMORY_DMABUF) {
+		mfc_err("Only V4L2_MEMORY_MAP and V4L2_MEMORY_DMABUF are supported\n");
+		return -EINVAL;
+	}
+	/* The DPBs are handed to the firmware from buf_init, which vb2 only
+	 * calls at REQBUFS time for MMAP buffers */
+	if (reqbufs->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE &&
+	    reqbufs->memory != V4L2_MEMORY_MMAP) {
+		mfc_err("Only V4L2_MEMORY_MAP is supported on capture\n");
 		return -EINVAL;
 	}
 	if (reqbufs->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
@@ -526,8 +543,14 @@ static int vidioc_querybuf(struct file *file, void *priv,
 	int ret;
 	int i;
 
-	if (buf->memory != V4L2_MEMORY_MMAP) {
-		mfc_err("Only mmaped buffers can be used\n");
+	if (buf->memory != V4L2_MEMORY_MMAP &&
+	    buf->memory != V4L2_MEMORY_DMABUF) {
+		mfc_err("Only mmaped and dmabuf buffers can be used\n");
+		return -EINVAL;
+	}
+	if (buf->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE &&
+	    buf->memory != V4L2_MEMORY_MMAP) {
+		mfc_err("Only mmaped buffers can be used on capture\n");
 		return -EINVAL;
 	}
 	mfc_debug(2, "State: %d, buf->type: %d\n", ctx->state, buf->type);
@@ -579,6 +602,19 @@ static int vidioc_dqbuf(struct file *file, void *priv, struct v4l2_buffer *buf)
 	return -EINVAL;
 }
 
+/* Export DMA buffer */
+static int vidioc_expbuf(struct file *file, void *priv,
+	struct v4l2_exportbuffer *eb)
+{
+	struct s5p_mfc_ctx *ctx = fh_to_ctx(priv);
+
+	if (eb->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE)
+		return vb2_expbuf(&ctx->vq_src, eb);
+	if (eb->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+		return vb2_expbuf(&ctx->vq_dst, eb);
+	return -EINVAL;
+}
+
 /* Stream on */
 static int vidioc_streamon(struct file *file, void *priv,
 			   enum v4l2_buf_type type)
@@ -639,6 +675,8 @@ static int vidioc_streamoff(struct file *file, void *priv,
 static int s5p_mfc_dec_s_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct s5p_mfc_ctx *ctx = ctrl_to_ctx(ctrl);
+	unsigned long flags;
+
 	switch (ctrl->id) {
 	case V4L2_CID_MPEG_MFC51_VIDEO_DECODER_H264_DISPLAY_DELAY:
 		ctx->display_delay = ctrl->val;
@@ -655,6 +693,11 @@ static int s5p_mfc_dec_s_ctrl(struct v4l2_ctrl *ctrl)
 	case V4L2_CID_CODEC_FRAME_TAG:
 		ctx->frame_tag = ctrl->val;
 		break;
+	case V4L2_CID_MPEG_MFC51_VIDEO_SCHED_WEIGHT:
+		spin_lock_irqsave(&ctx->dev->condlock, flags);
+		s5p_mfc_sched_set_weight(&ctx->dev->sched, ctx->num, ctrl->val);
+		spin_unlock_irqrestore(&ctx->dev->condlock, flags);
+		break;
 	default:
 		mfc_err("Invalid control 0x%08x\n", ctrl->id);
 		return -EINVAL;
@@ -759,6 +802,7 @@ static const struct v4l2_ioctl_ops s5p_mfc_dec_ioctl_ops = {
 	.vidioc_querybuf = vidioc_querybuf,
 	.vidioc_qbuf = vidioc_qbuf,
 	.vidioc_dqbuf = vidioc_dqbuf,
+	.vidioc_expbuf = vidioc_expbuf,
 	.vidioc_streamon = vidioc_streamon,
 	.vidioc_streamoff = vidioc_streamoff,
 	.vidioc_g_crop = vidioc_g_crop,
@@ -951,6 +995,7 @@ static void s5p_mfc_buf_queue(struct vb2_buffer *vb)
 	if (vq->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
 		mfc_buf = &ctx->src_bufs[vb->v4l2_buf.index];
 		mfc_buf->used = 0;
+		mfc_buf->queued = ktime_get();
 		spin_lock_irqsave(&dev->irqlock, flags);
 		list_add_tail(&mfc_buf->list, &ctx->src_queue);
 		ctx->src_queue_cnt++;
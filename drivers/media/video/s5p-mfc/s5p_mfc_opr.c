@@ -1094,19 +1094,9 @@ static int s5p_mfc_get_new_ctx(struct s5p_mfc_dev *dev)
 {
 	unsigned long flags;
 	int new_ctx;
-	int cnt;
 
 	spin_lock_irqsave(&dev->condlock, flags);
-	new_ctx = (dev->curr_ctx + 1) % MFC_NUM_CONTEXTS;
-	cnt = 0;
-	while (!test_bit(new_ctx, &dev->ctx_work_bits)) {
-		new_ctx = (new_ctx + 1) % MFC_NUM_CONTEXTS;
-		if (++cnt > MFC_NUM_CONTEXTS) {
-			/* No contexts to run */
-			spin_unlock_irqrestore(&dev->condlock, flags);
-			return -EAGAIN;
-		}
-	}
+	new_ctx = s5p_mfc_sched_pick(&dev->sched, dev->ctx_work_bits);
 	spin_unlock_irqrestore(&dev->condlock, flags);
 	return new_ctx;
 }
@@ -1276,6 +1266,7 @@ static int s5p_mfc_run_init_dec_buffers(struct s5p_mfc_ctx *ctx)
 void s5p_mfc_try_run(struct s5p_mfc_dev *dev)
 {
 	struct s5p_mfc_ctx *ctx;
+	unsigned long flags;
 	int new_ctx;
 	unsigned int ret = 0;
 
@@ -1301,7 +1292,13 @@ void s5p_mfc_try_run(struct s5p_mfc_dev *dev)
 		return;
 	}
 	ctx = dev->ctx[new_ctx];
-	/* Got context to run in ctx */
+	/* Got context to run in ctx. Account for the command before it is
+	 * issued, its interrupt may come before the command returns, and
+	 * already choose the next context while the hardware is busy */
+	spin_lock_irqsave(&dev->condlock, flags);
+	s5p_mfc_sched_run(&dev->sched, new_ctx, ctx->src_queue_cnt,
+			  dev->ctx_work_bits, ktime_to_us(ktime_get()));
+	spin_unlock_irqrestore(&dev->condlock, flags);
 	/*
 	 * Last frame has already been sent to MFC.
 	 * Now obtaining frames from MFC buffer
@@ -1372,6 +1369,11 @@ void s5p_mfc_try_run(struct s5p_mfc_dev *dev)
 	}
 
 	if (ret) {
+		/* Nothing was issued, the context keeps its turn */
+		spin_lock_irqsave(&dev->condlock, flags);
+		s5p_mfc_sched_cancel(&dev->sched);
+		spin_unlock_irqrestore(&dev->condlock, flags);
+
 		/* Free hardware lock */
 		if (test_and_clear_bit(0, &dev->hw_lock) == 0)
 			mfc_err("Failed to unlock hardware\n");
@@ -0,0 +1,182 @@
+/*
+ * drivers/media/video/s5p-mfc/s5p_mfc_sched.c
+ *
+ * C file for Samsung MFC (Multi Function Codec - FIMV) driver
+ * This file contains the scheduler that chooses which context runs next.
+ *
+ * The MFC runs one command at a time for all the open contexts. Picking
+ * them in plain round robin gives each context the same number of
+ * commands, so a context with large frames takes most of the hardware
+ * time and the frames of the others wait behind it. Instead every context
+ * gets a share of hardware time per round, proportional to its weight,
+ * and the contexts are picked in round robin among those that have not
+ * used up their share. A command that overruns the share is charged to
+ * the next round of its context.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/errno.h>
+#include "s5p_mfc_sched.h"
+
+static const struct s5p_mfc_sched_stats zero_stats;
+
+static s32 quantum(struct s5p_mfc_sched *s, int num)
+{
+	return s->weight[num] * MFC_SCHED_QUANTUM_US;
+}
+
+void s5p_mfc_sched_init(struct s5p_mfc_sched *s)
+{
+	int i;
+
+	for (i = 0; i < MFC_NUM_CONTEXTS; i++)
+		s5p_mfc_sched_ctx_init(s, i);
+	s->last = MFC_NUM_CONTEXTS - 1;
+	s->next = -1;
+	s->running = -1;
+	s->start_us = 0;
+	s->depth = 0;
+	s->prev_last = s->last;
+	s->prev_next = -1;
+}
+
+/* Reset the slot of a context that has just been opened */
+void s5p_mfc_sched_ctx_init(struct s5p_mfc_sched *s, int num)
+{
+	s->weight[num] = MFC_SCHED_WEIGHT_DEF;
+	s->credit_us[num] = quantum(s, num);
+	s->stats[num] = zero_stats;
+	if (s->next == num)
+		s->next = -1;
+}
+
+void s5p_mfc_sched_set_weight(struct s5p_mfc_sched *s, int num,
+			      unsigned int weight)
+{
+	if (weight < 1)
+		weight = 1;
+	if (weight > MFC_SCHED_WEIGHT_MAX)
+		weight = MFC_SCHED_WEIGHT_MAX;
+	s->weight[num] = weight;
+	if (s->credit_us[num] > quantum(s, num))
+		s->credit_us[num] = quantum(s, num);
+}
+
+/* The first ready context after the last one run that has credit left */
+static int s5p_mfc_sched_scan(struct s5p_mfc_sched *s, unsigned long ready)
+{
+	int i, n;
+
+	for (i = 1; i <= MFC_NUM_CONTEXTS; i++) {
+		n = (s->last + i) % MFC_NUM_CONTEXTS;
+		if ((ready & (1UL << n)) && s->credit_us[n] > 0)
+			return n;
+	}
+	return -EAGAIN;
+}
+
+/*
+ * Choose the context to run next out of the @ready bitmask, or return
+ * -EAGAIN if none is ready.
+ */
+int s5p_mfc_sched_pick(struct s5p_mfc_sched *s, unsigned long ready)
+{
+	int n = s->next;
+
+	s->next = -1;
+	ready &= (1UL << MFC_NUM_CONTEXTS) - 1;
+	if (!ready)
+		return -EAGAIN;
+	/* The choice made while the hardware was busy still holds unless
+	 * that context went idle or has used up its share meanwhile */
+	if (n >= 0 && (ready & (1UL << n)) && s->credit_us[n] > 0)
+		return n;
+
+	for (;;) {
+		n = s5p_mfc_sched_scan(s, ready);
+		if (n >= 0)
+			return n;
+		/* Every ready context has used up its share, start a new
+		 * round. Only the ready ones get credit, so a context can
+		 * not save up more than one share while it is idle. */
+		for (n = 0; n < MFC_NUM_CONTEXTS; n++)
+			if (ready & (1UL << n))
+				s->credit_us[n] += quantum(s, n);
+	}
+}
+
+/*
+ * Account for a command of context @num about to be started on the
+ * hardware with @depth source buffers queued, and already choose the
+ * context to run after it out of @ready so that the interrupt handler only
+ * has to check that choice. This has to be called before the command is
+ * issued, as it may complete before the caller gets to run again.
+ */
+void s5p_mfc_sched_run(struct s5p_mfc_sched *s, int num, unsigned int depth,
+		       unsigned long ready, u64 now_us)
+{
+	s->prev_last = s->last;
+	s->prev_next = s->next;
+	s->running = num;
+	s->last = num;
+	s->start_us = now_us;
+	s->depth = depth;
+	s->next = s5p_mfc_sched_scan(s, ready);
+}
+
+/* The command announced by s5p_mfc_sched_run() could not be issued */
+void s5p_mfc_sched_cancel(struct s5p_mfc_sched *s)
+{
+	if (s->running < 0)
+		return;
+	s->running = -1;
+	s->last = s->prev_last;
+	s->next = s->prev_next;
+}
+
+/* Charge the command that has just finished to its context */
+void s5p_mfc_sched_done(struct s5p_mfc_sched *s, u64 now_us)
+{
+	struct s5p_mfc_sched_stats *st;
+	int n = s->running;
+	u32 busy, max;
+
+	if (n < 0)
+		return;
+	s->running = -1;
+	st = &s->stats[n];
+	busy = now_us > s->start_us ? now_us - s->start_us : 0;
+	st->runs++;
+	st->depth += s->depth;
+	if (s->depth > st->max_depth)
+		st->max_depth = s->depth;
+	st->busy_us += busy;
+	if (busy > st->max_busy_us)
+		st->max_busy_us = busy;
+	/* A command that hung until the watchdog fired is not charged in
+	 * full, or the context would not run for many rounds */
+	max = MFC_SCHED_MAX_CHARGE * quantum(s, n);
+	s->credit_us[n] -= busy < max ? busy : max;
+}
+
+void s5p_mfc_sched_frame_done(struct s5p_mfc_sched *s, int num,
+			      u64 latency_us)
+{
+	struct s5p_mfc_sched_stats *st = &s->stats[num];
+
+	st->frames++;
+	st->latency_us += latency_us;
+	if (latency_us > st->max_latency_us)
+		st->max_latency_us = latency_us;
+}
+
+void s5p_mfc_sched_reset_stats(struct s5p_mfc_sched *s)
+{
+	int i;
+
+	for (i = 0; i < MFC_NUM_CONTEXTS; i++)
+		s->stats[i] = zero_stats;
+}
@@ -0,0 +1,94 @@
+/*
+ * drivers/media/video/s5p-mfc/s5p_mfc_sched.h
+ *
+ * Header file for Samsung MFC (Multi Function Codec - FIMV) driver
+ * It contains the hardware scheduler declarations.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef S5P_MFC_SCHED_H_
+#define S5P_MFC_SCHED_H_
+
+#include <linux/types.h>
+
+/*
+ * The scheduler does not touch the hardware or the driver structures, so
+ * that it can also be built into a user space simulation of the MFC
+ * (tools/media/mfc-sched-test.c).
+ */
+
+#define MFC_NUM_CONTEXTS	4
+
+/* Hardware time a context gets per round, per unit of weight */
+#define MFC_SCHED_QUANTUM_US	4000
+#define MFC_SCHED_WEIGHT_DEF	4
+#define MFC_SCHED_WEIGHT_MAX	16
+/* Most rounds of debt a single command can leave its context with */
+#define MFC_SCHED_MAX_CHARGE	4
+
+/**
+ * struct s5p_mfc_sched_stats - per context scheduler counters
+ * @runs:		commands run on the hardware
+ * @busy_us:		hardware time used by the commands
+ * @max_busy_us:	longest command
+ * @frames:		source buffers completed
+ * @latency_us:		time from queueing to completion of those buffers
+ * @max_latency_us:	longest of those times
+ * @depth:		sum of the source queue depths seen at each run
+ * @max_depth:		deepest source queue seen at a run
+ */
+struct s5p_mfc_sched_stats {
+	u32 runs;
+	u64 busy_us;
+	u32 max_busy_us;
+	u32 frames;
+	u64 latency_us;
+	u32 max_latency_us;
+	u64 depth;
+	u32 max_depth;
+};
+
+/**
+ * struct s5p_mfc_sched - weighted round robin over the MFC contexts
+ * @weight:	share of the hardware time of each context
+ * @credit_us:	hardware time each context may still use in this round,
+ *		negative when its last command overran it
+ * @stats:	counters of each context
+ * @last:	context that was run last, the round robin continues after it
+ * @next:	context chosen to run next while the hardware was busy, or -1
+ * @running:	context running on the hardware, or -1
+ * @start_us:	time the running command was started
+ * @depth:	source queue depth of the running context when it started
+ * @prev_last:	@last before the running command, to cancel it
+ * @prev_next:	@next before the running command, to cancel it
+ */
+struct s5p_mfc_sched {
+	unsigned int weight[MFC_NUM_CONTEXTS];
+	s32 credit_us[MFC_NUM_CONTEXTS];
+	struct s5p_mfc_sched_stats stats[MFC_NUM_CONTEXTS];
+	int last;
+	int next;
+	int running;
+	u64 start_us;
+	unsigned int depth;
+	int prev_last;
+	int prev_next;
+};
+
+void s5p_mfc_sched_init(struct s5p_mfc_sched *s);
+void s5p_mfc_sched_ctx_init(struct s5p_mfc_sched *s, int num);
+void s5p_mfc_sched_set_weight(struct s5p_mfc_sched *s, int num,
+			      unsigned int weight);
+int s5p_mfc_sched_pick(struct s5p_mfc_sched *s, unsigned long ready);
+void s5p_mfc_sched_run(struct s5p_mfc_sched *s, int num, unsigned int depth,
+		       unsigned long ready, u64 now_us);
+void s5p_mfc_sched_cancel(struct s5p_mfc_sched *s);
+void s5p_mfc_sched_done(struct s5p_mfc_sched *s, u64 now_us);
+void s5p_mfc_sched_frame_done(struct s5p_mfc_sched *s, int num,
+			      u64 latency_us);
+void s5p_mfc_sched_reset_stats(struct s5p_mfc_sched *s);
+
+#endif /* S5P_MFC_SCHED_H_ */
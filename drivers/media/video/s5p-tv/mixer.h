@@ -20,6 +20,7 @@
 
 #include <linux/fb.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/spinlock.h>
 #include <linux/wait.h>
 #include <media/v4l2-device.h>
@@ -38,6 +39,14 @@
 #define MXR_ENABLE 1
 #define MXR_DISABLE 0
 
+/** number of screens in the buffer of the framebuffer emulation */
+#define MXR_FB_BUFFERS 3
+/**
+ * maximal number of page flips waiting for vsync, latched one included:
+ * one screen is scanned out and one is left for the client to draw into
+ */
+#define MXR_FLIP_QUEUE_LEN (MXR_FB_BUFFERS - 2)
+
 /** description of supported format */
 struct mxr_format {
 	/** format name/mnemonic */
@@ -213,6 +222,27 @@ struct mxr_resources {
 	struct clk *sclk_dac;
 };
 
+/** page flips of a graphic layer, latched at vsync */
+struct mxr_flip_queue {
+	/** base addresses waiting for vsync */
+	dma_addr_t addr[MXR_FLIP_QUEUE_LEN];
+	/** time each of them was queued */
+	ktime_t queued[MXR_FLIP_QUEUE_LEN];
+	/** index of the oldest queued flip */
+	int head;
+	/** number of queued flips */
+	int count;
+	/** a base was written at the last vsync and shows from the next */
+	int latched;
+	dma_addr_t latched_addr;
+	ktime_t latched_queued;
+	/** number of completed flips */
+	unsigned long flips;
+	/** called from the vsync interrupt for every completed flip */
+	void (*flip_done)(void *priv);
+	void *flip_priv;
+};
+
 /* event flags used  */
 enum mxr_devide_flags {
 	MXR_EVENT_VSYNC = 0,
@@ -239,6 +269,10 @@ struct mxr_device {
 	wait_queue_head_t event_queue;
 	/** state flags */
 	unsigned long event_flags;
+	/** number of vsyncs seen, protected by reg_slock */
+	unsigned long vsync_count;
+	/** page flip queue for each graphic layer, protected by reg_slock */
+	struct mxr_flip_queue flip[MXR_MAX_LAYERS];
 
 	/** spinlock for protection of registers */
 	spinlock_t reg_slock;
@@ -341,6 +375,11 @@ void mxr_reg_set_mbus_fmt(struct mxr_device *mdev,
 void mxr_reg_graph_layer_stream(struct mxr_device *mdev, int idx, int en);
 void mxr_reg_graph_buffer(struct mxr_device *mdev, int idx, dma_addr_t addr);
 void mxr_reg_set_graph_base(struct mxr_device *mdev, int idx, dma_addr_t addr);
+int mxr_reg_queue_flip(struct mxr_device *mdev, int idx, dma_addr_t addr);
+int mxr_reg_wait4flip(struct mxr_device *mdev, int idx);
+void mxr_reg_flip_reset(struct mxr_device *mdev, int idx);
+void mxr_reg_set_flip_handler(struct mxr_device *mdev, int idx,
+	void (*flip_done)(void *priv), void *priv);
 void mxr_reg_graph_format(struct mxr_device *mdev, int idx,
 	const struct mxr_format *fmt, const struct mxr_geometry *geo);
 
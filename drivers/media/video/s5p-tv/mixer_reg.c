@@ -17,6 +17,9 @@
 
 #include <linux/delay.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/s5p_mixer.h>
+
 /* Register access subroutines */
 
 static inline u32 vp_read(struct mxr_device *mdev, u32 reg_id)
@@ -265,6 +268,146 @@ void mxr_reg_vp_buffer(struct mxr_device *mdev,
 	spin_unlock_irqrestore(&mdev->reg_slock, flags);
 }
 
+/* Page flipping
+ *
+ * A queued base address is written to the (shadowed) graphic base
+ * register from the vsync interrupt, so it is taken over by hardware at
+ * the following vsync; that interrupt completes the flip.  Writing it
+ * from the interrupt keeps the write well away from the vsync edge.
+ *
+ * A latched flip still holds its screen until the next vsync, so it
+ * counts against the queue like a queued one.  Together with the screen
+ * being scanned out that leaves the client one screen that is neither,
+ * the one it draws into once the pan has returned.
+ */
+
+/* called with reg_slock held */
+static int mxr_flip_pending(struct mxr_flip_queue *fq)
+{
+	return fq->count + fq->latched;
+}
+
+static int mxr_flip_has_room(struct mxr_device *mdev, int idx)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&mdev->reg_slock, flags);
+	ret = mxr_flip_pending(&mdev->flip[idx]) < MXR_FLIP_QUEUE_LEN;
+	spin_unlock_irqrestore(&mdev->reg_slock, flags);
+	return ret;
+}
+
+static int mxr_flip_idle(struct mxr_device *mdev, int idx)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&mdev->reg_slock, flags);
+	ret = !mdev->flip[idx].count && !mdev->flip[idx].latched;
+	spin_unlock_irqrestore(&mdev->reg_slock, flags);
+	return ret;
+}
+
+int mxr_reg_queue_flip(struct mxr_device *mdev, int idx, dma_addr_t addr)
+{
+	struct mxr_flip_queue *fq = &mdev->flip[idx];
+	unsigned long flags;
+	long ret;
+
+	for (;;) {
+		spin_lock_irqsave(&mdev->reg_slock, flags);
+		if (mxr_flip_pending(fq) < MXR_FLIP_QUEUE_LEN) {
+			int tail = (fq->head + fq->count) % MXR_FLIP_QUEUE_LEN;
+
+			fq->addr[tail] = addr;
+			fq->queued[tail] = ktime_get();
+			fq->count++;
+			/* pending, scanned out and the client's own screen */
+			WARN_ON_ONCE(mxr_flip_pending(fq) + 2 > MXR_FB_BUFFERS);
+			trace_mxr_flip_queue(idx, addr, fq->count);
+			spin_unlock_irqrestore(&mdev->reg_slock, flags);
+			return 0;
+		}
+		spin_unlock_irqrestore(&mdev->reg_slock, flags);
+
+		/* the next screen is still latched or shown, wait for a flip */
+		ret = wait_event_interruptible_timeout(mdev->event_queue,
+			mxr_flip_has_room(mdev, idx), msecs_to_jiffies(1000));
+		if (ret < 0)
+			return ret;
+		if (ret == 0) {
+			mxr_warn(mdev, "no vsync detected - flip timeout\n");
+			return -ETIME;
+		}
+	}
+}
+
+int mxr_reg_wait4flip(struct mxr_device *mdev, int idx)
+{
+	long ret;
+
+	/* nothing pending, the next flip point is the next vsync */
+	if (mxr_flip_idle(mdev, idx))
+		return mxr_reg_wait4vsync(mdev);
+
+	ret = wait_event_interruptible_timeout(mdev->event_queue,
+		mxr_flip_idle(mdev, idx), msecs_to_jiffies(1000));
+	if (ret > 0)
+		return 0;
+	if (ret < 0)
+		return ret;
+	mxr_warn(mdev, "no vsync detected - flip timeout\n");
+	return -ETIME;
+}
+
+void mxr_reg_flip_reset(struct mxr_device *mdev, int idx)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&mdev->reg_slock, flags);
+	mdev->flip[idx].count = 0;
+	mdev->flip[idx].latched = 0;
+	spin_unlock_irqrestore(&mdev->reg_slock, flags);
+	wake_up(&mdev->event_queue);
+}
+
+void mxr_reg_set_flip_handler(struct mxr_device *mdev, int idx,
+	void (*flip_done)(void *priv), void *priv)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&mdev->reg_slock, flags);
+	mdev->flip[idx].flip_done = flip_done;
+	mdev->flip[idx].flip_priv = priv;
+	spin_unlock_irqrestore(&mdev->reg_slock, flags);
+}
+
+/* called on vsync with reg_slock held */
+static void mxr_irq_flip_handle(struct mxr_device *mdev, int idx)
+{
+	struct mxr_flip_queue *fq = &mdev->flip[idx];
+
+	if (fq->latched) {
+		/* base written at the previous vsync is on screen now */
+		fq->latched = 0;
+		fq->flips++;
+		trace_mxr_flip_done(idx, fq->latched_addr, mdev->vsync_count,
+			ktime_us_delta(ktime_get(), fq->latched_queued));
+		if (fq->flip_done)
+			fq->flip_done(fq->flip_priv);
+	}
+
+	if (fq->count) {
+		fq->latched_addr = fq->addr[fq->head];
+		fq->latched_queued = fq->queued[fq->head];
+		fq->head = (fq->head + 1) % MXR_FLIP_QUEUE_LEN;
+		fq->count--;
+		fq->latched = 1;
+		mxr_write(mdev, MXR_GRAPHIC_BASE(idx), fq->latched_addr);
+	}
+}
+
 static void mxr_irq_layer_handle(struct mxr_layer *layer)
 {
 	struct list_head *head = &layer->enq_list;
@@ -311,6 +454,11 @@ irqreturn_t mxr_irq_handler(int irq, void *dev_data)
 
 	/* wake up process waiting for VSYNC */
 	if (val & MXR_INT_STATUS_VSYNC) {
+		mdev->vsync_count++;
+		trace_mxr_vsync(mdev->vsync_count);
+		/* only the two graphic layers have a flip queue */
+		mxr_irq_flip_handle(mdev, 0);
+		mxr_irq_flip_handle(mdev, 1);
 		set_bit(MXR_EVENT_VSYNC, &mdev->event_flags);
 		wake_up(&mdev->event_queue);
 	}
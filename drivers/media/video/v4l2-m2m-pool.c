@@ -0,0 +1,613 @@
+/*
+ * Memory-to-memory device pool for Video for Linux 2.
+ *
+ * Runs the jobs of the instances of one mem-to-mem video node on a set of
+ * engines: each job goes to the least loaded idle engine able to do it,
+ * while the jobs of each instance still run one at a time and in order.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ */
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+
+#include <media/v4l2-m2m-pool.h>
+
+MODULE_DESCRIPTION("Mem to mem device pool for videobuf");
+MODULE_LICENSE("GPL");
+
+static bool debug;
+module_param(debug, bool, 0644);
+
+#define dprintk(fmt, arg...)						\
+	do {								\
+		if (debug)						\
+			printk(KERN_DEBUG "%s: " fmt, __func__, ## arg);\
+	} while (0)
+
+
+/**
+ * struct v4l2_m2m_pool_unit - one engine of the pool
+ * @name:	engine name, for the statistics
+ * @priv:	driver's engine private data
+ * @curr:	instance whose job is running on the engine, or NULL
+ * @disabled:	nonzero while the engine must not be given jobs
+ * @started:	when the running job was started
+ * @load_ns:	total time spent running jobs, used to pick an engine
+ * @jobs:	statistics: jobs completed
+ * @busy_ns:	statistics: time spent running jobs
+ * @wait_ns:	statistics: time the jobs spent waiting for an engine
+ */
+struct v4l2_m2m_pool_unit {
+	const char			*name;
+	void				*priv;
+	struct v4l2_m2m_pool_ctx	*curr;
+	int				disabled;
+	ktime_t				started;
+	u64				load_ns;
+	u32				jobs;
+	u64				busy_ns;
+	u64				wait_ns;
+};
+
+/**
+ * struct v4l2_m2m_pool - per-device pool context
+ * @ops:	driver callbacks
+ * @lock:	protects everything below, and the pool state of instances
+ * @job_queue:	instances with a job waiting for an engine
+ * @wait:	woken up when an engine goes idle
+ * @reset_at:	when the statistics were last reset
+ * @num_units:	number of engines in @units
+ * @units:	the engines
+ */
+struct v4l2_m2m_pool {
+	struct v4l2_m2m_pool_ops	*ops;
+	spinlock_t			lock;
+	struct list_head		job_queue;
+	wait_queue_head_t		wait;
+	ktime_t				reset_at;
+	int				num_units;
+	struct v4l2_m2m_pool_unit	units[V4L2_M2M_POOL_MAX_UNITS];
+};
+
+/*
+ * Pick the engine for the next job of @pctx: of the idle engines that can
+ * do it, the one that has been busy for the shortest time so far. Returns
+ * -1 if there is none. Called with the pool lock held.
+ */
+static int v4l2_m2m_pool_pick_unit(struct v4l2_m2m_pool *pool,
+				   struct v4l2_m2m_pool_ctx *pctx)
+{
+	struct v4l2_m2m_pool_unit *u;
+	int i, best = -1;
+
+	for (i = 0; i < pool->num_units; i++) {
+		u = &pool->units[i];
+		if (u->curr || u->disabled)
+			continue;
+		if (pool->ops->unit_fits &&
+		    !pool->ops->unit_fits(u->priv, pctx->priv))
+			continue;
+		if (best < 0 || u->load_ns < pool->units[best].load_ns)
+			best = i;
+	}
+
+	return best;
+}
+
+/**
+ * v4l2_m2m_pool_try_run() - start as many waiting jobs as possible
+ *
+ * Jobs are taken in the order they were queued, but a job that no idle
+ * engine can do does not hold back the ones behind it.
+ */
+static void v4l2_m2m_pool_try_run(struct v4l2_m2m_pool *pool)
+{
+	struct v4l2_m2m_pool_ctx *pctx;
+	struct v4l2_m2m_pool_unit *u;
+	unsigned long flags;
+	ktime_t now;
+	int unit;
+
+again:
+	spin_lock_irqsave(&pool->lock, flags);
+	list_for_each_entry(pctx, &pool->job_queue, queue) {
+		if (pctx->stopped)
+			continue;
+		unit = v4l2_m2m_pool_pick_unit(pool, pctx);
+		if (unit < 0)
+			continue;
+
+		list_del(&pctx->queue);
+		pctx->queued = false;
+		pctx->unit = unit;
+
+		now = ktime_get();
+		u = &pool->units[unit];
+		u->curr = pctx;
+		u->started = now;
+		u->wait_ns += ktime_to_ns(ktime_sub(now, pctx->queued_at));
+		spin_unlock_irqrestore(&pool->lock, flags);
+
+		dprintk("Running %p on %s\n", pctx, u->name);
+		pool->ops->unit_run(u->priv, pctx->priv);
+		goto again;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+}
+
+/**
+ * v4l2_m2m_pool_job_queue() - hand the next job of an instance to the pool
+ *
+ * Call from the driver's device_run() callback, instead of starting the
+ * hardware there. The job is run by the unit_run() callback as soon as a
+ * suitable engine is idle, possibly before this function returns.
+ */
+void v4l2_m2m_pool_job_queue(struct v4l2_m2m_pool_ctx *pctx)
+{
+	struct v4l2_m2m_pool *pool = pctx->pool;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (pctx->queued || pctx->unit >= 0) {
+		spin_unlock_irqrestore(&pool->lock, flags);
+		dprintk("Instance %p already has a job\n", pctx);
+		return;
+	}
+	list_add_tail(&pctx->queue, &pool->job_queue);
+	pctx->queued = true;
+	pctx->queued_at = ktime_get();
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	v4l2_m2m_pool_try_run(pool);
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_job_queue);
+
+/**
+ * v4l2_m2m_pool_job_finish() - inform the pool that a job has been finished
+ *
+ * Call where v4l2_m2m_job_finish() would be called for a single engine,
+ * once the buffers of the job have been returned. The engine is given to
+ * the next waiting job, and the instance is requeued behind the jobs of
+ * the other instances if it has more buffers ready.
+ */
+void v4l2_m2m_pool_job_finish(struct v4l2_m2m_pool_ctx *pctx)
+{
+	struct v4l2_m2m_pool *pool = pctx->pool;
+	struct v4l2_m2m_pool_unit *u;
+	unsigned long flags;
+	s64 ns;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (pctx->unit < 0) {
+		spin_unlock_irqrestore(&pool->lock, flags);
+		dprintk("Called by an instance not currently running\n");
+		return;
+	}
+	u = &pool->units[pctx->unit];
+	ns = ktime_to_ns(ktime_sub(ktime_get(), u->started));
+	u->load_ns += ns;
+	u->busy_ns += ns;
+	u->jobs++;
+	u->curr = NULL;
+	pctx->unit = -1;
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	wake_up(&pool->wait);
+
+	v4l2_m2m_job_finish(pctx->m2m_dev, pctx->m2m_ctx);
+	v4l2_m2m_pool_try_run(pool);
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_job_finish);
+
+/**
+ * v4l2_m2m_pool_job_ready() - check whether the pool accepts a job
+ *
+ * Call from the driver's job_ready() callback; returns 0 while the instance
+ * is stopped.
+ */
+int v4l2_m2m_pool_job_ready(struct v4l2_m2m_pool_ctx *pctx)
+{
+	return !ACCESS_ONCE(pctx->stopped);
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_job_ready);
+
+/**
+ * v4l2_m2m_pool_job_abort() - stop an instance and drop its waiting job
+ *
+ * Call from the driver's job_abort() callback. A job still waiting for an
+ * engine is finished without being run; a running one is left to complete
+ * as usual. No new job is accepted until v4l2_m2m_pool_ctx_start().
+ */
+void v4l2_m2m_pool_job_abort(struct v4l2_m2m_pool_ctx *pctx)
+{
+	struct v4l2_m2m_pool *pool = pctx->pool;
+	unsigned long flags;
+	bool dropped;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	pctx->stopped = true;
+	dropped = pctx->queued;
+	if (dropped) {
+		list_del(&pctx->queue);
+		pctx->queued = false;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	if (dropped) {
+		dprintk("Dropped waiting job of %p\n", pctx);
+		v4l2_m2m_job_finish(pctx->m2m_dev, pctx->m2m_ctx);
+	}
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_job_abort);
+
+static bool v4l2_m2m_pool_ctx_idle(struct v4l2_m2m_pool_ctx *pctx)
+{
+	unsigned long flags;
+	bool idle;
+
+	spin_lock_irqsave(&pctx->pool->lock, flags);
+	idle = pctx->unit < 0;
+	spin_unlock_irqrestore(&pctx->pool->lock, flags);
+
+	return idle;
+}
+
+/**
+ * v4l2_m2m_pool_ctx_stop() - stop an instance and wait for its running job
+ *
+ * Usually called from the driver's stop_streaming() callback. Returns
+ * -ETIMEDOUT if the running job did not complete within @timeout jiffies.
+ */
+int v4l2_m2m_pool_ctx_stop(struct v4l2_m2m_pool_ctx *pctx,
+			   unsigned long timeout)
+{
+	int ret;
+
+	v4l2_m2m_pool_job_abort(pctx);
+	ret = wait_event_timeout(pctx->pool->wait,
+				 v4l2_m2m_pool_ctx_idle(pctx), timeout);
+
+	return ret == 0 ? -ETIMEDOUT : 0;
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_ctx_stop);
+
+/**
+ * v4l2_m2m_pool_ctx_start() - let a stopped instance queue jobs again
+ *
+ * Usually called from the driver's start_streaming() callback.
+ */
+void v4l2_m2m_pool_ctx_start(struct v4l2_m2m_pool_ctx *pctx)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pctx->pool->lock, flags);
+	pctx->stopped = false;
+	spin_unlock_irqrestore(&pctx->pool->lock, flags);
+
+	v4l2_m2m_pool_try_run(pctx->pool);
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_ctx_start);
+
+/**
+ * v4l2_m2m_pool_get_curr_priv() - return driver private data of the instance
+ * running on an engine, or NULL if the engine is idle
+ */
+void *v4l2_m2m_pool_get_curr_priv(struct v4l2_m2m_pool *pool, int unit)
+{
+	unsigned long flags;
+	void *ret = NULL;
+
+	if (unit < 0 || unit >= pool->num_units)
+		return NULL;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (pool->units[unit].curr)
+		ret = pool->units[unit].curr->priv;
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_get_curr_priv);
+
+/**
+ * v4l2_m2m_pool_add_unit() - add an engine to the pool
+ * @unit_priv:	driver's engine private data, passed to the callbacks
+ * @name:	engine name for the statistics, must stay valid
+ *
+ * Returns the engine number, or -ENOSPC if the pool is full.
+ */
+int v4l2_m2m_pool_add_unit(struct v4l2_m2m_pool *pool, void *unit_priv,
+			   const char *name)
+{
+	unsigned long flags;
+	int unit = -ENOSPC;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (pool->num_units < V4L2_M2M_POOL_MAX_UNITS) {
+		unit = pool->num_units++;
+		pool->units[unit].priv = unit_priv;
+		pool->units[unit].name = name;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	if (unit >= 0)
+		v4l2_m2m_pool_try_run(pool);
+	return unit;
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_add_unit);
+
+static bool v4l2_m2m_pool_unit_idle(struct v4l2_m2m_pool *pool, int unit)
+{
+	unsigned long flags;
+	bool idle;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	idle = pool->units[unit].curr == NULL;
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	return idle;
+}
+
+/**
+ * v4l2_m2m_pool_unit_disable() - take an engine out of the pool
+ *
+ * For a driver that sometimes needs an engine for something else. No new
+ * job is started on the engine, and the running one, if any, is waited for
+ * up to @timeout jiffies. Returns -ETIMEDOUT if it did not complete; the
+ * engine is disabled all the same. Calls nest, every one has to be
+ * balanced by v4l2_m2m_pool_unit_enable().
+ */
+int v4l2_m2m_pool_unit_disable(struct v4l2_m2m_pool *pool, int unit,
+			       unsigned long timeout)
+{
+	unsigned long flags;
+	int ret;
+
+	if (unit < 0 || unit >= pool->num_units)
+		return -EINVAL;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	pool->units[unit].disabled++;
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	ret = wait_event_timeout(pool->wait,
+				 v4l2_m2m_pool_unit_idle(pool, unit), timeout);
+
+	return ret == 0 ? -ETIMEDOUT : 0;
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_unit_disable);
+
+/**
+ * v4l2_m2m_pool_unit_enable() - give an engine back to the pool
+ */
+void v4l2_m2m_pool_unit_enable(struct v4l2_m2m_pool *pool, int unit)
+{
+	unsigned long flags;
+
+	if (unit < 0 || unit >= pool->num_units)
+		return;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (!WARN_ON(pool->units[unit].disabled == 0))
+		pool->units[unit].disabled--;
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	v4l2_m2m_pool_try_run(pool);
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_unit_enable);
+
+/**
+ * v4l2_m2m_pool_get_stats() - get the utilization counters of an engine
+ *
+ * The time of a job still running is included up to now.
+ */
+int v4l2_m2m_pool_get_stats(struct v4l2_m2m_pool *pool, int unit,
+			    struct v4l2_m2m_pool_unit_stats *stats)
+{
+	struct v4l2_m2m_pool_unit *u;
+	unsigned long flags;
+	ktime_t now;
+
+	if (unit < 0 || unit >= pool->num_units)
+		return -EINVAL;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	u = &pool->units[unit];
+	now = ktime_get();
+	stats->jobs = u->jobs;
+	stats->busy_ns = u->busy_ns;
+	if (u->curr)
+		stats->busy_ns += ktime_to_ns(ktime_sub(now, u->started));
+	stats->wait_ns = u->wait_ns;
+	stats->period_ns = ktime_to_ns(ktime_sub(now, pool->reset_at));
+	stats->disabled = u->disabled != 0;
+	stats->busy = u->curr != NULL;
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_get_stats);
+
+/**
+ * v4l2_m2m_pool_reset_stats() - restart the utilization counters
+ */
+void v4l2_m2m_pool_reset_stats(struct v4l2_m2m_pool *pool)
+{
+	struct v4l2_m2m_pool_unit *u;
+	unsigned long flags;
+	ktime_t now;
+	int i;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	now = ktime_get();
+	for (i = 0; i < pool->num_units; i++) {
+		u = &pool->units[i];
+		/* Count only the part of a running job after the reset */
+		if (u->curr) {
+			u->load_ns += ktime_to_ns(ktime_sub(now, u->started));
+			u->started = now;
+		}
+		u->jobs = 0;
+		u->busy_ns = 0;
+		u->wait_ns = 0;
+	}
+	pool->reset_at = now;
+	spin_unlock_irqrestore(&pool->lock, flags);
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_reset_stats);
+
+/**
+ * v4l2_m2m_pool_show_stats() - format the utilization counters
+ * @buf:	a PAGE_SIZE buffer, as passed to a sysfs show() method
+ *
+ * One line per engine, with the share of the time since the last reset
+ * that the engine spent running jobs.
+ */
+ssize_t v4l2_m2m_pool_show_stats(struct v4l2_m2m_pool *pool, char *buf)
+{
+	struct v4l2_m2m_pool_unit_stats st;
+	struct v4l2_m2m_pool_ctx *pctx;
+	unsigned long flags;
+	unsigned int waiting = 0;
+	ssize_t len;
+	u32 util;
+	int i;
+
+	len = scnprintf(buf, PAGE_SIZE, "%-20s %10s %12s %12s %5s\n",
+			"unit", "jobs", "busy_us", "wait_us", "util");
+
+	for (i = 0; i < pool->num_units; i++) {
+		v4l2_m2m_pool_get_stats(pool, i, &st);
+		util = st.period_ns ?
+			div64_u64(st.busy_ns * 100, st.period_ns) : 0;
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%-20s %10u %12llu %12llu %4u%% %s\n",
+				 pool->units[i].name, st.jobs,
+				 div_u64(st.busy_ns, NSEC_PER_USEC),
+				 div_u64(st.wait_ns, NSEC_PER_USEC), util,
+				 st.disabled ? "disabled" :
+				 st.busy ? "busy" : "idle");
+	}
+
+	spin_lock_irqsave(&pool->lock, flags);
+	list_for_each_entry(pctx, &pool->job_queue, queue)
+		waiting++;
+	spin_unlock_irqrestore(&pool->lock, flags);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "waiting: %u\n", waiting);
+
+	return len;
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_show_stats);
+
+/**
+ * v4l2_m2m_pool_ctx_init() - allocate and initialize an instance of a pool
+ * @m2m_ops:	callbacks of the instance's own v4l2_m2m_dev; device_run()
+ *		should call v4l2_m2m_pool_job_queue()
+ * @drv_priv:	driver's instance private data
+ * @queue_init:	as for v4l2_m2m_ctx_init()
+ *
+ * Usually called from driver's open() function.
+ */
+struct v4l2_m2m_pool_ctx *v4l2_m2m_pool_ctx_init(struct v4l2_m2m_pool *pool,
+		struct v4l2_m2m_ops *m2m_ops, void *drv_priv,
+		int (*queue_init)(void *priv, struct vb2_queue *src_vq, struct vb2_queue *dst_vq))
+{
+	struct v4l2_m2m_pool_ctx *pctx;
+	int ret;
+
+	pctx = kzalloc(sizeof *pctx, GFP_KERNEL);
+	if (!pctx)
+		return ERR_PTR(-ENOMEM);
+
+	pctx->pool = pool;
+	pctx->priv = drv_priv;
+	pctx->unit = -1;
+	INIT_LIST_HEAD(&pctx->queue);
+
+	pctx->m2m_dev = v4l2_m2m_init(m2m_ops);
+	if (IS_ERR(pctx->m2m_dev)) {
+		ret = PTR_ERR(pctx->m2m_dev);
+		goto err_free;
+	}
+
+	pctx->m2m_ctx = v4l2_m2m_ctx_init(pctx->m2m_dev, drv_priv, queue_init);
+	if (IS_ERR(pctx->m2m_ctx)) {
+		ret = PTR_ERR(pctx->m2m_ctx);
+		goto err_release;
+	}
+
+	return pctx;
+
+err_release:
+	v4l2_m2m_release(pctx->m2m_dev);
+err_free:
+	kfree(pctx);
+	return ERR_PTR(ret);
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_ctx_init);
+
+/**
+ * v4l2_m2m_pool_ctx_release() - release an instance of a pool
+ *
+ * Waits for a running job of the instance, through its job_abort()
+ * callback. Usually called from driver's release() function.
+ */
+void v4l2_m2m_pool_ctx_release(struct v4l2_m2m_pool_ctx *pctx)
+{
+	unsigned long flags;
+
+	v4l2_m2m_ctx_release(pctx->m2m_ctx);
+
+	spin_lock_irqsave(&pctx->pool->lock, flags);
+	if (WARN_ON(pctx->queued))
+		list_del(&pctx->queue);
+	spin_unlock_irqrestore(&pctx->pool->lock, flags);
+
+	v4l2_m2m_release(pctx->m2m_dev);
+	kfree(pctx);
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_ctx_release);
+
+/**
+ * v4l2_m2m_pool_init() - initialize a pool without engines
+ *
+ * Usually called from driver's probe() function.
+ */
+struct v4l2_m2m_pool *v4l2_m2m_pool_init(struct v4l2_m2m_pool_ops *ops)
+{
+	struct v4l2_m2m_pool *pool;
+
+	if (!ops || WARN_ON(!ops->unit_run))
+		return ERR_PTR(-EINVAL);
+
+	pool = kzalloc(sizeof *pool, GFP_KERNEL);
+	if (!pool)
+		return ERR_PTR(-ENOMEM);
+
+	pool->ops = ops;
+	spin_lock_init(&pool->lock);
+	INIT_LIST_HEAD(&pool->job_queue);
+	init_waitqueue_head(&pool->wait);
+	pool->reset_at = ktime_get();
+
+	return pool;
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_init);
+
+/**
+ * v4l2_m2m_pool_release() - free a pool
+ *
+ * All instances must have been released. Usually called from driver's
+ * remove() function.
+ */
+void v4l2_m2m_pool_release(struct v4l2_m2m_pool *pool)
+{
+	WARN_ON(!list_empty(&pool->job_queue));
+	kfree(pool);
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_pool_release);
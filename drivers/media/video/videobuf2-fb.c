@@ -18,6 +18,15 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/fb.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/lzo.h>
+#include <linux/bitmap.h>
+#include <linux/file.h>
+#include <linux/workqueue.h>
+#ifdef CONFIG_SW_SYNC
+#include <linux/sw_sync.h>
+#endif
 
 #include <linux/videodev2.h>
 #include <media/v4l2-dev.h>
@@ -45,7 +54,7 @@ module_param(debug, int, 0644);
 	} while (0)
 
 /* Number of virtual screens that are allocated */
-#define NUM_BUFFERS 2
+#define NUM_BUFFERS MXR_FB_BUFFERS
 
 struct vb2_fb_data {
 	struct video_device *vfd;
@@ -66,7 +75,36 @@ struct vb2_fb_data {
 	struct dentry fake_dentry;
 	struct inode fake_inode;
 	ump_dd_handle ump_handle[2];
+
+	/* dirty tile tracking, see FXIFB_GET_DIRTY */
+	void *shadow;		/* frame as last handed out */
+	unsigned long *pending;	/* tiles owed regardless of the shadow */
+	unsigned int next_tile;	/* first tile that did not fit last time */
+	u8 *dirty_map;
+	void *tile;		/* packed tile */
+	void *tile_lzo;		/* compressed tile */
+	void *lzo_wrkmem;
+
+#ifdef CONFIG_SW_SYNC
+	/* release fences, see FXIFB_PAN_FENCE; the timeline counts flips */
+	struct sw_sync_timeline *timeline;
+	u32 timeline_max;	/* flips issued, protected by fb lock */
+	u32 timeline_value;	/* flips signalled on the timeline */
+	atomic_t flips_done;
+	struct workqueue_struct *flip_wq;
+	struct work_struct release_work;
+#endif
+};
+
+#ifdef CONFIG_SW_SYNC
+/* a pan waiting for its acquire fence */
+struct vb2_fb_flip {
+	struct work_struct work;
+	struct fb_info *info;
+	struct sync_fence *acquire;
+	dma_addr_t addr;
 };
+#endif
 
 static int vb2_fb_activate(struct fb_info *info);
 static int vb2_fb_deactivate(struct fb_info *info);
@@ -122,6 +160,450 @@ static void create_ump_ids(struct vb2_fb_data *data, unsigned int smem, int size
 	data->ump_handle[1] = ump_dd_handle_create_from_phys_blocks(&block, 1);
 }
 
+static void vb2_fb_dirty_free(struct vb2_fb_data *data)
+{
+	vfree(data->shadow);
+	kfree(data->pending);
+	kfree(data->dirty_map);
+	kfree(data->tile);
+	kfree(data->tile_lzo);
+	kfree(data->lzo_wrkmem);
+	data->shadow = NULL;
+	data->pending = NULL;
+	data->dirty_map = NULL;
+	data->tile = NULL;
+	data->tile_lzo = NULL;
+	data->lzo_wrkmem = NULL;
+	data->next_tile = 0;
+}
+
+static int vb2_fb_dirty_alloc(struct vb2_fb_data *data, struct fb_info *info,
+			      unsigned int ntiles)
+{
+	unsigned int tile = FXIFB_TILE_WIDTH * FXIFB_TILE_HEIGHT *
+		DIV_ROUND_UP(info->var.bits_per_pixel, 8);
+
+	if (data->shadow)
+		return 0;
+
+	data->shadow = vmalloc(info->fix.line_length * info->var.yres);
+	data->pending = kmalloc(BITS_TO_LONGS(ntiles) * sizeof(long),
+				GFP_KERNEL);
+	data->dirty_map = kmalloc(DIV_ROUND_UP(ntiles, 8), GFP_KERNEL);
+	data->tile = kmalloc(tile, GFP_KERNEL);
+	data->tile_lzo = kmalloc(lzo1x_worst_compress(tile), GFP_KERNEL);
+	data->lzo_wrkmem = kmalloc(LZO1X_1_MEM_COMPRESS, GFP_KERNEL);
+	if (!data->shadow || !data->pending || !data->dirty_map ||
+	    !data->tile || !data->tile_lzo || !data->lzo_wrkmem) {
+		vb2_fb_dirty_free(data);
+		return -ENOMEM;
+	}
+	/* the shadow holds nothing yet, the first call reports every tile */
+	bitmap_fill(data->pending, ntiles);
+	data->next_tile = 0;
+	return 0;
+}
+
+static int vb2_fb_tile_changed(const u8 *frame, const u8 *shadow,
+			       unsigned int pitch, unsigned int w,
+			       unsigned int h)
+{
+	unsigned int y;
+
+	for (y = 0; y < h; y++, frame += pitch, shadow += pitch)
+		if (memcmp(frame, shadow, w))
+			return 1;
+	return 0;
+}
+
+/**
+ * fxifb_get_dirty() - hand out the tiles changed since the last call
+ * @info:	framebuffer vb2 emulator data
+ * @arg:	user's struct fxifb_dirty
+ */
+static int fxifb_get_dirty(struct fb_info *info,
+			   struct fxifb_dirty __user *arg)
+{
+	struct vb2_fb_data *data = info->par;
+	unsigned int bpp = DIV_ROUND_UP(info->var.bits_per_pixel, 8);
+	unsigned int pitch = info->fix.line_length;
+	unsigned int tx, ty, y, i, ntiles;
+	ktime_t start = ktime_get();
+	struct fxifb_dirty d;
+	u8 __user *out;
+	const u8 *frame;
+	u32 used = 0;
+	int ret = 0;
+
+	if (copy_from_user(&d, arg, sizeof(d)))
+		return -EFAULT;
+	if (!info->screen_base)
+		return -ENODEV;
+
+	d.tiles_x = DIV_ROUND_UP(info->var.xres, FXIFB_TILE_WIDTH);
+	d.tiles_y = DIV_ROUND_UP(info->var.yres, FXIFB_TILE_HEIGHT);
+	ntiles = d.tiles_x * d.tiles_y;
+	if (d.bitmap_len < DIV_ROUND_UP(ntiles, 8))
+		return -EINVAL;
+
+	ret = vb2_fb_dirty_alloc(data, info, ntiles);
+	if (ret)
+		return ret;
+
+	if (d.flags & FXIFB_DIRTY_FULL) {
+		bitmap_fill(data->pending, ntiles);
+		data->next_tile = 0;
+	}
+	if (data->next_tile >= ntiles)
+		data->next_tile = 0;
+	frame = info->screen_base + info->var.yoffset * pitch;
+	out = (u8 __user *)(uintptr_t)d.data;
+	memset(data->dirty_map, 0, DIV_ROUND_UP(ntiles, 8));
+	d.flags &= ~FXIFB_DIRTY_PARTIAL;
+	d.ntiles = 0;
+
+	/*
+	 * Start with the first tile that did not fit last time, so that a
+	 * small data buffer still gets every tile out in turn; the tiles
+	 * before it are picked up by the next call.
+	 */
+	for (i = data->next_tile; i < ntiles; i++) {
+		unsigned int y0, x0, w, h;
+		size_t off, len;
+		void *src = data->tile;
+		u32 hdr;
+
+		ty = i / d.tiles_x;
+		tx = i % d.tiles_x;
+		y0 = ty * FXIFB_TILE_HEIGHT;
+		x0 = tx * FXIFB_TILE_WIDTH;
+		h = min_t(unsigned int, FXIFB_TILE_HEIGHT, info->var.yres - y0);
+		w = bpp * min_t(unsigned int, FXIFB_TILE_WIDTH,
+				info->var.xres - x0);
+		off = y0 * pitch + x0 * bpp;
+		len = w * h;
+
+		if (!test_bit(i, data->pending) &&
+		    !vb2_fb_tile_changed(frame + off, data->shadow + off,
+					 pitch, w, h))
+			continue;
+
+		for (y = 0; y < h; y++)
+			memcpy(data->tile + y * w, frame + off + y * pitch, w);
+
+		if (d.flags & FXIFB_DIRTY_LZO) {
+			lzo1x_1_compress(data->tile, len, data->tile_lzo,
+					 &len, data->lzo_wrkmem);
+			src = data->tile_lzo;
+		}
+
+		if (used + sizeof(hdr) + len > d.data_len) {
+			d.flags |= FXIFB_DIRTY_PARTIAL;
+			break;
+		}
+		hdr = len;
+		if (copy_to_user(out + used, &hdr, sizeof(hdr)) ||
+		    copy_to_user(out + used + sizeof(hdr), src, len))
+			return -EFAULT;
+		used += sizeof(hdr) + len;
+
+		/* the tile has been handed out, remember it */
+		for (y = 0; y < h; y++)
+			memcpy(data->shadow + off + y * pitch,
+			       data->tile + y * w, w);
+		clear_bit(i, data->pending);
+		data->dirty_map[i / 8] |= 1 << (i % 8);
+		d.ntiles++;
+	}
+	data->next_tile = i < ntiles ? i : 0;
+
+	d.data_len = used;
+	d.diff_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (copy_to_user((void __user *)(uintptr_t)d.bitmap, data->dirty_map,
+			 DIV_ROUND_UP(ntiles, 8)) ||
+	    copy_to_user(arg, &d, sizeof(d)))
+		return -EFAULT;
+
+	dprintk(3, "fb emu: %u dirty tiles, %u bytes, %llu ns\n",
+		d.ntiles, used, d.diff_ns);
+	return 0;
+}
+
+static dma_addr_t fxifb_screen_addr(struct fb_info *info, u32 yoffset)
+{
+	struct vb2_fb_data *data = info->par;
+
+	return vb2_dma_contig_plane_dma_addr(data->q->bufs[0], 0) +
+		yoffset * info->fix.line_length;
+}
+
+static void vb2_fb_flip_done(void *priv);
+
+static int fxifb_flip(struct fb_info *info, dma_addr_t addr)
+{
+	struct vb2_fb_data *data = info->par;
+	struct mxr_layer *layer = vb2_get_drv_priv(data->q);
+	struct mxr_device *mdev = layer->mdev;
+
+	/* without vsync interrupts nothing would latch a queued flip */
+	if (!data->streaming) {
+		mxr_reg_set_graph_base(mdev, layer->idx, addr);
+		vb2_fb_flip_done(info);
+		return 0;
+	}
+
+	/*
+	 * The new screen is latched at vsync.  With three screens the
+	 * client can render the next frame while one flip is pending;
+	 * this blocks until the screen it renders next is neither latched
+	 * nor scanned out.
+	 */
+	return mxr_reg_queue_flip(mdev, layer->idx, addr);
+}
+
+#ifdef CONFIG_SW_SYNC
+/* called from the mixer's vsync interrupt */
+static void vb2_fb_flip_done(void *priv)
+{
+	struct fb_info *info = priv;
+	struct vb2_fb_data *data = info->par;
+
+	atomic_inc(&data->flips_done);
+	queue_work(system_nrt_wq, &data->release_work);
+}
+
+static void vb2_fb_release_work(struct work_struct *work)
+{
+	struct vb2_fb_data *data =
+		container_of(work, struct vb2_fb_data, release_work);
+	u32 done = atomic_read(&data->flips_done);
+
+	if (done != data->timeline_value) {
+		sw_sync_timeline_inc(data->timeline,
+				     done - data->timeline_value);
+		data->timeline_value = done;
+	}
+}
+
+/* signal every release fence handed out, no flip is pending any more */
+static void vb2_fb_release_all(struct fb_info *info)
+{
+	struct vb2_fb_data *data = info->par;
+
+	atomic_set(&data->flips_done, data->timeline_max);
+	queue_work(system_nrt_wq, &data->release_work);
+}
+
+static void vb2_fb_flip_work(struct work_struct *work)
+{
+	struct vb2_fb_flip *flip = container_of(work, struct vb2_fb_flip, work);
+	int ret;
+
+	if (flip->acquire) {
+		ret = sync_fence_wait(flip->acquire, 1000);
+		if (ret < 0)
+			printk(KERN_WARNING "fxifb: acquire fence %s: %d\n",
+			       flip->acquire->name, ret);
+		sync_fence_put(flip->acquire);
+	}
+
+	/*
+	 * A flip that did not happen still releases the old screen, once
+	 * the flips ahead of it are done: the timeline counts flips, so
+	 * signalling now would release the screen of a latched one.
+	 */
+	if (fxifb_flip(flip->info, flip->addr) < 0) {
+		struct vb2_fb_data *data = flip->info->par;
+		struct mxr_layer *layer = vb2_get_drv_priv(data->q);
+
+		mxr_reg_wait4flip(layer->mdev, layer->idx);
+		vb2_fb_flip_done(flip->info);
+	}
+	kfree(flip);
+}
+
+static int fxifb_pan_fence(struct fb_info *info,
+			   struct fxifb_pan_fence __user *arg)
+{
+	struct vb2_fb_data *data = info->par;
+	struct fxifb_pan_fence pf;
+	struct vb2_fb_flip *flip;
+	struct sync_fence *fence;
+	struct sync_pt *pt;
+	int fd, ret;
+
+	if (copy_from_user(&pf, arg, sizeof(pf)))
+		return -EFAULT;
+	/* compared this way round so that a huge yoffset can not wrap */
+	if (!info->screen_base ||
+	    info->var.yres > info->var.yres_virtual ||
+	    pf.yoffset > info->var.yres_virtual - info->var.yres)
+		return -EINVAL;
+
+	flip = kzalloc(sizeof(*flip), GFP_KERNEL);
+	if (!flip)
+		return -ENOMEM;
+	flip->info = info;
+	flip->addr = fxifb_screen_addr(info, pf.yoffset);
+	INIT_WORK(&flip->work, vb2_fb_flip_work);
+
+	if (pf.acquire_fence >= 0) {
+		flip->acquire = sync_fence_fdget(pf.acquire_fence);
+		if (!flip->acquire) {
+			ret = -EINVAL;
+			goto err_flip;
+		}
+	}
+
+	fd = get_unused_fd();
+	if (fd < 0) {
+		ret = fd;
+		goto err_acquire;
+	}
+
+	pt = sw_sync_pt_create(data->timeline, data->timeline_max + 1);
+	if (!pt) {
+		ret = -ENOMEM;
+		goto err_fd;
+	}
+	fence = sync_fence_create("fxifb-release", pt);
+	if (!fence) {
+		sync_pt_free(pt);
+		ret = -ENOMEM;
+		goto err_fd;
+	}
+
+	pf.release_fence = fd;
+	if (copy_to_user(arg, &pf, sizeof(pf))) {
+		sync_fence_put(fence);
+		ret = -EFAULT;
+		goto err_fd;
+	}
+	sync_fence_install(fence, fd);
+
+	data->timeline_max++;
+	info->var.yoffset = pf.yoffset;
+	queue_work(data->flip_wq, &flip->work);
+	return 0;
+
+err_fd:
+	put_unused_fd(fd);
+err_acquire:
+	if (flip->acquire)
+		sync_fence_put(flip->acquire);
+err_flip:
+	kfree(flip);
+	return ret;
+}
+
+static void vb2_fb_flip_sync(struct fb_info *info)
+{
+	struct vb2_fb_data *data = info->par;
+
+	flush_workqueue(data->flip_wq);
+}
+
+static void vb2_fb_flip_issued(struct fb_info *info)
+{
+	struct vb2_fb_data *data = info->par;
+
+	data->timeline_max++;
+}
+
+static int vb2_fb_sync_init(struct fb_info *info)
+{
+	struct vb2_fb_data *data = info->par;
+
+	data->timeline = sw_sync_timeline_create("fxifb");
+	if (!data->timeline)
+		return -ENOMEM;
+
+	data->flip_wq = alloc_ordered_workqueue("fxifb-flip", 0);
+	if (!data->flip_wq) {
+		sync_timeline_destroy(&data->timeline->obj);
+		return -ENOMEM;
+	}
+
+	atomic_set(&data->flips_done, 0);
+	INIT_WORK(&data->release_work, vb2_fb_release_work);
+	return 0;
+}
+
+static void vb2_fb_sync_free(struct fb_info *info)
+{
+	struct vb2_fb_data *data = info->par;
+
+	destroy_workqueue(data->flip_wq);
+	cancel_work_sync(&data->release_work);
+	sync_timeline_destroy(&data->timeline->obj);
+}
+
+/* count the flips latched by the mixer on the release timeline */
+static void vb2_fb_sync_start(struct fb_info *info)
+{
+	struct vb2_fb_data *data = info->par;
+	struct mxr_layer *layer = vb2_get_drv_priv(data->q);
+
+	mxr_reg_set_flip_handler(layer->mdev, layer->idx,
+				 vb2_fb_flip_done, info);
+}
+
+static void vb2_fb_sync_exit(struct fb_info *info)
+{
+	struct vb2_fb_data *data = info->par;
+	struct mxr_layer *layer = vb2_get_drv_priv(data->q);
+
+	mxr_reg_set_flip_handler(layer->mdev, layer->idx, NULL, NULL);
+	vb2_fb_sync_free(info);
+}
+#else
+static void vb2_fb_flip_done(void *priv)
+{
+}
+
+static void vb2_fb_flip_sync(struct fb_info *info)
+{
+}
+
+static void vb2_fb_flip_issued(struct fb_info *info)
+{
+}
+
+static void vb2_fb_release_all(struct fb_info *info)
+{
+}
+
+static int vb2_fb_sync_init(struct fb_info *info)
+{
+	return 0;
+}
+
+static void vb2_fb_sync_free(struct fb_info *info)
+{
+}
+
+static void vb2_fb_sync_start(struct fb_info *info)
+{
+}
+
+static void vb2_fb_sync_exit(struct fb_info *info)
+{
+}
+#endif
+
+static int fxifb_pan_display(struct fb_var_screeninfo *var,
+			     struct fb_info *info)
+{
+	int ret;
+
+	/* keep the order with fenced pans still waiting for their fence */
+	vb2_fb_flip_sync(info);
+	ret = fxifb_flip(info, fxifb_screen_addr(info, var->yoffset));
+	if (!ret)
+		vb2_fb_flip_issued(info);
+	return ret;
+}
+
 static int fxifb_wait_for_vsync(struct fb_info *info, u32 crtc)
 {
 	struct vb2_fb_data *data = info->par;
@@ -132,7 +614,8 @@ static int fxifb_wait_for_vsync(struct fb_info *info, u32 crtc)
 	if (crtc != 0)
 		return -ENODEV;
 
-	if (mxr_reg_wait4vsync(mdev) < 0)
+	/* returns once the last panned screen is being scanned out */
+	if (mxr_reg_wait4flip(mdev, layer->idx) < 0)
 		return -ETIMEDOUT;
 
 	return 0;
@@ -167,6 +650,16 @@ static int fxifb_ioctl(struct fb_info *info, unsigned int cmd,
 		break;
 	}
 
+	case FXIFB_GET_DIRTY:
+		ret = fxifb_get_dirty(info, (struct fxifb_dirty __user *)arg);
+		break;
+
+#ifdef CONFIG_SW_SYNC
+	case FXIFB_PAN_FENCE:
+		ret = fxifb_pan_fence(info, (struct fxifb_pan_fence __user *)arg);
+		break;
+#endif
+
 	default:
 		/* Unsupported / Invalid ioctl op */
 		printk(KERN_ERR "fxifb ioctl command: %x\n", cmd);
@@ -177,27 +670,6 @@ static int fxifb_ioctl(struct fb_info *info, unsigned int cmd,
 	return ret;
 }
 
-static int fxifb_pan_display(struct fb_var_screeninfo *var,
-			     struct fb_info *info)
-{
-	struct vb2_fb_data *data = info->par;
-	struct vb2_queue *q = data->q;
-	struct mxr_layer *layer = vb2_get_drv_priv(q);
-	struct mxr_device *mdev = layer->mdev;
-
-	dma_addr_t addr = vb2_dma_contig_plane_dma_addr(q->bufs[0], 0);
-
-	if (var->yoffset)
-		addr += var->yoffset * info->fix.line_length;
-
-	// TODO(havardk): This should only take effect after vsync,
-	// but we still get tearing?  It would be cleaner if we could
-	// queue two different buffers.
-	mxr_reg_set_graph_base(mdev, 0, addr);
-
-	return 0;
-}
-
 /**
  * vb2_drv_lock() - a shortcut to call driver specific lock()
  * @q:		videobuf2 queue
@@ -459,6 +931,7 @@ static int vb2_fb_deactivate(struct fb_info *info)
 	struct vb2_fb_data *data = info->par;
 
 	vb2_fb_stop(info);
+	vb2_fb_dirty_free(data);
 
 	info->screen_base = NULL;
 	info->screen_size = 0;
@@ -528,8 +1001,14 @@ static int vb2_fb_stop(struct fb_info *info)
 	int ret = 0;
 
 	if (data->streaming) {
+		struct mxr_layer *layer = vb2_get_drv_priv(q);
+
+		vb2_fb_flip_sync(info);
+		mxr_reg_flip_reset(layer->mdev, layer->idx);
 		ret = vb2_streamoff(q, q->type);
 		data->streaming = 0;
+		/* nothing is latched or scanned out any more */
+		vb2_fb_release_all(info);
 		dprintk(3, "fb emu: disabled streaming\n");
 	}
 
@@ -719,8 +1198,10 @@ void *vb2_fb_register(struct vb2_queue *q, struct video_device *vfd)
 		return ERR_PTR(-ENODEV);
 
 	info = framebuffer_alloc(sizeof(struct vb2_fb_data), &vfd->dev);
-	if (!info)
-		return ERR_PTR(-ENOMEM);
+	if (!info) {
+		ret = -ENOMEM;
+		goto err_module;
+	}
 
 	data = info->par;
 
@@ -734,13 +1215,7 @@ void *vb2_fb_register(struct vb2_queue *q, struct video_device *vfd)
 	info->flags = FBINFO_FLAG_DEFAULT;
 	info->screen_base = NULL;
 
-	ret = register_framebuffer(info);
-	if (ret)
-		return ERR_PTR(ret);
-
-	printk(KERN_INFO "fb%d: registered frame buffer emulation for /dev/%s\n",
-	       info->node, dev_name(&vfd->dev));
-
+	/* the device may be opened as soon as it is registered */
 	data->blank = 1;
 	data->vfd = vfd;
 	data->q = q;
@@ -749,7 +1224,27 @@ void *vb2_fb_register(struct vb2_queue *q, struct video_device *vfd)
 	data->fake_inode.i_rdev = vfd->cdev->dev;
 	data->dv_preset = 0;
 
+	ret = vb2_fb_sync_init(info);
+	if (ret)
+		goto err_info;
+
+	ret = register_framebuffer(info);
+	if (ret)
+		goto err_sync;
+
+	printk(KERN_INFO "fb%d: registered frame buffer emulation for /dev/%s\n",
+	       info->node, dev_name(&vfd->dev));
+
+	vb2_fb_sync_start(info);
 	return info;
+
+err_sync:
+	vb2_fb_sync_free(info);
+err_info:
+	framebuffer_release(info);
+err_module:
+	module_put(vfd->fops->owner);
+	return ERR_PTR(ret);
 }
 EXPORT_SYMBOL_GPL(vb2_fb_register);
 
@@ -763,6 +1258,7 @@ int vb2_fb_unregister(void *fb_emu)
 	struct vb2_fb_data *data = info->par;
 	struct module *owner = data->vfd->fops->owner;
 
+	vb2_fb_sync_exit(info);
 	unregister_framebuffer(info);
 	module_put(owner);
 	return 0;
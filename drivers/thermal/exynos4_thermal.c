@@ -73,6 +73,9 @@
 #define MAX_TRIP_COUNT	8
 #define MAX_COOLING_DEVICE 4
 
+/* GPU cooling devices register with this type, see the Mali driver */
+#define GPU_COOLING_TYPE "thermal-gpu"
+
 #define ACTIVE_INTERVAL 500
 #define IDLE_INTERVAL 10000
 
@@ -94,6 +97,9 @@ struct exynos4_tmu_data {
 	struct mutex lock;
 	struct clk *clk;
 	u8 temp_error1, temp_error2;
+#ifdef CONFIG_SENSORS_EXYNOS4_TMU_EMUL
+	int emul_temp;
+#endif
 };
 
 struct	thermal_trip_point_conf {
@@ -238,14 +244,23 @@ static int exynos4_get_crit_temp(struct thermal_zone_device *thermal,
 	return ret;
 }
 
+/*
+ * The cpufreq cooling device is ours; GPU cooling devices are registered by
+ * their drivers and bound to the same trips.
+ */
+static bool exynos4_is_cooling_dev(struct thermal_cooling_device *cdev)
+{
+	return cdev == th_zone->cool_dev[0] ||
+		!strcmp(cdev->type, GPU_COOLING_TYPE);
+}
+
 /* Bind callback functions for thermal zone */
 static int exynos4_bind(struct thermal_zone_device *thermal,
 			struct thermal_cooling_device *cdev)
 {
 	int ret = 0;
 
-	/* if the cooling device is the one from exynos4 bind it */
-	if (cdev != th_zone->cool_dev[0])
+	if (!exynos4_is_cooling_dev(cdev))
 		return 0;
 
 	if (thermal_zone_bind_cooling_device(thermal, 0, cdev)) {
@@ -270,7 +285,7 @@ static int exynos4_unbind(struct thermal_zone_device *thermal,
 {
 	int ret = 0;
 
-	if (cdev != th_zone->cool_dev[0])
+	if (!exynos4_is_cooling_dev(cdev))
 		return 0;
 
 	if (thermal_zone_unbind_cooling_device(thermal, 0, cdev)) {
@@ -530,6 +545,11 @@ static int exynos4_tmu_read(struct exynos4_tmu_data *data)
 	u8 temp_code;
 	int temp;
 
+#ifdef CONFIG_SENSORS_EXYNOS4_TMU_EMUL
+	if (data->emul_temp)
+		return data->emul_temp;
+#endif
+
 	mutex_lock(&data->lock);
 	clk_enable(data->clk);
 
@@ -568,6 +588,61 @@ static irqreturn_t exynos4_tmu_irq(int irq, void *id)
 	return IRQ_HANDLED;
 }
 
+#ifdef CONFIG_SENSORS_EXYNOS4_TMU_EMUL
+/*
+ * Writing a temperature in degrees Celsius makes the sensor report it instead
+ * of the measured one, so the trips and cooling devices can be exercised
+ * without heating the board. Write 0 to go back to the real sensor.
+ */
+static ssize_t exynos4_tmu_emul_temp_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct exynos4_tmu_data *data = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\n", data->emul_temp);
+}
+
+static ssize_t exynos4_tmu_emul_temp_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct exynos4_tmu_data *data = dev_get_drvdata(dev);
+	int temp;
+
+	if (kstrtoint(buf, 10, &temp))
+		return -EINVAL;
+
+	if (temp && (temp < 25 || temp > 125))
+		return -EINVAL;
+
+	data->emul_temp = temp;
+	exynos4_report_trigger();
+
+	return count;
+}
+
+static DEVICE_ATTR(emul_temp, S_IRUGO | S_IWUSR, exynos4_tmu_emul_temp_show,
+		   exynos4_tmu_emul_temp_store);
+
+static int exynos4_tmu_emul_register(struct platform_device *pdev)
+{
+	return device_create_file(&pdev->dev, &dev_attr_emul_temp);
+}
+
+static void exynos4_tmu_emul_unregister(struct platform_device *pdev)
+{
+	device_remove_file(&pdev->dev, &dev_attr_emul_temp);
+}
+#else
+static inline int exynos4_tmu_emul_register(struct platform_device *pdev)
+{
+	return 0;
+}
+
+static inline void exynos4_tmu_emul_unregister(struct platform_device *pdev)
+{
+}
+#endif
+
 static struct thermal_sensor_conf exynos4_sensor_conf = {
 	.name			= "exynos4-therm",
 	.read_temperature	= (int (*)(void *))exynos4_tmu_read,
@@ -712,6 +787,13 @@ static int __devinit exynos4_tmu_probe(struct platform_device *pdev)
 		dev_err(&pdev->dev, "Failed to register thermal interface\n");
 		goto err_clk;
 	}
+
+	ret = exynos4_tmu_emul_register(pdev);
+	if (ret) {
+		dev_err(&pdev->dev, "Failed to create emulation interface\n");
+		exynos4_unregister_thermal();
+		goto err_clk;
+	}
 	return 0;
 err_clk:
 	platform_set_drvdata(pdev, NULL);
@@ -732,6 +814,8 @@ static int __devexit exynos4_tmu_remove(struct platform_device *pdev)
 {
 	struct exynos4_tmu_data *data = platform_get_drvdata(pdev);
 
+	exynos4_tmu_emul_unregister(pdev);
+
 	exynos4_tmu_control(pdev, false);
 
 	exynos4_unregister_thermal();
@@ -10,11 +10,22 @@
 #include <linux/platform_device.h>
 #include <linux/completion.h>
 #include <linux/delay.h>
+#include <linux/poll.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/eventfd.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/usb/ccanyscrn.h>
 
 #define DEVNAME "ccanyscrn"
 #define MAX_REQUESTS 128
 #define MAX_BUF_SIZE 4096
+#define STATS_HIST_BUCKETS 12
 
 enum packet_types {
 	NODATA = 0,
@@ -30,6 +41,16 @@ enum message_part {
 	DATA
 };
 
+/* an outstanding shared ring descriptor */
+struct ring_pending {
+	unsigned long type;
+	void *buf;
+	int len;
+	fxi_request_complete_t complete;
+	void *context;
+	ktime_t posted;
+};
+
 /* represents one request in the request queue */
 struct request {
 	unsigned long type;
@@ -37,6 +58,18 @@ struct request {
 	signed long len;
 	void *buf;
 	void *write_buf;
+	ktime_t posted;
+};
+
+/* per session (open of the device) counters, see stats_show() */
+struct anyscreen_stats {
+	u64 calls; /* fxi_request()s from the gadget */
+	u64 requests; /* requests handed to the daemon */
+	u64 blocks;
+	u64 bytes;
+	/* daemon service time, bucket 0 is < 16us, bucket n >= 1 is
+	   [2^(n+3), 2^(n+4)) us, the last one open ended */
+	u32 service_hist[STATS_HIST_BUCKETS];
 };
 
 struct anyscreen {
@@ -56,10 +89,27 @@ struct anyscreen {
 
 	/* current batch being served to USB host */
 	unsigned char batch[CC_USB_MAX_BLOCKS][CC_USB_BLOCK_SIZE];
+	unsigned char *batch_buf; /* batch above, or the ring arena */
 	int batch_size;
 	int batch_valid; /* batch is valid */
 	int batch_block_pointer; /* current batch block pointer */
 
+	/* shared ring transport, see include/linux/usb/ccanyscrn.h */
+	struct cc_anyscreen_ring *ring;
+	unsigned char *arena;
+	unsigned long ring_size;
+	int ring_mode; /* flag: daemon serves requests through the ring */
+	u32 reaped; /* next descriptor to complete */
+	struct ring_pending pending[CC_ANYSCREEN_RING_SLOTS];
+	struct eventfd_ctx *eventfd;
+	wait_queue_head_t poll_wait;
+	wait_queue_head_t ring_wait;
+
+	int max_run; /* largest write handed to the daemon in one request */
+
+	struct anyscreen_stats stats;
+	struct dentry *debug_root;
+
 	/* various flags */
 	int preload; /* flag: preload mode active */
 	int imp_ack; /* flag: ACK is done in driver (not user space) */
@@ -82,9 +132,26 @@ static struct anyscreen *anyscreen_global;
 
 static atomic_t anyscreen_available = ATOMIC_INIT(1);
 
+static void ring_reset(struct anyscreen *p)
+{
+	p->ring_mode = false;
+	p->batch_buf = &p->batch[0][0];
+	if (p->eventfd) {
+		eventfd_ctx_put(p->eventfd);
+		p->eventfd = NULL;
+	}
+	p->ring->head = 0;
+	p->ring->tail = 0;
+	p->reaped = 0;
+	p->ring->entries = CC_ANYSCREEN_RING_ENTRIES;
+	p->ring->arena_offset = p->arena - (unsigned char *)p->ring;
+	p->ring->arena_size = CC_ANYSCREEN_ARENA_SIZE;
+}
+
 static void anyscreen_reset(struct anyscreen *p)
 {
 	mutex_lock(&p->lock);
+	ring_reset(p);
 	p->imp_ack = false;
 	p->current_request = NULL;
 	p->async_queue = NULL;
@@ -96,6 +163,7 @@ static void anyscreen_reset(struct anyscreen *p)
 	p->last_req = -1;
 	p->abort = false;
 	p->message_part = HEADER;
+	p->max_run = MAX_BUF_SIZE;
 	mutex_unlock(&p->lock);
 	dev_info(p->dev, "%s called\n", __func__);
 }
@@ -129,8 +197,78 @@ static struct request *queue_insert(struct anyscreen *p)
 	return req;
 }
 
-void queue_activate(struct anyscreen *p)
+/* statistics */
+
+static void stats_call(struct anyscreen *p, int size)
+{
+	p->stats.calls++;
+	p->stats.blocks += size / CC_USB_BLOCK_SIZE;
+	p->stats.bytes += size;
+}
+
+static void stats_served(struct anyscreen *p, ktime_t posted)
 {
+	s64 us = ktime_us_delta(ktime_get(), posted);
+	int bucket = 0;
+
+	if (us >= 16)
+		bucket = min(ilog2(us) - 3, STATS_HIST_BUCKETS - 1);
+	p->stats.service_hist[bucket]++;
+}
+
+static int stats_show(struct seq_file *seq, void *v)
+{
+	struct anyscreen *p = seq->private;
+	struct anyscreen_stats st;
+	u64 ratio = 0;
+	int i;
+
+	mutex_lock(&p->lock);
+	st = p->stats;
+	mutex_unlock(&p->lock);
+
+	if (st.requests)
+		ratio = div64_u64(st.blocks * 100, st.requests);
+
+	seq_printf(seq, "calls:\t\t%llu\n", st.calls);
+	seq_printf(seq, "requests:\t%llu\n", st.requests);
+	seq_printf(seq, "blocks:\t\t%llu\n", st.blocks);
+	seq_printf(seq, "bytes:\t\t%llu\n", st.bytes);
+	seq_printf(seq, "blocks/request:\t%llu.%02llu\n",
+		   div_u64(ratio, 100), ratio - div_u64(ratio, 100) * 100);
+	seq_printf(seq, "max run:\t%d\n", p->max_run);
+	seq_printf(seq, "service time (us):\n");
+	for (i = 0; i < STATS_HIST_BUCKETS; i++) {
+		if (i == 0)
+			seq_printf(seq, "\t     <16:");
+		else if (i == STATS_HIST_BUCKETS - 1)
+			seq_printf(seq, "\t%8u+:", 1 << (i + 3));
+		else
+			seq_printf(seq, "\t%8u :", 1 << (i + 3));
+		seq_printf(seq, " %u\n", st.service_hist[i]);
+	}
+	return 0;
+}
+
+static int stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stats_show, inode->i_private);
+}
+
+static const struct file_operations stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* caller holds p->lock */
+void queue_activate(struct anyscreen *p, struct request *req)
+{
+	req->posted = ktime_get();
+	p->stats.requests++;
+
 	if (!p->disable_async_notification) {
 		dev_dbg(p->dev, "send SIGIO, start poll\n");
 		p->disable_async_notification = true;
@@ -158,7 +296,8 @@ static void queue_remove(struct anyscreen *p)
 
 static inline void *next_block(struct anyscreen *p, int blocks)
 {
-	void *ptr = p->batch[p->batch_block_pointer % p->batch_size];
+	void *ptr = p->batch_buf +
+		(p->batch_block_pointer % p->batch_size) * CC_USB_BLOCK_SIZE;
 	p->batch_block_pointer += blocks;
 	return ptr;
 }
@@ -198,6 +337,206 @@ static int wait_for_daemon_connected(struct anyscreen *p)
 	return 0;
 }
 
+/* shared ring transport */
+
+static inline int ring_has_room(struct anyscreen *p)
+{
+	return p->ring->head - p->reaped < CC_ANYSCREEN_RING_SLOTS;
+}
+
+static inline void *ring_slot(struct anyscreen *p, u32 seq)
+{
+	return p->arena + CC_ANYSCREEN_BATCH_SIZE +
+		(seq % CC_ANYSCREEN_RING_SLOTS) * CC_ANYSCREEN_SLOT_SIZE;
+}
+
+static void ring_notify(struct anyscreen *p)
+{
+	if (p->eventfd)
+		eventfd_signal(p->eventfd, 1);
+	wake_up_interruptible(&p->poll_wait);
+}
+
+/* a write may carry several blocks (batch mode), any of them can be the
+   ACK or NACK of the current batch */
+static void check_ack(struct anyscreen *p, unsigned long addr,
+		      unsigned char *block, int size)
+{
+	for (; size >= CC_USB_BLOCK_SIZE;
+	     size -= CC_USB_BLOCK_SIZE, block += CC_USB_BLOCK_SIZE, addr++) {
+		/* ACK or NACK, get new batch */
+		if ((addr >= p->in_block) &&
+		    ((block[0] & ACK) || (block[0] == NACK))) {
+			p->batch_valid = false;
+			return;
+		}
+	}
+}
+
+/* post a request to the daemon.  buf is copied into a transfer slot for
+   writes and filled from it on completion for reads; a NULL buf means
+   the daemon fills the batch in place.  complete is called, in ring
+   order, once the daemon has returned the descriptor.  call is set when
+   the request has not been counted by stats_call() yet. */
+static int ring_submit(struct anyscreen *p, unsigned long type,
+		       unsigned long addr, void *buf, int len, int call,
+		       fxi_request_complete_t complete, void *context)
+{
+	struct cc_anyscreen_ring_desc *desc;
+	struct ring_pending *rp;
+	void *payload = p->arena;
+	u32 seq;
+
+	if (wait_event_interruptible(p->ring_wait,
+				     ring_has_room(p) || !p->ring_mode ||
+				     p->abort))
+		return -ERESTARTSYS;
+
+	mutex_lock(&p->lock);
+	/* release may have set abort and reset the ring since the wait */
+	if (!p->ring_mode || p->abort) {
+		mutex_unlock(&p->lock);
+		return -ESHUTDOWN;
+	}
+	if (call)
+		stats_call(p, len);
+	if (type == CC_REQ_WRITE && buf)
+		check_ack(p, addr, buf, len);
+	seq = p->ring->head;
+	if (buf) {
+		payload = ring_slot(p, seq);
+		if (type == CC_REQ_WRITE)
+			memcpy(payload, buf, len);
+	}
+
+	rp = &p->pending[seq % CC_ANYSCREEN_RING_SLOTS];
+	rp->type = type;
+	rp->buf = buf;
+	rp->len = len;
+	rp->complete = complete;
+	rp->context = context;
+	rp->posted = ktime_get();
+	p->stats.requests++;
+
+	desc = &p->ring->desc[seq % CC_ANYSCREEN_RING_ENTRIES];
+	desc->type = type;
+	desc->addr = addr;
+	desc->len = len;
+	desc->offset = (unsigned char *)payload - p->arena;
+	desc->status = 0;
+	desc->seq = seq;
+	/* descriptor must be visible before the daemon sees the new head */
+	smp_wmb();
+	p->ring->head = seq + 1;
+	ring_notify(p);
+	mutex_unlock(&p->lock);
+	return 0;
+}
+
+/* complete every descriptor the daemon has returned, in ring order.
+   With abort set, everything still outstanding is failed instead. */
+static void ring_reap(struct anyscreen *p, int abort)
+{
+	u32 tail;
+
+	mutex_lock(&p->lock);
+	tail = abort ? p->ring->head : ACCESS_ONCE(p->ring->tail);
+	smp_rmb();
+	while (p->reaped != tail && p->reaped != p->ring->head) {
+		u32 seq = p->reaped;
+		struct ring_pending *rp = &p->pending[seq % CC_ANYSCREEN_RING_SLOTS];
+		int status = -1;
+
+		if (!abort &&
+		    p->ring->desc[seq % CC_ANYSCREEN_RING_ENTRIES].status >= 0)
+			status = 0;
+		if (!status && rp->type == CC_REQ_READ && rp->buf)
+			memcpy(rp->buf, ring_slot(p, seq), rp->len);
+		p->reaped = seq + 1;
+		if (!abort)
+			stats_served(p, rp->posted);
+		if (rp->complete)
+			rp->complete(rp->context, status);
+	}
+	mutex_unlock(&p->lock);
+	wake_up_interruptible(&p->ring_wait);
+}
+
+struct ring_waiter {
+	struct completion done;
+	int status;
+};
+
+static void ring_waiter_complete(void *context, int status)
+{
+	struct ring_waiter *w = context;
+
+	w->status = status;
+	complete(&w->done);
+}
+
+static int ring_submit_wait(struct anyscreen *p, unsigned long type,
+			    unsigned long addr, void *buf, int len)
+{
+	struct ring_waiter w;
+
+	init_completion(&w.done);
+	if (ring_submit(p, type, addr, buf, len, false,
+			ring_waiter_complete, &w) < 0)
+		return -1;
+	wait_for_completion(&w.done);
+	return w.status;
+}
+
+static inline int ring_is_batch_read(struct anyscreen *p,
+				     unsigned long addr, unsigned long type)
+{
+	return type == CC_REQ_READ && addr >= p->out_block1 && p->preload;
+}
+
+static int ring_request(struct anyscreen *priv, unsigned long addr,
+			void *buf, unsigned long type, int size)
+{
+	if (ring_is_batch_read(priv, addr, type)) {
+		if (priv->imp_ack && (((addr >= priv->out_block2) && (priv->cur_out_block == priv->out_block1)) ||
+				((addr < priv->out_block2) && (priv->cur_out_block == priv->out_block2)))) {
+			/* implicit ACK, get new batch */
+			priv->batch_valid = false;
+			priv->cur_out_block = priv->cur_out_block == priv->out_block1 ? priv->out_block2 : priv->out_block1;
+		}
+
+		if (!priv->batch_valid) {
+			/* the daemon fills the batch in place */
+			if (ring_submit_wait(priv, type, addr, NULL,
+					     CC_ANYSCREEN_BATCH_SIZE) < 0)
+				return -1;
+			priv->batch_block_pointer = 0;
+			priv->batch_valid = true;
+		}
+
+		memcpy(buf, next_block(priv, size / CC_USB_BLOCK_SIZE), size);
+
+		if (*(uint32_t*)buf == 0) {
+			/* empty batch, need to fetch new batch next time */
+			priv->batch_block_pointer = 0;
+			priv->batch_valid = false;
+		}
+		return 0;
+	}
+
+	while (size) {
+		int bytes = min(size, CC_ANYSCREEN_SLOT_SIZE);
+
+		if (ring_submit_wait(priv, type, addr, buf, bytes) < 0)
+			return -1;
+
+		size -= bytes;
+		buf += bytes;
+		addr += bytes / CC_USB_BLOCK_SIZE;
+	}
+	return 0;
+}
+
 /* called by gadget driver whenever there is a request (read of write)
    from the host */
 int fxi_request (unsigned long addr, void *buf, unsigned long type, int size)
@@ -210,6 +549,7 @@ int fxi_request (unsigned long addr, void *buf, unsigned long type, int size)
 	if (priv->abort) {
 		dev_info(priv->dev, "Abort flag detected, completing shutdown event\n");
 		complete_all(&priv->shutdown);
+		mutex_unlock(&priv->lock);
 		return -1;
 	}
 	mutex_unlock(&priv->lock);
@@ -219,14 +559,17 @@ int fxi_request (unsigned long addr, void *buf, unsigned long type, int size)
 		return -1;
 	}
 
+	stats_call(priv, size);
+	if (priv->ring_mode)
+		return ring_request(priv, addr, buf, type, size);
+
 	if (type == CC_REQ_WRITE) {
 		while (size) {
 			struct request *req;
 			int bytes = size;
-			unsigned char *block = buf;
 
-			if (bytes > MAX_BUF_SIZE)
-				bytes = MAX_BUF_SIZE;
+			if (bytes > priv->max_run)
+				bytes = priv->max_run;
 
 			req = get_request_wait(priv);
 			if (!req) {
@@ -235,21 +578,21 @@ int fxi_request (unsigned long addr, void *buf, unsigned long type, int size)
 				return -1;
 			}
 
-			/* ACK, get new batch */
-			if ((addr >= priv->in_block) && (block[0] & ACK))
-				priv->batch_valid = false;
-
-			/* NACK, get a previous batch */
-			if ((addr >= priv->in_block) && (block[0] == NACK))
-				priv->batch_valid = false;
+			check_ack(priv, addr, buf, bytes);
 
 			mutex_lock(&priv->lock);
 			/* build request */
 			req->addr = addr;
 			req->type = type;
 			req->len = bytes;
-			req->buf = req->write_buf;
-			memcpy(req->write_buf, buf, bytes);
+			if (bytes > MAX_BUF_SIZE) {
+				/* batch mode: we wait for the daemon below,
+				   so it may read the caller's buffer */
+				req->buf = buf;
+			} else {
+				req->buf = req->write_buf;
+				memcpy(req->write_buf, buf, bytes);
+			}
 
 			/* update variables for next request
 			   (if this is longer than a single request) */
@@ -257,7 +600,7 @@ int fxi_request (unsigned long addr, void *buf, unsigned long type, int size)
 			buf += bytes;
 			addr += bytes / CC_USB_BLOCK_SIZE;
 
-			queue_activate(priv);
+			queue_activate(priv, req);
 			mutex_unlock(&priv->lock);
 
 			if (wait_for_user_to_complete_request(priv) < 0) {
@@ -291,7 +634,7 @@ int fxi_request (unsigned long addr, void *buf, unsigned long type, int size)
 				req->buf = priv->batch;
 				req->len = CC_USB_BLOCK_SIZE * CC_USB_MAX_BLOCKS;
 				priv->batch_block_pointer = 0;
-				queue_activate(priv);
+				queue_activate(priv, req);
 				mutex_unlock (&priv->lock);
 
 				if (wait_for_user_to_complete_request(priv) < 0) {
@@ -324,7 +667,7 @@ int fxi_request (unsigned long addr, void *buf, unsigned long type, int size)
 			req->type = type;
 			req->buf = buf;
 			req->len = size;
-			queue_activate(priv);
+			queue_activate(priv, req);
 			mutex_unlock (&priv->lock);
 
 			if (wait_for_user_to_complete_request(priv) < 0) {
@@ -340,6 +683,31 @@ int fxi_request (unsigned long addr, void *buf, unsigned long type, int size)
 }
 EXPORT_SYMBOL_GPL(fxi_request);
 
+/* Like fxi_request(), but returns as soon as the request is on the
+   shared ring so that the caller can keep several requests in flight.
+   complete(context, status) is called once the daemon has served it,
+   in submission order and possibly before this function returns; buf
+   must stay valid until then.  Writes are copied before returning.
+   Without the ring (or for requests it cannot hold) this falls back to
+   fxi_request().  Returns < 0, without calling complete, if the request
+   could not be queued. */
+int fxi_request_async(unsigned long addr, void *buf, unsigned long type,
+		      int size, fxi_request_complete_t complete, void *context)
+{
+	struct anyscreen *priv = anyscreen_global;
+
+	if (!priv->ring_mode || priv->abort ||
+	    size > CC_ANYSCREEN_SLOT_SIZE ||
+	    ring_is_batch_read(priv, addr, type)) {
+		complete(context, fxi_request(addr, buf, type, size));
+		return 0;
+	}
+
+	return ring_submit(priv, type, addr, buf, size, true,
+			   complete, context);
+}
+EXPORT_SYMBOL_GPL(fxi_request_async);
+
 /* fops */
 
 static int anyscreen_open(struct inode *inode, struct file *filp)
@@ -363,6 +731,7 @@ static int anyscreen_open(struct inode *inode, struct file *filp)
 	priv = container_of(filp->private_data, struct anyscreen, miscdev);
 	filp->private_data = priv;
 	anyscreen_global = priv;
+	memset(&priv->stats, 0, sizeof(priv->stats));
 	dev_info(priv->dev, "%s called\n", __func__);
 	return 0;
 }
@@ -383,6 +752,9 @@ static int anyscreen_release(struct inode *inode, struct file *filp)
 	complete_all(&priv->ready_for_new_requests);
 	mutex_unlock(&priv->lock);
 
+	/* fail whatever the daemon left on the ring */
+	ring_reap(priv, true);
+
 	dev_info(priv->dev, "Waiting for shutdown completion event ..\n");
 	wait_for_completion_timeout(&priv->shutdown, jiffs);
 	INIT_COMPLETION(priv->shutdown);
@@ -477,6 +849,10 @@ static long anyscreen_ioctl(struct file *file, unsigned int cmd,
 
 	case CC_ANYSCREEN_IOCTL_BLOCK_DONE: {
 		dev_dbg(priv->dev, "BLOCK_DONE\n");
+		mutex_lock(&priv->lock);
+		if (queue_size(priv))
+			stats_served(priv, queue_front(priv)->posted);
+		mutex_unlock(&priv->lock);
 		queue_remove(priv);
 		complete_all(&priv->ready_for_new_requests);
 		mutex_lock(&priv->lock);
@@ -544,6 +920,44 @@ static long anyscreen_ioctl(struct file *file, unsigned int cmd,
 		break;
 	}
 
+	case CC_ANYSCREEN_IOCTL_RING_ENABLE: {
+		/* arg is an eventfd to signal new work on, or -1 */
+		struct eventfd_ctx *ctx = NULL;
+
+		if ((int)arg >= 0) {
+			ctx = eventfd_ctx_fdget(arg);
+			if (IS_ERR(ctx))
+				return PTR_ERR(ctx);
+		}
+		mutex_lock(&priv->lock);
+		if (priv->eventfd)
+			eventfd_ctx_put(priv->eventfd);
+		priv->eventfd = ctx;
+		priv->batch_buf = priv->arena;
+		priv->batch_valid = false;
+		priv->ring_mode = true;
+		mutex_unlock(&priv->lock);
+		dev_dbg(priv->dev, "ring mode enabled\n");
+		break;
+	}
+
+	case CC_ANYSCREEN_IOCTL_BATCH_MODE: {
+		/* arg is the largest run, in bytes, the daemon takes in one
+		   request (0 turns batch mode off); returns what we'll use */
+		int run = clamp_t(int, arg, MAX_BUF_SIZE, CC_ANYSCREEN_RUN_MAX);
+
+		mutex_lock(&priv->lock);
+		priv->max_run = round_down(run, CC_USB_BLOCK_SIZE);
+		mutex_unlock(&priv->lock);
+		dev_dbg(priv->dev, "batch mode, max run %d\n", priv->max_run);
+		return priv->max_run;
+	}
+
+	case CC_ANYSCREEN_IOCTL_RING_DONE:
+		/* the daemon has advanced ring->tail */
+		ring_reap(priv, false);
+		break;
+
 	default:
 		dev_err(priv->dev, "invalid ioctl code %d\n", cmd);
 		return -EIO;
@@ -557,6 +971,32 @@ static int anyscreen_fasync (int fd, struct file *filp, int mode)
 	return fasync_helper(fd, filp, mode, &priv->async_queue);
 }
 
+static unsigned int anyscreen_poll(struct file *filp, poll_table *wait)
+{
+	struct anyscreen *priv = filp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &priv->poll_wait, wait);
+	if (priv->ring_mode) {
+		if (ACCESS_ONCE(priv->ring->tail) != priv->ring->head)
+			mask |= POLLIN | POLLRDNORM;
+	} else if (priv->current_request || queue_size(priv)) {
+		mask |= POLLIN | POLLRDNORM;
+	}
+	return mask;
+}
+
+static int anyscreen_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct anyscreen *priv = filp->private_data;
+
+	if (vma->vm_pgoff)
+		return -EINVAL;
+	if (vma->vm_end - vma->vm_start > priv->ring_size)
+		return -EINVAL;
+	return remap_vmalloc_range(vma, priv->ring, 0);
+}
+
 static struct file_operations anyscreen_fops = {
 	.owner = THIS_MODULE,
 	.open = anyscreen_open,
@@ -564,10 +1004,22 @@ static struct file_operations anyscreen_fops = {
 	.write = anyscreen_write,
 	.release = anyscreen_release,
 	.fasync = anyscreen_fasync,
+	.poll = anyscreen_poll,
+	.mmap = anyscreen_mmap,
 	.unlocked_ioctl = anyscreen_ioctl,
 };
 
 
+static void anyscreen_free(struct anyscreen *priv)
+{
+	int i;
+
+	for (i = 0; i < MAX_REQUESTS; i++)
+		kfree(priv->request_queue[i].write_buf);
+	vfree(priv->ring);
+	kfree(priv);
+}
+
 static int __devinit anyscreen_probe(struct platform_device *dev)
 {
 	int i, retval;
@@ -589,12 +1041,26 @@ static int __devinit anyscreen_probe(struct platform_device *dev)
 	init_completion(&priv->daemon_running);
 	init_completion(&priv->ready_for_new_requests);
 	init_completion(&priv->shutdown);
+	init_waitqueue_head(&priv->poll_wait);
+	init_waitqueue_head(&priv->ring_wait);
+
+	priv->ring_size = PAGE_ALIGN(sizeof(*priv->ring)) +
+		PAGE_ALIGN(CC_ANYSCREEN_ARENA_SIZE);
+	priv->ring = vmalloc_user(priv->ring_size);
+	if (!priv->ring) {
+		retval = -ENOMEM;
+		goto fail_alloc;
+	}
+	priv->arena = (unsigned char *)priv->ring +
+		PAGE_ALIGN(sizeof(*priv->ring));
 	anyscreen_reset(priv);
 
 	for (i = 0; i < MAX_REQUESTS; i++) {
 		priv->request_queue[i].write_buf = kmalloc(MAX_BUF_SIZE, GFP_KERNEL);
-		if (!priv->request_queue[i].write_buf)
+		if (!priv->request_queue[i].write_buf) {
+			retval = -ENOMEM;
 			goto fail_alloc;
+		}
 	}
 
 	retval = misc_register(&priv->miscdev);
@@ -603,23 +1069,33 @@ static int __devinit anyscreen_probe(struct platform_device *dev)
 	else
 		dev_info(priv->dev, "misc minor: %d\n", priv->miscdev.minor);
 
+	priv->debug_root = debugfs_create_dir(DEVNAME, NULL);
+	if (!IS_ERR_OR_NULL(priv->debug_root))
+		debugfs_create_file("stats", S_IRUGO, priv->debug_root, priv,
+				    &stats_fops);
+
 	dev_info(priv->dev, "init done");
 	return 0;
 
 fail_dev:
-	pr_err(DEVNAME ": no misc device registration failed\n");
-	return -ENODEV;
+	pr_err(DEVNAME ": misc device registration failed\n");
+	goto fail;
 
 fail_alloc:
-	/* TODO: free */
-	pr_err(DEVNAME ":fail to allocate memory\n");
-	return -ENODEV;
+	pr_err(DEVNAME ": fail to allocate memory\n");
+fail:
+	anyscreen_free(priv);
+	dev_set_drvdata(&dev->dev, NULL);
+	anyscreen_global = NULL;
+	return retval;
 }
 
 static int anyscreen_remove(struct platform_device *dev)
 {
 	struct anyscreen *priv = dev_get_drvdata(&dev->dev);
+	debugfs_remove_recursive(priv->debug_root);
 	misc_deregister(&priv->miscdev);
+	anyscreen_free(priv);
 	return 0;
 }
 
@@ -293,12 +293,11 @@
 #include <linux/usb/ch9.h>
 #include <linux/usb/gadget.h>
 #include <linux/usb/composite.h>
+#include <linux/usb/ccanyscrn.h>
 
 #include "gadget_chips.h"
 #include "../../../arch/arm/mach-exynos/fxi-fxiid.h"
 
-int fxi_request(unsigned long addr, void *buf, unsigned long type, int size);
-
 // TODO: make this to a module param
 #define FXI_DISK_SIZE (2 * 1024 * 1024 * 8 + 2 * 512)
 
@@ -326,6 +325,15 @@ static const char fsg_string_interface[] = "Mass Storage";
 struct fsg_dev;
 struct fsg_common;
 
+/* AnyScreen daemon read in flight for one buffer */
+struct fxi_pending {
+	struct fsg_common	*common;
+	unsigned int		amount;
+	int			status;
+	unsigned int		queued:1;
+	unsigned int		done:1;
+};
+
 /* FSF callback functions */
 struct fsg_operations {
 	/*
@@ -373,6 +381,12 @@ struct fsg_common {
 	struct fsg_buffhd	*next_buffhd_to_drain;
 	struct fsg_buffhd	*buffhds;
 
+	/* AnyScreen daemon requests, see fxi_request_async() */
+	struct fxi_pending	*fxi_pending;	/* one per buffhd */
+	atomic_t		fxi_inflight;
+	int			fxi_write_error;
+	wait_queue_head_t	fxi_wait;
+
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
 
@@ -716,6 +730,58 @@ static bool start_out_transfer(struct fsg_common *common, struct fsg_buffhd *bh)
 	return true;
 }
 
+/* AnyScreen request completion, called in process context */
+static void fxi_complete(struct fsg_common *common)
+{
+	atomic_dec(&common->fxi_inflight);
+	wake_up(&common->fxi_wait);
+}
+
+static void fxi_read_complete(void *context, int status)
+{
+	struct fxi_pending	*pending = context;
+	struct fsg_common	*common = pending->common;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&common->lock, flags);
+	pending->status = status;
+	pending->done = 1;
+	wakeup_thread(common);
+	spin_unlock_irqrestore(&common->lock, flags);
+	fxi_complete(common);
+}
+
+static void fxi_write_complete(void *context, int status)
+{
+	struct fsg_common	*common = context;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&common->lock, flags);
+	if (status < 0)
+		common->fxi_write_error = 1;
+	wakeup_thread(common);
+	spin_unlock_irqrestore(&common->lock, flags);
+	fxi_complete(common);
+}
+
+/* Wait until the daemon has returned every request we handed it */
+static void fxi_drain(struct fsg_common *common)
+{
+	unsigned int i;
+
+	wait_event(common->fxi_wait, !atomic_read(&common->fxi_inflight));
+	for (i = 0; i < fsg_num_buffers; ++i) {
+		common->fxi_pending[i].queued = 0;
+		common->fxi_pending[i].done = 0;
+	}
+}
+
+static struct fxi_pending *fxi_pending_of(struct fsg_common *common,
+					  struct fsg_buffhd *bh)
+{
+	return &common->fxi_pending[bh - common->buffhds];
+}
+
 static int sleep_thread(struct fsg_common *common)
 {
 	int	rc = 0;
@@ -743,10 +809,11 @@ static int sleep_thread(struct fsg_common *common)
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
-	u32			lba;
-	struct fsg_buffhd	*bh;
+	u32			lba, req_lba;
+	struct fsg_buffhd	*bh, *req_bh;
+	struct fxi_pending	*pending;
 	int			rc;
-	u32			amount_left;
+	u32			amount_left, amount_left_to_req;
 	unsigned int		amount;
 	loff_t file_offset;
 
@@ -781,31 +848,63 @@ static int do_read(struct fsg_common *common)
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
 
+	fxi_drain(common);
+	amount_left_to_req = amount_left;
+	req_lba = lba;
+	req_bh = common->next_buffhd_to_fill;
+
 	for (;;) {
-		int ret;
 		/*
-		 * Figure out how much we need to read:
-		 * Try to read the remaining amount.
-		 * But don't read more than the buffer size.
-		 * And don't try to read past the end of the file.
+		 * Hand every empty buffer to the daemon, so that it fills
+		 * the next buffers while the earlier ones are being sent.
+		 * Don't read more than the buffer size.  Without the ring
+		 * fxi_request_async() fills the buffer before returning;
+		 * send that one right away rather than filling the rest
+		 * first, so the host gets its first bytes as early as
+		 * before.
 		 */
-		amount = min(amount_left, FSG_BUFLEN);
+		while (amount_left_to_req > 0) {
+			pending = fxi_pending_of(common, req_bh);
+			if (req_bh->state != BUF_STATE_EMPTY || pending->queued)
+				break;
+
+			amount = min(amount_left_to_req, FSG_BUFLEN);
+			pending->common = common;
+			pending->amount = amount;
+			pending->queued = 1;
+			pending->done = 0;
+			atomic_inc(&common->fxi_inflight);
+			if (fxi_request_async(req_lba, req_bh->buf, FXIREAD,
+					      amount, fxi_read_complete,
+					      pending) < 0) {
+				atomic_dec(&common->fxi_inflight);
+				pending->status = -EIO;
+				pending->done = 1;
+			}
 
-		/* Wait for the next buffer to become available */
+			amount_left_to_req -= amount;
+			req_lba += amount >> 9;
+			req_bh = req_bh->next;
+			if (pending->done)
+				break;
+		}
+
+		/* Wait for the next buffer in line to be filled */
 		bh = common->next_buffhd_to_fill;
-		while (bh->state != BUF_STATE_EMPTY) {
+		pending = fxi_pending_of(common, bh);
+		if (!pending->queued || !pending->done) {
 			rc = sleep_thread(common);
-			if (rc)
+			if (rc) {
+				fxi_drain(common);
 				return rc;
+			}
+			continue;
 		}
+		smp_rmb();
+		pending->queued = 0;
+		amount = pending->amount;
 
-		/* Perform the read */
-		ret = fxi_request(lba, bh->buf, FXIREAD, amount);
-
-		if (signal_pending(current))
-			return -EINTR;
-
-		if (ret < 0) {
+		if (pending->status < 0) {
 			curlun->sense_data = SS_UNRECOVERED_READ_ERROR;
 			curlun->sense_data_info = file_offset >> curlun->blkbits;
 			curlun->info_valid = 1;
@@ -814,7 +913,7 @@ static int do_read(struct fsg_common *common)
 
 		amount_left  -= amount;
 		common->residue -= amount;
-    bh->inreq->length = amount;
+		file_offset += amount;
 
 		/*
 		 * Except at the end of the transfer, nread will be
@@ -829,14 +928,15 @@ static int do_read(struct fsg_common *common)
 
 		/* Send this buffer and go read some more */
 		bh->inreq->zero = 0;
-		if (!start_in_transfer(common, bh))
+		if (!start_in_transfer(common, bh)) {
 			/* Don't know what to do if common->fsg is NULL */
+			fxi_drain(common);
 			return -EIO;
+		}
 		common->next_buffhd_to_fill = bh->next;
-
-    lba += amount / 512;
 	}
 
+	fxi_drain(common);
 	return -EIO;		/* No default reply */
 }
 
@@ -885,6 +985,8 @@ static int do_write(struct fsg_common *common)
 	}
 
 	/* Carry out the file writes */
+	fxi_drain(common);
+	common->fxi_write_error = 0;
 	get_some_more = 1;
 	file_offset = usb_offset = ((loff_t) lba) << 9;
 	amount_left_to_req = common->data_size_from_cmnd;
@@ -954,13 +1056,23 @@ static int do_write(struct fsg_common *common)
 			if (amount == 0)
 				goto empty_write;
 
-			/* Perform the write */
-			ret = fxi_request(lba, bh->buf, FXIWRITE, amount);
+			/*
+			 * Perform the write.  The data is copied out of bh
+			 * before this returns, so the buffer can be refilled
+			 * while the daemon is still serving the request.
+			 */
+			atomic_inc(&common->fxi_inflight);
+			ret = fxi_request_async(lba, bh->buf, FXIWRITE, amount,
+						fxi_write_complete, common);
+			if (ret < 0) {
+				atomic_dec(&common->fxi_inflight);
+				common->fxi_write_error = 1;
+			}
 
 			if (signal_pending(current))
 				return -EINTR;
 
-			if (ret < 0) {
+			if (common->fxi_write_error) {
 				curlun->sense_data = SS_WRITE_ERROR;
 				curlun->sense_data_info = file_offset >> curlun->blkbits;
 				curlun->info_valid = 1;
@@ -969,6 +1081,7 @@ static int do_write(struct fsg_common *common)
 
 			amount_left_to_write -= amount;
 			common->residue -= amount;
+			file_offset += amount;
       lba += amount / 512;
 
  empty_write:
@@ -986,6 +1099,14 @@ static int do_write(struct fsg_common *common)
 			return rc;
 	}
 
+	/* Report failures of writes the daemon completed late */
+	fxi_drain(common);
+	if (common->fxi_write_error && !curlun->sense_data) {
+		curlun->sense_data = SS_WRITE_ERROR;
+		curlun->sense_data_info = file_offset >> curlun->blkbits;
+		curlun->info_valid = 1;
+	}
+
 	return -EIO;		/* No default reply */
 }
 
@@ -2568,6 +2689,17 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		return ERR_PTR(-ENOMEM);
 	}
 
+	common->fxi_pending = kcalloc(fsg_num_buffers,
+				      sizeof *(common->fxi_pending), GFP_KERNEL);
+	if (!common->fxi_pending) {
+		kfree(common->buffhds);
+		if (common->free_storage_on_release)
+			kfree(common);
+		return ERR_PTR(-ENOMEM);
+	}
+	atomic_set(&common->fxi_inflight, 0);
+	init_waitqueue_head(&common->fxi_wait);
+
 	common->ops = cfg->ops;
 	common->private_data = cfg->private_data;
 
@@ -2750,6 +2882,7 @@ static void fsg_common_release(struct kref *ref)
 		} while (++bh, --i);
 	}
 
+	kfree(common->fxi_pending);
 	kfree(common->buffhds);
 	if (common->free_storage_on_release)
 		kfree(common);
@@ -12,7 +12,10 @@
 #define __MALI_DRM_H__
 
 /* Mali specific ioctls */
-#define NOT_USED_0_3
+#define DRM_MALI_GEM_CREATE	0x00
+#define DRM_MALI_GEM_MMAP	0x01
+#define DRM_MALI_GEM_UMP_ID	0x02
+#define DRM_MALI_GEM_UMP_IMPORT	0x03
 #define DRM_MALI_FB_ALLOC	0x04
 #define DRM_MALI_FB_FREE	        0x05
 #define NOT_USED_6_12
@@ -21,6 +24,10 @@
 #define DRM_MALI_MEM_FREE	0x15
 #define DRM_MALI_FB_INIT	        0x16
 
+#define DRM_IOCTL_MALI_GEM_CREATE	DRM_IOWR(DRM_COMMAND_BASE + DRM_MALI_GEM_CREATE, struct drm_mali_gem_create)
+#define DRM_IOCTL_MALI_GEM_MMAP		DRM_IOWR(DRM_COMMAND_BASE + DRM_MALI_GEM_MMAP, struct drm_mali_gem_mmap)
+#define DRM_IOCTL_MALI_GEM_UMP_ID	DRM_IOWR(DRM_COMMAND_BASE + DRM_MALI_GEM_UMP_ID, struct drm_mali_gem_ump)
+#define DRM_IOCTL_MALI_GEM_UMP_IMPORT	DRM_IOWR(DRM_COMMAND_BASE + DRM_MALI_GEM_UMP_IMPORT, struct drm_mali_gem_ump)
 #define DRM_IOCTL_MALI_FB_ALLOC		DRM_IOWR(DRM_COMMAND_BASE + DRM_MALI_FB_ALLOC, drm_mali_mem_t)
 #define DRM_IOCTL_MALI_FB_FREE		DRM_IOW( DRM_COMMAND_BASE + DRM_MALI_FB_FREE, drm_mali_mem_t)
 #define DRM_IOCTL_MALI_MEM_INIT		DRM_IOWR(DRM_COMMAND_BASE + DRM_MALI_MEM_INIT, drm_mali_mem_t)
@@ -28,6 +35,41 @@
 #define DRM_IOCTL_MALI_MEM_FREE		DRM_IOW( DRM_COMMAND_BASE + DRM_MALI_MEM_FREE, drm_mali_mem_t)
 #define DRM_IOCTL_MALI_FB_INIT		DRM_IOW( DRM_COMMAND_BASE + DRM_MALI_FB_INIT, drm_mali_fb_t)
 
+/**
+ * Allocates a physically contiguous, write-combined buffer object.
+ * @size: in, rounded up to a whole number of pages
+ * @flags: in, must be 0
+ * @handle: out, GEM handle of the new object
+ */
+struct drm_mali_gem_create {
+	__u64 size;
+	__u32 flags;
+	__u32 handle;
+};
+
+/**
+ * Gets the offset to mmap() the DRM device at to map an object.
+ * @handle: in, GEM handle
+ * @offset: out, fake offset for mmap()
+ */
+struct drm_mali_gem_mmap {
+	__u32 handle;
+	__u32 pad;
+	__u64 offset;
+};
+
+/**
+ * DRM_IOCTL_MALI_GEM_UMP_ID gets the UMP secure ID of an object, for
+ * clients that hand buffers to Mali or X by secure ID.
+ * DRM_IOCTL_MALI_GEM_UMP_IMPORT makes a GEM object of a UMP secure ID.
+ * @handle: GEM handle, in for UMP_ID, out for UMP_IMPORT
+ * @secure_id: UMP secure ID, out for UMP_ID, in for UMP_IMPORT
+ */
+struct drm_mali_gem_ump {
+	__u32 handle;
+	__u32 secure_id;
+};
+
 typedef struct 
 {
 	int context;
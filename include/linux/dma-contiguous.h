@@ -53,10 +53,36 @@
 
 #ifdef __KERNEL__
 
+#include <linux/types.h>
+
 struct cma;
 struct page;
 struct device;
 
+/**
+ * struct dma_contiguous_stats - usage of a contiguous area
+ * @size:	size of the area in bytes
+ * @used:	bytes allocated from the area, the rest is free for movable pages
+ * @max_used:	most bytes allocated at once
+ * @allocs:	successful allocations
+ * @fails:	failed allocations
+ * @busy:	ranges that could not be migrated, and were retried elsewhere
+ * @last_us:	time the last allocation took, mostly migrating pages out
+ * @max_us:	longest allocation
+ * @total_us:	time taken by all the allocations
+ */
+struct dma_contiguous_stats {
+	unsigned long	size;
+	unsigned long	used;
+	unsigned long	max_used;
+	u32		allocs;
+	u32		fails;
+	u32		busy;
+	u32		last_us;
+	u32		max_us;
+	u64		total_us;
+};
+
 #ifdef CONFIG_CMA
 
 /*
@@ -75,6 +101,8 @@ struct page *dma_alloc_from_contiguous(struct device *dev, int count,
 				       unsigned int order);
 bool dma_release_from_contiguous(struct device *dev, struct page *pages,
 				 int count);
+int dma_contiguous_get_stats(struct device *dev,
+			     struct dma_contiguous_stats *stats);
 
 #else
 
@@ -103,6 +131,13 @@ bool dma_release_from_contiguous(struct device *dev, struct page *pages,
 	return false;
 }
 
+static inline
+int dma_contiguous_get_stats(struct device *dev,
+			     struct dma_contiguous_stats *stats)
+{
+	return -ENOSYS;
+}
+
 #endif
 
 #endif
@@ -27,4 +27,54 @@ struct fxifb_platform_data {
 	u32 fb_phys;
 };
 
+/*
+ * Dirty tile tracking, for mirroring the screen over slow links.
+ *
+ * FXIFB_GET_DIRTY compares the displayed frame with the frame handed out
+ * by the previous call, in tiles of FXIFB_TILE_WIDTH x FXIFB_TILE_HEIGHT
+ * pixels, and returns the changed ones: a bitmap with one bit per tile
+ * (row major, LSB first) and, in data, for each set bit a __u32 length
+ * followed by the tile's rows, packed, optionally LZO1X-1 compressed.
+ * The first call reports every tile.  If data fills up, FXIFB_DIRTY_PARTIAL
+ * is set and the next call resumes with the first tile that did not fit;
+ * a tile is only considered delivered once it has been copied to data.
+ */
+#define FXIFB_TILE_WIDTH	64
+#define FXIFB_TILE_HEIGHT	16
+
+#define FXIFB_DIRTY_LZO		(1 << 0)	/* in: compress tiles */
+#define FXIFB_DIRTY_FULL	(1 << 1)	/* in: report every tile */
+#define FXIFB_DIRTY_PARTIAL	(1 << 8)	/* out: data was too small */
+
+struct fxifb_dirty {
+	__u32 flags;
+	__u32 tiles_x;		/* out: tiles per row */
+	__u32 tiles_y;		/* out: tile rows */
+	__u32 ntiles;		/* out: tiles returned */
+	__u64 bitmap;		/* user pointer */
+	__u32 bitmap_len;	/* in: bytes at bitmap */
+	__u32 data_len;		/* in: bytes at data, out: bytes used */
+	__u64 data;		/* user pointer */
+	__u64 diff_ns;		/* out: time spent in the call */
+};
+
+#define FXIFB_GET_DIRTY		_IOWR('m', 313, struct fxifb_dirty)
+
+/*
+ * Fenced panning (needs CONFIG_SW_SYNC).
+ *
+ * Pans to yoffset once acquire_fence (a sync fence fd, or -1) has
+ * signalled, without blocking the caller.  release_fence is a new
+ * sync fence fd that signals once the screen shown before this pan is
+ * no longer scanned out, i.e. when this pan has taken effect.
+ */
+struct fxifb_pan_fence {
+	__u32 yoffset;
+	__s32 acquire_fence;	/* in */
+	__s32 release_fence;	/* out */
+	__u32 reserved;
+};
+
+#define FXIFB_PAN_FENCE		_IOWR('m', 314, struct fxifb_pan_fence)
+
 #endif  /* __FXIFB_H__ */
@@ -27,12 +27,16 @@ struct ion_handle;
  * @ION_HEAP_TYPE_CARVEOUT:	 memory allocated from a prereserved
  * 				 carveout heap, allocations are physically
  * 				 contiguous
+ * @ION_HEAP_TYPE_DMA:		 memory allocated from a CMA area through
+ *				 the DMA API, allocations are physically
+ *				 contiguous
  * @ION_HEAP_END:		 helper for iterating over heaps
  */
 enum ion_heap_type {
 	ION_HEAP_TYPE_SYSTEM,
 	ION_HEAP_TYPE_SYSTEM_CONTIG,
 	ION_HEAP_TYPE_CARVEOUT,
+	ION_HEAP_TYPE_DMA,
 	ION_HEAP_TYPE_CUSTOM, /* must be last so device specific heaps always
 				 are at the end of this enum */
 	ION_NUM_HEAPS,
@@ -41,6 +45,17 @@ enum ion_heap_type {
 #define ION_HEAP_SYSTEM_MASK		(1 << ION_HEAP_TYPE_SYSTEM)
 #define ION_HEAP_SYSTEM_CONTIG_MASK	(1 << ION_HEAP_TYPE_SYSTEM_CONTIG)
 #define ION_HEAP_CARVEOUT_MASK		(1 << ION_HEAP_TYPE_CARVEOUT)
+#define ION_HEAP_TYPE_DMA_MASK		(1 << ION_HEAP_TYPE_DMA)
+
+/*
+ * Buffer flags share the allocation flags with the heap id mask, from the
+ * top bit down, so heap ids must stay below 31.
+ *
+ * ION_FLAG_UNCACHED asks for a buffer that is mapped write-combined, to the
+ * kernel and to userspace.  Without it buffers are mapped cached, and the
+ * client does its own cache maintenance around dma.
+ */
+#define ION_FLAG_UNCACHED		(1 << 31)
 
 #ifdef __KERNEL__
 struct ion_device;
@@ -63,6 +78,8 @@ struct ion_buffer;
  * @name:	used for debug purposes
  * @base:	base address of heap in physical memory if applicable
  * @size:	size of the heap in bytes if applicable
+ * @priv:	heap type specific data; for ION_HEAP_TYPE_DMA the device
+ *		whose CMA area the heap allocates from
  *
  * Provided by the board file.
  */
@@ -72,6 +89,7 @@ struct ion_platform_heap {
 	const char *name;
 	ion_phys_addr_t base;
 	size_t size;
+	void *priv;
 };
 
 /**
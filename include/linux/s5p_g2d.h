@@ -0,0 +1,75 @@
+/*
+ * Samsung S5P G2D - 2D Graphics Accelerator, public API
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version
+ */
+
+#ifndef __LINUX_S5P_G2D_H__
+#define __LINUX_S5P_G2D_H__
+
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+/*
+ * Command lists
+ *
+ * By default every mem2mem job of the G2D is a single blit from the
+ * OUTPUT (source) buffer to the CAPTURE (destination) buffer, configured
+ * with the formats, crop rectangles and controls. A command list attached
+ * to an OUTPUT buffer instead makes the job of that buffer run all the
+ * operations of the list on the source and destination buffers, back to
+ * back, and return the buffers once the last one is done.
+ *
+ * The list stays attached to the buffer, so it is reused each time the
+ * buffer is queued, until it is replaced or cleared with a zero @count.
+ * It can only be changed while the buffer is not queued, and is dropped
+ * when the buffers are freed or the format of either queue is changed.
+ */
+
+enum s5p_g2d_op_type {
+	/* Copy @src of the source to @dst of the destination, stretching
+	 * it if the sizes differ */
+	S5P_G2D_OP_BLIT		= 0,
+	/* Fill @dst of the destination with @color; @src is unused */
+	S5P_G2D_OP_FILL		= 1,
+	/* Combine @src of the source, @dst of the destination and @color
+	 * with the raster operation @rop3, which takes the pattern (@color)
+	 * as the most significant bit of the index, then the source, then
+	 * the destination. @src and @dst must have the same size. */
+	S5P_G2D_OP_ROP		= 2,
+};
+
+/* Raster operations */
+#define S5P_G2D_ROP3_SRC	0xcc
+#define S5P_G2D_ROP3_DST	0xaa
+#define S5P_G2D_ROP3_PAT	0xf0
+#define S5P_G2D_ROP3_NOT_SRC	0x33
+#define S5P_G2D_ROP3_SRC_AND_DST 0x88
+#define S5P_G2D_ROP3_SRC_OR_DST	0xee
+#define S5P_G2D_ROP3_SRC_XOR_DST 0x66
+
+struct s5p_g2d_op {
+	__u32			type;		/* enum s5p_g2d_op_type */
+	__u32			rop3;
+	__u32			color;		/* in the destination format */
+	__u32			reserved;
+	struct v4l2_rect	src;
+	struct v4l2_rect	dst;
+};
+
+#define S5P_G2D_MAX_OPS		1024
+
+struct s5p_g2d_cmdlist {
+	__u32			index;		/* of the OUTPUT buffer */
+	__u32			count;		/* of operations in @ops */
+	__u64			ops;		/* struct s5p_g2d_op __user * */
+	__u32			reserved[4];
+};
+
+#define S5P_G2D_IOC_S_CMDLIST	_IOW('V', BASE_VIDIOC_PRIVATE + 0, \
+				     struct s5p_g2d_cmdlist)
+
+#endif /* __LINUX_S5P_G2D_H__ */
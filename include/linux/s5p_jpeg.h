@@ -0,0 +1,48 @@
+/*
+ * Samsung S5P JPEG codec, public API
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __LINUX_S5P_JPEG_H__
+#define __LINUX_S5P_JPEG_H__
+
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+/*
+ * Batched decoding
+ *
+ * By default the decoder handles a single image at a time: the header of
+ * the JPEG queued on OUTPUT sets the CAPTURE format, which has to be read
+ * back, and the CAPTURE buffer allocated to fit, before the image can be
+ * decoded. That makes every image cost a full format negotiation and a
+ * buffer allocation, which dominates with small images such as thumbnails.
+ *
+ * With V4L2_CID_S5P_JPEG_BATCH set, both queues take any number of
+ * buffers and keep the formats set by the application. OUTPUT buffers
+ * must be large enough for the largest file and CAPTURE buffers for the
+ * largest decoded image, so that the same buffers serve a whole series of
+ * images. The header of each JPEG is parsed once, when it is queued, and
+ * the image is rejected at that point if it does not fit the CAPTURE
+ * format. Once a CAPTURE buffer is dequeued, S5P_JPEG_IOC_G_IMAGE gives
+ * the size of the image decoded into it; bytesused is set accordingly.
+ * The control can only be changed while no buffers are allocated.
+ */
+#define V4L2_CID_S5P_JPEG_BATCH		(V4L2_CID_JPEG_CLASS_BASE + 0x1000)
+
+struct s5p_jpeg_image {
+	__u32			index;		/* of the CAPTURE buffer */
+	__u32			width;		/* aligned as the CAPTURE format */
+	__u32			height;
+	__u32			bytesperline;
+	__u32			subsampling;	/* enum v4l2_jpeg_chroma_subsampling */
+	__u32			reserved[3];
+};
+
+#define S5P_JPEG_IOC_G_IMAGE	_IOWR('V', BASE_VIDIOC_PRIVATE + 0, \
+				      struct s5p_jpeg_image)
+
+#endif /* __LINUX_S5P_JPEG_H__ */
@@ -1,6 +1,8 @@
 #ifndef __CCANYSCREEN_MISC_DRIVER_H__
 #define __CCANYSCREEN_MISC_DRIVER_H__
 
+#include <linux/types.h>
+
 enum request_types {
 	CC_REQ_NONE = 0,
 	CC_REQ_READ,
@@ -23,5 +25,71 @@ enum request_types {
 #define CC_ANYSCREEN_IOCTL_READY (CC_ANYSCREEN_IOCTL_BASE + 9)
 #define CC_ANYSCREEN_IOCTL_HASDATA (CC_ANYSCREEN_IOCTL_BASE + 0xa)
 #define CC_ANYSCREEN_IOCTL_DISABLE_POLL (CC_ANYSCREEN_IOCTL_BASE + 0xb)
+#define CC_ANYSCREEN_IOCTL_RING_ENABLE (CC_ANYSCREEN_IOCTL_BASE + 0xc)
+#define CC_ANYSCREEN_IOCTL_RING_DONE (CC_ANYSCREEN_IOCTL_BASE + 0xd)
+#define CC_ANYSCREEN_IOCTL_BATCH_MODE (CC_ANYSCREEN_IOCTL_BASE + 0xe)
+
+/*
+ * Batch mode
+ *
+ * By default writes reach the daemon in requests of at most 4096 bytes.
+ * CC_ANYSCREEN_IOCTL_BATCH_MODE takes the largest request, in bytes, the
+ * daemon is prepared to accept (0 for the default) and returns the size
+ * the driver settled on, at most CC_ANYSCREEN_RUN_MAX (the mass storage
+ * gadget's buffer size).  Each contiguous run of blocks from the host is
+ * then handed over, and acknowledged, as a single request.
+ */
+#define CC_ANYSCREEN_RUN_MAX 16384
+
+/*
+ * Shared ring transport
+ *
+ * Instead of read()ing a request header and copying the payload through
+ * read()/write(), the daemon may mmap() the device and serve requests
+ * straight out of a shared area.  The area starts with a struct
+ * cc_anyscreen_ring, followed (at ring->arena_offset) by the payload
+ * arena: the preload batch (CC_USB_MAX_BLOCKS * CC_USB_BLOCK_SIZE bytes)
+ * and then CC_ANYSCREEN_RING_SLOTS transfer slots of
+ * CC_ANYSCREEN_SLOT_SIZE bytes each.
+ *
+ * The kernel fills descriptors and advances head; the daemon serves
+ * descriptor[tail % entries], stores its status, advances tail and
+ * issues CC_ANYSCREEN_IOCTL_RING_DONE.  New work is signalled through
+ * poll() and, if one was passed to CC_ANYSCREEN_IOCTL_RING_ENABLE,
+ * an eventfd.  head and tail are free running counters.
+ */
+#define CC_ANYSCREEN_RING_ENTRIES 16
+#define CC_ANYSCREEN_RING_SLOTS 4
+#define CC_ANYSCREEN_SLOT_SIZE 16384
+#define CC_ANYSCREEN_BATCH_SIZE (CC_USB_MAX_BLOCKS * CC_USB_BLOCK_SIZE)
+#define CC_ANYSCREEN_ARENA_SIZE (CC_ANYSCREEN_BATCH_SIZE + \
+				 CC_ANYSCREEN_RING_SLOTS * CC_ANYSCREEN_SLOT_SIZE)
+
+struct cc_anyscreen_ring_desc {
+	__u32 type;	/* CC_REQ_READ or CC_REQ_WRITE */
+	__u32 addr;	/* block address */
+	__u32 len;	/* payload length in bytes */
+	__u32 offset;	/* payload offset from the start of the arena */
+	__s32 status;	/* set by the daemon, 0 or negative errno */
+	__u32 seq;
+};
+
+struct cc_anyscreen_ring {
+	__u32 head;		/* written by the kernel */
+	__u32 tail;		/* written by the daemon */
+	__u32 entries;
+	__u32 arena_offset;
+	__u32 arena_size;
+	__u32 reserved[3];
+	struct cc_anyscreen_ring_desc desc[CC_ANYSCREEN_RING_ENTRIES];
+};
+
+#ifdef __KERNEL__
+typedef void (*fxi_request_complete_t)(void *context, int status);
+
+int fxi_request(unsigned long addr, void *buf, unsigned long type, int size);
+int fxi_request_async(unsigned long addr, void *buf, unsigned long type,
+		      int size, fxi_request_complete_t complete, void *context);
+#endif
 
 #endif
@@ -0,0 +1,112 @@
+/*
+ * Memory-to-memory device pool for Video for Linux 2.
+ *
+ * Helper functions for drivers that expose several identical (or nearly
+ * identical) mem-to-mem engines as one video node and spread the jobs of
+ * all its instances over them.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version
+ */
+
+#ifndef _MEDIA_V4L2_M2M_POOL_H
+#define _MEDIA_V4L2_M2M_POOL_H
+
+#include <linux/ktime.h>
+#include <media/v4l2-mem2mem.h>
+
+#define V4L2_M2M_POOL_MAX_UNITS	8
+
+/**
+ * struct v4l2_m2m_pool_ops - mem-to-mem pool driver callbacks
+ * @unit_run:	required. Begin the job of the instance @priv on the engine
+ *		@unit_priv. When the job finishes, v4l2_m2m_pool_job_finish()
+ *		has to be called, as v4l2_m2m_job_finish() would be for a
+ *		single engine. Called without any pool lock held.
+ * @unit_fits:	optional. Should return 0 if the engine @unit_priv cannot
+ *		do the next job of the instance @priv, e.g. because the job
+ *		needs a feature only some of the engines have. If not
+ *		provided, every engine can run every job. Called with the pool
+ *		spinlock held; this method may not sleep.
+ */
+struct v4l2_m2m_pool_ops {
+	void (*unit_run)(void *unit_priv, void *priv);
+	int (*unit_fits)(void *unit_priv, void *priv);
+};
+
+struct v4l2_m2m_pool;
+
+/**
+ * struct v4l2_m2m_pool_ctx - an instance whose jobs are run by a pool
+ * @m2m_ctx:	the m2m context of the instance, for the v4l2_m2m_* buffer
+ *		and streaming helpers
+ *
+ * Each instance gets a v4l2_m2m_dev of its own. It lets at most one job of
+ * the instance run at a time, so jobs of one instance still complete in
+ * the order their buffers were queued, while the pool runs the jobs of
+ * different instances side by side on its engines.
+ */
+struct v4l2_m2m_pool_ctx {
+	struct v4l2_m2m_ctx	*m2m_ctx;
+
+/* private: internal use only */
+	struct v4l2_m2m_pool	*pool;
+	struct v4l2_m2m_dev	*m2m_dev;
+	struct list_head	queue;
+	int			unit;
+	bool			queued;
+	bool			stopped;
+	ktime_t			queued_at;
+	void			*priv;
+};
+
+/**
+ * struct v4l2_m2m_pool_unit_stats - utilization counters of an engine
+ * @jobs:	jobs completed
+ * @busy_ns:	time spent running jobs
+ * @wait_ns:	time the jobs it ran spent waiting for an engine
+ * @period_ns:	time since the counters were last reset
+ * @disabled:	set while the engine is taken out of the pool
+ * @busy:	set while the engine is running a job
+ */
+struct v4l2_m2m_pool_unit_stats {
+	u32	jobs;
+	u64	busy_ns;
+	u64	wait_ns;
+	u64	period_ns;
+	bool	disabled;
+	bool	busy;
+};
+
+struct v4l2_m2m_pool *v4l2_m2m_pool_init(struct v4l2_m2m_pool_ops *ops);
+void v4l2_m2m_pool_release(struct v4l2_m2m_pool *pool);
+
+int v4l2_m2m_pool_add_unit(struct v4l2_m2m_pool *pool, void *unit_priv,
+			   const char *name);
+int v4l2_m2m_pool_unit_disable(struct v4l2_m2m_pool *pool, int unit,
+			       unsigned long timeout);
+void v4l2_m2m_pool_unit_enable(struct v4l2_m2m_pool *pool, int unit);
+void *v4l2_m2m_pool_get_curr_priv(struct v4l2_m2m_pool *pool, int unit);
+
+int v4l2_m2m_pool_get_stats(struct v4l2_m2m_pool *pool, int unit,
+			    struct v4l2_m2m_pool_unit_stats *stats);
+void v4l2_m2m_pool_reset_stats(struct v4l2_m2m_pool *pool);
+ssize_t v4l2_m2m_pool_show_stats(struct v4l2_m2m_pool *pool, char *buf);
+
+struct v4l2_m2m_pool_ctx *v4l2_m2m_pool_ctx_init(struct v4l2_m2m_pool *pool,
+		struct v4l2_m2m_ops *m2m_ops, void *drv_priv,
+		int (*queue_init)(void *priv, struct vb2_queue *src_vq, struct vb2_queue *dst_vq));
+void v4l2_m2m_pool_ctx_release(struct v4l2_m2m_pool_ctx *pctx);
+
+void v4l2_m2m_pool_ctx_start(struct v4l2_m2m_pool_ctx *pctx);
+int v4l2_m2m_pool_ctx_stop(struct v4l2_m2m_pool_ctx *pctx,
+			   unsigned long timeout);
+
+int v4l2_m2m_pool_job_ready(struct v4l2_m2m_pool_ctx *pctx);
+void v4l2_m2m_pool_job_queue(struct v4l2_m2m_pool_ctx *pctx);
+void v4l2_m2m_pool_job_abort(struct v4l2_m2m_pool_ctx *pctx);
+void v4l2_m2m_pool_job_finish(struct v4l2_m2m_pool_ctx *pctx);
+
+#endif /* _MEDIA_V4L2_M2M_POOL_H */
@@ -0,0 +1,73 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM s5p_mixer
+
+#if !defined(_TRACE_S5P_MIXER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_S5P_MIXER_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(mxr_vsync,
+	    TP_PROTO(unsigned long count),
+
+	    TP_ARGS(count),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned long, count)
+		    ),
+
+	    TP_fast_assign(
+		    __entry->count = count;
+		    ),
+
+	    TP_printk("count=%lu", __entry->count)
+);
+
+TRACE_EVENT(mxr_flip_queue,
+	    TP_PROTO(int idx, u32 addr, int depth),
+
+	    TP_ARGS(idx, addr, depth),
+
+	    TP_STRUCT__entry(
+		    __field(int, idx)
+		    __field(u32, addr)
+		    __field(int, depth)
+		    ),
+
+	    TP_fast_assign(
+		    __entry->idx = idx;
+		    __entry->addr = addr;
+		    __entry->depth = depth;
+		    ),
+
+	    TP_printk("layer=%d addr=%08x depth=%d", __entry->idx,
+		      __entry->addr, __entry->depth)
+);
+
+TRACE_EVENT(mxr_flip_done,
+	    TP_PROTO(int idx, u32 addr, unsigned long vsync, s64 latency_us),
+
+	    TP_ARGS(idx, addr, vsync, latency_us),
+
+	    TP_STRUCT__entry(
+		    __field(int, idx)
+		    __field(u32, addr)
+		    __field(unsigned long, vsync)
+		    __field(s64, latency_us)
+		    ),
+
+	    TP_fast_assign(
+		    __entry->idx = idx;
+		    __entry->addr = addr;
+		    __entry->vsync = vsync;
+		    __entry->latency_us = latency_us;
+		    ),
+
+	    TP_printk("layer=%d addr=%08x vsync=%lu latency=%lldus",
+		      __entry->idx, __entry->addr, __entry->vsync,
+		      __entry->latency_us)
+);
+
+#endif /* if !defined(_TRACE_S5P_MIXER_H) || defined(TRACE_HEADER_MULTI_READ) */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
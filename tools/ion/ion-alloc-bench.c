@@ -0,0 +1,301 @@
+/*
+ * ion-alloc-bench.c -- ION 1080p buffer allocation benchmark
+ *
+ * Allocates a set of 1920x1080 RGBA buffers from /dev/ion, maps each one
+ * into this process, then frees them all, for a number of rounds.  For
+ * each round it prints the mean, minimum and maximum allocation latency,
+ * the mean free latency and how much vmalloc space the kernel used while
+ * the buffers were allocated and mapped, taken from VmallocUsed in
+ * /proc/meminfo.  The first round shows the cost of getting pages from
+ * the page allocator, later rounds the cost when the heap can reuse them.
+ *
+ * With -f, the given amount of anonymous memory is touched and then every
+ * other page of it is unmapped before the first round, so that free memory
+ * is fragmented and a contiguous heap (-m 8 on the FXI board's CMA heap)
+ * has to migrate pages to satisfy an allocation.  MemFree and Cached are
+ * printed before and after, which shows how much of the memory set aside
+ * for the heap remained usable by userspace and the page cache.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -o ion-alloc-bench ion-alloc-bench.c */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/* userspace ABI, from include/linux/ion.h */
+struct ion_handle;
+
+struct ion_allocation_data {
+	size_t len;
+	size_t align;
+	unsigned int flags;
+	struct ion_handle *handle;
+};
+
+struct ion_fd_data {
+	struct ion_handle *handle;
+	int fd;
+};
+
+struct ion_handle_data {
+	struct ion_handle *handle;
+};
+
+#define ION_IOC_MAGIC		'I'
+#define ION_IOC_ALLOC		_IOWR(ION_IOC_MAGIC, 0, struct ion_allocation_data)
+#define ION_IOC_FREE		_IOWR(ION_IOC_MAGIC, 1, struct ion_handle_data)
+#define ION_IOC_MAP		_IOWR(ION_IOC_MAGIC, 2, struct ion_fd_data)
+
+#define ION_HEAP_SYSTEM_MASK	(1 << 0)
+#define ION_HEAP_DMA_MASK	(1 << 3)
+#define ION_FLAG_UNCACHED	(1u << 31)
+
+#define BUFFER_SIZE		(1920 * 1080 * 4)
+#define MAX_BUFFERS		64
+
+static const char *device = "/dev/ion";
+static unsigned int heap_mask = ION_HEAP_SYSTEM_MASK;
+static unsigned int nr_buffers = 16;
+static unsigned int rounds = 5;
+static int uncached;
+static unsigned int fragment_mb;
+
+struct buffer {
+	struct ion_handle *handle;
+	int fd;
+	void *map;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static long meminfo_kb(const char *field)
+{
+	char line[128];
+	size_t len = strlen(field);
+	long kb = -1;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+		if (!strncmp(line, field, len) && line[len] == ':') {
+			kb = strtol(line + len + 1, NULL, 10);
+			break;
+		}
+	fclose(f);
+	return kb;
+}
+
+static long vmalloc_used_kb(void)
+{
+	return meminfo_kb("VmallocUsed");
+}
+
+static void print_meminfo(const char *when)
+{
+	printf("%s: MemFree %ld KiB, Cached %ld KiB\n", when,
+	       meminfo_kb("MemFree"), meminfo_kb("Cached"));
+}
+
+/*
+ * Leaves every other page of the region mapped, so the page allocator has
+ * no free block larger than a page in the memory it came from.
+ */
+static int fragment(size_t size)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	char *p;
+	size_t off;
+
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		perror("mmap fragment");
+		return -1;
+	}
+	for (off = 0; off < size; off += page)
+		p[off] = 1;
+	for (off = 0; off < size; off += 2 * page)
+		munmap(p + off, page);
+	return 0;
+}
+
+static void release(int fd, struct buffer *buf)
+{
+	struct ion_handle_data data;
+
+	if (buf->map && buf->map != MAP_FAILED)
+		munmap(buf->map, BUFFER_SIZE);
+	if (buf->fd >= 0)
+		close(buf->fd);
+	if (buf->handle) {
+		data.handle = buf->handle;
+		ioctl(fd, ION_IOC_FREE, &data);
+	}
+	memset(buf, 0, sizeof(*buf));
+	buf->fd = -1;
+}
+
+static int round_run(int fd, unsigned int round)
+{
+	uint64_t alloc_total = 0, alloc_min = UINT64_MAX, alloc_max = 0;
+	struct buffer bufs[MAX_BUFFERS];
+	long vmalloc_before, vmalloc_held;
+	uint64_t t0, t1;
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < nr_buffers; i++) {
+		memset(&bufs[i], 0, sizeof(bufs[i]));
+		bufs[i].fd = -1;
+	}
+
+	vmalloc_before = vmalloc_used_kb();
+
+	for (i = 0; i < nr_buffers; i++) {
+		struct ion_allocation_data alloc;
+		struct ion_fd_data map;
+
+		memset(&alloc, 0, sizeof(alloc));
+		alloc.len = BUFFER_SIZE;
+		alloc.align = 4096;
+		alloc.flags = heap_mask | (uncached ? ION_FLAG_UNCACHED : 0);
+
+		t0 = now_ns();
+		if (ioctl(fd, ION_IOC_ALLOC, &alloc)) {
+			fprintf(stderr, "allocate buffer %u: %s\n", i,
+				strerror(errno));
+			ret = -1;
+			goto out;
+		}
+		t1 = now_ns();
+		bufs[i].handle = alloc.handle;
+
+		alloc_total += t1 - t0;
+		if (t1 - t0 < alloc_min)
+			alloc_min = t1 - t0;
+		if (t1 - t0 > alloc_max)
+			alloc_max = t1 - t0;
+
+		map.handle = alloc.handle;
+		if (ioctl(fd, ION_IOC_MAP, &map)) {
+			fprintf(stderr, "map buffer %u: %s\n", i,
+				strerror(errno));
+			ret = -1;
+			goto out;
+		}
+		bufs[i].fd = map.fd;
+		bufs[i].map = mmap(NULL, BUFFER_SIZE, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, map.fd, 0);
+		if (bufs[i].map == MAP_FAILED) {
+			fprintf(stderr, "mmap buffer %u: %s\n", i,
+				strerror(errno));
+			ret = -1;
+			goto out;
+		}
+		((volatile uint32_t *)bufs[i].map)[0] = i;
+	}
+
+	vmalloc_held = vmalloc_used_kb();
+
+	t0 = now_ns();
+	for (i = 0; i < nr_buffers; i++)
+		release(fd, &bufs[i]);
+	t1 = now_ns();
+
+	printf("%5u %11.1f %11.1f %11.1f %11.1f %14ld %14ld\n", round,
+	       alloc_total / 1e3 / nr_buffers, alloc_min / 1e3,
+	       alloc_max / 1e3, (t1 - t0) / 1e3 / nr_buffers,
+	       vmalloc_before, vmalloc_held - vmalloc_before);
+	return 0;
+
+out:
+	for (i = 0; i < nr_buffers; i++)
+		release(fd, &bufs[i]);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int round;
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "d:f:m:n:r:u")) != -1) {
+		switch (opt) {
+		case 'd':
+			device = optarg;
+			break;
+		case 'f':
+			fragment_mb = atoi(optarg);
+			break;
+		case 'm':
+			heap_mask = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			nr_buffers = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'u':
+			uncached = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-d device] [-f MiB] [-m heap mask] [-n buffers] [-r rounds] [-u]\n"
+				"  -f  fragment this much memory before allocating\n"
+				"  -u  uncached (write-combined) buffers\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (!nr_buffers || nr_buffers > MAX_BUFFERS) {
+		fprintf(stderr, "-n must be between 1 and %d\n", MAX_BUFFERS);
+		return 1;
+	}
+
+	fd = open(device, O_RDWR);
+	if (fd < 0) {
+		perror(device);
+		return 1;
+	}
+
+	printf("%u buffers of %u KiB, heap mask 0x%x, %s\n", nr_buffers,
+	       BUFFER_SIZE >> 10, heap_mask, uncached ? "uncached" : "cached");
+	print_meminfo("before");
+	if (fragment_mb) {
+		if (fragment((size_t)fragment_mb << 20)) {
+			close(fd);
+			return 1;
+		}
+		print_meminfo("fragmented");
+	}
+	printf("%5s %11s %11s %11s %11s %14s %14s\n", "round", "alloc us",
+	       "min us", "max us", "free us", "vmalloc KiB", "+held KiB");
+	for (round = 0; round < rounds; round++)
+		if (round_run(fd, round))
+			break;
+	print_meminfo("after");
+
+	close(fd);
+	return 0;
+}
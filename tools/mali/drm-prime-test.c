@@ -0,0 +1,327 @@
+/*
+ * drm-prime-test.c -- Mali DRM buffer sharing test
+ *
+ * Opens the Mali DRM device twice, as two clients would.  The first client
+ * allocates a buffer object, maps it and fills it with a pattern.  The
+ * buffer is then passed to the second client twice, once as a PRIME
+ * (dma-buf) file descriptor and once by its UMP secure ID, and each time
+ * the second client maps what it imported and checks that it sees the
+ * pattern.  A write through the imported mapping is checked back in the
+ * first client's mapping.  Every step is timed, and the program exits
+ * non-zero on the first step that fails.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -o drm-prime-test drm-prime-test.c */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/* userspace ABI, from include/drm/drm.h and include/drm/mali_drm.h */
+struct drm_auth {
+	unsigned int magic;
+};
+
+struct drm_gem_close {
+	uint32_t handle;
+	uint32_t pad;
+};
+
+struct drm_prime_handle {
+	uint32_t handle;
+	uint32_t flags;
+	int32_t fd;
+};
+
+struct drm_mali_gem_create {
+	uint64_t size;
+	uint32_t flags;
+	uint32_t handle;
+};
+
+struct drm_mali_gem_mmap {
+	uint32_t handle;
+	uint32_t pad;
+	uint64_t offset;
+};
+
+struct drm_mali_gem_ump {
+	uint32_t handle;
+	uint32_t secure_id;
+};
+
+#define DRM_IOCTL_BASE			'd'
+#define DRM_COMMAND_BASE		0x40
+#define DRM_IOCTL_GET_MAGIC		_IOR(DRM_IOCTL_BASE, 0x02, struct drm_auth)
+#define DRM_IOCTL_GEM_CLOSE		_IOW(DRM_IOCTL_BASE, 0x09, struct drm_gem_close)
+#define DRM_IOCTL_AUTH_MAGIC		_IOW(DRM_IOCTL_BASE, 0x11, struct drm_auth)
+#define DRM_IOCTL_PRIME_HANDLE_TO_FD	_IOWR(DRM_IOCTL_BASE, 0x2d, struct drm_prime_handle)
+#define DRM_IOCTL_PRIME_FD_TO_HANDLE	_IOWR(DRM_IOCTL_BASE, 0x2e, struct drm_prime_handle)
+
+#define DRM_IOCTL_MALI_GEM_CREATE	_IOWR(DRM_IOCTL_BASE, DRM_COMMAND_BASE + 0x00, struct drm_mali_gem_create)
+#define DRM_IOCTL_MALI_GEM_MMAP		_IOWR(DRM_IOCTL_BASE, DRM_COMMAND_BASE + 0x01, struct drm_mali_gem_mmap)
+#define DRM_IOCTL_MALI_GEM_UMP_ID	_IOWR(DRM_IOCTL_BASE, DRM_COMMAND_BASE + 0x02, struct drm_mali_gem_ump)
+#define DRM_IOCTL_MALI_GEM_UMP_IMPORT	_IOWR(DRM_IOCTL_BASE, DRM_COMMAND_BASE + 0x03, struct drm_mali_gem_ump)
+
+static const char *device = "/dev/dri/card0";
+static size_t size = 1920 * 1080 * 4;
+static unsigned int rounds = 1;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void step(const char *what, uint64_t t0)
+{
+	printf("  %-24s %9.1f us\n", what, (now_ns() - t0) / 1e3);
+}
+
+static int xioctl(int fd, unsigned long request, void *arg, const char *what)
+{
+	int ret;
+
+	do
+		ret = ioctl(fd, request, arg);
+	while (ret && (errno == EINTR || errno == EAGAIN));
+	if (ret)
+		fprintf(stderr, "%s: %s\n", what, strerror(errno));
+	return ret;
+}
+
+static uint32_t pattern(size_t i, unsigned int seed)
+{
+	return (uint32_t)i * 2654435761u ^ seed;
+}
+
+static void fill(void *map, unsigned int seed)
+{
+	uint32_t *p = map;
+	size_t i;
+
+	for (i = 0; i < size / 4; i++)
+		p[i] = pattern(i, seed);
+}
+
+static int check(const void *map, unsigned int seed, const char *what)
+{
+	const uint32_t *p = map;
+	size_t i;
+
+	for (i = 0; i < size / 4; i++)
+		if (p[i] != pattern(i, seed)) {
+			fprintf(stderr, "%s: word %zu is 0x%08x, expected 0x%08x\n",
+				what, i, p[i], pattern(i, seed));
+			return -1;
+		}
+	return 0;
+}
+
+static void *map_handle(int fd, uint32_t handle, const char *what)
+{
+	struct drm_mali_gem_mmap req;
+	void *map;
+
+	memset(&req, 0, sizeof(req));
+	req.handle = handle;
+	if (xioctl(fd, DRM_IOCTL_MALI_GEM_MMAP, &req, what))
+		return NULL;
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		   req.offset);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "%s: mmap: %s\n", what, strerror(errno));
+		return NULL;
+	}
+	return map;
+}
+
+static void close_handle(int fd, uint32_t handle)
+{
+	struct drm_gem_close req;
+
+	memset(&req, 0, sizeof(req));
+	req.handle = handle;
+	xioctl(fd, DRM_IOCTL_GEM_CLOSE, &req, "close handle");
+}
+
+/*
+ * Checks one import in the second client: the pattern written by the first
+ * client must be visible, and a new pattern written here must show up in
+ * the first client's mapping.
+ */
+static int check_import(int fd, uint32_t handle, void *exporter_map,
+			unsigned int seed, const char *what)
+{
+	uint64_t t0;
+	void *map;
+	int ret;
+
+	t0 = now_ns();
+	map = map_handle(fd, handle, what);
+	if (!map)
+		return -1;
+	step("map import", t0);
+
+	t0 = now_ns();
+	ret = check(map, seed, what);
+	if (!ret) {
+		fill(map, seed + 1);
+		ret = check(exporter_map, seed + 1, what);
+	}
+	step("check import", t0);
+
+	munmap(map, size);
+	return ret;
+}
+
+static int round_run(int fd, int fd2, unsigned int round)
+{
+	struct drm_mali_gem_create create;
+	struct drm_prime_handle prime;
+	struct drm_mali_gem_ump ump;
+	uint32_t imported;
+	unsigned int seed = round * 4;
+	void *map = NULL;
+	uint64_t t0;
+	int ret = -1;
+
+	printf("round %u\n", round);
+
+	memset(&create, 0, sizeof(create));
+	create.size = size;
+	t0 = now_ns();
+	if (xioctl(fd, DRM_IOCTL_MALI_GEM_CREATE, &create, "create"))
+		return -1;
+	step("create", t0);
+
+	map = map_handle(fd, create.handle, "map");
+	if (!map)
+		goto out;
+	fill(map, seed);
+
+	/* by dma-buf */
+	memset(&prime, 0, sizeof(prime));
+	prime.handle = create.handle;
+	prime.flags = O_CLOEXEC;
+	t0 = now_ns();
+	if (xioctl(fd, DRM_IOCTL_PRIME_HANDLE_TO_FD, &prime, "export"))
+		goto out;
+	step("export dma-buf", t0);
+
+	t0 = now_ns();
+	ret = xioctl(fd2, DRM_IOCTL_PRIME_FD_TO_HANDLE, &prime, "import");
+	close(prime.fd);
+	if (ret)
+		goto out;
+	step("import dma-buf", t0);
+	imported = prime.handle;
+
+	ret = check_import(fd2, imported, map, seed, "dma-buf");
+	close_handle(fd2, imported);
+	if (ret)
+		goto out;
+
+	/* by UMP secure ID */
+	memset(&ump, 0, sizeof(ump));
+	ump.handle = create.handle;
+	ret = -1;
+	if (xioctl(fd, DRM_IOCTL_MALI_GEM_UMP_ID, &ump, "ump id"))
+		goto out;
+	fill(map, seed + 2);
+
+	t0 = now_ns();
+	if (xioctl(fd2, DRM_IOCTL_MALI_GEM_UMP_IMPORT, &ump, "ump import"))
+		goto out;
+	step("import ump", t0);
+	imported = ump.handle;
+
+	ret = check_import(fd2, imported, map, seed + 2, "ump");
+	close_handle(fd2, imported);
+
+out:
+	if (map)
+		munmap(map, size);
+	close_handle(fd, create.handle);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	struct drm_auth auth;
+	unsigned int round;
+	long page = sysconf(_SC_PAGESIZE);
+	int fd, fd2, opt;
+	int ret = 0;
+
+	while ((opt = getopt(argc, argv, "d:r:s:")) != -1) {
+		switch (opt) {
+		case 'd':
+			device = optarg;
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-d device] [-r rounds] [-s bytes]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	size = (size + page - 1) & ~(size_t)(page - 1);
+	if (!size) {
+		fprintf(stderr, "-s must not be 0\n");
+		return 1;
+	}
+
+	fd = open(device, O_RDWR);
+	if (fd < 0) {
+		perror(device);
+		return 1;
+	}
+	fd2 = open(device, O_RDWR);
+	if (fd2 < 0) {
+		perror(device);
+		close(fd);
+		return 1;
+	}
+
+	/*
+	 * The second client has to be authenticated by the master.  That only
+	 * works when the first open made us master, i.e. no X server is
+	 * running; otherwise we rely on running as root.
+	 */
+	if (!ioctl(fd2, DRM_IOCTL_GET_MAGIC, &auth) &&
+	    ioctl(fd, DRM_IOCTL_AUTH_MAGIC, &auth))
+		fprintf(stderr, "warning: cannot authenticate second client: %s\n",
+			strerror(errno));
+
+	printf("%zu KiB buffer objects on %s\n", size >> 10, device);
+	for (round = 0; round < rounds; round++)
+		if (round_run(fd, fd2, round)) {
+			ret = 1;
+			break;
+		}
+	printf("%s\n", ret ? "FAIL" : "PASS");
+
+	close(fd2);
+	close(fd);
+	return ret;
+}
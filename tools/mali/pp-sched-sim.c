@@ -0,0 +1,450 @@
+/*
+ * pp-sched-sim.c -- Mali PP job scheduling simulator
+ *
+ * Feeds a trace of PP jobs through a model of the PP scheduler's job
+ * selection and prints, per session, the number of jobs, the mean and
+ * maximum latency from submission to completion of the last sub job, and
+ * how many jobs took longer than the session's frame period.  Each trace
+ * is run twice: with the old single FIFO job queue, and with per-session
+ * queues picked by priority and taking turns job by job within a priority,
+ * as done by mali_pp_scheduler_get_physical_job() and
+ * mali_pp_scheduler_dequeue_physical_job().
+ *
+ * A trace has one session per "session" line and one job per "job" line,
+ * jobs sorted by submission time:
+ *
+ *   session <name> <high|normal|background> <frame period us>
+ *   job <submit time us> <session name> <sub jobs> <us per sub job>
+ *
+ * Without -t a synthetic trace is used: a compositor and a foreground
+ * application rendering at 60 fps and a background application submitting
+ * bursts of long fragment jobs.  -g prints that trace, as a starting point
+ * for other ones.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -o pp-sched-sim pp-sched-sim.c */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_SESSIONS	16
+#define MAX_CORES	8
+#define MAX_SUB_JOBS	8
+#define PRIORITY_COUNT	3
+
+static const char *priority_names[PRIORITY_COUNT] = {
+	"high", "normal", "background"
+};
+
+struct job {
+	uint64_t submit;
+	unsigned int session;
+	unsigned int sub_jobs;
+	unsigned int sub_job_us;
+
+	/* simulation state */
+	unsigned int started;
+	unsigned int completed;
+	struct job *next;		/* in the FIFO or session queue */
+};
+
+struct session {
+	char name[32];
+	unsigned int priority;
+	unsigned int period_us;
+
+	/* simulation state */
+	struct job *head, *tail;	/* queued jobs with unstarted sub jobs */
+	struct session *next;		/* in the list of its priority */
+	unsigned int jobs;
+	uint64_t latency_total;
+	uint64_t latency_max;
+	unsigned int late;
+};
+
+struct core {
+	struct job *job;
+	uint64_t done;
+};
+
+static struct session sessions[MAX_SESSIONS];
+static unsigned int nr_sessions;
+static struct job *jobs;
+static unsigned int nr_jobs;
+static unsigned int nr_cores = 4;
+
+/* FIFO policy state */
+static struct job *fifo_head, *fifo_tail;
+
+/* priority policy state */
+static struct session *prio_head[PRIORITY_COUNT], *prio_tail[PRIORITY_COUNT];
+
+static void add_job(uint64_t submit, unsigned int session,
+		    unsigned int sub_jobs, unsigned int sub_job_us)
+{
+	static unsigned int alloc;
+
+	if (nr_jobs == alloc) {
+		alloc = alloc ? alloc * 2 : 1024;
+		jobs = realloc(jobs, alloc * sizeof(*jobs));
+		if (!jobs) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	memset(&jobs[nr_jobs], 0, sizeof(*jobs));
+	jobs[nr_jobs].submit = submit;
+	jobs[nr_jobs].session = session;
+	jobs[nr_jobs].sub_jobs = sub_jobs;
+	jobs[nr_jobs].sub_job_us = sub_job_us;
+	nr_jobs++;
+}
+
+static int add_session(const char *name, const char *priority,
+		       unsigned int period_us)
+{
+	struct session *s;
+	unsigned int i;
+
+	if (nr_sessions == MAX_SESSIONS)
+		return -1;
+	s = &sessions[nr_sessions];
+	memset(s, 0, sizeof(*s));
+	snprintf(s->name, sizeof(s->name), "%s", name);
+	for (i = 0; i < PRIORITY_COUNT; i++)
+		if (!strcmp(priority, priority_names[i]))
+			break;
+	if (i == PRIORITY_COUNT)
+		return -1;
+	s->priority = i;
+	s->period_us = period_us;
+	nr_sessions++;
+	return 0;
+}
+
+static void synthetic_trace(unsigned int seconds)
+{
+	uint64_t t;
+
+	add_session("compositor", "high", 16667);
+	add_session("app", "normal", 16667);
+	add_session("background", "background", 50000);
+
+	for (t = 0; t < seconds * 1000000ull; t += 16667) {
+		add_job(t, 0, 4, 1500);
+		add_job(t + 2000, 1, 4, 3000);
+	}
+	/* the background application renders a few frames at a time */
+	for (t = 500; t < seconds * 1000000ull; t += 50000) {
+		add_job(t, 2, 4, 8000);
+		add_job(t, 2, 4, 8000);
+		add_job(t, 2, 4, 8000);
+	}
+
+	/* merge the three streams into submission order */
+	for (t = 1; t < nr_jobs; t++) {
+		struct job j = jobs[t];
+		uint64_t k = t;
+
+		while (k > 0 && jobs[k - 1].submit > j.submit) {
+			jobs[k] = jobs[k - 1];
+			k--;
+		}
+		jobs[k] = j;
+	}
+}
+
+static int read_trace(const char *path)
+{
+	char line[256], a[64], b[64];
+	unsigned long long submit;
+	unsigned int x, y, i;
+	FILE *f;
+	int lineno = 0;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "session %63s %63s %u", a, b, &x) == 3) {
+			if (add_session(a, b, x))
+				goto bad;
+			continue;
+		}
+		if (sscanf(line, "job %llu %63s %u %u", &submit, a, &x, &y) != 4)
+			goto bad;
+		for (i = 0; i < nr_sessions; i++)
+			if (!strcmp(sessions[i].name, a))
+				break;
+		if (i == nr_sessions || !x || x > MAX_SUB_JOBS ||
+		    (nr_jobs && submit < jobs[nr_jobs - 1].submit))
+			goto bad;
+		add_job(submit, i, x, y);
+	}
+	fclose(f);
+	return 0;
+bad:
+	fprintf(stderr, "%s:%d: bad line\n", path, lineno);
+	fclose(f);
+	return -1;
+}
+
+static void print_trace(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_sessions; i++)
+		printf("session %s %s %u\n", sessions[i].name,
+		       priority_names[sessions[i].priority],
+		       sessions[i].period_us);
+	for (i = 0; i < nr_jobs; i++)
+		printf("job %llu %s %u %u\n",
+		       (unsigned long long)jobs[i].submit,
+		       sessions[jobs[i].session].name, jobs[i].sub_jobs,
+		       jobs[i].sub_job_us);
+}
+
+/* the old scheduler: one queue of jobs in submission order */
+static void fifo_queue(struct job *job)
+{
+	if (fifo_tail)
+		fifo_tail->next = job;
+	else
+		fifo_head = job;
+	fifo_tail = job;
+}
+
+static struct job *fifo_get(void)
+{
+	return fifo_head;
+}
+
+static void fifo_dequeue(struct job *job)
+{
+	if (job->started < job->sub_jobs)
+		return;
+	fifo_head = job->next;
+	if (!fifo_head)
+		fifo_tail = NULL;
+}
+
+/* the new scheduler: sessions by priority, taking turns job by job */
+static void prio_add_session(struct session *s)
+{
+	s->next = NULL;
+	if (prio_tail[s->priority])
+		prio_tail[s->priority]->next = s;
+	else
+		prio_head[s->priority] = s;
+	prio_tail[s->priority] = s;
+}
+
+static void prio_queue(struct job *job)
+{
+	struct session *s = &sessions[job->session];
+
+	if (s->tail) {
+		s->tail->next = job;
+	} else {
+		s->head = job;
+		prio_add_session(s);
+	}
+	s->tail = job;
+}
+
+static struct job *prio_get(void)
+{
+	unsigned int p;
+
+	for (p = 0; p < PRIORITY_COUNT; p++)
+		if (prio_head[p])
+			return prio_head[p]->head;
+	return NULL;
+}
+
+static void prio_dequeue(struct job *job)
+{
+	struct session *s = &sessions[job->session];
+
+	if (job->started < job->sub_jobs)
+		return;
+
+	s->head = job->next;
+	if (!s->head)
+		s->tail = NULL;
+
+	/* the session is at the head of its list, rotate it to the back */
+	prio_head[s->priority] = s->next;
+	if (!prio_head[s->priority])
+		prio_tail[s->priority] = NULL;
+	if (s->head)
+		prio_add_session(s);
+}
+
+struct policy {
+	const char *name;
+	void (*queue)(struct job *job);
+	struct job *(*get)(void);
+	void (*dequeue)(struct job *job);
+};
+
+static const struct policy policies[] = {
+	{ "fifo", fifo_queue, fifo_get, fifo_dequeue },
+	{ "priority", prio_queue, prio_get, prio_dequeue },
+};
+
+static void simulate(const struct policy *policy)
+{
+	struct core cores[MAX_CORES];
+	unsigned int next_job = 0, done = 0, i;
+	uint64_t now = 0;
+
+	memset(cores, 0, sizeof(cores));
+	fifo_head = fifo_tail = NULL;
+	memset(prio_head, 0, sizeof(prio_head));
+	memset(prio_tail, 0, sizeof(prio_tail));
+	for (i = 0; i < nr_sessions; i++) {
+		struct session *s = &sessions[i];
+
+		s->head = s->tail = NULL;
+		s->next = NULL;
+		s->jobs = s->late = 0;
+		s->latency_total = s->latency_max = 0;
+	}
+	for (i = 0; i < nr_jobs; i++) {
+		jobs[i].started = jobs[i].completed = 0;
+		jobs[i].next = NULL;
+	}
+
+	while (done < nr_jobs) {
+		uint64_t next = UINT64_MAX;
+
+		/* complete the sub jobs which finish now */
+		for (i = 0; i < nr_cores; i++) {
+			struct job *job = cores[i].job;
+			struct session *s;
+			uint64_t latency;
+
+			if (!job || cores[i].done > now)
+				continue;
+			cores[i].job = NULL;
+			if (++job->completed < job->sub_jobs)
+				continue;
+
+			s = &sessions[job->session];
+			latency = now - job->submit;
+			s->jobs++;
+			s->latency_total += latency;
+			if (latency > s->latency_max)
+				s->latency_max = latency;
+			if (latency > s->period_us)
+				s->late++;
+			done++;
+		}
+
+		/* queue the jobs submitted by now */
+		while (next_job < nr_jobs && jobs[next_job].submit <= now)
+			policy->queue(&jobs[next_job++]);
+
+		/* start sub jobs on the idle cores */
+		for (i = 0; i < nr_cores; i++) {
+			struct job *job;
+
+			if (cores[i].job)
+				continue;
+			job = policy->get();
+			if (!job)
+				break;
+			job->started++;
+			policy->dequeue(job);
+			cores[i].job = job;
+			cores[i].done = now + job->sub_job_us;
+		}
+
+		for (i = 0; i < nr_cores; i++)
+			if (cores[i].job && cores[i].done < next)
+				next = cores[i].done;
+		if (next_job < nr_jobs && jobs[next_job].submit < next)
+			next = jobs[next_job].submit;
+		if (next == UINT64_MAX)
+			break;
+		now = next;
+	}
+
+	printf("%s scheduling, %u cores:\n", policy->name, nr_cores);
+	printf("  %-16s %-10s %8s %12s %12s %8s\n", "session", "priority",
+	       "jobs", "avg lat us", "max lat us", "late");
+	for (i = 0; i < nr_sessions; i++) {
+		struct session *s = &sessions[i];
+
+		printf("  %-16s %-10s %8u %12llu %12llu %8u\n", s->name,
+		       priority_names[s->priority], s->jobs,
+		       s->jobs ? (unsigned long long)(s->latency_total / s->jobs) : 0,
+		       (unsigned long long)s->latency_max, s->late);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *trace = NULL;
+	unsigned int seconds = 10, i;
+	int generate = 0, opt;
+
+	while ((opt = getopt(argc, argv, "c:gs:t:")) != -1) {
+		switch (opt) {
+		case 'c':
+			nr_cores = atoi(optarg);
+			break;
+		case 'g':
+			generate = 1;
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 't':
+			trace = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-c cores] [-g] [-s seconds] [-t trace]\n"
+				"  -g  print the synthetic trace instead of simulating\n"
+				"  -s  length of the synthetic trace\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (!nr_cores || nr_cores > MAX_CORES) {
+		fprintf(stderr, "-c must be between 1 and %d\n", MAX_CORES);
+		return 1;
+	}
+
+	if (trace) {
+		if (read_trace(trace))
+			return 1;
+	} else {
+		synthetic_trace(seconds);
+	}
+
+	if (generate) {
+		print_trace();
+		return 0;
+	}
+
+	for (i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+		simulate(&policies[i]);
+
+	free(jobs);
+	return 0;
+}
@@ -0,0 +1,390 @@
+/*
+ * dmabuf-share-test.c -- buffer sharing between vb2 queues through DMABUF
+ *
+ * An MMAP buffer of the OUTPUT queue of one mem2mem instance (the
+ * exporter) is filled with a pattern and exported with VIDIOC_EXPBUF.
+ * The dma-buf fd is queued with V4L2_MEMORY_DMABUF on the OUTPUT queue of
+ * a second instance (the importer), which copies it into a CAPTURE buffer
+ * that is checked against the pattern.  The exporter is closed right
+ * after the export and the dma-buf fd right after it has been queued, so
+ * the data has to arrive through the references taken by the importer.
+ * Once the importer is closed as well nothing refers to the buffer any
+ * more; this is repeated for a number of rounds, and the free memory must
+ * not shrink by the buffers of the rounds, i.e. every buffer has to be
+ * released.  Both instances are opened on the same device unless -i is
+ * given; it has to copy RGB32 frames unchanged with its default settings,
+ * as s5p-g2d and the s5p-fimc mem2mem node do.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -I../../usr/include -o dmabuf-share-test dmabuf-share-test.c */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+static const char *exporter = "/dev/video0";
+static const char *importer;
+static unsigned int width = 640, height = 480;
+static unsigned int rounds = 50;
+static int mplane;
+
+static int xioctl(int fd, unsigned long request, void *arg, const char *what)
+{
+	int ret;
+
+	do
+		ret = ioctl(fd, request, arg);
+	while (ret && errno == EINTR);
+	if (ret)
+		fprintf(stderr, "%s: %s\n", what, strerror(errno));
+	return ret;
+}
+
+static long mem_free(void)
+{
+	char line[128];
+	long kb = -1;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+		if (!strncmp(line, "MemFree:", 8)) {
+			kb = strtol(line + 8, NULL, 10);
+			break;
+		}
+	fclose(f);
+	return kb;
+}
+
+static enum v4l2_buf_type out_type(void)
+{
+	return mplane ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE :
+			V4L2_BUF_TYPE_VIDEO_OUTPUT;
+}
+
+static enum v4l2_buf_type cap_type(void)
+{
+	return mplane ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE :
+			V4L2_BUF_TYPE_VIDEO_CAPTURE;
+}
+
+/* Both instances use the device's m2m flavour, found on the exporter */
+static int probe_device(void)
+{
+	struct v4l2_capability cap;
+	int fd;
+
+	fd = open(exporter, O_RDWR);
+	if (fd < 0) {
+		perror(exporter);
+		return -1;
+	}
+	if (xioctl(fd, VIDIOC_QUERYCAP, &cap, "query capabilities")) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	if ((cap.capabilities & V4L2_CAP_VIDEO_OUTPUT_MPLANE) &&
+	    (cap.capabilities & V4L2_CAP_VIDEO_CAPTURE_MPLANE))
+		mplane = 1;
+	else if (!(cap.capabilities & V4L2_CAP_VIDEO_OUTPUT) ||
+		 !(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE)) {
+		fprintf(stderr, "%s is not a mem2mem device\n", exporter);
+		return -1;
+	}
+	return 0;
+}
+
+static int set_format(int fd, enum v4l2_buf_type type, size_t *size)
+{
+	struct v4l2_format fmt;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = type;
+	if (mplane) {
+		fmt.fmt.pix_mp.width = width;
+		fmt.fmt.pix_mp.height = height;
+		fmt.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_RGB32;
+		fmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+		fmt.fmt.pix_mp.num_planes = 1;
+	} else {
+		fmt.fmt.pix.width = width;
+		fmt.fmt.pix.height = height;
+		fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_RGB32;
+		fmt.fmt.pix.field = V4L2_FIELD_NONE;
+	}
+	if (xioctl(fd, VIDIOC_S_FMT, &fmt, "set format"))
+		return -1;
+	*size = mplane ? fmt.fmt.pix_mp.plane_fmt[0].sizeimage :
+			 fmt.fmt.pix.sizeimage;
+	return 0;
+}
+
+static int request(int fd, enum v4l2_buf_type type, enum v4l2_memory memory,
+		   unsigned int count)
+{
+	struct v4l2_requestbuffers req;
+
+	memset(&req, 0, sizeof(req));
+	req.type = type;
+	req.memory = memory;
+	req.count = count;
+	if (xioctl(fd, VIDIOC_REQBUFS, &req, "request buffers"))
+		return -1;
+	if (req.count < count) {
+		fprintf(stderr, "got %u buffers, need %u\n", req.count, count);
+		return -1;
+	}
+	return 0;
+}
+
+/* Set up buffer 0 of a queue; the plane only matters for mplane devices */
+static void init_buffer(struct v4l2_buffer *buf, struct v4l2_plane *plane,
+			enum v4l2_buf_type type, enum v4l2_memory memory)
+{
+	memset(buf, 0, sizeof(*buf));
+	memset(plane, 0, sizeof(*plane));
+	buf->type = type;
+	buf->memory = memory;
+	buf->index = 0;
+	if (mplane) {
+		buf->m.planes = plane;
+		buf->length = 1;
+	}
+}
+
+static void *map_buffer(int fd, enum v4l2_buf_type type, size_t *len)
+{
+	struct v4l2_buffer buf;
+	struct v4l2_plane plane;
+	void *p;
+
+	init_buffer(&buf, &plane, type, V4L2_MEMORY_MMAP);
+	if (xioctl(fd, VIDIOC_QUERYBUF, &buf, "query buffer"))
+		return NULL;
+	*len = mplane ? plane.length : buf.length;
+	p = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		 mplane ? plane.m.mem_offset : buf.m.offset);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+	return p;
+}
+
+static uint32_t pattern(unsigned int round, size_t i)
+{
+	return (round << 24) ^ (uint32_t)i * 2654435761u;
+}
+
+/* Export a buffer holding the pattern of @round, return its dma-buf fd */
+static int export(unsigned int round, size_t *size)
+{
+	struct v4l2_exportbuffer exp;
+	uint32_t *p;
+	size_t i, len;
+	int fd, ret = -1;
+
+	fd = open(exporter, O_RDWR);
+	if (fd < 0) {
+		perror(exporter);
+		return -1;
+	}
+	if (set_format(fd, out_type(), size) ||
+	    request(fd, out_type(), V4L2_MEMORY_MMAP, 1))
+		goto out;
+	p = map_buffer(fd, out_type(), &len);
+	if (!p)
+		goto out;
+	for (i = 0; i < *size / 4; i++)
+		p[i] = pattern(round, i);
+	munmap(p, len);
+
+	memset(&exp, 0, sizeof(exp));
+	exp.type = out_type();
+	exp.index = 0;
+	exp.plane = 0;
+	exp.flags = O_CLOEXEC;
+	if (xioctl(fd, VIDIOC_EXPBUF, &exp, "export buffer"))
+		goto out;
+	ret = exp.fd;
+
+	/* the dma-buf alone keeps the buffer from now on */
+	if (request(fd, out_type(), V4L2_MEMORY_MMAP, 0)) {
+		close(ret);
+		ret = -1;
+	}
+out:
+	close(fd);
+	return ret;
+}
+
+static int queue_dmabuf(int fd, int dmabuf, size_t size)
+{
+	struct v4l2_buffer buf;
+	struct v4l2_plane plane;
+
+	init_buffer(&buf, &plane, out_type(), V4L2_MEMORY_DMABUF);
+	if (mplane) {
+		plane.m.fd = dmabuf;
+		plane.length = size;
+		plane.bytesused = size;
+	} else {
+		buf.m.fd = dmabuf;
+		buf.length = size;
+		buf.bytesused = size;
+	}
+	return xioctl(fd, VIDIOC_QBUF, &buf, "queue dma-buf");
+}
+
+/* Copy the exported buffer on the importer and check what arrives */
+static int import(unsigned int round, int dmabuf, size_t size)
+{
+	struct v4l2_buffer buf;
+	struct v4l2_plane plane;
+	enum v4l2_buf_type type;
+	struct pollfd pfd;
+	uint32_t *p = NULL;
+	size_t i, len, cap_size;
+	int fd, ret = -1;
+
+	fd = open(importer, O_RDWR | O_NONBLOCK);
+	if (fd < 0) {
+		perror(importer);
+		close(dmabuf);
+		return -1;
+	}
+	if (set_format(fd, out_type(), &size) ||
+	    set_format(fd, cap_type(), &cap_size) ||
+	    request(fd, out_type(), V4L2_MEMORY_DMABUF, 1) ||
+	    request(fd, cap_type(), V4L2_MEMORY_MMAP, 1))
+		goto out;
+	p = map_buffer(fd, cap_type(), &len);
+	if (!p)
+		goto out;
+	memset(p, 0, len);
+
+	init_buffer(&buf, &plane, cap_type(), V4L2_MEMORY_MMAP);
+	if (xioctl(fd, VIDIOC_QBUF, &buf, "queue capture buffer") ||
+	    queue_dmabuf(fd, dmabuf, size))
+		goto out;
+	/* the queued buffer holds its own reference */
+	close(dmabuf);
+	dmabuf = -1;
+
+	type = out_type();
+	if (xioctl(fd, VIDIOC_STREAMON, &type, "stream on"))
+		goto out;
+	type = cap_type();
+	if (xioctl(fd, VIDIOC_STREAMON, &type, "stream on"))
+		goto out;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 1000) <= 0) {
+		fprintf(stderr, "round %u: timed out waiting for the copy\n",
+			round);
+		goto out;
+	}
+	init_buffer(&buf, &plane, cap_type(), V4L2_MEMORY_MMAP);
+	if (xioctl(fd, VIDIOC_DQBUF, &buf, "dequeue capture buffer"))
+		goto out;
+
+	/* the fourth byte is padding in RGB32 and need not be copied */
+	for (i = 0; i < cap_size / 4 && i < size / 4; i++)
+		if ((p[i] ^ pattern(round, i)) & 0x00ffffff) {
+			fprintf(stderr, "round %u: word %zu is 0x%08x, expected 0x%08x\n",
+				round, i, p[i], pattern(round, i));
+			goto out;
+		}
+	ret = 0;
+out:
+	if (p)
+		munmap(p, len);
+	if (dmabuf >= 0)
+		close(dmabuf);
+	/* streamoff and the release of the queues drop the attachment */
+	close(fd);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	long free0 = -1, free1 = -1, leaked;
+	unsigned int r;
+	size_t size = 0;
+	int opt, dmabuf;
+
+	while ((opt = getopt(argc, argv, "e:h:i:n:w:")) != -1) {
+		switch (opt) {
+		case 'e':
+			exporter = optarg;
+			break;
+		case 'h':
+			height = atoi(optarg);
+			break;
+		case 'i':
+			importer = optarg;
+			break;
+		case 'n':
+			rounds = atoi(optarg);
+			break;
+		case 'w':
+			width = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-e exporter] [-i importer] [-w width] [-h height] [-n rounds]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (rounds < 2 || !width || !height) {
+		fprintf(stderr, "-n must be at least 2, -w and -h not 0\n");
+		return 1;
+	}
+	if (!importer)
+		importer = exporter;
+	if (probe_device())
+		return 1;
+
+	for (r = 0; r < rounds; r++) {
+		dmabuf = export(r, &size);
+		if (dmabuf < 0 || import(r, dmabuf, size)) {
+			printf("FAIL\n");
+			return 1;
+		}
+		/* the first round may allocate for good, e.g. firmware */
+		if (r == 0)
+			free0 = mem_free();
+	}
+	free1 = mem_free();
+
+	printf("%u rounds of %ux%u (%zu KiB) from %s to %s, data checked\n",
+	       rounds, width, height, size >> 10, exporter, importer);
+	leaked = free0 - free1;
+	printf("free memory %+ld KiB after the first round\n", -leaked);
+	/* a buffer kept by each round would eat half of them at least */
+	if (free0 >= 0 && free1 >= 0 &&
+	    leaked > (long)((rounds - 1) * (size >> 10) / 2)) {
+		fprintf(stderr, "exported buffers are not released\n");
+		printf("FAIL\n");
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
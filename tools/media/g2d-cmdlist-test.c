@@ -0,0 +1,411 @@
+/*
+ * g2d-cmdlist-test.c -- s5p-g2d command list reference and test
+ *
+ * Builds a random command list of fills, blits (stretched when the source
+ * and destination sizes differ) and raster operations over two XRGB8888
+ * frames and runs it through a software
+ * model of the G2D, which gives the expected result and a timing to
+ * compare with.  With -d the same list is attached to the OUTPUT buffer
+ * of the s5p-g2d video node and run as one mem2mem job per iteration;
+ * the destination frame is then checked against the model and the time
+ * per job and per operation is printed for both.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * $(CROSS_COMPILE)cc -Wall -Wextra -O2 -I../../usr/include \
+ *	-o g2d-cmdlist-test g2d-cmdlist-test.c
+ * (after "make headers_install", for linux/s5p_g2d.h)
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+#include <linux/s5p_g2d.h>
+
+static const char *device;
+static unsigned int width = 640, height = 480;
+static unsigned int nops = 64;
+static unsigned int runs = 20;
+static unsigned int seed = 1;
+
+static struct s5p_g2d_op *ops;
+static uint32_t *src, *dst_init, *ref;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int xioctl(int fd, unsigned long request, void *arg, const char *what)
+{
+	int ret;
+
+	do
+		ret = ioctl(fd, request, arg);
+	while (ret && errno == EINTR);
+	if (ret)
+		fprintf(stderr, "%s: %s\n", what, strerror(errno));
+	return ret;
+}
+
+/*
+ * Software model
+ */
+
+/* Bit i of the result is bit (p << 2 | s << 1 | d) of the ROP3 code */
+static uint32_t rop3(unsigned int code, uint32_t p, uint32_t s, uint32_t d)
+{
+	uint32_t r = 0;
+	unsigned int i;
+
+	for (i = 0; i < 8; i++) {
+		uint32_t m;
+
+		if (!(code & 1 << i))
+			continue;
+		m = (i & 4 ? p : ~p) & (i & 2 ? s : ~s) & (i & 1 ? d : ~d);
+		r |= m;
+	}
+	return r;
+}
+
+/*
+ * A stretched blit samples the nearest source pixel: the G2D steps through
+ * the source rectangle in 16.16 fixed point, starting at its top left
+ * corner, and drops the fraction.
+ */
+static unsigned int scale_step(unsigned int from, unsigned int to)
+{
+	return (uint32_t)(((uint64_t)from << 16) / to);
+}
+
+static void model_op(const struct s5p_g2d_op *op, const uint32_t *s,
+		     uint32_t *d)
+{
+	const struct v4l2_rect *sr = &op->src, *dr = &op->dst;
+	unsigned int dw = dr->width, dh = dr->height;
+	unsigned int xstep = 1 << 16, ystep = 1 << 16;
+	unsigned int x, y;
+
+	if (op->type == S5P_G2D_OP_BLIT) {
+		xstep = scale_step(sr->width, dw);
+		ystep = scale_step(sr->height, dh);
+	}
+
+	for (y = 0; y < dh; y++) {
+		const uint32_t *sp = s + (sr->top + (y * ystep >> 16)) * width +
+				     sr->left;
+		uint32_t *dp = d + (dr->top + y) * width + dr->left;
+
+		for (x = 0; x < dw; x++) {
+			switch (op->type) {
+			case S5P_G2D_OP_FILL:
+				dp[x] = op->color;
+				break;
+			case S5P_G2D_OP_ROP:
+				dp[x] = rop3(op->rop3, op->color, sp[x], dp[x]);
+				break;
+			default:
+				dp[x] = sp[x * xstep >> 16];
+				break;
+			}
+		}
+	}
+}
+
+static void model_run(const uint32_t *s, uint32_t *d)
+{
+	unsigned int i;
+
+	for (i = 0; i < nops; i++)
+		model_op(&ops[i], s, d);
+}
+
+/*
+ * Command list
+ */
+
+static void random_rect(struct v4l2_rect *r, unsigned int w, unsigned int h)
+{
+	r->width = w ? w : 1 + rand() % (width / 2);
+	r->height = h ? h : 1 + rand() % (height / 2);
+	r->left = rand() % (width - r->width + 1);
+	r->top = rand() % (height - r->height + 1);
+}
+
+static void build_cmdlist(void)
+{
+	static const unsigned int codes[] = {
+		S5P_G2D_ROP3_NOT_SRC, S5P_G2D_ROP3_SRC_AND_DST,
+		S5P_G2D_ROP3_SRC_OR_DST, S5P_G2D_ROP3_SRC_XOR_DST,
+		0xe2,	/* DSPDxax: source where the pattern is set */
+	};
+	unsigned int i;
+
+	for (i = 0; i < nops; i++) {
+		struct s5p_g2d_op *op = &ops[i];
+
+		memset(op, 0, sizeof(*op));
+		op->type = rand() % 3;
+		op->color = rand() & 0xffffff;
+		random_rect(&op->dst, 0, 0);
+		switch (op->type) {
+		case S5P_G2D_OP_FILL:
+			break;
+		case S5P_G2D_OP_ROP:
+			op->rop3 = codes[rand() % (sizeof(codes) / sizeof(codes[0]))];
+			random_rect(&op->src, op->dst.width, op->dst.height);
+			break;
+		default:
+			/* every other blit is stretched */
+			if (rand() & 1)
+				random_rect(&op->src, 0, 0);
+			else
+				random_rect(&op->src, op->dst.width,
+					    op->dst.height);
+			break;
+		}
+	}
+}
+
+static void fill_frames(void)
+{
+	size_t i, n = (size_t)width * height;
+
+	for (i = 0; i < n; i++) {
+		src[i] = ((uint32_t)i * 2654435761u) & 0xffffff;
+		dst_init[i] = ((uint32_t)i * 40503u + 0x5a5a5a) & 0xffffff;
+	}
+}
+
+/*
+ * Hardware
+ */
+
+static int setup_queue(int fd, enum v4l2_buf_type type, void **map,
+		       size_t *size)
+{
+	struct v4l2_requestbuffers req;
+	struct v4l2_format fmt;
+	struct v4l2_buffer buf;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = type;
+	fmt.fmt.pix.width = width;
+	fmt.fmt.pix.height = height;
+	fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_RGB32;
+	fmt.fmt.pix.field = V4L2_FIELD_NONE;
+	if (xioctl(fd, VIDIOC_S_FMT, &fmt, "set format"))
+		return -1;
+	if (fmt.fmt.pix.width != width || fmt.fmt.pix.height != height ||
+	    fmt.fmt.pix.bytesperline != width * 4) {
+		fprintf(stderr, "unsupported frame size %ux%u\n", width, height);
+		return -1;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.type = type;
+	req.memory = V4L2_MEMORY_MMAP;
+	req.count = 1;
+	if (xioctl(fd, VIDIOC_REQBUFS, &req, "request buffers"))
+		return -1;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.type = type;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = 0;
+	if (xioctl(fd, VIDIOC_QUERYBUF, &buf, "query buffer"))
+		return -1;
+	*size = buf.length;
+	*map = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    fd, buf.m.offset);
+	if (*map == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	return 0;
+}
+
+static int queue(int fd, enum v4l2_buf_type type, size_t size)
+{
+	struct v4l2_buffer buf;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.type = type;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = 0;
+	if (type == V4L2_BUF_TYPE_VIDEO_OUTPUT)
+		buf.bytesused = size;
+	return xioctl(fd, VIDIOC_QBUF, &buf, "queue buffer");
+}
+
+static int dequeue(int fd, enum v4l2_buf_type type)
+{
+	struct v4l2_buffer buf;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.type = type;
+	buf.memory = V4L2_MEMORY_MMAP;
+	return xioctl(fd, VIDIOC_DQBUF, &buf, "dequeue buffer");
+}
+
+static int compare(const uint32_t *out)
+{
+	size_t i, n = (size_t)width * height;
+
+	for (i = 0; i < n; i++)
+		if ((out[i] & 0xffffff) != (ref[i] & 0xffffff)) {
+			fprintf(stderr, "pixel %zu,%zu is 0x%06x, expected 0x%06x\n",
+				i % width, i / width, out[i] & 0xffffff,
+				ref[i] & 0xffffff);
+			return -1;
+		}
+	return 0;
+}
+
+static int run_device(void)
+{
+	struct s5p_g2d_cmdlist cl;
+	enum v4l2_buf_type type;
+	void *in, *out;
+	size_t in_size, out_size, frame = (size_t)width * height * 4;
+	uint64_t t, total = 0;
+	unsigned int i;
+	int fd;
+
+	fd = open(device, O_RDWR);
+	if (fd < 0) {
+		perror(device);
+		return -1;
+	}
+	if (setup_queue(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT, &in, &in_size) ||
+	    setup_queue(fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, &out, &out_size))
+		return -1;
+	memcpy(in, src, frame);
+
+	memset(&cl, 0, sizeof(cl));
+	cl.index = 0;
+	cl.count = nops;
+	cl.ops = (uintptr_t)ops;
+	if (xioctl(fd, S5P_G2D_IOC_S_CMDLIST, &cl, "set command list"))
+		return -1;
+
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	if (xioctl(fd, VIDIOC_STREAMON, &type, "stream on"))
+		return -1;
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	if (xioctl(fd, VIDIOC_STREAMON, &type, "stream on"))
+		return -1;
+
+	for (i = 0; i < runs; i++) {
+		memcpy(out, dst_init, frame);
+		t = now_ns();
+		if (queue(fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, out_size) ||
+		    queue(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT, in_size) ||
+		    dequeue(fd, V4L2_BUF_TYPE_VIDEO_CAPTURE) ||
+		    dequeue(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT))
+			return -1;
+		total += now_ns() - t;
+		if (compare(out))
+			return -1;
+	}
+
+	printf("g2d:      %8.1f us per list, %6.2f us per operation\n",
+	       total / 1e3 / runs, total / 1e3 / runs / nops);
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	size_t frame;
+	uint32_t *tmp;
+	uint64_t t, total = 0;
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:h:n:r:s:w:")) != -1) {
+		switch (opt) {
+		case 'd':
+			device = optarg;
+			break;
+		case 'h':
+			height = atoi(optarg);
+			break;
+		case 'n':
+			nops = atoi(optarg);
+			break;
+		case 'r':
+			runs = atoi(optarg);
+			break;
+		case 's':
+			seed = atoi(optarg);
+			break;
+		case 'w':
+			width = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-d device] [-w width] [-h height] [-n operations] [-r runs] [-s seed]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (width < 2 || height < 2 || width > 4095 || height > 4095 ||
+	    nops < 1 || nops > S5P_G2D_MAX_OPS || runs < 1) {
+		fprintf(stderr, "frame must be 2..4095 pixels, -n 1..%d, -r at least 1\n",
+			S5P_G2D_MAX_OPS);
+		return 1;
+	}
+
+	frame = (size_t)width * height * 4;
+	ops = calloc(nops, sizeof(*ops));
+	src = malloc(frame);
+	dst_init = malloc(frame);
+	ref = malloc(frame);
+	tmp = malloc(frame);
+	if (!ops || !src || !dst_init || !ref || !tmp) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	srand(seed);
+	build_cmdlist();
+	fill_frames();
+
+	memcpy(ref, dst_init, frame);
+	model_run(src, ref);
+	for (i = 0; i < runs; i++) {
+		memcpy(tmp, dst_init, frame);
+		t = now_ns();
+		model_run(src, tmp);
+		total += now_ns() - t;
+	}
+
+	printf("%u operations on %ux%u XRGB8888, %u runs\n",
+	       nops, width, height, runs);
+	printf("software: %8.1f us per list, %6.2f us per operation\n",
+	       total / 1e3 / runs, total / 1e3 / runs / nops);
+
+	if (device && run_device()) {
+		printf("FAIL\n");
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
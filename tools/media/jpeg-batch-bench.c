@@ -0,0 +1,675 @@
+/*
+ * jpeg-batch-bench.c -- s5p-jpeg decoding benchmark
+ *
+ * Decodes all the baseline JPEG files of a directory with the s5p-jpeg
+ * decoder node, first one image at a time as the decoder requires by
+ * default (set the formats, allocate the buffers, decode, free them), then
+ * in batch mode (V4L2_CID_S5P_JPEG_BATCH), where the formats are set and
+ * the buffers allocated once for the largest file and image and reused
+ * for all of them, with several images in flight.  The number of images
+ * decoded per second is printed for both.
+ *
+ * With -f and -s each image decoded in batch mode is also scaled to the
+ * given size by a FIMC mem2mem node, which reads the CAPTURE buffer of the
+ * decoder through DMABUF, as a gallery would to make its thumbnails.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * $(CROSS_COMPILE)cc -Wall -Wextra -O2 -I../../usr/include \
+ *	-o jpeg-batch-bench jpeg-batch-bench.c
+ * (after "make headers_install", for linux/s5p_jpeg.h)
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+#include <linux/s5p_jpeg.h>
+
+#define OUT	V4L2_BUF_TYPE_VIDEO_OUTPUT
+#define CAP	V4L2_BUF_TYPE_VIDEO_CAPTURE
+#define M_OUT	V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE
+#define M_CAP	V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE
+
+struct image {
+	char		*name;
+	unsigned char	*data;
+	size_t		size;
+	unsigned int	w, h;
+};
+
+static struct image *images;
+static unsigned int nimages;
+static size_t max_size;
+static unsigned int max_w, max_h;
+
+static const char *device = "/dev/video0";
+static const char *fimc_device;
+static unsigned int scale_w, scale_h;
+static unsigned int nbufs = 4;
+static unsigned int rounds = 1;
+
+struct mapping {
+	void		*addr;
+	size_t		len;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int xioctl(int fd, unsigned long request, void *arg, const char *what)
+{
+	int ret;
+
+	do
+		ret = ioctl(fd, request, arg);
+	while (ret && errno == EINTR);
+	if (ret)
+		fprintf(stderr, "%s: %s\n", what, strerror(errno));
+	return ret;
+}
+
+/*
+ * Image files
+ */
+
+/* Size of a baseline JPEG, which is all the hardware decodes */
+static int parse_sof0(const unsigned char *p, size_t size,
+		      unsigned int *w, unsigned int *h)
+{
+	size_t i = 2, len;
+
+	if (size < 4 || p[0] != 0xff || p[1] != 0xd8)
+		return -1;
+	while (i + 4 <= size) {
+		if (p[i] != 0xff) {
+			i++;
+			continue;
+		}
+		/* fill bytes, stuffing and markers without payload */
+		if (p[i + 1] == 0xff) {
+			i++;
+			continue;
+		}
+		if (p[i + 1] == 0x00 || p[i + 1] == 0x01 ||
+		    (p[i + 1] >= 0xd0 && p[i + 1] <= 0xd7)) {
+			i += 2;
+			continue;
+		}
+		len = p[i + 2] << 8 | p[i + 3];
+		if (p[i + 1] == 0xc0) {
+			if (i + 9 > size)
+				return -1;
+			*h = p[i + 5] << 8 | p[i + 6];
+			*w = p[i + 7] << 8 | p[i + 8];
+			return *w && *h ? 0 : -1;
+		}
+		/* other frame types are not supported */
+		if (p[i + 1] > 0xc0 && p[i + 1] <= 0xcf &&
+		    p[i + 1] != 0xc4 && p[i + 1] != 0xc8 && p[i + 1] != 0xcc)
+			return -1;
+		i += 2 + len;
+	}
+	return -1;
+}
+
+static int load_image(const char *dir, const char *name)
+{
+	struct image *img = &images[nimages];
+	char path[4096];
+	struct stat st;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	if (stat(path, &st) || !S_ISREG(st.st_mode) || !st.st_size)
+		return -1;
+	img->size = st.st_size;
+	img->data = malloc(img->size);
+	img->name = strdup(name);
+	if (!img->data || !img->name)
+		return -1;
+	f = fopen(path, "rb");
+	if (!f || fread(img->data, 1, img->size, f) != img->size) {
+		if (f)
+			fclose(f);
+		free(img->data);
+		return -1;
+	}
+	fclose(f);
+	if (parse_sof0(img->data, img->size, &img->w, &img->h)) {
+		fprintf(stderr, "%s: not a baseline JPEG, skipped\n", name);
+		free(img->data);
+		return -1;
+	}
+	if (img->size > max_size)
+		max_size = img->size;
+	if (img->w > max_w)
+		max_w = img->w;
+	if (img->h > max_h)
+		max_h = img->h;
+	nimages++;
+	return 0;
+}
+
+static int is_jpeg(const char *name)
+{
+	const char *ext = strrchr(name, '.');
+
+	return ext && (!strcasecmp(ext, ".jpg") || !strcasecmp(ext, ".jpeg"));
+}
+
+static int cmp_name(const void *a, const void *b)
+{
+	return strcmp(((const struct image *)a)->name,
+		      ((const struct image *)b)->name);
+}
+
+static int load_images(const char *dir)
+{
+	unsigned int n = 0;
+	struct dirent *de;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d) {
+		perror(dir);
+		return -1;
+	}
+	while ((de = readdir(d)))
+		n += is_jpeg(de->d_name);
+	images = calloc(n ? n : 1, sizeof(*images));
+	if (!images) {
+		closedir(d);
+		return -1;
+	}
+	rewinddir(d);
+	while ((de = readdir(d)) && nimages < n)
+		if (is_jpeg(de->d_name))
+			load_image(dir, de->d_name);
+	closedir(d);
+	qsort(images, nimages, sizeof(*images), cmp_name);
+	return nimages ? 0 : -1;
+}
+
+/*
+ * V4L2 helpers
+ */
+
+static int set_fmt(int fd, unsigned int type, unsigned int fourcc,
+		   unsigned int w, unsigned int h, unsigned int sizeimage)
+{
+	struct v4l2_format fmt;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = type;
+	if (type == M_OUT || type == M_CAP) {
+		fmt.fmt.pix_mp.pixelformat = fourcc;
+		fmt.fmt.pix_mp.width = w;
+		fmt.fmt.pix_mp.height = h;
+		fmt.fmt.pix_mp.num_planes = 1;
+	} else {
+		fmt.fmt.pix.pixelformat = fourcc;
+		fmt.fmt.pix.width = w;
+		fmt.fmt.pix.height = h;
+		fmt.fmt.pix.sizeimage = sizeimage;
+	}
+	return xioctl(fd, VIDIOC_S_FMT, &fmt, "set format");
+}
+
+static int reqbufs(int fd, unsigned int type, unsigned int memory,
+		   unsigned int count)
+{
+	struct v4l2_requestbuffers req;
+
+	memset(&req, 0, sizeof(req));
+	req.count = count;
+	req.type = type;
+	req.memory = memory;
+	if (xioctl(fd, VIDIOC_REQBUFS, &req, "request buffers"))
+		return -1;
+	return req.count;
+}
+
+static int map_buffer(int fd, unsigned int type, unsigned int index,
+		      struct mapping *map)
+{
+	struct v4l2_buffer buf;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.type = type;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = index;
+	if (xioctl(fd, VIDIOC_QUERYBUF, &buf, "query buffer"))
+		return -1;
+	map->len = buf.length;
+	map->addr = mmap(NULL, buf.length, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, fd, buf.m.offset);
+	if (map->addr == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	return 0;
+}
+
+static int qbuf(int fd, unsigned int type, unsigned int index,
+		unsigned int bytesused)
+{
+	struct v4l2_buffer buf;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.type = type;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = index;
+	buf.bytesused = bytesused;
+	return xioctl(fd, VIDIOC_QBUF, &buf, "queue buffer");
+}
+
+/* Returns the index of the buffer, or -1 if it could not be dequeued */
+static int dqbuf(int fd, unsigned int type, unsigned int *flags)
+{
+	struct v4l2_buffer buf;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.type = type;
+	buf.memory = V4L2_MEMORY_MMAP;
+	if (xioctl(fd, VIDIOC_DQBUF, &buf, "dequeue buffer"))
+		return -1;
+	*flags = buf.flags;
+	return buf.index;
+}
+
+static int stream(int fd, unsigned int type, int on)
+{
+	return xioctl(fd, on ? VIDIOC_STREAMON : VIDIOC_STREAMOFF, &type,
+		      on ? "stream on" : "stream off");
+}
+
+/*
+ * One image at a time
+ */
+
+static int decode_single(int fd, struct image *img)
+{
+	struct mapping map;
+	struct v4l2_format fmt;
+	unsigned int flags = 0;
+	int ret = -1;
+
+	if (set_fmt(fd, OUT, V4L2_PIX_FMT_JPEG, 0, 0, img->size) ||
+	    reqbufs(fd, OUT, V4L2_MEMORY_MMAP, 1) < 1)
+		return -1;
+	if (map_buffer(fd, OUT, 0, &map))
+		goto free_out;
+	memcpy(map.addr, img->data, img->size);
+	/* the header is parsed as the buffer reaches the driver */
+	if (qbuf(fd, OUT, 0, img->size) || stream(fd, OUT, 1))
+		goto unmap;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = CAP;
+	if (xioctl(fd, VIDIOC_G_FMT, &fmt, "get format") ||
+	    set_fmt(fd, CAP, V4L2_PIX_FMT_YUYV, fmt.fmt.pix.width,
+		    fmt.fmt.pix.height, 0) ||
+	    reqbufs(fd, CAP, V4L2_MEMORY_MMAP, 1) < 1)
+		goto stop;
+	if (qbuf(fd, CAP, 0, 0) || stream(fd, CAP, 1))
+		goto free_cap;
+	if (dqbuf(fd, CAP, &flags) >= 0 && dqbuf(fd, OUT, &flags) >= 0)
+		ret = flags & V4L2_BUF_FLAG_ERROR ? -1 : 0;
+	stream(fd, CAP, 0);
+free_cap:
+	reqbufs(fd, CAP, V4L2_MEMORY_MMAP, 0);
+stop:
+	stream(fd, OUT, 0);
+unmap:
+	munmap(map.addr, map.len);
+free_out:
+	reqbufs(fd, OUT, V4L2_MEMORY_MMAP, 0);
+	return ret;
+}
+
+static int run_single(int fd, int scale, unsigned int *errors)
+{
+	unsigned int i;
+
+	(void)scale;
+
+	for (i = 0; i < nimages; i++)
+		if (decode_single(fd, &images[i])) {
+			fprintf(stderr, "%s: decoding failed\n",
+				images[i].name);
+			(*errors)++;
+		}
+	return 0;
+}
+
+/*
+ * Downscaling through FIMC
+ */
+
+static struct {
+	int		fd;
+	int		dmabuf[VIDEO_MAX_FRAME];
+	size_t		length[VIDEO_MAX_FRAME];
+	unsigned int	count;
+	unsigned int	src_w, src_h;
+	int		streaming;
+} fimc = { .fd = -1 };
+
+static int fimc_init(int jpeg_fd, unsigned int count,
+		     struct mapping *cap_maps)
+{
+	struct v4l2_exportbuffer eb;
+	unsigned int i;
+
+	fimc.fd = open(fimc_device, O_RDWR);
+	if (fimc.fd < 0) {
+		perror(fimc_device);
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		memset(&eb, 0, sizeof(eb));
+		eb.type = CAP;
+		eb.index = i;
+		if (xioctl(jpeg_fd, VIDIOC_EXPBUF, &eb, "export buffer"))
+			return -1;
+		fimc.dmabuf[i] = eb.fd;
+		fimc.length[i] = cap_maps[i].len;
+	}
+	fimc.count = count;
+	fimc.src_w = fimc.src_h = 0;
+	fimc.streaming = 0;
+
+	if (set_fmt(fimc.fd, M_CAP, V4L2_PIX_FMT_YUYV, scale_w, scale_h, 0) ||
+	    reqbufs(fimc.fd, M_CAP, V4L2_MEMORY_MMAP, 1) < 1 ||
+	    stream(fimc.fd, M_CAP, 1))
+		return -1;
+	return 0;
+}
+
+/* The source format follows the size of the images, set it as it changes */
+static int fimc_set_source(unsigned int w, unsigned int h)
+{
+	if (w == fimc.src_w && h == fimc.src_h)
+		return 0;
+	if (fimc.streaming) {
+		stream(fimc.fd, M_OUT, 0);
+		reqbufs(fimc.fd, M_OUT, V4L2_MEMORY_DMABUF, 0);
+		fimc.streaming = 0;
+	}
+	if (set_fmt(fimc.fd, M_OUT, V4L2_PIX_FMT_YUYV, w, h, 0) ||
+	    reqbufs(fimc.fd, M_OUT, V4L2_MEMORY_DMABUF, fimc.count) < 1 ||
+	    stream(fimc.fd, M_OUT, 1))
+		return -1;
+	fimc.src_w = w;
+	fimc.src_h = h;
+	fimc.streaming = 1;
+	return 0;
+}
+
+static int fimc_scale(unsigned int index, unsigned int w, unsigned int h,
+		      unsigned int bytesused)
+{
+	struct v4l2_plane plane;
+	struct v4l2_buffer buf;
+
+	if (fimc_set_source(w, h))
+		return -1;
+
+	memset(&plane, 0, sizeof(plane));
+	memset(&buf, 0, sizeof(buf));
+	buf.type = M_OUT;
+	buf.memory = V4L2_MEMORY_DMABUF;
+	buf.index = index;
+	buf.length = 1;
+	buf.m.planes = &plane;
+	plane.m.fd = fimc.dmabuf[index];
+	plane.length = fimc.length[index];
+	plane.bytesused = bytesused;
+	if (xioctl(fimc.fd, VIDIOC_QBUF, &buf, "queue fimc source"))
+		return -1;
+
+	memset(&plane, 0, sizeof(plane));
+	memset(&buf, 0, sizeof(buf));
+	buf.type = M_CAP;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = 0;
+	buf.length = 1;
+	buf.m.planes = &plane;
+	if (xioctl(fimc.fd, VIDIOC_QBUF, &buf, "queue fimc destination"))
+		return -1;
+
+	buf.type = M_OUT;
+	buf.memory = V4L2_MEMORY_DMABUF;
+	if (xioctl(fimc.fd, VIDIOC_DQBUF, &buf, "dequeue fimc source"))
+		return -1;
+	buf.type = M_CAP;
+	buf.memory = V4L2_MEMORY_MMAP;
+	if (xioctl(fimc.fd, VIDIOC_DQBUF, &buf, "dequeue fimc destination"))
+		return -1;
+	return buf.flags & V4L2_BUF_FLAG_ERROR ? -1 : 0;
+}
+
+static void fimc_exit(void)
+{
+	unsigned int i;
+
+	if (fimc.fd < 0)
+		return;
+	if (fimc.streaming) {
+		stream(fimc.fd, M_OUT, 0);
+		reqbufs(fimc.fd, M_OUT, V4L2_MEMORY_DMABUF, 0);
+	}
+	stream(fimc.fd, M_CAP, 0);
+	reqbufs(fimc.fd, M_CAP, V4L2_MEMORY_MMAP, 0);
+	for (i = 0; i < fimc.count; i++)
+		close(fimc.dmabuf[i]);
+	close(fimc.fd);
+	fimc.fd = -1;
+}
+
+/*
+ * Batch mode
+ */
+
+static int set_batch(int fd, int on)
+{
+	struct v4l2_control ctrl = {
+		.id	= V4L2_CID_S5P_JPEG_BATCH,
+		.value	= on,
+	};
+
+	return xioctl(fd, VIDIOC_S_CTRL, &ctrl, "set batch mode");
+}
+
+static void queue_image(int fd, struct mapping *maps, unsigned int index,
+			unsigned int *slot, unsigned int n)
+{
+	struct image *img = &images[n];
+
+	memcpy(maps[index].addr, img->data, img->size);
+	slot[index] = n;
+	qbuf(fd, OUT, index, img->size);
+}
+
+static int run_batch(int fd, int scale, unsigned int *errors)
+{
+	struct mapping out_maps[VIDEO_MAX_FRAME], cap_maps[VIDEO_MAX_FRAME];
+	unsigned int slot[VIDEO_MAX_FRAME];
+	struct s5p_jpeg_image img;
+	unsigned int flags, next = 0, done = 0, i;
+	int nout, ncap, o, c, ret = -1;
+
+	memset(out_maps, 0, sizeof(out_maps));
+	memset(cap_maps, 0, sizeof(cap_maps));
+	if (set_batch(fd, 1) ||
+	    set_fmt(fd, OUT, V4L2_PIX_FMT_JPEG, 0, 0, max_size) ||
+	    set_fmt(fd, CAP, V4L2_PIX_FMT_YUYV, max_w, max_h, 0))
+		return -1;
+	nout = reqbufs(fd, OUT, V4L2_MEMORY_MMAP, nbufs);
+	ncap = reqbufs(fd, CAP, V4L2_MEMORY_MMAP, nbufs);
+	if (nout < 1 || ncap < 1)
+		goto free;
+	for (i = 0; i < (unsigned int)nout; i++)
+		if (map_buffer(fd, OUT, i, &out_maps[i]))
+			goto free;
+	for (i = 0; i < (unsigned int)ncap; i++)
+		if (map_buffer(fd, CAP, i, &cap_maps[i]))
+			goto free;
+	if (scale && fimc_init(fd, ncap, cap_maps))
+		goto free;
+
+	for (i = 0; i < (unsigned int)ncap; i++)
+		qbuf(fd, CAP, i, 0);
+	for (i = 0; i < (unsigned int)nout && next < nimages; i++)
+		queue_image(fd, out_maps, i, slot, next++);
+	if (stream(fd, OUT, 1) || stream(fd, CAP, 1))
+		goto stop;
+
+	while (done < nimages) {
+		o = dqbuf(fd, OUT, &flags);
+		if (o < 0)
+			break;
+		/* a header that does not parse fails without a job */
+		if (flags & V4L2_BUF_FLAG_ERROR) {
+			fprintf(stderr, "%s: rejected\n",
+				images[slot[o]].name);
+			(*errors)++;
+		} else {
+			c = dqbuf(fd, CAP, &flags);
+			if (c < 0)
+				break;
+			img.index = c;
+			if ((flags & V4L2_BUF_FLAG_ERROR) ||
+			    xioctl(fd, S5P_JPEG_IOC_G_IMAGE, &img, "get image") ||
+			    img.width < images[slot[o]].w ||
+			    img.height < images[slot[o]].h ||
+			    (scale && fimc_scale(c, img.width, img.height,
+						 img.bytesperline * img.height))) {
+				fprintf(stderr, "%s: decoding failed\n",
+					images[slot[o]].name);
+				(*errors)++;
+			}
+			qbuf(fd, CAP, c, 0);
+		}
+		done++;
+		if (next < nimages)
+			queue_image(fd, out_maps, o, slot, next++);
+	}
+	ret = done == nimages ? 0 : -1;
+
+stop:
+	stream(fd, OUT, 0);
+	stream(fd, CAP, 0);
+	fimc_exit();
+free:
+	for (i = 0; nout > 0 && i < (unsigned int)nout; i++)
+		if (out_maps[i].addr && out_maps[i].addr != MAP_FAILED)
+			munmap(out_maps[i].addr, out_maps[i].len);
+	for (i = 0; ncap > 0 && i < (unsigned int)ncap; i++)
+		if (cap_maps[i].addr && cap_maps[i].addr != MAP_FAILED)
+			munmap(cap_maps[i].addr, cap_maps[i].len);
+	reqbufs(fd, OUT, V4L2_MEMORY_MMAP, 0);
+	reqbufs(fd, CAP, V4L2_MEMORY_MMAP, 0);
+	set_batch(fd, 0);
+	return ret;
+}
+
+static int bench(int fd, const char *name,
+		 int (*run)(int fd, int scale, unsigned int *errors),
+		 int scale)
+{
+	unsigned int errors = 0, r;
+	uint64_t t;
+
+	t = now_ns();
+	for (r = 0; r < rounds; r++)
+		if (run(fd, scale, &errors))
+			return -1;
+	t = now_ns() - t;
+	printf("%-16s %8.1f images/s, %7.1f us per image, %u failed\n",
+	       name, 1e9 * nimages * rounds / t,
+	       t / 1e3 / nimages / rounds, errors);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int fd, opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "d:f:n:r:s:")) != -1) {
+		switch (opt) {
+		case 'd':
+			device = optarg;
+			break;
+		case 'f':
+			fimc_device = optarg;
+			break;
+		case 'n':
+			nbufs = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 's':
+			if (sscanf(optarg, "%ux%u", &scale_w, &scale_h) != 2)
+				scale_w = scale_h = 0;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1)
+		goto usage;
+	if (nbufs < 1 || nbufs > VIDEO_MAX_FRAME || rounds < 1 ||
+	    (fimc_device && (!scale_w || !scale_h))) {
+		fprintf(stderr, "-n must be 1..%d, -r at least 1, -f needs -s WxH\n",
+			VIDEO_MAX_FRAME);
+		return 1;
+	}
+
+	if (load_images(argv[optind])) {
+		fprintf(stderr, "%s: no baseline JPEG files\n", argv[optind]);
+		return 1;
+	}
+	printf("%u images, largest %ux%u, %zu bytes\n",
+	       nimages, max_w, max_h, max_size);
+
+	fd = open(device, O_RDWR);
+	if (fd < 0) {
+		perror(device);
+		return 1;
+	}
+	if (bench(fd, "single", run_single, 0) ||
+	    bench(fd, "batch", run_batch, 0))
+		ret = 1;
+	if (!ret && fimc_device && bench(fd, "batch + scale", run_batch, 1))
+		ret = 1;
+	close(fd);
+	return ret;
+
+usage:
+	fprintf(stderr, "usage: %s [-d decoder] [-n buffers] [-r rounds] [-f fimc -s WxH] directory\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,362 @@
+/*
+ * m2m-pool-test.c -- mem2mem device pool load generator
+ *
+ * Opens several instances of the m2m-pool-testdev video node, which runs
+ * the jobs of all its instances on a number of simulated engines, and
+ * streams frames through all of them at once.  Every source frame carries
+ * its instance and frame number, and each instance checks that its
+ * destination frames come back complete and in the order they were
+ * queued.  Per instance throughput is printed at the end, followed by the
+ * per engine utilization read from the driver's sysfs "stats" attribute.
+ * An instance can be restricted to some of the engines (-m), to check
+ * that jobs only go where they fit and do not hold back the others.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -o m2m-pool-test m2m-pool-test.c */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+#define MAX_INST	16
+#define NUM_BUFS	2
+
+/* private controls of m2m-pool-testdev */
+#define CID_TRANS_TIME_MSEC	V4L2_CID_PRIVATE_BASE
+#define CID_UNIT_MASK		(V4L2_CID_PRIVATE_BASE + 2)
+
+static const char *device = "/dev/video0";
+static const char *stats = "/sys/devices/platform/m2m-pool-testdev/stats";
+static unsigned int ninst = 4;
+static unsigned int frames = 50;
+static unsigned int transtime = 10;
+static unsigned int width = 320, height = 240;
+static unsigned int mask0;
+
+struct inst {
+	int fd;
+	unsigned int id;
+	void *src[NUM_BUFS], *dst[NUM_BUFS];
+	size_t size;
+	unsigned int queued, done;
+	uint64_t start_ns, end_ns;
+};
+
+static struct inst inst[MAX_INST];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int xioctl(int fd, unsigned long request, void *arg, const char *what)
+{
+	int ret;
+
+	do
+		ret = ioctl(fd, request, arg);
+	while (ret && errno == EINTR);
+	if (ret)
+		fprintf(stderr, "%s: %s\n", what, strerror(errno));
+	return ret;
+}
+
+static int set_ctrl(int fd, unsigned int id, int value, const char *what)
+{
+	struct v4l2_control ctrl;
+
+	memset(&ctrl, 0, sizeof(ctrl));
+	ctrl.id = id;
+	ctrl.value = value;
+	return xioctl(fd, VIDIOC_S_CTRL, &ctrl, what);
+}
+
+static int setup_queue(struct inst *in, enum v4l2_buf_type type, void **maps)
+{
+	struct v4l2_requestbuffers req;
+	struct v4l2_format fmt;
+	struct v4l2_buffer buf;
+	unsigned int i;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = type;
+	fmt.fmt.pix.width = width;
+	fmt.fmt.pix.height = height;
+	fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+	fmt.fmt.pix.field = V4L2_FIELD_NONE;
+	if (xioctl(in->fd, VIDIOC_S_FMT, &fmt, "set format"))
+		return -1;
+	in->size = fmt.fmt.pix.sizeimage;
+
+	memset(&req, 0, sizeof(req));
+	req.type = type;
+	req.memory = V4L2_MEMORY_MMAP;
+	req.count = NUM_BUFS;
+	if (xioctl(in->fd, VIDIOC_REQBUFS, &req, "request buffers"))
+		return -1;
+	if (req.count < NUM_BUFS) {
+		fprintf(stderr, "got %u buffers, need %u\n", req.count, NUM_BUFS);
+		return -1;
+	}
+
+	for (i = 0; i < NUM_BUFS; i++) {
+		memset(&buf, 0, sizeof(buf));
+		buf.type = type;
+		buf.memory = V4L2_MEMORY_MMAP;
+		buf.index = i;
+		if (xioctl(in->fd, VIDIOC_QUERYBUF, &buf, "query buffer"))
+			return -1;
+		maps[i] = mmap(NULL, buf.length, PROT_READ | PROT_WRITE,
+			       MAP_SHARED, in->fd, buf.m.offset);
+		if (maps[i] == MAP_FAILED) {
+			perror("mmap");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int inst_open(struct inst *in, unsigned int id)
+{
+	enum v4l2_buf_type type;
+
+	in->id = id;
+	in->fd = open(device, O_RDWR | O_NONBLOCK);
+	if (in->fd < 0) {
+		perror(device);
+		return -1;
+	}
+	if (set_ctrl(in->fd, CID_TRANS_TIME_MSEC, transtime, "transtime"))
+		return -1;
+	if (id == 0 && mask0 && set_ctrl(in->fd, CID_UNIT_MASK, mask0, "mask"))
+		return -1;
+
+	if (setup_queue(in, V4L2_BUF_TYPE_VIDEO_OUTPUT, in->src) ||
+	    setup_queue(in, V4L2_BUF_TYPE_VIDEO_CAPTURE, in->dst))
+		return -1;
+
+	type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	if (xioctl(in->fd, VIDIOC_STREAMON, &type, "stream on"))
+		return -1;
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	return xioctl(in->fd, VIDIOC_STREAMON, &type, "stream on");
+}
+
+static uint32_t pattern(const struct inst *in, unsigned int frame, size_t i)
+{
+	return (in->id << 24 | frame) ^ (uint32_t)i * 2654435761u;
+}
+
+static int queue(struct inst *in, enum v4l2_buf_type type, unsigned int index)
+{
+	struct v4l2_buffer buf;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.type = type;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = index;
+	if (type == V4L2_BUF_TYPE_VIDEO_OUTPUT)
+		buf.bytesused = in->size;
+	return xioctl(in->fd, VIDIOC_QBUF, &buf, "queue buffer");
+}
+
+/* Queue the next frame of the instance into source buffer @index */
+static int queue_frame(struct inst *in, unsigned int index)
+{
+	uint32_t *p = in->src[index];
+	size_t i;
+
+	for (i = 0; i < in->size / 4; i++)
+		p[i] = pattern(in, in->queued, i);
+	in->queued++;
+	return queue(in, V4L2_BUF_TYPE_VIDEO_OUTPUT, index);
+}
+
+static int dequeue(struct inst *in, enum v4l2_buf_type type,
+		   struct v4l2_buffer *buf)
+{
+	memset(buf, 0, sizeof(*buf));
+	buf->type = type;
+	buf->memory = V4L2_MEMORY_MMAP;
+	if (ioctl(in->fd, VIDIOC_DQBUF, buf) == 0)
+		return 1;
+	if (errno == EAGAIN)
+		return 0;
+	fprintf(stderr, "dequeue buffer: %s\n", strerror(errno));
+	return -1;
+}
+
+/* Check the next completed frame: it must be the oldest one queued */
+static int check_frame(struct inst *in, unsigned int index)
+{
+	const uint32_t *p = in->dst[index];
+	size_t i;
+
+	for (i = 0; i < in->size / 4; i++)
+		if (p[i] != pattern(in, in->done, i)) {
+			fprintf(stderr, "instance %u: frame %u, word %zu is 0x%08x, expected 0x%08x\n",
+				in->id, in->done, i, p[i],
+				pattern(in, in->done, i));
+			return -1;
+		}
+	in->done++;
+	return 0;
+}
+
+static int inst_service(struct inst *in)
+{
+	struct v4l2_buffer buf;
+	int ret;
+
+	while ((ret = dequeue(in, V4L2_BUF_TYPE_VIDEO_CAPTURE, &buf)) > 0) {
+		if (check_frame(in, buf.index))
+			return -1;
+		if (in->done == frames)
+			in->end_ns = now_ns();
+		else if (queue(in, V4L2_BUF_TYPE_VIDEO_CAPTURE, buf.index))
+			return -1;
+	}
+	if (ret < 0)
+		return -1;
+
+	while ((ret = dequeue(in, V4L2_BUF_TYPE_VIDEO_OUTPUT, &buf)) > 0)
+		if (in->queued < frames && queue_frame(in, buf.index))
+			return -1;
+	return ret;
+}
+
+static void print_stats(void)
+{
+	char line[256];
+	FILE *f;
+
+	f = fopen(stats, "r");
+	if (!f) {
+		fprintf(stderr, "%s: %s\n", stats, strerror(errno));
+		return;
+	}
+	while (fgets(line, sizeof(line), f))
+		fputs(line, stdout);
+	fclose(f);
+}
+
+static void reset_stats(void)
+{
+	FILE *f = fopen(stats, "w");
+
+	if (f) {
+		fputs("0\n", f);
+		fclose(f);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct pollfd pfd[MAX_INST];
+	unsigned int i, left;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "d:f:m:n:s:t:")) != -1) {
+		switch (opt) {
+		case 'd':
+			device = optarg;
+			break;
+		case 'f':
+			frames = atoi(optarg);
+			break;
+		case 'm':
+			mask0 = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			ninst = atoi(optarg);
+			break;
+		case 's':
+			stats = optarg;
+			break;
+		case 't':
+			transtime = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-d device] [-f frames] [-m instance 0 engine mask] [-n instances] [-s stats file] [-t msec]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (ninst < 1 || ninst > MAX_INST || frames < 1) {
+		fprintf(stderr, "-n must be 1..%d and -f at least 1\n", MAX_INST);
+		return 1;
+	}
+
+	for (i = 0; i < ninst; i++)
+		if (inst_open(&inst[i], i))
+			return 1;
+
+	printf("%u instances x %u frames of %ux%u, %u ms per job\n",
+	       ninst, frames, width, height, transtime);
+	reset_stats();
+
+	for (i = 0; i < ninst; i++) {
+		unsigned int b;
+
+		inst[i].start_ns = now_ns();
+		for (b = 0; b < NUM_BUFS; b++)
+			if (queue(&inst[i], V4L2_BUF_TYPE_VIDEO_CAPTURE, b) ||
+			    (inst[i].queued < frames && queue_frame(&inst[i], b)))
+				return 1;
+		pfd[i].fd = inst[i].fd;
+		pfd[i].events = POLLIN | POLLOUT;
+	}
+
+	do {
+		if (poll(pfd, ninst, 10000) <= 0) {
+			fprintf(stderr, "timed out waiting for frames\n");
+			ret = 1;
+			break;
+		}
+		left = 0;
+		for (i = 0; i < ninst; i++) {
+			if (inst[i].done == frames)
+				continue;
+			if (pfd[i].revents && inst_service(&inst[i])) {
+				ret = 1;
+				break;
+			}
+			if (inst[i].done < frames)
+				left++;
+			else
+				pfd[i].fd = -1;
+		}
+	} while (!ret && left);
+
+	for (i = 0; i < ninst; i++) {
+		double s = (inst[i].end_ns - inst[i].start_ns) / 1e9;
+
+		if (inst[i].done == frames)
+			printf("instance %u: %u frames in order, %.1f fps\n",
+			       i, frames, frames / s);
+		else
+			printf("instance %u: %u of %u frames\n",
+			       i, inst[i].done, frames);
+		close(inst[i].fd);
+	}
+	print_stats();
+	printf("%s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
@@ -0,0 +1,204 @@
+/*
+ * mfc-mem-test.c -- s5p-mfc memory reclaim measurement
+ *
+ * The memory ports of the MFC draw their buffers from contiguous memory
+ * areas, which hold movable pages (mostly page cache) while the MFC is
+ * idle and are reclaimed as the driver allocates.  This program shows the
+ * memory available to user space and the usage of both areas while the
+ * MFC is idle, after the decoder has been opened (which loads the
+ * firmware), once stream buffers have been allocated as for playback,
+ * and again after the decoder is closed.  The time taken by the open and
+ * by the buffer allocation, which includes migrating the pages out of the
+ * areas, is printed with the reclaim times kept by the kernel.  With -f a
+ * file is read first so that the page cache fills the areas.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -o mfc-mem-test mfc-mem-test.c */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+static const char *device = "/dev/video0";
+static const char *stats = "/sys/devices/platform/s5p-mfc/mem_stats";
+static const char *fill;
+static unsigned int nbufs = 8;
+static unsigned int bufsize = 1 << 20;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static int xioctl(int fd, unsigned long request, void *arg, const char *what)
+{
+	int ret;
+
+	do
+		ret = ioctl(fd, request, arg);
+	while (ret && errno == EINTR);
+	if (ret)
+		fprintf(stderr, "%s: %s\n", what, strerror(errno));
+	return ret;
+}
+
+static long meminfo(const char *key)
+{
+	char line[128];
+	size_t len = strlen(key);
+	long kb = -1;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+		if (!strncmp(line, key, len) && line[len] == ':') {
+			kb = strtol(line + len + 1, NULL, 10);
+			break;
+		}
+	fclose(f);
+	return kb;
+}
+
+static long idle_free = -1;
+
+static void report(const char *phase)
+{
+	char line[256];
+	long memfree = meminfo("MemFree"), cached = meminfo("Cached");
+	FILE *f;
+
+	if (idle_free < 0)
+		idle_free = memfree + cached;
+	printf("%s:\n  MemFree %ld KiB, Cached %ld KiB, %+ld KiB from idle\n",
+	       phase, memfree, cached, memfree + cached - idle_free);
+	f = fopen(stats, "r");
+	if (!f) {
+		perror(stats);
+		return;
+	}
+	while (fgets(line, sizeof(line), f))
+		printf("  %s", line);
+	fclose(f);
+}
+
+/* Read @fill so that its pages are cached, some of them in the areas */
+static void fill_cache(void)
+{
+	static char buf[1 << 16];
+	ssize_t n;
+	int fd;
+
+	fd = open(fill, O_RDONLY);
+	if (fd < 0) {
+		perror(fill);
+		return;
+	}
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		;
+	close(fd);
+}
+
+static int request_buffers(int fd, unsigned int count)
+{
+	struct v4l2_requestbuffers req;
+
+	memset(&req, 0, sizeof(req));
+	req.count = count;
+	req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	req.memory = V4L2_MEMORY_MMAP;
+	if (xioctl(fd, VIDIOC_REQBUFS, &req, "request buffers"))
+		return -1;
+	return req.count;
+}
+
+int main(int argc, char **argv)
+{
+	struct v4l2_format fmt;
+	uint64_t t;
+	int fd, n, opt;
+
+	while ((opt = getopt(argc, argv, "b:d:f:n:s:")) != -1) {
+		switch (opt) {
+		case 'b':
+			bufsize = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			device = optarg;
+			break;
+		case 'f':
+			fill = optarg;
+			break;
+		case 'n':
+			nbufs = atoi(optarg);
+			break;
+		case 's':
+			stats = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-d decoder] [-s mem_stats] [-f file] [-n buffers] [-b buffer size]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (nbufs < 1 || bufsize < 4096) {
+		fprintf(stderr, "-n must be at least 1, -b at least 4096\n");
+		return 1;
+	}
+
+	if (fill)
+		fill_cache();
+	report("idle");
+
+	t = now_us();
+	fd = open(device, O_RDWR);
+	if (fd < 0) {
+		perror(device);
+		return 1;
+	}
+	t = now_us() - t;
+	report("opened");
+	printf("  open took %llu us\n", (unsigned long long)t);
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	fmt.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_H264;
+	fmt.fmt.pix_mp.num_planes = 1;
+	fmt.fmt.pix_mp.plane_fmt[0].sizeimage = bufsize;
+	if (xioctl(fd, VIDIOC_S_FMT, &fmt, "set format")) {
+		close(fd);
+		return 1;
+	}
+	t = now_us();
+	n = request_buffers(fd, nbufs);
+	t = now_us() - t;
+	if (n < 0) {
+		close(fd);
+		return 1;
+	}
+	report("playing");
+	printf("  %d stream buffers of %u KiB took %llu us\n",
+	       n, fmt.fmt.pix_mp.plane_fmt[0].sizeimage >> 10,
+	       (unsigned long long)t);
+
+	request_buffers(fd, 0);
+	close(fd);
+	report("closed");
+	return 0;
+}
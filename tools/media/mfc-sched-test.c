@@ -0,0 +1,298 @@
+/*
+ * mfc-sched-test.c -- s5p-mfc scheduler simulation
+ *
+ * Builds the scheduler of the s5p-mfc driver (s5p_mfc_sched.c) into a
+ * simulation of the MFC: one command runs at a time, each stream has a
+ * fixed decode time per frame, and the interrupt at the end of a command
+ * charges it and starts the next one, as s5p_mfc_irq() and
+ * s5p_mfc_try_run() do.  Streams either queue frames at a fixed rate, or
+ * keep their queue full to decode as fast as possible.  Each scenario is
+ * run with the scheduler and with the plain round robin the driver used
+ * before, and the share of hardware time, frame rate and latency of each
+ * stream is printed.  The run fails if the scheduler does not split the
+ * hardware time of the streams decoding flat out by weight, or lets a
+ * real time stream fall behind.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -o mfc-sched-test mfc-sched-test.c */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+
+#include "../../drivers/media/video/s5p-mfc/s5p_mfc_sched.c"
+
+#define QLEN		8
+#define MAX_STREAMS	MFC_NUM_CONTEXTS
+
+struct stream {
+	const char *name;
+	unsigned int cost_us;	/* hardware time per frame */
+	unsigned int period_us;	/* 0: keeps its queue full */
+	unsigned int weight;
+
+	u64 queued[QLEN];
+	unsigned int head, count;
+	u64 next_arrival;
+
+	u64 busy_us, frames, drops;
+	u64 latency_us, max_latency_us;
+};
+
+struct scenario {
+	const char *name;
+	unsigned int nstreams;
+	struct stream streams[MAX_STREAMS];
+};
+
+static struct scenario scenarios[] = {
+	{
+		/* A large and a small stream, both decoding flat out */
+		.name = "unequal frames",
+		.nstreams = 2,
+		.streams = {
+			{ .name = "1080p", .cost_us = 30000, .weight = 4 },
+			{ .name = "cif", .cost_us = 5000, .weight = 4 },
+		},
+	},
+	{
+		/* Same streams, one given three times the share */
+		.name = "weights 1:3",
+		.nstreams = 2,
+		.streams = {
+			{ .name = "low", .cost_us = 10000, .weight = 2 },
+			{ .name = "high", .cost_us = 10000, .weight = 6 },
+		},
+	},
+	{
+		/* Picture in picture at 30 fps next to a transcode */
+		.name = "pip",
+		.nstreams = 3,
+		.streams = {
+			{ .name = "main", .cost_us = 18000, .period_us = 33333,
+			  .weight = 4 },
+			{ .name = "pip", .cost_us = 3000, .period_us = 33333,
+			  .weight = 4 },
+			{ .name = "transcode", .cost_us = 12000, .weight = 1 },
+		},
+	},
+};
+
+static u64 duration_us = 10000000;
+
+static void push(struct stream *st, u64 now)
+{
+	if (st->count == QLEN) {
+		st->drops++;
+		return;
+	}
+	st->queued[(st->head + st->count) % QLEN] = now;
+	st->count++;
+}
+
+static u64 pop(struct stream *st)
+{
+	u64 t = st->queued[st->head];
+
+	st->head = (st->head + 1) % QLEN;
+	st->count--;
+	return t;
+}
+
+/* The round robin of the driver before the scheduler */
+static int rr_pick(int *last, unsigned long ready)
+{
+	int n = *last, cnt = 0;
+
+	do {
+		n = (n + 1) % MFC_NUM_CONTEXTS;
+		if (++cnt > MFC_NUM_CONTEXTS)
+			return -1;
+	} while (!(ready & (1UL << n)));
+	*last = n;
+	return n;
+}
+
+static void simulate(struct scenario *sc, int use_sched)
+{
+	struct s5p_mfc_sched s;
+	struct stream *st;
+	unsigned long ready;
+	u64 now = 0, hw_end = 0, next;
+	int running = -1, last = MFC_NUM_CONTEXTS - 1;
+	unsigned int i;
+
+	s5p_mfc_sched_init(&s);
+	for (i = 0; i < sc->nstreams; i++) {
+		st = &sc->streams[i];
+		st->head = st->count = 0;
+		st->busy_us = st->frames = st->drops = 0;
+		st->latency_us = st->max_latency_us = 0;
+		st->next_arrival = 0;
+		s5p_mfc_sched_set_weight(&s, i, st->weight);
+		if (!st->period_us)
+			while (st->count < QLEN)
+				push(st, 0);
+	}
+
+	while (now < duration_us) {
+		/* Interrupt: the command has finished */
+		if (running >= 0 && now == hw_end) {
+			u64 lat;
+
+			st = &sc->streams[running];
+			s5p_mfc_sched_done(&s, now);
+			lat = now - pop(st);
+			s5p_mfc_sched_frame_done(&s, running, lat);
+			st->frames++;
+			st->busy_us += st->cost_us;
+			st->latency_us += lat;
+			if (lat > st->max_latency_us)
+				st->max_latency_us = lat;
+			if (!st->period_us)
+				push(st, now);
+			running = -1;
+		}
+		/* New frames queued by the real time streams */
+		for (i = 0; i < sc->nstreams; i++) {
+			st = &sc->streams[i];
+			if (st->period_us && st->next_arrival == now) {
+				push(st, now);
+				st->next_arrival += st->period_us;
+			}
+		}
+		/* Try to run the next command */
+		ready = 0;
+		for (i = 0; i < sc->nstreams; i++)
+			if (sc->streams[i].count)
+				ready |= 1UL << i;
+		if (running < 0 && ready) {
+			running = use_sched ? s5p_mfc_sched_pick(&s, ready) :
+					      rr_pick(&last, ready);
+			st = &sc->streams[running];
+			hw_end = now + st->cost_us;
+			if (use_sched)
+				s5p_mfc_sched_run(&s, running, st->count,
+						  ready, now);
+		}
+
+		next = running >= 0 ? hw_end : UINT64_MAX;
+		for (i = 0; i < sc->nstreams; i++) {
+			st = &sc->streams[i];
+			if (st->period_us && st->next_arrival < next)
+				next = st->next_arrival;
+		}
+		if (next == UINT64_MAX)
+			break;
+		now = next;
+	}
+}
+
+static void report(struct scenario *sc, const char *how)
+{
+	unsigned int i;
+
+	printf("  %s:\n", how);
+	for (i = 0; i < sc->nstreams; i++) {
+		struct stream *st = &sc->streams[i];
+
+		printf("    %-10s weight %2u: %5.1f%% busy, %6.1f fps, latency %6.1f ms (max %6.1f), %llu dropped\n",
+		       st->name, st->weight,
+		       100.0 * st->busy_us / duration_us,
+		       st->frames * 1e6 / duration_us,
+		       st->frames ? st->latency_us / 1e3 / st->frames : 0.0,
+		       st->max_latency_us / 1e3,
+		       (unsigned long long)st->drops);
+	}
+}
+
+/* Backlogged streams must share the hardware in proportion to weight */
+static int check_shares(struct scenario *sc)
+{
+	unsigned int i, wsum = 0;
+	u64 busy = 0;
+	int ret = 0;
+
+	for (i = 0; i < sc->nstreams; i++) {
+		if (sc->streams[i].period_us)
+			continue;
+		wsum += sc->streams[i].weight;
+		busy += sc->streams[i].busy_us;
+	}
+	for (i = 0; i < sc->nstreams; i++) {
+		struct stream *st = &sc->streams[i];
+		double want, got;
+
+		if (st->period_us || !busy)
+			continue;
+		want = (double)st->weight / wsum;
+		got = (double)st->busy_us / busy;
+		if (got < want - 0.05 || got > want + 0.05) {
+			printf("  %s: %.1f%% of the time, expected %.1f%%\n",
+			       st->name, 100 * got, 100 * want);
+			ret = -1;
+		}
+	}
+	return ret;
+}
+
+/*
+ * Real time streams must keep up without dropping frames. A command can
+ * not be preempted, so a frame may wait for the commands of the other
+ * streams, but must be done within two frame periods of being queued.
+ */
+static int check_realtime(struct scenario *sc)
+{
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < sc->nstreams; i++) {
+		struct stream *st = &sc->streams[i];
+
+		if (!st->period_us)
+			continue;
+		if (st->drops || st->max_latency_us > 2 * st->period_us) {
+			printf("  %s: %llu dropped, max latency %.1f ms\n",
+			       st->name, (unsigned long long)st->drops,
+			       st->max_latency_us / 1e3);
+			ret = -1;
+		}
+	}
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int ret = 0;
+
+	if (argc > 1)
+		duration_us = strtoull(argv[1], NULL, 0) * 1000000ull;
+	if (!duration_us) {
+		fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+		struct scenario *sc = &scenarios[i];
+
+		printf("%s\n", sc->name);
+		simulate(sc, 0);
+		report(sc, "round robin");
+		simulate(sc, 1);
+		report(sc, "scheduler");
+		if (check_shares(sc) || check_realtime(sc))
+			ret = 1;
+	}
+	printf("%s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
@@ -0,0 +1,137 @@
+/*
+ * ump-alloc-bench.c -- UMP allocation latency benchmark
+ *
+ * Allocates and releases UMP buffers through /dev/ump for every power
+ * of two from 4 KiB to 16 MiB and prints the mean, minimum and maximum
+ * allocation latency and the mean release latency for each size.
+ * -c asks for CPU cached buffers, -l for physically linear ones.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -I../../drivers/gpu/arm/ump/common -I../../drivers/gpu/arm/ump/linux -o ump-alloc-bench ump-alloc-bench.c */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef uint32_t u32;
+
+#include "ump_ioctl.h"
+
+#define MIN_SIZE	(4u << 10)
+#define MAX_SIZE	(16u << 20)
+
+static const char *device = "/dev/ump";
+static unsigned int iterations = 20;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int bench(int fd, u32 size, ump_uk_alloc_constraints constraints)
+{
+	uint64_t alloc_total = 0, alloc_min = UINT64_MAX, alloc_max = 0;
+	uint64_t release_total = 0;
+	_ump_uk_allocate_s alloc;
+	_ump_uk_release_s release;
+	uint64_t t0, t1, t2;
+	unsigned int i;
+
+	for (i = 0; i < iterations; i++) {
+		memset(&alloc, 0, sizeof(alloc));
+		alloc.size = size;
+		alloc.constraints = constraints;
+
+		t0 = now_ns();
+		if (ioctl(fd, UMP_IOC_ALLOCATE, &alloc)) {
+			fprintf(stderr, "allocate %u bytes: %s\n", size,
+				strerror(errno));
+			return -1;
+		}
+		t1 = now_ns();
+
+		memset(&release, 0, sizeof(release));
+		release.secure_id = alloc.secure_id;
+		if (ioctl(fd, UMP_IOC_RELEASE, &release)) {
+			fprintf(stderr, "release id %u: %s\n", alloc.secure_id,
+				strerror(errno));
+			return -1;
+		}
+		t2 = now_ns();
+
+		alloc_total += t1 - t0;
+		if (t1 - t0 < alloc_min)
+			alloc_min = t1 - t0;
+		if (t1 - t0 > alloc_max)
+			alloc_max = t1 - t0;
+		release_total += t2 - t1;
+	}
+
+	printf("%8u KiB %11.1f %11.1f %11.1f %11.1f\n", size >> 10,
+	       alloc_total / 1e3 / iterations, alloc_min / 1e3,
+	       alloc_max / 1e3, release_total / 1e3 / iterations);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	ump_uk_alloc_constraints constraints = UMP_REF_DRV_UK_CONSTRAINT_NONE;
+	u32 size;
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "d:n:cl")) != -1) {
+		switch (opt) {
+		case 'd':
+			device = optarg;
+			break;
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 'c':
+			constraints |= UMP_REF_DRV_UK_CONSTRAINT_USE_CACHE;
+			break;
+		case 'l':
+			constraints |= UMP_REF_DRV_UK_CONSTRAINT_PHYSICALLY_LINEAR;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-d device] [-n iterations] [-c] [-l]\n"
+				"  -c  CPU cached buffers\n"
+				"  -l  physically linear buffers\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (!iterations) {
+		fprintf(stderr, "-n must be at least 1\n");
+		return 1;
+	}
+
+	fd = open(device, O_RDWR);
+	if (fd < 0) {
+		perror(device);
+		return 1;
+	}
+
+	printf("%12s %11s %11s %11s %11s\n", "size",
+	       "alloc us", "min us", "max us", "release us");
+	for (size = MIN_SIZE; size <= MAX_SIZE; size <<= 1)
+		if (bench(fd, size, constraints))
+			break;
+
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * umplock-bench.c -- umplock ioctl load generator
+ *
+ * Runs create/process/release cycles on /dev/umplock from 1, 2 and 4
+ * threads and prints the lock/unlock cycles per second for each thread
+ * count. Each thread works on its own secure ids unless -s is given, in
+ * which case all threads fight over the same one.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -I../../drivers/gpu/arm/umplock -o umplock-bench umplock-bench.c -lpthread */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "umplock_ioctl.h"
+
+#define MAX_THREADS 4
+
+static const char *device = "/dev/umplock";
+static unsigned int seconds = 2;
+static unsigned int ids_per_thread = 64;
+static int shared;
+
+static volatile int stop;
+
+struct worker {
+	pthread_t thread;
+	int fd;
+	unsigned int index;
+	uint64_t cycles;
+	int error;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	_lock_item_s item;
+	unsigned int i = 0;
+
+	memset(&item, 0, sizeof(item));
+	item.usage = _LOCK_ACCESS_TEXTURE;
+
+	while (!stop) {
+		if (shared)
+			item.secure_id = 1;
+		else
+			item.secure_id = 1 + w->index * ids_per_thread +
+					 i++ % ids_per_thread;
+
+		if (ioctl(w->fd, LOCK_IOCTL_CREATE, &item) ||
+		    ioctl(w->fd, LOCK_IOCTL_PROCESS, &item) ||
+		    ioctl(w->fd, LOCK_IOCTL_RELEASE, &item)) {
+			w->error = errno;
+			break;
+		}
+		w->cycles++;
+	}
+
+	return NULL;
+}
+
+static int run(int fd, unsigned int nthreads)
+{
+	struct worker workers[MAX_THREADS];
+	uint64_t t0, t1, cycles = 0;
+	unsigned int i;
+
+	memset(workers, 0, sizeof(workers));
+	stop = 0;
+
+	t0 = now_ns();
+	for (i = 0; i < nthreads; i++) {
+		workers[i].fd = fd;
+		workers[i].index = i;
+		if (pthread_create(&workers[i].thread, NULL, worker_fn,
+				   &workers[i])) {
+			perror("pthread_create");
+			return -1;
+		}
+	}
+
+	sleep(seconds);
+	stop = 1;
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (workers[i].error) {
+			fprintf(stderr, "thread %u: ioctl: %s\n", i,
+				strerror(workers[i].error));
+			return -1;
+		}
+		cycles += workers[i].cycles;
+	}
+	t1 = now_ns();
+
+	printf("%7u %14.0f %14.0f\n", nthreads,
+	       cycles * 1e9 / (t1 - t0),
+	       cycles * 1e9 / (t1 - t0) / nthreads);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned int thread_counts[] = { 1, 2, MAX_THREADS };
+	unsigned int i;
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "d:t:n:s")) != -1) {
+		switch (opt) {
+		case 'd':
+			device = optarg;
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'n':
+			ids_per_thread = atoi(optarg);
+			break;
+		case 's':
+			shared = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-d device] [-t seconds] [-n ids per thread] [-s]\n"
+				"  -s  all threads lock the same secure id\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (!seconds || !ids_per_thread) {
+		fprintf(stderr, "-t and -n must be at least 1\n");
+		return 1;
+	}
+
+	fd = open(device, O_RDWR);
+	if (fd < 0) {
+		perror(device);
+		return 1;
+	}
+
+	printf("threads   lock+unlock/s  per thread/s\n");
+	for (i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++)
+		if (run(fd, thread_counts[i]))
+			break;
+
+	close(fd);
+	return 0;
+}
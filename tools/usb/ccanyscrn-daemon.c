@@ -0,0 +1,195 @@
+/*
+ * ccanyscrn-daemon.c -- stub AnyScreen daemon for transport benchmarking
+ *
+ * Serves every request from /dev/ccanyscrn with a fixed pattern (reads)
+ * or by discarding the data (writes), either through the legacy
+ * read()/write() protocol or through the shared ring, and prints the
+ * throughput and the mean per-block service latency once a second.
+ * Per-session request counters are in /sys/kernel/debug/ccanyscrn/stats.
+ * Drive it from the host side, e.g. with dd on the gadget's disk when
+ * the gadget is bound to dummy_hcd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -g -o ccanyscrn-daemon ccanyscrn-daemon.c */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../include/linux/usb/ccanyscrn.h"
+
+static const char *device = "/dev/ccanyscrn";
+
+struct stats {
+	uint64_t bytes;
+	uint64_t blocks;
+	uint64_t service_ns;
+	uint64_t start_ns;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void account(struct stats *st, uint32_t len, uint64_t t0)
+{
+	uint64_t t = now_ns();
+
+	st->bytes += len;
+	st->blocks += (len + CC_USB_BLOCK_SIZE - 1) / CC_USB_BLOCK_SIZE;
+	st->service_ns += t - t0;
+
+	if (t - st->start_ns >= 1000000000ull) {
+		double secs = (t - st->start_ns) / 1e9;
+
+		printf("%8.2f MB/s  %8.2f us/block\n",
+		       st->bytes / secs / 1e6,
+		       st->blocks ? st->service_ns / 1e3 / st->blocks : 0.0);
+		memset(st, 0, sizeof(*st));
+		st->start_ns = t;
+	}
+}
+
+static void serve(uint32_t type, void *buf, uint32_t len)
+{
+	if (type == CC_REQ_READ)
+		memset(buf, 0x5a, len);
+}
+
+static int run_legacy(int fd)
+{
+	static unsigned char buf[CC_ANYSCREEN_BATCH_SIZE];
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	struct stats st = { .start_ns = now_ns() };
+
+	for (;;) {
+		unsigned long req[3];
+		uint64_t t0;
+
+		if (poll(&pfd, 1, -1) < 0)
+			return -errno;
+		t0 = now_ns();
+		if (read(fd, req, sizeof(req)) != sizeof(req))
+			return -EIO;
+		if (req[0] == CC_REQ_NONE)
+			continue;
+		if (req[2] > sizeof(buf))
+			return -EINVAL;
+
+		if (req[0] == CC_REQ_READ) {
+			serve(req[0], buf, req[2]);
+			if (write(fd, buf, req[2]) < 0)
+				return -errno;
+		} else if (read(fd, buf, req[2]) < 0) {
+			return -errno;
+		}
+		ioctl(fd, CC_ANYSCREEN_IOCTL_BLOCK_DONE, 0);
+		account(&st, req[2], t0);
+	}
+}
+
+static int run_ring(int fd)
+{
+	struct cc_anyscreen_ring *ring;
+	struct stats st = { .start_ns = now_ns() };
+	size_t size;
+	int efd;
+
+	size = sysconf(_SC_PAGESIZE);
+	size = (sizeof(*ring) + size - 1) / size * size +
+		CC_ANYSCREEN_ARENA_SIZE;
+	ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED)
+		return -errno;
+
+	efd = eventfd(0, 0);
+	if (efd < 0)
+		return -errno;
+	if (ioctl(fd, CC_ANYSCREEN_IOCTL_RING_ENABLE, efd) < 0)
+		return -errno;
+
+	for (;;) {
+		volatile uint32_t *head = &ring->head;
+		uint64_t events, t0;
+
+		if (read(efd, &events, sizeof(events)) != sizeof(events))
+			return -EIO;
+		t0 = now_ns();
+
+		while (ring->tail != *head) {
+			struct cc_anyscreen_ring_desc *d;
+
+			__sync_synchronize();
+			d = &ring->desc[ring->tail % ring->entries];
+			serve(d->type, (char *)ring + ring->arena_offset +
+			      d->offset, d->len);
+			d->status = 0;
+			__sync_synchronize();
+			ring->tail++;
+			ioctl(fd, CC_ANYSCREEN_IOCTL_RING_DONE, 0);
+			account(&st, d->len, t0);
+			t0 = now_ns();
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int legacy = 0, batch = 0;
+	int fd, i, ret;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-l")) {
+			legacy = 1;
+		} else if (!strcmp(argv[i], "-b")) {
+			batch = 1;
+		} else {
+			fprintf(stderr, "usage: %s [-l] [-b]\n"
+				"  -l  use the read()/write() protocol\n"
+				"  -b  negotiate batch mode\n", argv[0]);
+			return 1;
+		}
+	}
+
+	fd = open(device, O_RDWR);
+	if (fd < 0) {
+		perror(device);
+		return 1;
+	}
+	if (ioctl(fd, CC_ANYSCREEN_IOCTL_READY, 0) < 0) {
+		perror("CC_ANYSCREEN_IOCTL_READY");
+		return 1;
+	}
+
+	if (batch) {
+		ret = ioctl(fd, CC_ANYSCREEN_IOCTL_BATCH_MODE,
+			    CC_ANYSCREEN_RUN_MAX);
+		if (ret < 0) {
+			perror("CC_ANYSCREEN_IOCTL_BATCH_MODE");
+			return 1;
+		}
+		printf("batch mode, runs of up to %d bytes\n", ret);
+	}
+
+	ret = legacy ? run_legacy(fd) : run_ring(fd);
+	fprintf(stderr, "%s: %s\n", argv[0], strerror(-ret));
+	return 1;
+}